@@ -0,0 +1,209 @@
+/*------------------------------------------------------------------*/
+/* arena.c                                                          */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {MIN_CHUNK_SIZE = 4096};
+
+/*------------------------------------------------------------------*/
+
+/* A Chunk is a block of memory obtained from malloc(), from which
+   allocations are carved in order. Its data follows the header. */
+
+struct Chunk
+{
+   /* The number of usable bytes in the chunk. */
+   size_t uSize;
+
+   /* The next chunk, which is used once this one is full. */
+   struct Chunk *psNext;
+};
+
+/* An Arena consists of a list of chunks, the chunk currently being
+   allocated from, and how much of it is in use. */
+
+struct Arena
+{
+   /* The first chunk. Chunks are kept across resets. */
+   struct Chunk *psFirst;
+
+   /* The chunk being allocated from. */
+   struct Chunk *psCurrent;
+
+   /* The number of bytes of psCurrent in use. */
+   size_t uUsed;
+};
+
+/* Allocations are aligned to this type, which is at least as 
+   strictly aligned as any object the shell stores. */
+
+union Align
+{
+   long l;
+   double d;
+   void *pv;
+   void (*pf)(void);
+};
+
+/*------------------------------------------------------------------*/
+
+static size_t roundUp(size_t uSize)
+
+/* Return uSize rounded up to a multiple of the alignment of union
+   Align. */
+
+{
+   size_t uAlign = sizeof(union Align);
+
+   return (uSize + uAlign - 1) / uAlign * uAlign;
+}
+
+/*------------------------------------------------------------------*/
+
+static char *chunkData(struct Chunk *psChunk)
+
+/* Return the first usable byte of psChunk. */
+
+{
+   assert(psChunk != NULL);
+
+   return (char*)psChunk + roundUp(sizeof(struct Chunk));
+}
+
+/*------------------------------------------------------------------*/
+
+Arena_T Arena_new(void)
+
+/* Return a new, empty Arena_T. */
+
+{
+   Arena_T oArena;
+
+   oArena = (struct Arena*)malloc(sizeof(struct Arena));
+   assert(oArena != NULL);
+   oArena->psFirst = NULL;
+   oArena->psCurrent = NULL;
+   oArena->uUsed = 0;
+   return oArena;
+}
+
+/*------------------------------------------------------------------*/
+
+void Arena_free(Arena_T oArena)
+
+/* Free oArena and all memory allocated from it. */
+
+{
+   struct Chunk *psChunk;
+   struct Chunk *psNext;
+
+   if(oArena == NULL)
+      return;
+
+   for(psChunk = oArena->psFirst; psChunk != NULL; psChunk = psNext)
+   {
+      psNext = psChunk->psNext;
+      free(psChunk);
+   }
+   free(oArena);
+}
+
+/*------------------------------------------------------------------*/
+
+void *Arena_alloc(Arena_T oArena, size_t uSize)
+
+/* Return a pointer to uSize bytes allocated from oArena, suitably
+   aligned for any type. The memory remains valid until oArena is 
+   reset or freed. It is a checked runtime error for oArena to be
+   NULL. */
+
+{
+   struct Chunk *psChunk;
+   struct Chunk **ppsLink;
+   size_t uChunkSize;
+   void *pvBlock;
+
+   assert(oArena != NULL);
+
+   uSize = roundUp(uSize);
+
+   /* Use the rest of the current chunk if it suffices. Otherwise
+      move to the first following chunk that is large enough, which
+      a previous line may have left behind. */
+   if(oArena->psCurrent != NULL &&
+      oArena->uUsed + uSize <= oArena->psCurrent->uSize)
+   {
+      pvBlock = chunkData(oArena->psCurrent) + oArena->uUsed;
+      oArena->uUsed += uSize;
+      return pvBlock;
+   }
+
+   if(oArena->psCurrent == NULL)
+      ppsLink = &oArena->psFirst;
+   else
+      ppsLink = &oArena->psCurrent->psNext;
+   while(*ppsLink != NULL && (*ppsLink)->uSize < uSize)
+      ppsLink = &(*ppsLink)->psNext;
+
+   if(*ppsLink == NULL)
+   {
+      uChunkSize = MIN_CHUNK_SIZE;
+      if(oArena->psCurrent != NULL)
+         uChunkSize = oArena->psCurrent->uSize * 2;
+      if(uChunkSize < uSize)
+         uChunkSize = uSize;
+
+      psChunk = (struct Chunk*)malloc(roundUp(sizeof(struct Chunk)) +
+                                      uChunkSize);
+      assert(psChunk != NULL);
+      psChunk->uSize = uChunkSize;
+      psChunk->psNext = NULL;
+      *ppsLink = psChunk;
+   }
+
+   oArena->psCurrent = *ppsLink;
+   oArena->uUsed = uSize;
+   return chunkData(oArena->psCurrent);
+}
+
+/*------------------------------------------------------------------*/
+
+char *Arena_strdup(Arena_T oArena, const char *pcString)
+
+/* Return a copy of string pcString allocated from oArena. It is a
+   checked runtime error for oArena or pcString to be NULL. */
+
+{
+   char *pcCopy;
+   size_t uLength;
+
+   assert(oArena != NULL);
+   assert(pcString != NULL);
+
+   uLength = strlen(pcString) + 1;
+   pcCopy = (char*)Arena_alloc(oArena, uLength);
+   memcpy(pcCopy, pcString, uLength);
+   return pcCopy;
+}
+
+/*------------------------------------------------------------------*/
+
+void Arena_reset(Arena_T oArena)
+
+/* Release all memory allocated from oArena in constant time, keeping
+   it for reuse. It is a checked runtime error for oArena to be 
+   NULL. */
+
+{
+   assert(oArena != NULL);
+
+   oArena->psCurrent = oArena->psFirst;
+   oArena->uUsed = 0;
+}
@@ -0,0 +1,38 @@
+/*------------------------------------------------------------------*/
+/* arena.h                                                          */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef ARENA_INCLUDED
+#define ARENA_INCLUDED
+
+#include <stddef.h>
+
+typedef struct Arena *Arena_T;
+/* An Arena_T is a bump-pointer allocator. Its memory is released 
+   all at once by Arena_reset(), and is then reused, so an Arena_T
+   that is reset after every input line stops calling malloc() once
+   it has grown to fit the largest line. */
+
+Arena_T Arena_new(void);
+/* Return a new, empty Arena_T. */
+
+void Arena_free(Arena_T oArena);
+/* Free oArena and all memory allocated from it. */
+
+void *Arena_alloc(Arena_T oArena, size_t uSize);
+/* Return a pointer to uSize bytes allocated from oArena, suitably
+   aligned for any type. The memory remains valid until oArena is 
+   reset or freed. It is a checked runtime error for oArena to be
+   NULL. */
+
+char *Arena_strdup(Arena_T oArena, const char *pcString);
+/* Return a copy of string pcString allocated from oArena. It is a
+   checked runtime error for oArena or pcString to be NULL. */
+
+void Arena_reset(Arena_T oArena);
+/* Release all memory allocated from oArena in constant time, keeping
+   it for reuse. It is a checked runtime error for oArena to be 
+   NULL. */
+
+#endif                      /* ARENA_INCLUDED */
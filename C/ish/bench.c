@@ -0,0 +1,179 @@
+/*------------------------------------------------------------------*/
+/* bench.c                                                          */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+/* The number of calls of malloc(), calloc(), and realloc() so 
+   far. */
+static long lNumAllocs = 0;
+
+/*------------------------------------------------------------------*/
+
+/* Count allocations by interposing on the allocator. This relies on
+   the __libc_ entry points of the GNU C library. */
+
+extern void *__libc_malloc(size_t uSize);
+extern void *__libc_calloc(size_t uCount, size_t uSize);
+extern void *__libc_realloc(void *pvBlock, size_t uSize);
+
+void *malloc(size_t uSize)
+{
+   lNumAllocs++;
+   return __libc_malloc(uSize);
+}
+
+void *calloc(size_t uCount, size_t uSize)
+{
+   lNumAllocs++;
+   return __libc_calloc(uCount, uSize);
+}
+
+void *realloc(void *pvBlock, size_t uSize)
+{
+   lNumAllocs++;
+   return __libc_realloc(pvBlock, uSize);
+}
+
+/*------------------------------------------------------------------*/
+
+long benchAllocs(void)
+
+/* Return the number of calls of malloc(), calloc(), and realloc() 
+   the program has made so far. */
+
+{
+   return lNumAllocs;
+}
+
+/*------------------------------------------------------------------*/
+
+double benchNow(void)
+
+/* Return the current time of a monotonic clock, in seconds. */
+
+{
+   struct timespec sNow;
+   int iRet;
+
+   iRet = clock_gettime(CLOCK_MONOTONIC, &sNow);
+   assert(iRet == 0);
+   return (double)sNow.tv_sec + (double)sNow.tv_nsec / 1e9;
+}
+
+/*------------------------------------------------------------------*/
+
+void benchHeader(void)
+
+/* Write to stdout the line that names the fields of result lines. 
+   It starts with '#', so scripts can skip it. */
+
+{
+   printf("#name\tvariant\tops\tseconds\tns_per_op\tops_per_sec\t"
+          "allocs_per_op\tmb_per_sec\n");
+}
+
+/*------------------------------------------------------------------*/
+
+void benchReport(const char *pcName, const char *pcVariant,
+                 long lNumOps, double dSeconds, long lNumAllocs,
+                 double dNumBytes)
+
+/* Write one result line to stdout for benchmark pcName run as 
+   pcVariant, which performed lNumOps operations in dSeconds seconds
+   with lNumAllocs allocations, processing dNumBytes bytes. The 
+   fields are tab-separated so scripts can track them across builds.
+   It is a checked runtime error for pcName or pcVariant to be NULL.
+   It is a checked runtime error for lNumOps to be non-positive. */
+
+{
+   assert(pcName != NULL);
+   assert(pcVariant != NULL);
+   assert(lNumOps > 0);
+
+   printf("%s\t%s\t%ld\t%.6f\t%.1f\t%.1f\t%.2f\t%.1f\n", pcName, 
+          pcVariant, lNumOps, dSeconds, 
+          dSeconds * 1e9 / (double)lNumOps, 
+          (double)lNumOps / dSeconds, 
+          (double)lNumAllocs / (double)lNumOps,
+          dNumBytes / 1e6 / dSeconds);
+   fflush(stdout);
+}
+
+/*------------------------------------------------------------------*/
+
+void benchLatencyHeader(void)
+
+/* Write to stdout the line that names the fields of latency lines.
+   It starts with '#', so scripts can skip it. */
+
+{
+   printf("#name\tvariant\tsamples\tp50_ns\tp90_ns\tp99_ns\tmax_ns\n");
+}
+
+/*------------------------------------------------------------------*/
+
+static int compareSeconds(const void *pvSeconds1, 
+                          const void *pvSeconds2)
+
+/* Return -1, 0, or 1 as the double at pvSeconds1 is less than, equal
+   to, or greater than the double at pvSeconds2. */
+
+{
+   double d1 = *(const double*)pvSeconds1;
+   double d2 = *(const double*)pvSeconds2;
+
+   return (d1 > d2) - (d1 < d2);
+}
+
+/*------------------------------------------------------------------*/
+
+static double getPercentile(const double *pdSorted, long lNumSamples,
+                            int iPercent)
+
+/* Return the iPercent-th percentile of the lNumSamples sorted times
+   in pdSorted, by the nearest rank, in ns. */
+
+{
+   long lRank;
+
+   lRank = (lNumSamples * iPercent + 99) / 100;
+   if(lRank < 1)
+      lRank = 1;
+   return pdSorted[lRank - 1] * 1e9;
+}
+
+/*------------------------------------------------------------------*/
+
+void benchLatency(const char *pcName, const char *pcVariant,
+                  double *pdSamples, long lNumSamples)
+
+/* Write one latency line to stdout for benchmark pcName run as
+   pcVariant, whose operations took the lNumSamples times in seconds
+   in pdSamples, which are sorted in place. It is a checked runtime 
+   error for pcName, pcVariant, or pdSamples to be NULL. It is a 
+   checked runtime error for lNumSamples to be non-positive. */
+
+{
+   assert(pcName != NULL);
+   assert(pcVariant != NULL);
+   assert(pdSamples != NULL);
+   assert(lNumSamples > 0);
+
+   qsort(pdSamples, (size_t)lNumSamples, sizeof(double), 
+         compareSeconds);
+   printf("%s\t%s\t%ld\t%.1f\t%.1f\t%.1f\t%.1f\n", pcName, pcVariant,
+          lNumSamples, getPercentile(pdSamples, lNumSamples, 50),
+          getPercentile(pdSamples, lNumSamples, 90),
+          getPercentile(pdSamples, lNumSamples, 99),
+          pdSamples[lNumSamples - 1] * 1e9);
+   fflush(stdout);
+}
@@ -0,0 +1,47 @@
+/*------------------------------------------------------------------*/
+/* bench.h                                                          */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef BENCH_INCLUDED
+#define BENCH_INCLUDED
+
+double benchNow(void);
+/* Return the current time of a monotonic clock, in seconds. */
+
+long benchAllocs(void);
+/* Return the number of calls of malloc(), calloc(), and realloc() 
+   the program has made so far. */
+
+void benchHeader(void);
+/* Write to stdout the line that names the fields of result lines. 
+   It starts with '#', so scripts can skip it. */
+
+void benchReport(const char *pcName, const char *pcVariant,
+                 long lNumOps, double dSeconds, long lNumAllocs,
+                 double dNumBytes);
+/* Write one result line to stdout for benchmark pcName run as 
+   pcVariant, which performed lNumOps operations in dSeconds seconds
+   with lNumAllocs allocations, processing dNumBytes bytes. The 
+   fields are tab-separated so scripts can track them across builds:
+   name, variant, operations, seconds, ns per operation, operations
+   per second, allocations per operation, and megabytes per second,
+   which is 0 if dNumBytes is. It is a checked runtime error for 
+   pcName or pcVariant to be NULL. It is a checked runtime error for
+   lNumOps to be non-positive. */
+
+void benchLatencyHeader(void);
+/* Write to stdout the line that names the fields of latency lines.
+   It starts with '#', so scripts can skip it. */
+
+void benchLatency(const char *pcName, const char *pcVariant,
+                  double *pdSamples, long lNumSamples);
+/* Write one latency line to stdout for benchmark pcName run as
+   pcVariant, whose operations took the lNumSamples times in seconds
+   in pdSamples, which are sorted in place. The fields are 
+   tab-separated: name, variant, samples, and the 50th, 90th, and 
+   99th percentiles and the maximum, in ns. It is a checked runtime 
+   error for pcName, pcVariant, or pdSamples to be NULL. It is a 
+   checked runtime error for lNumSamples to be non-positive. */
+
+#endif                      /* BENCH_INCLUDED */
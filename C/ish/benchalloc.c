@@ -0,0 +1,104 @@
+/*------------------------------------------------------------------*/
+/* benchalloc.c                                                     */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#include "dynarray.h"
+#include "arena.h"
+#include "lexi.h"
+#include "parse.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {DEFAULT_LINES = 200000};
+
+/*------------------------------------------------------------------*/
+
+/* The lines of the synthetic script, which is these lines repeated
+   in order. */
+static const char *apcScript[] =
+{
+   "ls -l -a /usr/bin",
+   "grep -n \"some pattern\" file1.c file2.c > matches.txt",
+   "sort < input.txt | uniq -c | sort -rn | head -20 > top.txt",
+   "cc -O2 -Wall -c exec.c -o exec.o",
+   "echo \"hello world\" \"and more\" plain words here",
+   "cat a b c d e f g h i j k l m n o p | wc -l &"
+};
+
+enum {SCRIPT_LENGTH = sizeof(apcScript) / sizeof(apcScript[0])};
+
+/*------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Lex and parse argv[1] lines (default 200000) of a synthetic script
+   the way performCommand() does, and report the time and the number
+   of allocations per line. The arena and arrays are warmed up with 
+   one pass over the script first, so the count is the steady state.
+   Return 0. */
+
+{
+   char *pcLine;
+   size_t auLength[SCRIPT_LENGTH];
+   size_t uMaxLength = 0;
+   size_t uNumBytes = 0;
+   size_t u;
+   DynArray_T oCommands;
+   Arena_T oArena;
+   long lNumLines = DEFAULT_LINES;
+   long lAllocsBefore = 0;
+   long l;
+   int iBackground;
+   int iNumTokens;
+   double dStart = 0.0;
+   double dSeconds;
+
+   if(argc > 1)
+      lNumLines = atol(argv[1]);
+   assert(lNumLines > 0);
+   benchHeader();
+
+   for(u = 0; u < SCRIPT_LENGTH; u++)
+   {
+      auLength[u] = strlen(apcScript[u]);
+      if(auLength[u] > uMaxLength)
+         uMaxLength = auLength[u];
+   }
+   pcLine = (char*)malloc(uMaxLength + 1);
+   assert(pcLine != NULL);
+
+   oArena = Arena_new();
+   oCommands = DynArray_new(0);
+
+   for(l = -(long)SCRIPT_LENGTH; l < lNumLines; l++)
+   {
+      if(l == 0)
+      {
+         lAllocsBefore = benchAllocs();
+         dStart = benchNow();
+      }
+      u = (size_t)((l + SCRIPT_LENGTH) % SCRIPT_LENGTH);
+      if(l >= 0)
+         uNumBytes += auLength[u];
+      memcpy(pcLine, apcScript[u], auLength[u] + 1);
+      (void)parseLine(pcLine, auLength[u], oCommands, &iBackground,
+                      &iNumTokens, oArena, "benchalloc");
+      DynArray_clear(oCommands);
+      Arena_reset(oArena);
+   }
+   dSeconds = benchNow() - dStart;
+
+   benchReport("lexparse", "script", lNumLines, dSeconds, 
+               benchAllocs() - lAllocsBefore, (double)uNumBytes);
+
+   DynArray_free(oCommands);
+   Arena_free(oArena);
+   free(pcLine);
+   return 0;
+}
@@ -0,0 +1,111 @@
+/*------------------------------------------------------------------*/
+/* benchbuiltin.c                                                   */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#include "dynarray.h"
+#include "arena.h"
+#include "lexi.h"
+#include "parse.h"
+#include "hist.h"
+#include "exec.h"
+#include "builtin.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+enum {DEFAULT_ITERATIONS = 2000};
+
+/* The commands measured, which a script typically runs many times.
+   Each writes to /dev/null, so only the launch is measured. */
+static const char *apcCommands[] =
+{
+   "echo hello world > /dev/null",
+   "printf %s-%d\\n name 42 > /dev/null",
+   "test -d /tmp",
+   "[ abc = abc ]",
+   "true",
+   "pwd > /dev/null",
+   "cat /etc/hostname > /dev/null"
+};
+
+enum {NUM_COMMANDS = sizeof(apcCommands) / sizeof(apcCommands[0])};
+
+/*------------------------------------------------------------------*/
+
+static void runCommand(const char *pcLine, long lIterations,
+                       int iUtilities, const char *pcVariant)
+
+/* Execute pcLine lIterations times, running utilities in the shell
+   iff iUtilities is TRUE, and report the commands per second as 
+   pcVariant. It is a checked runtime error for pcLine or pcVariant
+   to be NULL. */
+
+{
+   DynArray_T oCommands;
+   History_T oHistList;
+   Arena_T oArena;
+   char *pcCopy;
+   double dStart;
+   long lAllocs;
+   long l;
+   int iSuccessful;
+   int iBackground;
+   int iNumTokens;
+
+   assert(pcLine != NULL);
+   assert(pcVariant != NULL);
+
+   oHistList = History_new(0, NULL);
+   oArena = Arena_new();
+   oCommands = DynArray_new(0);
+   /* parseLine() terminates words within the line it is given. */
+   pcCopy = Arena_strdup(oArena, pcLine);
+   iSuccessful = parseLine(pcCopy, strlen(pcCopy), oCommands,
+                           &iBackground, &iNumTokens, oArena,
+                           "benchbuiltin");
+   assert(iSuccessful);
+
+   builtinSetUtilities(iUtilities);
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(l = 0; l < lIterations; l++)
+      execute(oCommands, iBackground, oHistList, "benchbuiltin");
+   benchReport(pcLine, pcVariant, lIterations, benchNow() - dStart,
+               benchAllocs() - lAllocs, 0.0);
+
+   DynArray_free(oCommands);
+   History_free(oHistList);
+   Arena_free(oArena);
+}
+
+/*------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Compare the commands per second of utilities run as programs and
+   run in the shell. argv[1] is the number of commands per
+   measurement (default 2000). Return 0. */
+
+{
+   long lIterations = DEFAULT_ITERATIONS;
+   size_t u;
+
+   if(argc > 1)
+      lIterations = atol(argv[1]);
+   benchHeader();
+   assert(lIterations > 0);
+
+   for(u = 0; u < NUM_COMMANDS; u++)
+   {
+      runCommand(apcCommands[u], lIterations, FALSE, "external");
+      runCommand(apcCommands[u], lIterations, TRUE, "builtin");
+   }
+   return 0;
+}
@@ -0,0 +1,639 @@
+/*------------------------------------------------------------------*/
+/* benchmicro.c                                                     */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "dynarray.h"
+#include "arena.h"
+#include "lexi.h"
+#include "parse.h"
+#include "hist.h"
+#include "smallarray.h"
+#include "var.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+/* The sizes of the workloads at scale 1. */
+enum {LEX_ITERATIONS = 2000};
+enum {LONG_LINE_SIZE = 8192};
+enum {NUM_SHORT_TOKENS = 2000};
+enum {NUM_ARGS = 4000};
+enum {HISTORY_SIZE = 100000};
+enum {NUM_PREFIXES = 1024};
+enum {ARRAY_SIZE = 200000};
+enum {SORT_THREADS = 4};
+enum {NUM_SEARCHES = 200};
+enum {SHORT_ITERATIONS = 1000000};
+enum {SHORT_LENGTH = 6};
+enum {NUM_VARIABLES = 64};
+enum {LOOKUP_ITERATIONS = 1000000};
+
+/* The orders of the arrays that are sorted. */
+enum Order {ORDER_RANDOM, ORDER_SORTED, ORDER_REVERSED, 
+            ORDER_FEW_VALUES, ORDER_EQUAL, NUM_ORDERS};
+
+static const char *apcOrderNames[NUM_ORDERS] =
+   {"random", "sorted", "reversed", "few_values", "equal"};
+
+/*------------------------------------------------------------------*/
+
+/* The state of the pseudo-random number generator, fixed so every
+   run uses the same workloads. */
+static unsigned long ulRandom = 12345;
+
+/*------------------------------------------------------------------*/
+
+static unsigned long getRandom(void)
+
+/* Return the next pseudo-random number, in [0, 2^31). */
+
+{
+   ulRandom = (ulRandom * 1103515245UL + 12345UL) & 0x7fffffffUL;
+   return ulRandom;
+}
+
+/*------------------------------------------------------------------*/
+
+static char *makeLine(size_t uSize, int iMaxWord, int iQuoted)
+
+/* Return a new line of about uSize characters of random words of 1
+   to iMaxWord letters, separated by spaces and by a '|' between
+   every 8 words. If iQuoted is TRUE, every other word is quoted
+   with embedded spaces. The caller owns the line. */
+
+{
+   char *pcLine;
+   size_t uLength = 0;
+   int iWord = 0;
+   int iLength;
+   int i;
+
+   pcLine = (char*)malloc(uSize + 2 * (size_t)iMaxWord + 16);
+   assert(pcLine != NULL);
+   while(uLength < uSize)
+   {
+      if(iWord > 0)
+         pcLine[uLength++] = ' ';
+      if(iWord > 0 && iWord % 8 == 0)
+      {
+         pcLine[uLength++] = '|';
+         pcLine[uLength++] = ' ';
+      }
+      if(iQuoted && iWord % 2 == 1)
+         pcLine[uLength++] = '"';
+      iLength = 1 + (int)(getRandom() % (unsigned long)iMaxWord);
+      for(i = 0; i < iLength; i++)
+         pcLine[uLength++] = (iQuoted && i % 4 == 3) ? ' ' :
+                             (char)('a' + getRandom() % 26);
+      if(iQuoted && iWord % 2 == 1)
+         pcLine[uLength++] = '"';
+      iWord++;
+   }
+   pcLine[uLength] = '\0';
+   return pcLine;
+}
+
+/*------------------------------------------------------------------*/
+
+static char *makeArgsLine(int iNumArgs)
+
+/* Return a new line of one command with iNumArgs short arguments,
+   with its stdin redirected before them and its stdout amid them.
+   The caller owns the line. */
+
+{
+   char *pcLine;
+   size_t uLength;
+   int i;
+
+   pcLine = (char*)malloc(16 * (size_t)iNumArgs + 64);
+   assert(pcLine != NULL);
+   uLength = (size_t)sprintf(pcLine, "cmd < in");
+   for(i = 0; i < iNumArgs; i++)
+   {
+      if(i == iNumArgs / 2)
+         uLength += (size_t)sprintf(pcLine + uLength, " >out");
+      uLength += (size_t)sprintf(pcLine + uLength, " a%d", i);
+   }
+   return pcLine;
+}
+
+/*------------------------------------------------------------------*/
+
+static void countToken(enum TokenType eType, char *pcValue,
+                       size_t uValueLength, void *pvExtra)
+
+/* Count a token in the long that pvExtra points to. */
+
+{
+   (*(long*)pvExtra)++;
+}
+
+/*------------------------------------------------------------------*/
+
+static void benchLex(const char *pcName, const char *pcLine,
+                     long lIterations)
+
+/* Report the cost of lexing pcLine lIterations times, with a 
+   callback that only counts the tokens. */
+
+{
+   Arena_T oArena;
+   char *pcCopy;
+   size_t uLength;
+   long lAllocs;
+   long lNumTokens = 0;
+   double dStart;
+   long l;
+
+   uLength = strlen(pcLine);
+   pcCopy = (char*)malloc(uLength + 1);
+   assert(pcCopy != NULL);
+   oArena = Arena_new();
+
+   /* Warm up the arena, so the steady state is measured. */
+   for(l = -1; l < lIterations; l++)
+   {
+      if(l == 0)
+      {
+         lAllocs = benchAllocs();
+         dStart = benchNow();
+      }
+      memcpy(pcCopy, pcLine, uLength + 1);
+      (void)lexScan(pcCopy, uLength, countToken, &lNumTokens, TRUE,
+                    oArena, "benchmicro");
+      Arena_reset(oArena);
+   }
+   benchReport("lexScan", pcName, lIterations, benchNow() - dStart,
+               benchAllocs() - lAllocs,
+               (double)uLength * (double)lIterations);
+   assert(lNumTokens > 0);
+
+   Arena_free(oArena);
+   free(pcCopy);
+}
+
+/*------------------------------------------------------------------*/
+
+static void benchParseLine(const char *pcName, const char *pcLine,
+                           long lIterations)
+
+/* Report the cost of lexing and parsing pcLine lIterations times 
+   with parseLine(), as performCommand() does with each line it 
+   reads. */
+
+{
+   DynArray_T oCommands;
+   Arena_T oArena;
+   char *pcCopy;
+   size_t uLength;
+   long lAllocs;
+   double dStart;
+   int iBackground;
+   int iNumTokens;
+   int iSuccessful;
+   long l;
+
+   uLength = strlen(pcLine);
+   pcCopy = (char*)malloc(uLength + 1);
+   assert(pcCopy != NULL);
+   oCommands = DynArray_new(0);
+   oArena = Arena_new();
+
+   /* Warm up the arena and the array, so the steady state is
+      measured. */
+   for(l = -1; l < lIterations; l++)
+   {
+      if(l == 0)
+      {
+         lAllocs = benchAllocs();
+         dStart = benchNow();
+      }
+      memcpy(pcCopy, pcLine, uLength + 1);
+      iSuccessful = parseLine(pcCopy, uLength, oCommands, &iBackground,
+                              &iNumTokens, oArena, "benchmicro");
+      assert(iSuccessful);
+      DynArray_clear(oCommands);
+      Arena_reset(oArena);
+   }
+   benchReport("parseLine", pcName, lIterations, benchNow() - dStart,
+               benchAllocs() - lAllocs,
+               (double)uLength * (double)lIterations);
+
+   Arena_free(oArena);
+   DynArray_free(oCommands);
+   free(pcCopy);
+}
+
+/*------------------------------------------------------------------*/
+
+static void benchHistory(long lScale)
+
+/* Report the cost of filling a history of HISTORY_SIZE * lScale
+   entries, of adding as many again with eviction, and of expanding
+   !commandprefix against it. */
+
+{
+   History_T oHistList;
+   char acLine[64];
+   char *apcPrefixes[NUM_PREFIXES];
+   char *pcBuffer = NULL;
+   size_t uBufferSize = 0;
+   const char *pcEntry;
+   size_t uLength;
+   size_t uBytes = 0;
+   long lNumEntries;
+   long lAllocs;
+   double dStart;
+   long lResult;
+   long l;
+   int i;
+
+   lNumEntries = HISTORY_SIZE * lScale;
+   oHistList = History_new((int)lNumEntries, NULL);
+
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(l = 0; l < lNumEntries; l++)
+   {
+      uLength = (size_t)sprintf(acLine, "cmd%lu -x %lu file%lu.txt",
+                                getRandom() % 50000, l, getRandom());
+      History_add(oHistList, acLine, uLength, TRUE);
+      uBytes += uLength;
+   }
+   benchReport("History_add", "fill", lNumEntries, benchNow() - dStart,
+               benchAllocs() - lAllocs, (double)uBytes);
+
+   uBytes = 0;
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(l = 0; l < lNumEntries; l++)
+   {
+      uLength = (size_t)sprintf(acLine, "cmd%lu -y %lu file%lu.txt",
+                                getRandom() % 50000, l, getRandom());
+      History_add(oHistList, acLine, uLength, TRUE);
+      uBytes += uLength;
+   }
+   benchReport("History_add", "evict", lNumEntries,
+               benchNow() - dStart, benchAllocs() - lAllocs,
+               (double)uBytes);
+
+   /* Each prefix is the first word of a random entry, shortened, so
+      every expansion succeeds. */
+   for(i = 0; i < NUM_PREFIXES; i++)
+   {
+      pcEntry = History_get(oHistList,
+                            (int)(getRandom() % (unsigned long)
+                                  History_getLength(oHistList)),
+                            &uLength);
+      uLength = strcspn(pcEntry, " ") - (size_t)(i % 3);
+      apcPrefixes[i] = (char*)malloc(uLength + 16);
+      assert(apcPrefixes[i] != NULL);
+      sprintf(apcPrefixes[i], "!%.*s | wc", (int)uLength, pcEntry);
+   }
+
+   uBytes = 0;
+   for(l = -1; l < lNumEntries; l++)
+   {
+      if(l == 0)
+      {
+         lAllocs = benchAllocs();
+         dStart = benchNow();
+      }
+      i = (int)((l + 1) % NUM_PREFIXES);
+      uLength = strlen(apcPrefixes[i]);
+      lResult = histExpandLine(apcPrefixes[i], uLength, oHistList,
+                               &pcBuffer, &uBufferSize, "benchmicro");
+      assert(lResult > 0);
+      if(l >= 0)
+         uBytes += uLength;
+   }
+   benchReport("histExpandLine", "prefix", lNumEntries,
+               benchNow() - dStart, benchAllocs() - lAllocs,
+               (double)uBytes);
+
+   for(i = 0; i < NUM_PREFIXES; i++)
+      free(apcPrefixes[i]);
+   free(pcBuffer);
+   History_free(oHistList);
+}
+
+/*------------------------------------------------------------------*/
+
+static int compareInt(const void *pvElement1, const void *pvElement2)
+
+/* Return a negative, zero, or positive number as the int at
+   pvElement1 is less than, equal to, or greater than the int at
+   pvElement2. */
+
+{
+   int i1 = *(const int*)pvElement1;
+   int i2 = *(const int*)pvElement2;
+
+   return (i1 > i2) - (i1 < i2);
+}
+
+/*------------------------------------------------------------------*/
+
+static DynArray_T makeArray(int *piValues, int iLength,
+                            enum Order eOrder)
+
+/* Fill piValues with iLength ints in order eOrder, and return a new
+   DynArray of pointers to them. */
+
+{
+   DynArray_T oArray;
+   int i;
+
+   oArray = DynArray_new(0);
+   for(i = 0; i < iLength; i++)
+   {
+      switch(eOrder)
+      {
+         case ORDER_SORTED:
+            piValues[i] = i;
+            break;
+         case ORDER_REVERSED:
+            piValues[i] = iLength - i;
+            break;
+         case ORDER_FEW_VALUES:
+            piValues[i] = (int)(getRandom() % 16);
+            break;
+         case ORDER_EQUAL:
+            piValues[i] = 7;
+            break;
+         default:
+            piValues[i] = (int)(getRandom() % 1000000000UL);
+            break;
+      }
+      DynArray_add(oArray, &piValues[i]);
+   }
+   return oArray;
+}
+
+/*------------------------------------------------------------------*/
+
+static void checkSorted(DynArray_T oArray)
+
+/* Assert that the ints that oArray points to are in ascending 
+   order. */
+
+{
+   int i;
+
+   for(i = 1; i < DynArray_getLength(oArray); i++)
+      assert(compareInt(DynArray_get(oArray, i - 1),
+                        DynArray_get(oArray, i)) <= 0);
+}
+
+/*------------------------------------------------------------------*/
+
+static void benchShortArrays(long lScale)
+
+/* Report the cost of creating, filling with SHORT_LENGTH elements,
+   and discarding an array SHORT_ITERATIONS * lScale times, as a 
+   DynArray of pointers and as a SmallArray of ints on the stack. */
+
+{
+   DynArray_T oArray;
+   struct SmallArray sArray;
+   int aiValues[SHORT_LENGTH];
+   long lIterations;
+   long lAllocs;
+   double dStart;
+   long lSum = 0;
+   long l;
+   int i;
+
+   lIterations = SHORT_ITERATIONS * lScale;
+   for(i = 0; i < SHORT_LENGTH; i++)
+      aiValues[i] = i;
+
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(l = 0; l < lIterations; l++)
+   {
+      oArray = DynArray_new(0);
+      for(i = 0; i < SHORT_LENGTH; i++)
+         DynArray_add(oArray, &aiValues[i]);
+      lSum += *(int*)DynArray_get(oArray, SHORT_LENGTH - 1);
+      DynArray_free(oArray);
+   }
+   benchReport("short_array", "DynArray", lIterations,
+               benchNow() - dStart, benchAllocs() - lAllocs, 0.0);
+
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(l = 0; l < lIterations; l++)
+   {
+      SmallArray_init(&sArray, sizeof(int));
+      for(i = 0; i < SHORT_LENGTH; i++)
+         (void)SmallArray_add(&sArray, &aiValues[i]);
+      lSum += *(int*)SmallArray_get(&sArray, SHORT_LENGTH - 1);
+      SmallArray_free(&sArray);
+   }
+   benchReport("short_array", "SmallArray", lIterations,
+               benchNow() - dStart, benchAllocs() - lAllocs, 0.0);
+
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(l = 0; l < lIterations; l++)
+   {
+      SmallArray_init(&sArray, sizeof(int));
+      SmallArray_addAll(&sArray, aiValues, SHORT_LENGTH);
+      lSum += *(int*)SmallArray_get(&sArray, SHORT_LENGTH - 1);
+      SmallArray_free(&sArray);
+   }
+   benchReport("short_array", "SmallArray_addAll", lIterations,
+               benchNow() - dStart, benchAllocs() - lAllocs, 0.0);
+   assert(lSum == 3 * lIterations * (SHORT_LENGTH - 1));
+}
+
+/*------------------------------------------------------------------*/
+
+static void benchArray(long lScale)
+
+/* Report the cost of the DynArray operations on arrays of
+   ARRAY_SIZE * lScale ints, sorting them in each order, and in 
+   parallel. */
+
+{
+   DynArray_T oArray;
+   int *piValues;
+   int iLength;
+   int iKey;
+   long lAllocs;
+   double dStart;
+   int iIndex;
+   int iMisses = 0;
+   int i;
+
+   iLength = (int)(ARRAY_SIZE * lScale);
+   piValues = (int*)malloc((size_t)iLength * sizeof(int));
+   assert(piValues != NULL);
+
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   oArray = makeArray(piValues, iLength, ORDER_RANDOM);
+   benchReport("DynArray_add", "random", iLength, benchNow() - dStart,
+               benchAllocs() - lAllocs, 0.0);
+   DynArray_free(oArray);
+
+   for(i = 0; i < NUM_ORDERS; i++)
+   {
+      oArray = makeArray(piValues, iLength, (enum Order)i);
+      lAllocs = benchAllocs();
+      dStart = benchNow();
+      DynArray_sort(oArray, compareInt);
+      benchReport("DynArray_sort", apcOrderNames[i], iLength,
+                  benchNow() - dStart, benchAllocs() - lAllocs, 0.0);
+      checkSorted(oArray);
+      DynArray_free(oArray);
+   }
+
+   oArray = makeArray(piValues, iLength, ORDER_RANDOM);
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   DynArray_sortParallel(oArray, compareInt, SORT_THREADS);
+   benchReport("DynArray_sortParallel", "random", iLength,
+               benchNow() - dStart, benchAllocs() - lAllocs, 0.0);
+   checkSorted(oArray);
+
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(i = 0; i < iLength; i++)
+   {
+      iIndex = DynArray_bsearch(oArray, &piValues[i], compareInt);
+      assert(iIndex != -1);
+   }
+   benchReport("DynArray_bsearch", "hit", iLength, benchNow() - dStart,
+               benchAllocs() - lAllocs, 0.0);
+
+   /* Most random keys are not in the array, so this measures misses. */
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(i = 0; i < iLength; i++)
+   {
+      iKey = (int)(getRandom() % 1000000000UL);
+      if(DynArray_bsearch(oArray, &iKey, compareInt) == -1)
+         iMisses++;
+   }
+   benchReport("DynArray_bsearch", "random", iLength,
+               benchNow() - dStart, benchAllocs() - lAllocs, 0.0);
+   assert(iMisses > 0);
+
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(i = 0; i < NUM_SEARCHES; i++)
+   {
+      iKey = (int)(getRandom() % 1000000000UL);
+      (void)DynArray_search(oArray, &iKey, compareInt);
+   }
+   benchReport("DynArray_search", "linear", NUM_SEARCHES,
+               benchNow() - dStart, benchAllocs() - lAllocs, 0.0);
+   DynArray_free(oArray);
+
+   free(piValues);
+}
+
+/*------------------------------------------------------------------*/
+
+static void benchVariables(long lScale)
+
+/* Add NUM_VARIABLES variables to the environment, and time looking
+   up the last of them with getenv() and with varGet(). */
+
+{
+   char acName[32];
+   const char *pcValue;
+   long lIterations;
+   long lAllocs;
+   long lFound = 0;
+   double dStart;
+   long l;
+   int i;
+
+   for(i = 0; i < NUM_VARIABLES; i++)
+   {
+      sprintf(acName, "BENCH_VARIABLE_%d", i);
+      (void)setenv(acName, "value", 1);
+   }
+   lIterations = LOOKUP_ITERATIONS * lScale;
+
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(l = 0; l < lIterations; l++)
+   {
+      pcValue = getenv(acName);
+      lFound += (pcValue != NULL);
+   }
+   benchReport("variable_lookup", "getenv", lIterations,
+               benchNow() - dStart, benchAllocs() - lAllocs, 0.0);
+
+   /* The first call reads the table from environ. */
+   (void)varGet(acName, strlen(acName));
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(l = 0; l < lIterations; l++)
+   {
+      pcValue = varGet(acName, strlen(acName));
+      lFound += (pcValue != NULL);
+   }
+   benchReport("variable_lookup", "varGet", lIterations,
+               benchNow() - dStart, benchAllocs() - lAllocs, 0.0);
+   assert(lFound == 2 * lIterations);
+}
+
+/*------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Run the microbenchmarks of the lexer, the parser, the history
+   list, variables, and DynArray, with every workload multiplied by
+   argv[1] (default 1), and write one result line per benchmark to
+   stdout. Return 0. */
+
+{
+   char *pcLongLine;
+   char *pcShortTokens;
+   char *pcQuoted;
+   char *pcManyArgs;
+   long lScale = 1;
+   long lIterations;
+
+   if(argc > 1)
+      lScale = atol(argv[1]);
+   assert(lScale > 0);
+   lIterations = LEX_ITERATIONS * lScale;
+
+   pcLongLine = makeLine(LONG_LINE_SIZE, 12, FALSE);
+   pcShortTokens = makeLine(3 * NUM_SHORT_TOKENS, 2, FALSE);
+   pcQuoted = makeLine(LONG_LINE_SIZE, 12, TRUE);
+   pcManyArgs = makeArgsLine(NUM_ARGS);
+
+   benchHeader();
+   benchLex("long_line", pcLongLine, lIterations);
+   benchLex("many_tokens", pcShortTokens, lIterations);
+   benchLex("quoted", pcQuoted, lIterations);
+   benchParseLine("long_line", pcLongLine, lIterations);
+   benchParseLine("many_tokens", pcShortTokens, lIterations);
+   benchParseLine("many_args", pcManyArgs, lIterations);
+   benchHistory(lScale);
+   benchShortArrays(lScale);
+   benchVariables(lScale);
+   benchArray(lScale);
+
+   free(pcManyArgs);
+   free(pcQuoted);
+   free(pcShortTokens);
+   free(pcLongLine);
+   return 0;
+}
@@ -0,0 +1,333 @@
+/*------------------------------------------------------------------*/
+/* benchreplay.c                                                    */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "dynarray.h"
+#include "arena.h"
+#include "lexi.h"
+#include "parse.h"
+#include "hist.h"
+#include "exec.h"
+#include "builtin.h"
+#include "job.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+enum {DEFAULT_PASSES = 200};
+
+enum {HISTORY_SIZE = 1000};
+
+/* The phases of running a line, in order. */
+enum Phase {PHASE_EXPAND, PHASE_PARSE, PHASE_EXEC, NUM_PHASES};
+
+static const char *apcPhaseNames[NUM_PHASES] =
+   {"replay-expand", "replay-parse", "replay-exec"};
+
+/* The lines replayed when no script is given. Every command is
+   trivial, so the time is the shell's: "true" is /bin/true unless
+   utilities are enabled. */
+static const char *apcDefaultCorpus[] =
+{
+   "true",
+   "true -x --long=value file1 file2 file3",
+   "true \"a quoted argument\" \"and another one\" plain",
+   "true < /dev/null > /dev/null",
+   "true | true",
+   "cat <<< \"a here-string\"",
+   "!true -x",
+   "echo replay",
+   "test -n replay",
+   NULL
+};
+
+/*------------------------------------------------------------------*/
+
+/* A way of launching commands: with fork() or posix_spawn(), and
+   with or without utilities run in the shell. */
+
+struct Variant
+{
+   const char *pcName;
+   int iSpawn;
+   int iUtilities;
+};
+
+static const struct Variant asVariants[] =
+{
+   {"fork", FALSE, FALSE},
+   {"spawn", TRUE, FALSE},
+   {"builtin", TRUE, TRUE}
+};
+
+enum {NUM_VARIANTS = sizeof(asVariants) / sizeof(asVariants[0])};
+
+/*------------------------------------------------------------------*/
+
+static void readScript(const char *pcFile, DynArray_T oLines)
+
+/* Append to oLines a new copy of each nonempty line of the file
+   named pcFile, without its newline. */
+
+{
+   FILE *psFile;
+   char *pcLine = NULL;
+   size_t uLineSize = 0;
+   ssize_t lLength;
+
+   psFile = fopen(pcFile, "r");
+   if(psFile == NULL)
+   {
+      perror(pcFile);
+      exit(EXIT_FAILURE);
+   }
+   while((lLength = getline(&pcLine, &uLineSize, psFile)) >= 0)
+   {
+      if(lLength > 0 && pcLine[lLength - 1] == '\n')
+         pcLine[--lLength] = '\0';
+      if(lLength > 0)
+         DynArray_add(oLines, strdup(pcLine));
+   }
+   free(pcLine);
+   fclose(psFile);
+}
+
+/*------------------------------------------------------------------*/
+
+static double *replay(DynArray_T oLines, long lPasses,
+                      const struct Variant *psVariant)
+
+/* Run every line in oLines lPasses times as ish runs the lines of a
+   script, launching commands as psVariant says, and report the lines
+   per second and the time spent in each phase. Return a new array of
+   the time each line took, in seconds. The caller owns the array. */
+
+{
+   DynArray_T oCommands;
+   History_T oHistList;
+   Arena_T oArena;
+   double adPhases[NUM_PHASES];
+   double adTimes[NUM_PHASES + 1];
+   double *pdLatencies;
+   char *pcExpanded = NULL;
+   size_t uExpandedSize = 0;
+   char *pcLine;
+   char *pcCopy;
+   size_t uLength;
+   long lLength;
+   long lNumLines;
+   long lNumFailed = 0;
+   long lAllocs;
+   double dStart;
+   double dBytes = 0.0;
+   int iSuccessful;
+   int iBackground;
+   int iNumTokens;
+   int iNull;
+   int iStdout;
+   long l;
+   int i;
+   int j;
+
+   lNumLines = lPasses * DynArray_getLength(oLines);
+   pdLatencies = (double*)malloc((size_t)lNumLines * sizeof(double));
+   assert(pdLatencies != NULL);
+   for(j = 0; j < NUM_PHASES; j++)
+      adPhases[j] = 0.0;
+
+   oHistList = History_new(HISTORY_SIZE, NULL);
+   oArena = Arena_new();
+   oCommands = DynArray_new(0);
+   execSetSpawn(psVariant->iSpawn);
+   builtinSetUtilities(psVariant->iUtilities);
+
+   /* The commands write to /dev/null, so only the results reach
+      stdout. */
+   fflush(stdout);
+   iStdout = dup(1);
+   iNull = open("/dev/null", O_WRONLY);
+   assert(iStdout != -1 && iNull != -1);
+   dup2(iNull, 1);
+   close(iNull);
+
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(l = 0; l < lNumLines; l++)
+   {
+      i = (int)(l % DynArray_getLength(oLines));
+      pcLine = (char*)DynArray_get(oLines, i);
+      uLength = strlen(pcLine);
+      dBytes += (double)uLength;
+      iSuccessful = TRUE;
+
+      adTimes[PHASE_EXPAND] = benchNow();
+      if(histHasCommandPrefix(pcLine, uLength))
+      {
+         lLength = histExpandLine(pcLine, uLength, oHistList,
+                                  &pcExpanded, &uExpandedSize,
+                                  "benchreplay");
+         iSuccessful = lLength >= 0;
+         if(iSuccessful)
+         {
+            pcLine = pcExpanded;
+            uLength = (size_t)lLength;
+         }
+      }
+
+      adTimes[PHASE_PARSE] = benchNow();
+      if(iSuccessful)
+      {
+         pcCopy = (char*)Arena_alloc(oArena, uLength + 1);
+         memcpy(pcCopy, pcLine, uLength + 1);
+         iSuccessful = parseLine(pcCopy, uLength, oCommands,
+                                 &iBackground, &iNumTokens, oArena,
+                                 "benchreplay");
+         if(iNumTokens > 0)
+            History_add(oHistList, pcLine, uLength, TRUE);
+         iSuccessful = iSuccessful && iNumTokens > 0;
+      }
+
+      adTimes[PHASE_EXEC] = benchNow();
+      if(iSuccessful)
+      {
+         (void)execute(oCommands, iBackground, oHistList,
+                       "benchreplay");
+         jobReap();
+      }
+      else
+         lNumFailed++;
+      DynArray_clear(oCommands);
+      Arena_reset(oArena);
+
+      adTimes[NUM_PHASES] = benchNow();
+      for(j = 0; j < NUM_PHASES; j++)
+         adPhases[j] += adTimes[j + 1] - adTimes[j];
+      pdLatencies[l] = adTimes[NUM_PHASES] - adTimes[PHASE_EXPAND];
+   }
+
+   fflush(stdout);
+   dup2(iStdout, 1);
+   close(iStdout);
+
+   benchReport("replay", psVariant->pcName, lNumLines,
+               benchNow() - dStart, benchAllocs() - lAllocs, dBytes);
+   for(j = 0; j < NUM_PHASES; j++)
+      benchReport(apcPhaseNames[j], psVariant->pcName, lNumLines,
+                  adPhases[j], 0, 0.0);
+   if(lNumFailed > 0)
+      fprintf(stderr, "benchreplay: %s: %ld lines failed\n",
+              psVariant->pcName, lNumFailed);
+
+   free(pcExpanded);
+   DynArray_free(oCommands);
+   Arena_free(oArena);
+   History_free(oHistList);
+   return pdLatencies;
+}
+
+/*------------------------------------------------------------------*/
+
+static void freeLine(void *pvLine, void *pvExtra)
+
+/* Free the line pvLine. */
+
+{
+   free(pvLine);
+}
+
+/*------------------------------------------------------------------*/
+
+static void usage(void)
+
+/* Write a usage message to stderr and exit with EXIT_FAILURE. */
+
+{
+   fprintf(stderr,
+           "Usage: benchreplay [-n passes] [-v fork|spawn|builtin] "
+           "[script ...]\n");
+   exit(EXIT_FAILURE);
+}
+
+/*------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Replay the lines of each script named in argv, or a corpus of
+   trivial commands if none is, -n times (default 200) through the
+   history expansion, lexer and parser, and executor of ish, once 
+   for each way of launching commands, or only for the one named by
+   -v. Write to stdout the lines per second, the time per line spent
+   in each phase, and the 50th, 90th, and 99th percentile latency of
+   a line. Return 0. */
+
+{
+   DynArray_T oLines;
+   double *apdLatencies[NUM_VARIANTS];
+   const char *pcVariant = NULL;
+   long lPasses = DEFAULT_PASSES;
+   int iOpt;
+   int iFound = FALSE;
+   int i;
+
+   while((iOpt = getopt(argc, argv, "n:v:")) != -1)
+   {
+      if(iOpt == 'n')
+         lPasses = atol(optarg);
+      else if(iOpt == 'v')
+         pcVariant = optarg;
+      else
+         usage();
+   }
+   if(lPasses <= 0)
+      usage();
+
+   oLines = DynArray_new(0);
+   for(i = optind; i < argc; i++)
+      readScript(argv[i], oLines);
+   if(optind == argc)
+      for(i = 0; apcDefaultCorpus[i] != NULL; i++)
+         DynArray_add(oLines, strdup(apcDefaultCorpus[i]));
+   if(DynArray_getLength(oLines) == 0)
+   {
+      fprintf(stderr, "benchreplay: No lines to replay\n");
+      exit(EXIT_FAILURE);
+   }
+
+   jobInit(FALSE, "benchreplay");
+   benchHeader();
+   for(i = 0; i < NUM_VARIANTS; i++)
+   {
+      apdLatencies[i] = NULL;
+      if(pcVariant == NULL || strcmp(pcVariant, asVariants[i].pcName)
+         == 0)
+      {
+         apdLatencies[i] = replay(oLines, lPasses, &asVariants[i]);
+         iFound = TRUE;
+      }
+   }
+   if(!iFound)
+      usage();
+
+   benchLatencyHeader();
+   for(i = 0; i < NUM_VARIANTS; i++)
+      if(apdLatencies[i] != NULL)
+      {
+         benchLatency("replay", asVariants[i].pcName, apdLatencies[i],
+                      lPasses * DynArray_getLength(oLines));
+         free(apdLatencies[i]);
+      }
+
+   DynArray_map(oLines, freeLine, NULL);
+   DynArray_free(oLines);
+   return 0;
+}
@@ -0,0 +1,249 @@
+/*------------------------------------------------------------------*/
+/* benchscript.c                                                    */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+enum {DEFAULT_RUNS = 10};
+
+enum {DEFAULT_DIGITS = 5};
+
+enum {MAX_DIGITS = 7};
+
+enum {NAME_SIZE = 256};
+
+/* The ways the same commands are written: as nested for loops, as
+   nested for loops whose body calls a function, and as one line
+   each. */
+enum Variant {VARIANT_LOOP, VARIANT_CALL, VARIANT_UNROLLED,
+              NUM_VARIANTS};
+
+static const char *apcVariants[NUM_VARIANTS] =
+   {"loop", "call", "unrolled"};
+
+/*------------------------------------------------------------------*/
+
+static void writeIndent(FILE *psFile, int iDepth)
+
+/* Write to psFile the indentation of a line iDepth levels deep. */
+
+{
+   int i;
+
+   assert(psFile != NULL);
+
+   for(i = 0; i < iDepth; i++)
+      fputs("   ", psFile);
+}
+
+/*------------------------------------------------------------------*/
+
+static void writeScript(const char *pcName, enum Variant eVariant,
+                        int iNumDigits)
+
+/* Write to the file named pcName a script, written as eVariant, that
+   runs "test -n" once for each number of iNumDigits digits. None
+   forks: test runs in the shell, so the time is the shell's own. */
+
+{
+   FILE *psFile;
+   long lNumLines = 1;
+   long l;
+   int i;
+
+   assert(pcName != NULL);
+
+   psFile = fopen(pcName, "w");
+   if(psFile == NULL)
+   {
+      perror(pcName);
+      exit(EXIT_FAILURE);
+   }
+
+   if(eVariant == VARIANT_UNROLLED)
+   {
+      for(i = 0; i < iNumDigits; i++)
+         lNumLines *= 10;
+      for(l = 0; l < lNumLines; l++)
+         fprintf(psFile, "test -n \"%0*ld\"\n", iNumDigits, l);
+   }
+   else
+   {
+      if(eVariant == VARIANT_CALL)
+         fputs("check() {\n   test -n \"$1\"\n}\n", psFile);
+      for(i = 0; i < iNumDigits; i++)
+      {
+         writeIndent(psFile, i);
+         fprintf(psFile, "for d%d in 0 1 2 3 4 5 6 7 8 9\n", i);
+         writeIndent(psFile, i);
+         fputs("do\n", psFile);
+      }
+      writeIndent(psFile, iNumDigits);
+      fputs((eVariant == VARIANT_CALL) ? "check \"" : "test -n \"",
+            psFile);
+      for(i = 0; i < iNumDigits; i++)
+         fprintf(psFile, "$d%d", i);
+      fputs("\"\n", psFile);
+      for(i = iNumDigits - 1; i >= 0; i--)
+      {
+         writeIndent(psFile, i);
+         fputs("done\n", psFile);
+      }
+   }
+
+   if(fclose(psFile) != 0)
+   {
+      perror(pcName);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static double runShell(const char *pcShell, const char *pcScript)
+
+/* Run the shell pcShell on the script pcScript with stdout
+   redirected to /dev/null, and return the time it took in
+   seconds. */
+
+{
+   double dStart;
+   pid_t iPid;
+   int iStatus;
+   int iFd;
+
+   assert(pcShell != NULL);
+   assert(pcScript != NULL);
+
+   dStart = benchNow();
+   iPid = fork();
+   if(iPid == -1) {perror("benchscript"); exit(EXIT_FAILURE); }
+   if(iPid == 0)
+   {
+      iFd = open("/dev/null", O_RDWR);
+      if(iFd == -1 || dup2(iFd, 1) == -1)
+         _exit(EXIT_FAILURE);
+      execl(pcShell, pcShell, pcScript, (char*)NULL);
+      perror(pcShell);
+      _exit(EXIT_FAILURE);
+   }
+   if(waitpid(iPid, &iStatus, 0) == -1 || !WIFEXITED(iStatus) ||
+      WEXITSTATUS(iStatus) != 0)
+   {
+      fprintf(stderr, "benchscript: %s failed\n", pcShell);
+      exit(EXIT_FAILURE);
+   }
+   return benchNow() - dStart;
+}
+
+/*------------------------------------------------------------------*/
+
+static void usage(void)
+
+/* Write a usage message to stderr and exit with EXIT_FAILURE. */
+
+{
+   fprintf(stderr,
+           "Usage: benchscript [-n runs] [-d digits] [-s shell]\n");
+   exit(EXIT_FAILURE);
+}
+
+/*------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Generate scripts that run a command once for each number of -d
+   digits (default 5), written as nested for loops, as loops that
+   call a function, and unrolled into one line each, in a new HOME
+   directory. Run the shell -s (default ./ish) on each -n times
+   (default 10), and write to stdout the commands per second and the
+   50th, 90th, and 99th percentile time of a run of each. Return
+   0. */
+
+{
+   char acHome[] = "/tmp/benchscriptXXXXXX";
+   char acScript[NAME_SIZE];
+   char acHistory[NAME_SIZE];
+   const char *pcShell = "./ish";
+   double *apdSamples[NUM_VARIANTS];
+   double dTotal;
+   long lRuns = DEFAULT_RUNS;
+   long lNumCommands = 1;
+   long l;
+   int iNumDigits = DEFAULT_DIGITS;
+   int iOpt;
+   int i;
+
+   while((iOpt = getopt(argc, argv, "n:d:s:")) != -1)
+   {
+      if(iOpt == 'n')
+         lRuns = atol(optarg);
+      else if(iOpt == 'd')
+         iNumDigits = atoi(optarg);
+      else if(iOpt == 's')
+         pcShell = optarg;
+      else
+         usage();
+   }
+   if(lRuns <= 0 || iNumDigits <= 0 || iNumDigits > MAX_DIGITS ||
+      optind != argc)
+      usage();
+   for(i = 0; i < iNumDigits; i++)
+      lNumCommands *= 10;
+
+   if(mkdtemp(acHome) == NULL)
+   {
+      perror("benchscript");
+      exit(EXIT_FAILURE);
+   }
+   sprintf(acScript, "%s/script", acHome);
+   sprintf(acHistory, "%s/.ish_history", acHome);
+
+   /* The shell finds its files through HOME, which has no .ishrc. */
+   if(setenv("HOME", acHome, 1) == -1)
+   {
+      perror("benchscript");
+      exit(EXIT_FAILURE);
+   }
+
+   benchHeader();
+   for(i = 0; i < NUM_VARIANTS; i++)
+   {
+      writeScript(acScript, (enum Variant)i, iNumDigits);
+      apdSamples[i] = (double*)malloc((size_t)lRuns * sizeof(double));
+      assert(apdSamples[i] != NULL);
+      dTotal = 0.0;
+      for(l = 0; l < lRuns; l++)
+      {
+         apdSamples[i][l] = runShell(pcShell, acScript);
+         dTotal += apdSamples[i][l];
+      }
+      benchReport("script", apcVariants[i], lRuns * lNumCommands,
+                  dTotal, 0, 0.0);
+   }
+   benchLatencyHeader();
+   for(i = 0; i < NUM_VARIANTS; i++)
+   {
+      benchLatency("script", apcVariants[i], apdSamples[i], lRuns);
+      free(apdSamples[i]);
+   }
+
+   (void)unlink(acScript);
+   (void)unlink(acHistory);
+   (void)rmdir(acHome);
+   return 0;
+}
@@ -0,0 +1,308 @@
+/*------------------------------------------------------------------*/
+/* benchserver.c                                                    */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "bench.h"
+#include "server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+enum {DEFAULT_RUNS = 200};
+
+enum {DEFAULT_LINES = 2000};
+
+enum {NAME_SIZE = 256};
+
+/* How long to wait for the server to listen, in tries 10 ms apart. */
+enum {MAX_TRIES = 500};
+
+/* The command each job runs. It runs in the shell, so the time is
+   that of getting a shell to run it. */
+static const char acCommand[] = "true\n";
+
+/* The lines that the generated .ishrc cycles through, with %d
+   replaced by the number of the line. */
+static const char *apcRcLines[] =
+{
+   "setenv BENCH_%d \"a generated value\"",
+   "true -x --long=value \"quoted argument %d\" file1 file2 file3",
+   "test -n \"line %d\"",
+   NULL
+};
+
+/*------------------------------------------------------------------*/
+
+static void writeFile(const char *pcName, long lNumLines)
+
+/* Write to the file named pcName an .ishrc of lNumLines lines, or
+   the command of a job if lNumLines is 0. */
+
+{
+   FILE *psFile;
+   long l;
+   int i = 0;
+
+   assert(pcName != NULL);
+
+   psFile = fopen(pcName, "w");
+   if(psFile == NULL)
+   {
+      perror(pcName);
+      exit(EXIT_FAILURE);
+   }
+   if(lNumLines == 0)
+      fputs(acCommand, psFile);
+   for(l = 0; l < lNumLines; l++)
+   {
+      if(apcRcLines[i] == NULL)
+         i = 0;
+      fprintf(psFile, apcRcLines[i++], (int)l);
+      fputc('\n', psFile);
+   }
+   if(fclose(psFile) != 0)
+   {
+      perror(pcName);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static pid_t startShell(const char *pcShell, const char *pcStdin,
+                        const char *pcSocket)
+
+/* Start the shell pcShell with stdout redirected to /dev/null, and
+   return its pid. If pcSocket is NULL, its stdin is redirected from
+   the file pcStdin, so it runs the .ishrc in HOME and then that
+   file; otherwise it serves pcSocket with one worker. */
+
+{
+   pid_t iPid;
+   int iFd;
+
+   assert(pcShell != NULL);
+   assert(pcStdin != NULL);
+
+   iPid = fork();
+   if(iPid == -1) {perror("benchserver"); exit(EXIT_FAILURE); }
+   if(iPid == 0)
+   {
+      iFd = open("/dev/null", O_RDWR);
+      if(iFd == -1 || dup2(iFd, 1) == -1)
+         _exit(EXIT_FAILURE);
+      if(pcSocket != NULL)
+         execl(pcShell, pcShell, "-s", pcSocket, "-j", "1",
+               (char*)NULL);
+      else
+      {
+         iFd = open(pcStdin, O_RDONLY);
+         if(iFd == -1 || dup2(iFd, 0) == -1)
+            _exit(EXIT_FAILURE);
+         execl(pcShell, pcShell, (char*)NULL);
+      }
+      perror(pcShell);
+      _exit(EXIT_FAILURE);
+   }
+   return iPid;
+}
+
+/*------------------------------------------------------------------*/
+
+static void waitShell(const char *pcShell, pid_t iPid)
+
+/* Wait for the shell pcShell of pid iPid, and exit if it failed. */
+
+{
+   int iStatus;
+
+   assert(pcShell != NULL);
+
+   if(waitpid(iPid, &iStatus, 0) == -1 || !WIFEXITED(iStatus) ||
+      WEXITSTATUS(iStatus) != 0)
+   {
+      fprintf(stderr, "benchserver: %s failed\n", pcShell);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static double runFresh(const char *pcShell, const char *pcCommand)
+
+/* Run a job in a new shell pcShell, which reads its .ishrc and then
+   the file pcCommand, and return the time it took in seconds. */
+
+{
+   double dStart;
+
+   assert(pcShell != NULL);
+   assert(pcCommand != NULL);
+
+   dStart = benchNow();
+   waitShell(pcShell, startShell(pcShell, pcCommand, NULL));
+   return benchNow() - dStart;
+}
+
+/*------------------------------------------------------------------*/
+
+static double runServed(const char *pcSocket)
+
+/* Run a job on the server listening on pcSocket, and return the time
+   it took in seconds. */
+
+{
+   struct ServerReply sReply;
+   double dStart;
+
+   assert(pcSocket != NULL);
+
+   dStart = benchNow();
+   if(!serverRequest(pcSocket, acCommand, strlen(acCommand), &sReply)
+      || sReply.iStatus != 0)
+   {
+      perror("benchserver");
+      exit(EXIT_FAILURE);
+   }
+   return benchNow() - dStart;
+}
+
+/*------------------------------------------------------------------*/
+
+static void usage(void)
+
+/* Write a usage message to stderr and exit with EXIT_FAILURE. */
+
+{
+   fprintf(stderr,
+           "Usage: benchserver [-n runs] [-l lines] [-s shell]\n");
+   exit(EXIT_FAILURE);
+}
+
+/*------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Generate an .ishrc of -l lines (default 2000) in a new HOME
+   directory, and run a job -n times (default 200) in a new shell -s
+   (default ./ish) each time, which reads the .ishrc, with its cache,
+   and -n times on a server that the same shell runs. Write to stdout
+   the jobs per second and the 50th, 90th, and 99th percentile time
+   of a job of each. Return 0. */
+
+{
+   char acHome[] = "/tmp/benchserverXXXXXX";
+   char acRc[NAME_SIZE];
+   char acCache[NAME_SIZE];
+   char acHistory[NAME_SIZE];
+   char acJob[NAME_SIZE];
+   char acSocket[NAME_SIZE];
+   struct ServerReply sReply;
+   const char *pcShell = "./ish";
+   double *pdFresh;
+   double *pdServed;
+   double dTotal;
+   long lRuns = DEFAULT_RUNS;
+   long lNumLines = DEFAULT_LINES;
+   long l;
+   pid_t iServer;
+   int iOpt;
+   int i;
+
+   while((iOpt = getopt(argc, argv, "n:l:s:")) != -1)
+   {
+      if(iOpt == 'n')
+         lRuns = atol(optarg);
+      else if(iOpt == 'l')
+         lNumLines = atol(optarg);
+      else if(iOpt == 's')
+         pcShell = optarg;
+      else
+         usage();
+   }
+   if(lRuns <= 0 || lNumLines <= 0 || optind != argc)
+      usage();
+
+   if(mkdtemp(acHome) == NULL)
+   {
+      perror("benchserver");
+      exit(EXIT_FAILURE);
+   }
+   sprintf(acRc, "%s/.ishrc", acHome);
+   sprintf(acCache, "%s/.ishrc.cache", acHome);
+   sprintf(acHistory, "%s/.ish_history", acHome);
+   sprintf(acJob, "%s/command", acHome);
+   sprintf(acSocket, "%s/socket", acHome);
+   writeFile(acRc, lNumLines);
+   writeFile(acJob, 0);
+
+   /* The shell finds its files through HOME. */
+   if(setenv("HOME", acHome, 1) == -1)
+   {
+      perror("benchserver");
+      exit(EXIT_FAILURE);
+   }
+
+   pdFresh = (double*)malloc((size_t)lRuns * sizeof(double));
+   pdServed = (double*)malloc((size_t)lRuns * sizeof(double));
+   assert(pdFresh != NULL);
+   assert(pdServed != NULL);
+
+   benchHeader();
+
+   /* The first run makes the cache that the timed runs use. */
+   (void)runFresh(pcShell, acJob);
+   dTotal = 0.0;
+   for(l = 0; l < lRuns; l++)
+   {
+      pdFresh[l] = runFresh(pcShell, acJob);
+      dTotal += pdFresh[l];
+   }
+   benchReport("server", "fresh", lRuns, dTotal, 0, 0.0);
+
+   iServer = startShell(pcShell, acJob, acSocket);
+   for(i = 0; !serverRequest(acSocket, "", 0, &sReply); i++)
+   {
+      if(i == MAX_TRIES)
+      {
+         fprintf(stderr, "benchserver: %s: No server\n", acSocket);
+         (void)kill(iServer, SIGTERM);
+         exit(EXIT_FAILURE);
+      }
+      (void)usleep(10000);
+   }
+   dTotal = 0.0;
+   for(l = 0; l < lRuns; l++)
+   {
+      pdServed[l] = runServed(acSocket);
+      dTotal += pdServed[l];
+   }
+   benchReport("server", "served", lRuns, dTotal, 0, 0.0);
+   (void)kill(iServer, SIGTERM);
+   waitShell(pcShell, iServer);
+
+   benchLatencyHeader();
+   benchLatency("server", "fresh", pdFresh, lRuns);
+   benchLatency("server", "served", pdServed, lRuns);
+
+   free(pdServed);
+   free(pdFresh);
+   (void)unlink(acJob);
+   (void)unlink(acCache);
+   (void)unlink(acHistory);
+   (void)unlink(acRc);
+   (void)rmdir(acHome);
+   return 0;
+}
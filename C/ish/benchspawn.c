@@ -0,0 +1,116 @@
+/*------------------------------------------------------------------*/
+/* benchspawn.c                                                     */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#include "dynarray.h"
+#include "arena.h"
+#include "lexi.h"
+#include "parse.h"
+#include "hist.h"
+#include "exec.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+enum {DEFAULT_ITERATIONS = 2000};
+
+enum {PAGE_SIZE = 4096};
+
+/*------------------------------------------------------------------*/
+
+static void runCommands(const char *pcLine, long lIterations,
+                        int iSpawn, const char *pcVariant)
+
+/* Execute pcLine lIterations times, launching it with posix_spawn()
+   iff iSpawn is TRUE, and report the commands per second as 
+   pcVariant. It is a checked runtime error for pcLine or pcVariant
+   to be NULL. */
+
+{
+   DynArray_T oCommands;
+   History_T oHistList;
+   Arena_T oArena;
+   char *pcCopy;
+   double dStart;
+   long lAllocs;
+   long l;
+   int iSuccessful;
+   int iBackground;
+   int iNumTokens;
+
+   assert(pcLine != NULL);
+   assert(pcVariant != NULL);
+
+   oHistList = History_new(0, NULL);
+   oArena = Arena_new();
+   oCommands = DynArray_new(0);
+   /* parseLine() terminates words within the line it is given. */
+   pcCopy = Arena_strdup(oArena, pcLine);
+   iSuccessful = parseLine(pcCopy, strlen(pcCopy), oCommands,
+                           &iBackground, &iNumTokens, oArena,
+                           "benchspawn");
+   assert(iSuccessful);
+
+   execSetSpawn(iSpawn);
+   lAllocs = benchAllocs();
+   dStart = benchNow();
+   for(l = 0; l < lIterations; l++)
+      execute(oCommands, iBackground, oHistList, "benchspawn");
+   benchReport(pcLine, pcVariant, lIterations, benchNow() - dStart,
+               benchAllocs() - lAllocs, 0.0);
+
+   DynArray_free(oCommands);
+   History_free(oHistList);
+   Arena_free(oArena);
+}
+
+/*------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Compare the commands per second of the fork() and posix_spawn()
+   launch paths, first with a small heap and then after growing the
+   heap by argv[2] megabytes (default 256), which is what makes 
+   fork() expensive in a long-lived shell. argv[1] is the number of
+   commands per measurement (default 2000). Return 0. */
+
+{
+   long lIterations = DEFAULT_ITERATIONS;
+   long lHeapMb = 256;
+   char *pcHeap;
+   char acVariant[64];
+   size_t u;
+
+   if(argc > 1)
+      lIterations = atol(argv[1]);
+   benchHeader();
+   if(argc > 2)
+      lHeapMb = atol(argv[2]);
+   assert(lIterations > 0);
+   assert(lHeapMb >= 0);
+
+   runCommands("/bin/true", lIterations, FALSE, "fork-0MB");
+   runCommands("/bin/true", lIterations, TRUE, "spawn-0MB");
+
+   /* Touch every page, so fork() has page tables to copy. */
+   pcHeap = (char*)malloc((size_t)lHeapMb * 1024 * 1024 + 1);
+   assert(pcHeap != NULL);
+   for(u = 0; u < (size_t)lHeapMb * 1024 * 1024; u += PAGE_SIZE)
+      pcHeap[u] = 1;
+
+   sprintf(acVariant, "fork-%ldMB", lHeapMb);
+   runCommands("/bin/true", lIterations, FALSE, acVariant);
+   sprintf(acVariant, "spawn-%ldMB", lHeapMb);
+   runCommands("/bin/true", lIterations, TRUE, acVariant);
+   runCommands("/bin/true | /bin/true", lIterations, TRUE, acVariant);
+
+   free(pcHeap);
+   return 0;
+}
@@ -0,0 +1,236 @@
+/*------------------------------------------------------------------*/
+/* benchstartup.c                                                   */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+enum {DEFAULT_RUNS = 20};
+
+enum {DEFAULT_LINES = 20000};
+
+enum {NAME_SIZE = 256};
+
+/* The lines that the generated .ishrc cycles through, with %d
+   replaced by the number of the line. None forks: utilities and
+   setenv run in the shell, so the time is startup's own. */
+static const char *apcRcLines[] =
+{
+   "setenv BENCH_%d \"a generated value\"",
+   "true -x --long=value \"quoted argument %d\" file1 file2 file3",
+   "true < /dev/null > /dev/null",
+   "cd .",
+   "test -n \"line %d\"",
+   NULL
+};
+
+/*------------------------------------------------------------------*/
+
+static void writeRc(const char *pcName, long lNumLines)
+
+/* Write to the file named pcName an .ishrc of lNumLines lines. */
+
+{
+   FILE *psFile;
+   long l;
+   int i = 0;
+
+   assert(pcName != NULL);
+
+   psFile = fopen(pcName, "w");
+   if(psFile == NULL)
+   {
+      perror(pcName);
+      exit(EXIT_FAILURE);
+   }
+   for(l = 0; l < lNumLines; l++)
+   {
+      if(apcRcLines[i] == NULL)
+         i = 0;
+      fprintf(psFile, apcRcLines[i++], (int)l);
+      fputc('\n', psFile);
+   }
+   if(fclose(psFile) != 0)
+   {
+      perror(pcName);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static double runShell(const char *pcShell)
+
+/* Run the shell pcShell with stdin and stdout redirected from and to
+   /dev/null, so it runs the .ishrc in HOME and exits, and return the
+   time it took in seconds. */
+
+{
+   double dStart;
+   pid_t iPid;
+   int iStatus;
+   int iFd;
+
+   assert(pcShell != NULL);
+
+   dStart = benchNow();
+   iPid = fork();
+   if(iPid == -1) {perror("benchstartup"); exit(EXIT_FAILURE); }
+   if(iPid == 0)
+   {
+      iFd = open("/dev/null", O_RDWR);
+      if(iFd == -1 || dup2(iFd, 0) == -1 || dup2(iFd, 1) == -1)
+         _exit(EXIT_FAILURE);
+      execl(pcShell, pcShell, (char*)NULL);
+      perror(pcShell);
+      _exit(EXIT_FAILURE);
+   }
+   if(waitpid(iPid, &iStatus, 0) == -1 || !WIFEXITED(iStatus) ||
+      WEXITSTATUS(iStatus) != 0)
+   {
+      fprintf(stderr, "benchstartup: %s failed\n", pcShell);
+      exit(EXIT_FAILURE);
+   }
+   return benchNow() - dStart;
+}
+
+/*------------------------------------------------------------------*/
+
+static double *runVariant(const char *pcShell, const char *pcCache,
+                          long lRuns, int iHit, long lNumLines,
+                          double dRcBytes)
+
+/* Run the shell pcShell lRuns times, with its cache file pcCache
+   made by an earlier run if iHit is TRUE and removed before each run
+   otherwise, and report the lines per second of an .ishrc of
+   lNumLines lines and dRcBytes bytes. Return the time of each run,
+   in an array the caller owns. */
+
+{
+   double *pdSamples;
+   double dTotal = 0.0;
+   long l;
+
+   assert(pcShell != NULL);
+   assert(pcCache != NULL);
+
+   pdSamples = (double*)malloc((size_t)lRuns * sizeof(double));
+   assert(pdSamples != NULL);
+
+   (void)unlink(pcCache);
+   if(iHit)
+      (void)runShell(pcShell);
+   for(l = 0; l < lRuns; l++)
+   {
+      if(!iHit)
+         (void)unlink(pcCache);
+      pdSamples[l] = runShell(pcShell);
+      dTotal += pdSamples[l];
+   }
+   benchReport("startup", iHit ? "hit" : "miss", lRuns * lNumLines,
+               dTotal, 0, dRcBytes * (double)lRuns);
+   return pdSamples;
+}
+
+/*------------------------------------------------------------------*/
+
+static void usage(void)
+
+/* Write a usage message to stderr and exit with EXIT_FAILURE. */
+
+{
+   fprintf(stderr,
+           "Usage: benchstartup [-n runs] [-l lines] [-s shell]\n");
+   exit(EXIT_FAILURE);
+}
+
+/*------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Generate an .ishrc of -l lines (default 20000) in a new HOME
+   directory, and run the shell -s (default ./ish) with it -n times
+   (default 20) without a cache of it, and -n times with one. Write
+   to stdout the lines per second and the 50th, 90th, and 99th
+   percentile startup time of each. Return 0. */
+
+{
+   char acHome[] = "/tmp/benchstartupXXXXXX";
+   char acRc[NAME_SIZE];
+   char acCache[NAME_SIZE];
+   char acHistory[NAME_SIZE];
+   const char *pcShell = "./ish";
+   double *pdMiss;
+   double *pdHit;
+   long lRuns = DEFAULT_RUNS;
+   long lNumLines = DEFAULT_LINES;
+   long lRcBytes;
+   FILE *psFile;
+   int iOpt;
+
+   while((iOpt = getopt(argc, argv, "n:l:s:")) != -1)
+   {
+      if(iOpt == 'n')
+         lRuns = atol(optarg);
+      else if(iOpt == 'l')
+         lNumLines = atol(optarg);
+      else if(iOpt == 's')
+         pcShell = optarg;
+      else
+         usage();
+   }
+   if(lRuns <= 0 || lNumLines <= 0 || optind != argc)
+      usage();
+
+   if(mkdtemp(acHome) == NULL)
+   {
+      perror("benchstartup");
+      exit(EXIT_FAILURE);
+   }
+   sprintf(acRc, "%s/.ishrc", acHome);
+   sprintf(acCache, "%s/.ishrc.cache", acHome);
+   sprintf(acHistory, "%s/.ish_history", acHome);
+   writeRc(acRc, lNumLines);
+   psFile = fopen(acRc, "r");
+   assert(psFile != NULL);
+   (void)fseek(psFile, 0, SEEK_END);
+   lRcBytes = ftell(psFile);
+   (void)fclose(psFile);
+
+   /* The shell finds its files through HOME. */
+   if(setenv("HOME", acHome, 1) == -1)
+   {
+      perror("benchstartup");
+      exit(EXIT_FAILURE);
+   }
+
+   benchHeader();
+   pdMiss = runVariant(pcShell, acCache, lRuns, FALSE, lNumLines,
+                       (double)lRcBytes);
+   pdHit = runVariant(pcShell, acCache, lRuns, TRUE, lNumLines,
+                      (double)lRcBytes);
+   benchLatencyHeader();
+   benchLatency("startup", "miss", pdMiss, lRuns);
+   benchLatency("startup", "hit", pdHit, lRuns);
+
+   free(pdHit);
+   free(pdMiss);
+   (void)unlink(acCache);
+   (void)unlink(acHistory);
+   (void)unlink(acRc);
+   (void)rmdir(acHome);
+   return 0;
+}
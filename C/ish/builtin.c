@@ -0,0 +1,668 @@
+/*------------------------------------------------------------------*/
+/* builtin.c                                                        */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "dynarray.h"
+#include "arena.h"
+#include "parse.h"
+#include "hist.h"
+#include "exec.h"
+#include "builtin.h"
+#include "pathcache.h"
+#include "job.h"
+#include "util.h"
+#include "parallel.h"
+#include "var.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+/* The value of iMaxArg for a builtin that takes any number of
+   arguments. */
+enum {ANY_ARG = -1};
+
+/* The flags of a builtin. BUILTIN_PARENT marks one that acts on the
+   shell itself, so it runs in the shell whenever it can. 
+   BUILTIN_UTILITY marks one that stands in for a program of the same
+   name. BUILTIN_STDIN marks one that may read stdin, and so may wait
+   for the terminal. */
+enum {BUILTIN_PARENT = 1, BUILTIN_UTILITY = 2, BUILTIN_STDIN = 4};
+
+/* The environment variable that, if set, makes utilities run their
+   programs instead. */
+#define EXTERNAL_VARIABLE "ISH_EXTERNAL"
+
+/*------------------------------------------------------------------*/
+
+/* A Builtin is a command that the shell runs itself. */
+
+struct Builtin
+{
+   /* The name of the command. */
+   const char *pcName;
+
+   /* The function that runs the command, and returns its exit
+      status. */
+   int (*pfRun)(char **ppcArray, int iNumArg, History_T oHistList,
+                char *pcProgName);
+
+   /* The function that returns TRUE if pfRun handles the arguments
+      of the command, or NULL if it handles any. */
+   int (*pfAccepts)(char **ppcArray);
+
+   /* The least and greatest numbers of arguments of the command. 
+      iMaxArg is ANY_ARG if there is no limit. */
+   int iMinArg;
+   int iMaxArg;
+
+   /* What is missing when there are fewer than iMinArg arguments, as
+      in "Missing variable", or NULL if iMinArg is 0. */
+   const char *pcMissing;
+
+   /* The BUILTIN_ flags that describe the command. */
+   int iFlags;
+};
+
+/*------------------------------------------------------------------*/
+
+/* Whether utilities run in the shell: TRUE, FALSE, or -1 if
+   EXTERNAL_VARIABLE has not been read since it last changed. */
+
+static int iUtilitiesEnabled = -1;
+
+/* TRUE iff the process is a child of the shell; see 
+   builtinSetChild(). */
+
+static int iInChild = FALSE;
+
+/*------------------------------------------------------------------*/
+
+static void checkExternal(const char *pcVariable)
+
+/* Forget whether utilities are enabled if pcVariable is
+   EXTERNAL_VARIABLE. */
+
+{
+   if(strcmp(pcVariable, EXTERNAL_VARIABLE) == 0)
+      iUtilitiesEnabled = -1;
+}
+
+/*------------------------------------------------------------------*/
+
+static int callSetenv(char **ppcArray, int iNumArg, History_T oHistList,
+                      char *pcProgName)
+
+/* Set the variable named by the first of the 1 or 2 arguments
+   iNumArg in ppcArray to the second, or to the empty string.
+   Return the exit status of the command. pcProgName is used in 
+   printing error messages. It is a checked runtime error for the 
+   first element in ppcArray to not be "setenv". It is a checked 
+   runtime error for ppcArray or pcProgName to be NULL. It is a 
+   checked runtime error for iNumArg to not be 1 or 2. */
+
+{
+   int iStatus = EXIT_SUCCESS;
+
+   assert(ppcArray != NULL);
+   assert(strcmp(ppcArray[0], "setenv") == 0);
+   assert(pcProgName != NULL);
+   assert(iNumArg == 1 || iNumArg == 2);
+
+   if(varSet(ppcArray[1], (iNumArg == 1) ? "" : ppcArray[2]) == -1)
+   {
+      perror(pcProgName);
+      iStatus = EXIT_FAILURE;
+   }
+
+   if(strcmp(ppcArray[1], "PATH") == 0)
+      pathReset();
+   checkExternal(ppcArray[1]);
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static int callUnsetenv(char **ppcArray, int iNumArg,
+                        History_T oHistList, char *pcProgName)
+
+/* Unset the variable named by the 1 argument iNumArg in ppcArray.
+   Return the exit status of the command. pcProgName is used in
+   printing error messages. It is a checked runtime error for the
+   first element in ppcArray to not be "unsetenv". It is a checked
+   runtime error for ppcArray or pcProgName to be NULL. It is a
+   checked runtime error for iNumArg to not be 1. */
+
+{
+   int iStatus = EXIT_SUCCESS;
+
+   assert(ppcArray != NULL);
+   assert(strcmp(ppcArray[0], "unsetenv") == 0);
+   assert(pcProgName != NULL);
+   assert(iNumArg == 1);
+
+   if(varUnset(ppcArray[1]) == -1)
+   {
+      perror(pcProgName);
+      iStatus = EXIT_FAILURE;
+   }
+
+   if(strcmp(ppcArray[1], "PATH") == 0)
+      pathReset();
+   checkExternal(ppcArray[1]);
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static int callCd(char **ppcArray, int iNumArg, History_T oHistList,
+                  char *pcProgName)
+
+/* Call chdir() with the argument in ppcArray, or with HOME if the
+   number of arguments iNumArg is 0. Return the exit status of the
+   command. pcProgName is used in printing error messages. It is a
+   checked runtime error for the first element in ppcArray to not be
+   "cd". It is a checked runtime error for ppcArray or pcProgName to
+   be NULL. It is a checked runtime error for iNumArg to not be 0 or
+   1. */
+
+{
+   const char *pcDir;
+
+   assert(ppcArray != NULL);
+   assert(strcmp(ppcArray[0], "cd") == 0);
+   assert(pcProgName != NULL);
+   assert(iNumArg == 0 || iNumArg == 1);
+
+   pcDir = (iNumArg == 0) ? varGet("HOME", 4) : ppcArray[1];
+   if(pcDir == NULL)
+   {
+      fprintf(stderr, "%s: cd: HOME not set\n", pcProgName);
+      return EXIT_FAILURE;
+   }
+   if(chdir(pcDir) == -1)
+   {
+      fprintf(stderr, "%s: ", pcProgName);
+      perror(pcDir);
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
+
+/*------------------------------------------------------------------*/
+
+static int callExit(char **ppcArray, int iNumArg, History_T oHistList,
+                    char *pcProgName)
+
+/* Call exit(), or return 0 in a child of the shell, which then 
+   exits as it does after any builtin. It is a checked runtime error
+   for the first element in ppcArray to not be "exit". It is a 
+   checked runtime error for ppcArray or pcProgName to be NULL. It is
+   a checked runtime error for the number of arguments iNumArg to not
+   be 0. */
+
+/* exit() in a child would move the offset of a seekable stdin, 
+   which the child shares with the shell, back, so the shell would 
+   read its input again. */
+
+{
+   assert(ppcArray != NULL);
+   assert(strcmp(ppcArray[0], "exit") == 0);
+   assert(pcProgName != NULL);
+   assert(iNumArg == 0);
+
+   if(iInChild)
+      return EXIT_SUCCESS;
+   printf("\n");
+   exit(EXIT_SUCCESS);
+}
+
+/*------------------------------------------------------------------*/
+
+static int callHash(char **ppcArray, int iNumArg, History_T oHistList,
+                    char *pcProgName)
+
+/* Print the path cache if the number of arguments iNumArg in
+   ppcArray is 0. Empty the path cache if the only argument is "-r".
+   Otherwise add each argument to the path cache, printing an error
+   message to stderr for each one that cannot be found. Return the
+   exit status of the command. pcProgName is used in printing error
+   messages. It is a checked runtime error for the first element in
+   ppcArray to not be "hash". It is a checked runtime error for
+   ppcArray or pcProgName to be NULL. It is a checked runtime error
+   for iNumArg to be negative. */
+
+{
+   int iStatus = EXIT_SUCCESS;
+   int i;
+
+   assert(ppcArray != NULL);
+   assert(strcmp(ppcArray[0], "hash") == 0);
+   assert(pcProgName != NULL);
+   assert(iNumArg >= 0);
+
+   if(iNumArg == 0)
+      pathPrint();
+   else if(iNumArg == 1 && strcmp(ppcArray[1], "-r") == 0)
+      pathReset();
+   else
+      for(i = 1; i <= iNumArg; i++)
+         if(pathLookup(ppcArray[i]) == NULL)
+         {
+            fprintf(stderr, "%s: hash: %s: Not found\n", pcProgName,
+                    ppcArray[i]);
+            iStatus = EXIT_FAILURE;
+         }
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static int callJobs(char **ppcArray, int iNumArg, History_T oHistList,
+                    char *pcProgName)
+
+/* Print the job table, and return the exit status of the command.
+   It is a checked runtime error for the first element in ppcArray 
+   to not be "jobs". It is a checked runtime error for ppcArray or
+   pcProgName to be NULL. It is a checked runtime error for the
+   number of arguments iNumArg to not be 0. */
+
+{
+   assert(ppcArray != NULL);
+   assert(strcmp(ppcArray[0], "jobs") == 0);
+   assert(pcProgName != NULL);
+   assert(iNumArg == 0);
+
+   jobPrint();
+   return EXIT_SUCCESS;
+}
+
+/*------------------------------------------------------------------*/
+
+static int callWait(char **ppcArray, int iNumArg, History_T oHistList,
+                    char *pcProgName)
+
+/* Wait for every background job if the number of arguments iNumArg
+   in ppcArray is 0, or for the job numbered by the argument (with
+   an optional leading '%') if it is 1. Return the exit status of 
+   the command, which is that of the job that finished last. 
+   pcProgName is used in printing error messages. It is a checked 
+   runtime error for the first element in ppcArray to not be "wait".
+   It is a checked runtime error for ppcArray or pcProgName to be 
+   NULL. It is a checked runtime error for iNumArg to not be 0 or 
+   1. */
+
+{
+   char *pcJob;
+   char *pcEnd;
+   long lJob;
+   int iStatus;
+
+   assert(ppcArray != NULL);
+   assert(strcmp(ppcArray[0], "wait") == 0);
+   assert(pcProgName != NULL);
+   assert(iNumArg == 0 || iNumArg == 1);
+
+   if(iNumArg == 0)
+   {
+      (void)jobWait(0, &iStatus);
+      return iStatus;
+   }
+
+   pcJob = ppcArray[1];
+   if(pcJob[0] == '%')
+      pcJob++;
+   lJob = strtol(pcJob, &pcEnd, 10);
+   if(*pcJob == '\0' || *pcEnd != '\0' || lJob <= 0 ||
+      !jobWait((int)lJob, &iStatus))
+   {
+      fprintf(stderr, "%s: wait: %s: No such job\n", pcProgName,
+              ppcArray[1]);
+      return EXIT_FAILURE;
+   }
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static int callTime(char **ppcArray, int iNumArg, History_T oHistList,
+                    char *pcProgName)
+
+/* Print the CPU time and maximum resident set size of the shell and
+   of its children, and return the exit status of the command. "time"
+   followed by a command is handled before the command runs, so this
+   is reached only with no arguments; see vmExecute(). A pipeline in
+   the background cannot be timed, since its usage would be known 
+   only once it is reaped, and is rejected with an error. It is a 
+   checked runtime error for the first element in ppcArray to not be
+   "time". It is a checked runtime error for ppcArray or pcProgName 
+   to be NULL. It is a checked runtime error for the number of 
+   arguments iNumArg to not be 0. */
+
+{
+   struct rusage sUsage;
+   struct ExecStats sStats;
+
+   assert(ppcArray != NULL);
+   assert(strcmp(ppcArray[0], "time") == 0);
+   assert(pcProgName != NULL);
+   assert(iNumArg == 0);
+
+   (void)getrusage(RUSAGE_SELF, &sUsage);
+   sStats.dWall = -1.0;
+   sStats.dUser = (double)sUsage.ru_utime.tv_sec + 
+                  (double)sUsage.ru_utime.tv_usec / 1e6;
+   sStats.dSys = (double)sUsage.ru_stime.tv_sec + 
+                 (double)sUsage.ru_stime.tv_usec / 1e6;
+   sStats.lMaxRss = sUsage.ru_maxrss;
+   execPrintStats(&sStats, "shell", stdout);
+
+   (void)getrusage(RUSAGE_CHILDREN, &sUsage);
+   sStats.dUser = (double)sUsage.ru_utime.tv_sec + 
+                  (double)sUsage.ru_utime.tv_usec / 1e6;
+   sStats.dSys = (double)sUsage.ru_stime.tv_sec + 
+                 (double)sUsage.ru_stime.tv_usec / 1e6;
+   sStats.lMaxRss = sUsage.ru_maxrss;
+   execPrintStats(&sStats, "children", stdout);
+   return EXIT_SUCCESS;
+}
+
+/*------------------------------------------------------------------*/
+
+/* An entry of the history list, with the wall time of its command,
+   or -1 if none was recorded. */
+
+struct HistEntry
+{
+   int iIndex;
+   double dSeconds;
+};
+
+/*------------------------------------------------------------------*/
+
+static int compareSlowest(const void *pv1, const void *pv2)
+
+/* Return a negative, zero, or positive number as the HistEntry pv1
+   took longer than, as long as, or less long than the HistEntry pv2.
+   Entries that took equally long are in the order of the history 
+   list. */
+
+{
+   const struct HistEntry *ps1 = (const struct HistEntry*)pv1;
+   const struct HistEntry *ps2 = (const struct HistEntry*)pv2;
+
+   if(ps1->dSeconds > ps2->dSeconds)
+      return -1;
+   if(ps1->dSeconds < ps2->dSeconds)
+      return 1;
+   return ps1->iIndex - ps2->iIndex;
+}
+
+/*------------------------------------------------------------------*/
+
+static void printEntry(History_T oHistList, int iIndex, int iTimes)
+
+/* Print the entry of oHistList at index iIndex, preceded by its 
+   event number, and by the wall time and exit status of its command
+   iff iTimes is TRUE. */
+
+{
+   const char *pcLine;
+   size_t uLength;
+   double dSeconds;
+   long lNumber;
+   int iStatus;
+
+   /* Entries from the history file are printed straight from its 
+      mapping, so they are not terminated by '\0'. */
+   pcLine = History_get(oHistList, iIndex, &uLength);
+   lNumber = History_getNumber(oHistList, iIndex);
+   if(!iTimes)
+      printf("%ld\t%.*s\n", lNumber, (int)uLength, pcLine);
+   else if(History_getResult(oHistList, iIndex, &dSeconds, &iStatus))
+      printf("%ld\t%9.3f\t%3d\t%.*s\n", lNumber, dSeconds, iStatus, 
+             (int)uLength, pcLine);
+   else
+      printf("%ld\t%9s\t%3s\t%.*s\n", lNumber, "-", "-", (int)uLength,
+             pcLine);
+}
+
+/*------------------------------------------------------------------*/
+
+static int callHistory(char **ppcArray, int iNumArg,
+                       History_T oHistList, char *pcProgName)
+
+/* Print out the history list, and return the exit status of the
+   command. With the option "-t", print the wall time in seconds and
+   the exit status of each command too. With the option "-s", do so
+   with the slowest commands first. pcProgName is used in printing
+   error messages. It is a checked runtime error for ppcArray, 
+   oHistList, or pcProgName to be NULL. It is a checked runtime 
+   error for the first element in ppcArray to not be "history". It 
+   is a checked runtime error for the number of arguments iNumArg to
+   not be 0 or 1. */
+
+{
+   struct HistEntry *psEntries;
+   int iLength;
+   int iStatus;
+   int i;
+
+   assert(ppcArray != NULL);
+   assert(strcmp(ppcArray[0], "history") == 0);
+   assert(oHistList != NULL);
+   assert(iNumArg == 0 || iNumArg == 1);
+   assert(pcProgName != NULL);
+
+   iLength = History_getLength(oHistList);
+   if(iNumArg == 0 || strcmp(ppcArray[1], "-t") == 0)
+   {
+      for(i = 0; i < iLength; i++)
+         printEntry(oHistList, i, iNumArg == 1);
+      return EXIT_SUCCESS;
+   }
+   if(strcmp(ppcArray[1], "-s") != 0)
+   {
+      fprintf(stderr, "%s: history: %s: Invalid option\n", pcProgName,
+              ppcArray[1]);
+      return EXIT_FAILURE;
+   }
+
+   psEntries = (struct HistEntry*)calloc((size_t)iLength + 1, 
+                                         sizeof(struct HistEntry));
+   assert(psEntries != NULL);
+   for(i = 0; i < iLength; i++)
+   {
+      psEntries[i].iIndex = i;
+      if(!History_getResult(oHistList, i, &psEntries[i].dSeconds, 
+                            &iStatus))
+         psEntries[i].dSeconds = -1.0;
+   }
+   qsort(psEntries, (size_t)iLength, sizeof(struct HistEntry), 
+         compareSlowest);
+   for(i = 0; i < iLength; i++)
+      printEntry(oHistList, psEntries[i].iIndex, TRUE);
+   free(psEntries);
+   return EXIT_SUCCESS;
+}
+
+/*------------------------------------------------------------------*/
+
+/* The builtins, in the order of builtin.def. */
+
+#define BUILTIN(pcName, pfRun, pfAccepts, iMinArg, iMaxArg, pcMissing, \
+                iFlags) \
+   {pcName, pfRun, pfAccepts, iMinArg, iMaxArg, pcMissing, iFlags},
+
+static const struct Builtin asBuiltins[] =
+{
+#include "builtin.def"
+};
+
+#undef BUILTIN
+
+/* The perfect hash of the names in asBuiltins that mkhash generates:
+   BUILTIN_HASH_SEED, BUILTIN_HASH_SIZE, and aiBuiltinSlots. */
+
+#include "builtinhash.h"
+
+/*------------------------------------------------------------------*/
+
+static unsigned long hashName(const char *pcName, unsigned long ulSeed)
+
+/* Return the FNV-1a hash of pcName, starting from ulSeed, with its
+   high bits folded into the low bits that select a slot. This must
+   match hashName() in mkhash.c. */
+
+{
+   unsigned long ulHash = ulSeed ^ 2166136261UL;
+
+   for(; *pcName != '\0'; pcName++)
+      ulHash = ((ulHash ^ (unsigned char)*pcName) * 16777619UL) 
+               & 0xffffffffUL;
+   return ulHash ^ (ulHash >> 16);
+}
+
+/*------------------------------------------------------------------*/
+
+static const struct Builtin *findBuiltin(const char *pcName)
+
+/* Return the builtin named pcName, or NULL if there is none. */
+
+/* Since the hash is perfect, the only builtin that pcName can be is
+   the one in its slot, so one comparison decides. */
+
+{
+   int iIndex;
+
+   iIndex = aiBuiltinSlots[hashName(pcName, BUILTIN_HASH_SEED) & 
+                           (BUILTIN_HASH_SIZE - 1)];
+   if(iIndex == -1 || strcmp(asBuiltins[iIndex].pcName, pcName) != 0)
+      return NULL;
+   return &asBuiltins[iIndex];
+}
+
+/*------------------------------------------------------------------*/
+
+void builtinSetUtilities(int iEnabled)
+
+/* Run utilities in the shell if iEnabled is TRUE, and as programs if
+   it is FALSE, until EXTERNAL_VARIABLE is next changed. */
+
+{
+   iUtilitiesEnabled = iEnabled;
+}
+
+/*------------------------------------------------------------------*/
+
+void builtinSetChild(void)
+
+/* Note that the calling process is a child of the shell, which runs
+   a builtin and exits, so that exit returns instead of exiting. */
+
+{
+   iInChild = TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+int builtinIsBuiltin(char **ppcArray)
+
+/* Return TRUE if the command whose argument array is ppcArray is
+   run as a builtin, and FALSE otherwise. It is a checked runtime
+   error for ppcArray to be NULL. */
+
+{
+   const struct Builtin *psBuiltin;
+
+   assert(ppcArray != NULL);
+
+   psBuiltin = findBuiltin(ppcArray[0]);
+   if(psBuiltin == NULL)
+      return FALSE;
+   if((psBuiltin->iFlags & BUILTIN_UTILITY) != 0)
+   {
+      if(iUtilitiesEnabled == -1)
+         iUtilitiesEnabled =
+            (varGet(EXTERNAL_VARIABLE, strlen(EXTERNAL_VARIABLE)) == NULL);
+      if(!iUtilitiesEnabled)
+         return FALSE;
+   }
+   return psBuiltin->pfAccepts == NULL || 
+          (*psBuiltin->pfAccepts)(ppcArray);
+}
+
+/*------------------------------------------------------------------*/
+
+int builtinRunsInShell(char **ppcArray, int iStdinIsTerminal)
+
+/* Return TRUE if the builtin command whose argument array is 
+   ppcArray should run in the shell itself when it is alone in the
+   foreground, and FALSE if it should run in a child. 
+   iStdinIsTerminal is TRUE iff the command's stdin is a terminal. 
+   It is a checked runtime error for ppcArray to be NULL. It is a 
+   checked runtime error for the command to not satisfy 
+   builtinIsBuiltin(). */
+
+/* The shell ignores SIGINT, so a builtin that waits for the 
+   terminal runs in a child, where ^C can interrupt it. */
+
+{
+   const struct Builtin *psBuiltin;
+
+   assert(ppcArray != NULL);
+
+   psBuiltin = findBuiltin(ppcArray[0]);
+   assert(psBuiltin != NULL);
+   return (psBuiltin->iFlags & BUILTIN_PARENT) != 0 || 
+          (psBuiltin->iFlags & BUILTIN_STDIN) == 0 || 
+          !iStdinIsTerminal;
+}
+
+/*------------------------------------------------------------------*/
+
+int builtinRun(char **ppcArray, int iNumArg, History_T oHistList,
+               char *pcProgName)
+
+/* Run the builtin named by the first element in ppcArray, with the
+   iNumArg arguments in ppcArray, in the current process, and return
+   its exit status. If the builtin does not take iNumArg arguments,
+   print an error message to stderr and return EXIT_FAILURE instead.
+   pcProgName is used in printing error messages. It is a checked 
+   runtime error for ppcArray, oHistList, or pcProgName to be NULL.
+   It is a checked runtime error for the command to not satisfy 
+   builtinIsBuiltin(). */
+
+{
+   const struct Builtin *psBuiltin;
+
+   assert(ppcArray != NULL);
+   assert(oHistList != NULL);
+   assert(pcProgName != NULL);
+
+   psBuiltin = findBuiltin(ppcArray[0]);
+   assert(psBuiltin != NULL);
+
+   if(iNumArg < psBuiltin->iMinArg)
+   {
+      fprintf(stderr, "%s: %s: Missing %s\n", pcProgName, ppcArray[0],
+              psBuiltin->pcMissing);
+      return EXIT_FAILURE;
+   }
+   if(psBuiltin->iMaxArg != ANY_ARG && iNumArg > psBuiltin->iMaxArg)
+   {
+      fprintf(stderr, "%s: %s: Too many arguments\n", pcProgName,
+              ppcArray[0]);
+      return EXIT_FAILURE;
+   }
+   return (*psBuiltin->pfRun)(ppcArray, iNumArg, oHistList, pcProgName);
+}
@@ -0,0 +1,48 @@
+/*------------------------------------------------------------------*/
+/* builtin.h                                                        */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef BUILTIN_INCLUDED
+#define BUILTIN_INCLUDED
+
+/* A builtin is a command that the shell runs itself rather than
+   launching a program. Builtins write to stdout and stderr, so they
+   may run in the shell with those redirected. */
+
+int builtinIsBuiltin(char **ppcArray);
+/* Return TRUE if the command whose argument array is ppcArray is
+   run as a builtin, and FALSE otherwise. Utilities, the builtins
+   that stand in for programs, are not if the environment variable
+   ISH_EXTERNAL is set, or if they do not handle the arguments. It is
+   a checked runtime error for ppcArray to be NULL. */
+
+int builtinRunsInShell(char **ppcArray, int iStdinIsTerminal);
+/* Return TRUE if the builtin command whose argument array is 
+   ppcArray should run in the shell itself when it is alone in the
+   foreground, and FALSE if it should run in a child: builtins that
+   act on the shell always run in it, and those that may wait for 
+   the terminal do not when iStdinIsTerminal is TRUE. It is a 
+   checked runtime error for ppcArray to be NULL. It is a checked 
+   runtime error for the command to not satisfy builtinIsBuiltin(). */
+
+void builtinSetUtilities(int iEnabled);
+/* Run utilities in the shell if iEnabled is TRUE, and as programs if
+   it is FALSE, until ISH_EXTERNAL is next changed. */
+
+void builtinSetChild(void);
+/* Note that the calling process is a child of the shell, which runs
+   a builtin and exits, so that exit returns instead of exiting. */
+
+int builtinRun(char **ppcArray, int iNumArg, History_T oHistList,
+               char *pcProgName);
+/* Run the builtin named by the first element in ppcArray, with the
+   iNumArg arguments in ppcArray, in the current process, and return
+   its exit status. If the builtin does not take iNumArg arguments,
+   print an error message to stderr and return EXIT_FAILURE instead.
+   pcProgName is used in printing error messages. It is a checked 
+   runtime error for ppcArray, oHistList, or pcProgName to be NULL.
+   It is a checked runtime error for the command to not satisfy 
+   builtinIsBuiltin(). */
+
+#endif                      /* BUILTIN_INCLUDED */
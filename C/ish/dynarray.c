@@ -6,14 +6,33 @@
 #include "dynarray.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
-enum {MIN_PHYS_LENGTH = 2};
+enum {MIN_PHYS_LENGTH = 8};
 enum {GROWTH_FACTOR = 2};
 
+/* Ranges of at most this many elements are sorted by insertion. */
+enum {INSERTION_SORT_LENGTH = 16};
+
+/* Ranges of more than this many elements take their pivot from nine
+   elements rather than three. */
+enum {NINTHER_LENGTH = 128};
+
+/* The most elements an insertion sort of a nearly sorted range may
+   move before it gives up. */
+enum {PARTIAL_INSERTION_LIMIT = 8};
+
+/* DynArray_sortParallel() sorts shorter arrays in one thread, and
+   uses at most MAX_SORT_THREADS threads. */
+enum {PARALLEL_SORT_LENGTH = 1 << 15};
+enum {MAX_SORT_THREADS = 64};
+
 /*--------------------------------------------------------------------*/
 
 /* A DynArray consists of an array, along with its logical and
-   physical lengths. */
+   physical lengths. The first MIN_PHYS_LENGTH elements are stored
+   within the DynArray itself, so a short DynArray is one object. */
 
 struct DynArray
 {
@@ -25,8 +44,13 @@ struct DynArray
       DynArray. */
    int iPhysLength;
 
-   /* The array that underlies the DynArray. */
+   /* The array that underlies the DynArray: apvInline, or an array
+      on the heap once the DynArray has outgrown it. */
    const void **ppvArray;
+
+   /* The storage for a DynArray of at most MIN_PHYS_LENGTH 
+      elements. */
+   const void *apvInline[MIN_PHYS_LENGTH];
 };
 
 /*--------------------------------------------------------------------*/
@@ -65,10 +89,18 @@ DynArray_T DynArray_new(int iLength)
       oDynArray->iPhysLength = iLength;
    else
       oDynArray->iPhysLength = MIN_PHYS_LENGTH;
-   oDynArray->ppvArray =
-      (const void**)calloc((size_t)oDynArray->iPhysLength,
-                            sizeof(void*));
-   assert(oDynArray->ppvArray != NULL);
+   if (oDynArray->iPhysLength == MIN_PHYS_LENGTH)
+   {
+      oDynArray->ppvArray = oDynArray->apvInline;
+      memset(oDynArray->apvInline, 0, sizeof(oDynArray->apvInline));
+   }
+   else
+   {
+      oDynArray->ppvArray =
+         (const void**)calloc((size_t)oDynArray->iPhysLength,
+                               sizeof(void*));
+      assert(oDynArray->ppvArray != NULL);
+   }
 
    return oDynArray;
 }
@@ -83,7 +115,8 @@ void DynArray_free(DynArray_T oDynArray)
    if (oDynArray == NULL)
       return;
 
-   free(oDynArray->ppvArray);
+   if (oDynArray->ppvArray != oDynArray->apvInline)
+      free(oDynArray->ppvArray);
    free(oDynArray);
 }
 
@@ -145,6 +178,38 @@ void *DynArray_set(DynArray_T oDynArray, int iIndex,
 
 /*--------------------------------------------------------------------*/
 
+static void DynArray_setPhysLength(DynArray_T oDynArray,
+                                   int iPhysLength)
+
+/* Make the physical length of oDynArray iPhysLength, moving its
+   elements to the heap if they are stored within it. */
+
+{
+   const void **ppvArray;
+
+   assert(oDynArray != NULL);
+   assert(DynArray_isValid(oDynArray));
+   assert(iPhysLength > oDynArray->iPhysLength);
+
+   if (oDynArray->ppvArray == oDynArray->apvInline)
+   {
+      ppvArray = (const void**)malloc(sizeof(void*) * iPhysLength);
+      assert(ppvArray != NULL);
+      memcpy(ppvArray, oDynArray->apvInline, 
+             sizeof(void*) * oDynArray->iLength);
+   }
+   else
+   {
+      ppvArray = (const void**)realloc(oDynArray->ppvArray,
+                                        sizeof(void*) * iPhysLength);
+      assert(ppvArray != NULL);
+   }
+   oDynArray->ppvArray = ppvArray;
+   oDynArray->iPhysLength = iPhysLength;
+}
+
+/*--------------------------------------------------------------------*/
+
 static void DynArray_grow(DynArray_T oDynArray)
 
 /* Double the physical length of oDynArray. */
@@ -153,11 +218,34 @@ static void DynArray_grow(DynArray_T oDynArray)
    assert(oDynArray != NULL);
    assert(DynArray_isValid(oDynArray));
 
-   oDynArray->iPhysLength *= GROWTH_FACTOR;
-   oDynArray->ppvArray =
-      (const void**)realloc(oDynArray->ppvArray,
-                      sizeof(void*) * oDynArray->iPhysLength);
-   assert(oDynArray->ppvArray != NULL);
+   DynArray_setPhysLength(oDynArray,
+                          oDynArray->iPhysLength * GROWTH_FACTOR);
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_reserve(DynArray_T oDynArray, int iLength)
+
+/* Make oDynArray able to hold iLength elements without growing.
+   It is a checked runtime error for oDynArray to be NULL.
+   It is a checked runtime error for iLength to be negative. */
+
+{
+   int iPhysLength;
+
+   assert(oDynArray != NULL);
+   assert(DynArray_isValid(oDynArray));
+   assert(iLength >= 0);
+
+   if (iLength <= oDynArray->iPhysLength)
+      return;
+
+   /* Keep the doubling, so reserving a little at a time still takes
+      amortized constant time per element. */
+   iPhysLength = oDynArray->iPhysLength * GROWTH_FACTOR;
+   if (iPhysLength < iLength)
+      iPhysLength = iLength;
+   DynArray_setPhysLength(oDynArray, iPhysLength);
 }
 
 /*--------------------------------------------------------------------*/
@@ -180,6 +268,44 @@ void DynArray_add(DynArray_T oDynArray, const void *pvElement)
 
 /*--------------------------------------------------------------------*/
 
+void DynArray_addAll(DynArray_T oDynArray, const void **ppvElements,
+   int iCount)
+
+/* Add the iCount elements of ppvElements to the end of oDynArray, in
+   order, thus increasing its length by iCount.
+   It is a checked runtime error for oDynArray or ppvElements to be
+   NULL.
+   It is a checked runtime error for iCount to be negative. */
+
+{
+   assert(oDynArray != NULL);
+   assert(DynArray_isValid(oDynArray));
+   assert(ppvElements != NULL);
+   assert(iCount >= 0);
+
+   DynArray_reserve(oDynArray, oDynArray->iLength + iCount);
+   memcpy(oDynArray->ppvArray + oDynArray->iLength, ppvElements,
+          sizeof(void*) * iCount);
+   oDynArray->iLength += iCount;
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_clear(DynArray_T oDynArray)
+
+/* Remove every element of oDynArray, keeping its storage for reuse,
+   thus making its length 0.
+   It is a checked runtime error for oDynArray to be NULL. */
+
+{
+   assert(oDynArray != NULL);
+   assert(DynArray_isValid(oDynArray));
+
+   oDynArray->iLength = 0;
+}
+
+/*--------------------------------------------------------------------*/
+
 void DynArray_addAt(DynArray_T oDynArray, int iIndex,
    const void *pvElement)
 
@@ -292,57 +418,264 @@ static void DynArray_swap(const void *ppvArray[], int iOne, int iTwo)
 
 /*--------------------------------------------------------------------*/
 
-static int DynArray_partition(const void *ppvArray[],
+static void DynArray_insertionSort(const void *ppvArray[],
+   int iLeft, int iRight,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2))
+
+/* Sort ppvArray[iLeft...iRight] in ascending order, as determined
+   by *pfCompare, by insertion. */
+
+{
+   const void *pvElement;
+   int i;
+   int j;
+
+   for (i = iLeft + 1; i <= iRight; i++)
+   {
+      pvElement = ppvArray[i];
+      for (j = i; j > iLeft &&
+              (*pfCompare)(pvElement, ppvArray[j-1]) < 0; j--)
+         ppvArray[j] = ppvArray[j-1];
+      ppvArray[j] = pvElement;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static int DynArray_partialInsertionSort(const void *ppvArray[],
    int iLeft, int iRight,
    int (*pfCompare)(const void *pvElement1, const void *pvElement2))
 
-/* Divide ppvArray[iLeft...iRight] into two partitions so elements
-   in the first partition are <= elements in the second partition.
-   Return the index of the element that marks the partition
-   boundary. The sort order is determined by *pfCompare. */
+/* Try to sort ppvArray[iLeft...iRight] by insertion, giving up once
+   more than PARTIAL_INSERTION_LIMIT elements have been moved. Return
+   1 (TRUE) iff the range is sorted. */
+
+{
+   const void *pvElement;
+   int iMoved = 0;
+   int i;
+   int j;
+
+   for (i = iLeft + 1; i <= iRight; i++)
+   {
+      if ((*pfCompare)(ppvArray[i], ppvArray[i-1]) >= 0)
+         continue;
+      pvElement = ppvArray[i];
+      for (j = i; j > iLeft &&
+              (*pfCompare)(pvElement, ppvArray[j-1]) < 0; j--)
+         ppvArray[j] = ppvArray[j-1];
+      ppvArray[j] = pvElement;
+      iMoved += i - j;
+      if (iMoved > PARTIAL_INSERTION_LIMIT)
+         return 0;
+   }
+   return 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void DynArray_siftDown(const void *ppvArray[], int iBase,
+   int iRoot, int iLength,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2))
+
+/* Restore the max-heap property of the heap of iLength elements 
+   starting at ppvArray[iBase], below the element at index iRoot of
+   the heap. */
+
+{
+   int iChild;
+
+   while ((iChild = 2 * iRoot + 1) < iLength)
+   {
+      if (iChild + 1 < iLength &&
+          (*pfCompare)(ppvArray[iBase + iChild],
+                       ppvArray[iBase + iChild + 1]) < 0)
+         iChild++;
+      if ((*pfCompare)(ppvArray[iBase + iRoot],
+                       ppvArray[iBase + iChild]) >= 0)
+         return;
+      DynArray_swap(ppvArray, iBase + iRoot, iBase + iChild);
+      iRoot = iChild;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static void DynArray_heapsort(const void *ppvArray[],
+   int iLeft, int iRight,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2))
+
+/* Sort ppvArray[iLeft...iRight] in ascending order, as determined
+   by *pfCompare, in O(n log n) time whatever the input. */
+
+{
+   int iLength = iRight - iLeft + 1;
+   int i;
+
+   for (i = iLength / 2 - 1; i >= 0; i--)
+      DynArray_siftDown(ppvArray, iLeft, i, iLength, pfCompare);
+   for (i = iLength - 1; i > 0; i--)
+   {
+      DynArray_swap(ppvArray, iLeft, iLeft + i);
+      DynArray_siftDown(ppvArray, iLeft, 0, i, pfCompare);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static void DynArray_sort3(const void *ppvArray[], int iOne, int iTwo,
+   int iThree,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2))
+
+/* Order ppvArray[iOne], ppvArray[iTwo], and ppvArray[iThree] so that
+   ppvArray[iTwo] is their median. */
+
+{
+   if ((*pfCompare)(ppvArray[iTwo], ppvArray[iOne]) < 0)
+      DynArray_swap(ppvArray, iOne, iTwo);
+   if ((*pfCompare)(ppvArray[iThree], ppvArray[iTwo]) < 0)
+   {
+      DynArray_swap(ppvArray, iTwo, iThree);
+      if ((*pfCompare)(ppvArray[iTwo], ppvArray[iOne]) < 0)
+         DynArray_swap(ppvArray, iOne, iTwo);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+static int DynArray_partition(const void *ppvArray[],
+   int iLeft, int iRight, int *piSwapped,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2))
+
+/* Divide ppvArray[iLeft...iRight] around the pivot ppvArray[iLeft],
+   so elements before it are <= it and elements after it are >= it.
+   Return the pivot's final index. Set *piSwapped to 1 (TRUE) iff any
+   elements had to be exchanged. The sort order is determined by 
+   *pfCompare. */
 
-/* This function is a variation of the partition() function shown in
-   the book "Algorithms in C" by Robert Sedgewick. */
+/* Both scans stop at elements equal to the pivot, as in the
+   partition() function of the book "Algorithms in C" by Robert
+   Sedgewick, so runs of equal elements are split evenly. */
 
 {
-   int iFirst = iLeft-1;
-   int iLast = iRight;
+   const void *pvPivot = ppvArray[iLeft];
+   int iFirst = iLeft;
+   int iLast = iRight + 1;
 
+   *piSwapped = 0;
    while (1)
    {
-      while ((*pfCompare)(ppvArray[++iFirst], ppvArray[iRight]) < 0)
+      while (++iFirst <= iRight &&
+             (*pfCompare)(ppvArray[iFirst], pvPivot) < 0)
+         ;
+      while ((*pfCompare)(pvPivot, ppvArray[--iLast]) < 0)
          ;
-      while ((*pfCompare)(ppvArray[iRight], ppvArray[--iLast]) < 0)
-         if (iLast == iLeft)
-            break;
       if (iFirst >= iLast)
          break;
       DynArray_swap(ppvArray, iFirst, iLast);
+      *piSwapped = 1;
    }
-   DynArray_swap(ppvArray, iFirst, iRight);
-   return iFirst;
+   DynArray_swap(ppvArray, iLeft, iLast);
+   return iLast;
 }
 
 /*--------------------------------------------------------------------*/
 
-static void DynArray_quicksort(const void *ppvArray[],
-   int iLeft, int iRight,
+static void DynArray_introsort(const void *ppvArray[],
+   int iLeft, int iRight, int iDepth,
    int (*pfCompare)(const void *pvElement1, const void *pvElement2))
 
 /* Sort ppvArray[iLeft...iRight] in ascending order, as determined
-   by *pfCompare. */
+   by *pfCompare, switching to heapsort once more than iDepth 
+   partitions have been unbalanced. */
 
-/* This function is a variation of the quicksort() function shown in
-   the book "Algorithms in C" by Robert Sedgewick. */
+/* This is a pattern-defeating quicksort in the manner of Orson
+   Peters' pdqsort. The pivot is the median of three elements, or of
+   three medians of three for large ranges. A partition that needed 
+   no exchanges suggests the range is already nearly sorted, so a
+   bounded insertion sort is tried before partitioning further. The
+   smaller side is sorted recursively and the larger one in the
+   loop, so the stack depth is O(log n). */
 
 {
+   int iLength;
    int iMid;
-   if (iRight > iLeft)
+   int iStep;
+   int iPivot;
+   int iSwapped;
+
+   while ((iLength = iRight - iLeft + 1) > INSERTION_SORT_LENGTH)
+   {
+      if (iDepth < 0)
+      {
+         DynArray_heapsort(ppvArray, iLeft, iRight, pfCompare);
+         return;
+      }
+
+      iMid = iLeft + iLength / 2;
+      if (iLength > NINTHER_LENGTH)
+      {
+         iStep = iLength / 8;
+         DynArray_sort3(ppvArray, iLeft, iLeft + iStep, 
+                        iLeft + 2 * iStep, pfCompare);
+         DynArray_sort3(ppvArray, iMid - iStep, iMid, iMid + iStep,
+                        pfCompare);
+         DynArray_sort3(ppvArray, iRight - 2 * iStep, iRight - iStep,
+                        iRight, pfCompare);
+         DynArray_sort3(ppvArray, iLeft + iStep, iMid, 
+                        iRight - iStep, pfCompare);
+      }
+      else
+         DynArray_sort3(ppvArray, iLeft, iMid, iRight, pfCompare);
+      DynArray_swap(ppvArray, iLeft, iMid);
+
+      iPivot = DynArray_partition(ppvArray, iLeft, iRight, &iSwapped,
+                                  pfCompare);
+
+      /* A badly unbalanced partition counts against the depth 
+         limit; a clean one may mean the input was sorted. */
+      if (iPivot - iLeft < iLength / 8 || iRight - iPivot < iLength / 8)
+         iDepth--;
+      else if (!iSwapped &&
+         DynArray_partialInsertionSort(ppvArray, iLeft, iPivot - 1,
+                                       pfCompare) &&
+         DynArray_partialInsertionSort(ppvArray, iPivot + 1, iRight,
+                                       pfCompare))
+         return;
+
+      if (iPivot - iLeft < iRight - iPivot)
+      {
+         DynArray_introsort(ppvArray, iLeft, iPivot - 1, iDepth,
+                            pfCompare);
+         iLeft = iPivot + 1;
+      }
+      else
+      {
+         DynArray_introsort(ppvArray, iPivot + 1, iRight, iDepth,
+                            pfCompare);
+         iRight = iPivot - 1;
+      }
+   }
+   DynArray_insertionSort(ppvArray, iLeft, iRight, pfCompare);
+}
+
+/*--------------------------------------------------------------------*/
+
+static int DynArray_depthLimit(int iLength)
+
+/* Return the number of unbalanced partitions an introsort of iLength
+   elements may make before switching to heapsort: the base-2 
+   logarithm of iLength. */
+
+{
+   int iDepth = 0;
+
+   while (iLength > 1)
    {
-      iMid = DynArray_partition(ppvArray, iLeft, iRight, pfCompare);
-      DynArray_quicksort(ppvArray, iLeft, iMid - 1, pfCompare);
-      DynArray_quicksort(ppvArray, iMid + 1, iRight, pfCompare);
+      iDepth++;
+      iLength >>= 1;
    }
+   return iDepth;
 }
 
 /*--------------------------------------------------------------------*/
@@ -362,8 +695,179 @@ void DynArray_sort(DynArray_T oDynArray,
    assert(DynArray_isValid(oDynArray));
    assert(pfCompare != NULL);
 
-   DynArray_quicksort(oDynArray->ppvArray, 0, oDynArray->iLength-1,
-      pfCompare);
+   DynArray_introsort(oDynArray->ppvArray, 0, oDynArray->iLength-1,
+      DynArray_depthLimit(oDynArray->iLength), pfCompare);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* A range of a parallel sort, and the work a thread does on it. */
+
+struct DynArray_Task
+{
+   /* The array being sorted, and a scratch array as long as it. */
+   const void **ppvArray;
+   const void **ppvScratch;
+
+   /* The range is ppvArray[iLeft...iRight]. If iMid is not -1, the
+      task merges the sorted runs [iLeft...iMid] and [iMid+1...iRight];
+      otherwise it sorts the range. */
+   int iLeft;
+   int iMid;
+   int iRight;
+
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2);
+};
+
+/*--------------------------------------------------------------------*/
+
+static void *DynArray_runTask(void *pvTask)
+
+/* Perform the sort or merge described by the DynArray_Task at 
+   pvTask. Return NULL. */
+
+{
+   struct DynArray_Task *psTask = (struct DynArray_Task*)pvTask;
+   const void **ppvArray = psTask->ppvArray;
+   const void **ppvScratch = psTask->ppvScratch;
+   int iOne;
+   int iTwo;
+   int i;
+
+   if (psTask->iMid == -1)
+   {
+      DynArray_introsort(ppvArray, psTask->iLeft, psTask->iRight,
+         DynArray_depthLimit(psTask->iRight - psTask->iLeft + 1),
+         psTask->pfCompare);
+      return NULL;
+   }
+
+   iOne = psTask->iLeft;
+   iTwo = psTask->iMid + 1;
+   for (i = psTask->iLeft; i <= psTask->iRight; i++)
+   {
+      if (iTwo > psTask->iRight ||
+          (iOne <= psTask->iMid &&
+           (*psTask->pfCompare)(ppvArray[iTwo], ppvArray[iOne]) >= 0))
+         ppvScratch[i] = ppvArray[iOne++];
+      else
+         ppvScratch[i] = ppvArray[iTwo++];
+   }
+   memcpy(ppvArray + psTask->iLeft, ppvScratch + psTask->iLeft,
+          sizeof(void*) * (psTask->iRight - psTask->iLeft + 1));
+   return NULL;
+}
+
+/*--------------------------------------------------------------------*/
+
+static void DynArray_runTasks(struct DynArray_Task *psTasks,
+   int iNumTasks)
+
+/* Perform the iNumTasks tasks in psTasks concurrently, each in a 
+   thread of its own except the first, which the calling thread 
+   performs. A task whose thread cannot be created is performed by
+   the calling thread instead. */
+
+{
+   pthread_t aiThreads[MAX_SORT_THREADS];
+   int aiStarted[MAX_SORT_THREADS];
+   int i;
+
+   assert(iNumTasks <= MAX_SORT_THREADS);
+
+   for (i = 1; i < iNumTasks; i++)
+      aiStarted[i] = pthread_create(&aiThreads[i], NULL,
+         DynArray_runTask, &psTasks[i]) == 0;
+   (void)DynArray_runTask(&psTasks[0]);
+   for (i = 1; i < iNumTasks; i++)
+   {
+      if (aiStarted[i])
+         (void)pthread_join(aiThreads[i], NULL);
+      else
+         (void)DynArray_runTask(&psTasks[i]);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_sortParallel(DynArray_T oDynArray,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2),
+   int iNumThreads)
+
+/* Sort oDynArray in the order determined by *pfCompare, as
+   DynArray_sort() does, using up to iNumThreads threads. *pfCompare
+   must be safe to call from several threads at once. Arrays shorter
+   than PARALLEL_SORT_LENGTH are sorted in the calling thread.
+   It is a checked runtime error for oDynArray or pfCompare to be
+   NULL.
+   It is a checked runtime error for iNumThreads to be less than 1. */
+
+/* Each thread sorts one of iNumThreads equal runs, and the runs are
+   then merged pairwise, the merges of each round in parallel. */
+
+{
+   struct DynArray_Task asTasks[MAX_SORT_THREADS];
+   int aiBounds[MAX_SORT_THREADS + 1];
+   const void **ppvScratch;
+   int iNumRuns;
+   int iNumTasks;
+   int i;
+
+   assert(oDynArray != NULL);
+   assert(DynArray_isValid(oDynArray));
+   assert(pfCompare != NULL);
+   assert(iNumThreads >= 1);
+
+   if (iNumThreads > MAX_SORT_THREADS)
+      iNumThreads = MAX_SORT_THREADS;
+   if (iNumThreads == 1 || oDynArray->iLength < PARALLEL_SORT_LENGTH)
+   {
+      DynArray_sort(oDynArray, pfCompare);
+      return;
+   }
+
+   ppvScratch = (const void**)malloc(sizeof(void*) * 
+                                      oDynArray->iLength);
+   if (ppvScratch == NULL)
+   {
+      DynArray_sort(oDynArray, pfCompare);
+      return;
+   }
+
+   iNumRuns = iNumThreads;
+   for (i = 0; i <= iNumRuns; i++)
+      aiBounds[i] = (int)((long)oDynArray->iLength * i / iNumRuns);
+   for (i = 0; i < iNumRuns; i++)
+   {
+      asTasks[i].ppvArray = oDynArray->ppvArray;
+      asTasks[i].ppvScratch = ppvScratch;
+      asTasks[i].iLeft = aiBounds[i];
+      asTasks[i].iMid = -1;
+      asTasks[i].iRight = aiBounds[i + 1] - 1;
+      asTasks[i].pfCompare = pfCompare;
+   }
+   DynArray_runTasks(asTasks, iNumRuns);
+
+   /* Merge runs 2i and 2i + 1 into run i, until one run is left. */
+   while (iNumRuns > 1)
+   {
+      iNumTasks = iNumRuns / 2;
+      for (i = 0; i < iNumTasks; i++)
+      {
+         asTasks[i].iLeft = aiBounds[2 * i];
+         asTasks[i].iMid = aiBounds[2 * i + 1] - 1;
+         asTasks[i].iRight = aiBounds[2 * i + 2] - 1;
+      }
+      DynArray_runTasks(asTasks, iNumTasks);
+      for (i = 0; i < iNumTasks; i++)
+         aiBounds[i] = aiBounds[2 * i];
+      if (iNumRuns % 2 == 1)
+         aiBounds[iNumTasks++] = aiBounds[iNumRuns - 1];
+      aiBounds[iNumTasks] = oDynArray->iLength;
+      iNumRuns = iNumTasks;
+   }
+
+   free(ppvScratch);
 }
 
 /*--------------------------------------------------------------------*/
@@ -408,31 +912,34 @@ int DynArray_bsearch(DynArray_T oDynArray, void *pvSoughtElement,
    It is an unchecked runtime error for oDynArray not to be sorted
    as determined by *pfCompare. */
 
+/* The search halves the range without branching on the comparison,
+   which compilers turn into a conditional move, so it does not 
+   suffer mispredicted branches. */
+
 {
-   int iLeft;
-   int iRight;
-   int iMid;
-   int iCompare;
+   const void **ppvBase;
+   int iLength;
+   int iHalf;
 
    assert(oDynArray != NULL);
    assert(DynArray_isValid(oDynArray));
    assert(pfCompare != NULL);
 
-   iLeft = 0;
-   iRight = oDynArray->iLength - 1;
+   if (oDynArray->iLength == 0)
+      return -1;
 
-   while (iLeft <= iRight)
+   /* Keep ppvBase at the last element <= *pvSoughtElement, if any. */
+   ppvBase = oDynArray->ppvArray;
+   iLength = oDynArray->iLength;
+   while (iLength > 1)
    {
-      iMid = (iLeft + iRight) / 2;
-      iCompare =
-         (*pfCompare)(pvSoughtElement, oDynArray->ppvArray[iMid]);
-      if (iCompare == 0)
-         return iMid;
-      if (iCompare < 0)
-         iRight = iMid - 1;
-      else
-         iLeft = iMid + 1;
+      iHalf = iLength / 2;
+      ppvBase = ((*pfCompare)(pvSoughtElement, ppvBase[iHalf]) >= 0) ?
+         ppvBase + iHalf : ppvBase;
+      iLength -= iHalf;
    }
 
+   if ((*pfCompare)(pvSoughtElement, *ppvBase) == 0)
+      return (int)(ppvBase - oDynArray->ppvArray);
    return -1;
 }
@@ -38,6 +38,24 @@ void DynArray_add(DynArray_T oDynArray, const void *pvElement);
 /* Add pvElement to the end of oDynArray, thus incrementing its length.
    It is a checked runtime error for oDynArray to be NULL. */
 
+void DynArray_addAll(DynArray_T oDynArray, const void **ppvElements,
+   int iCount);
+/* Add the iCount elements of ppvElements to the end of oDynArray, in
+   order, thus increasing its length by iCount.
+   It is a checked runtime error for oDynArray or ppvElements to be
+   NULL.
+   It is a checked runtime error for iCount to be negative. */
+
+void DynArray_reserve(DynArray_T oDynArray, int iLength);
+/* Make oDynArray able to hold iLength elements without growing.
+   It is a checked runtime error for oDynArray to be NULL.
+   It is a checked runtime error for iLength to be negative. */
+
+void DynArray_clear(DynArray_T oDynArray);
+/* Remove every element of oDynArray, keeping its storage for reuse,
+   thus making its length 0.
+   It is a checked runtime error for oDynArray to be NULL. */
+
 void DynArray_addAt(DynArray_T oDynArray, int iIndex,
    const void *pvElement);
 /* Add pvElement to oDynArray such that it is the iIndex'th element.
@@ -75,6 +93,17 @@ void DynArray_sort(DynArray_T oDynArray,
    It is a checked runtime error for oDynArray or pfCompare to be
    NULL. */
 
+void DynArray_sortParallel(DynArray_T oDynArray,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2),
+   int iNumThreads);
+/* Sort oDynArray in the order determined by *pfCompare, as
+   DynArray_sort() does, using up to iNumThreads threads. *pfCompare
+   must be safe to call from several threads at once. Short arrays 
+   are sorted in the calling thread.
+   It is a checked runtime error for oDynArray or pfCompare to be
+   NULL.
+   It is a checked runtime error for iNumThreads to be less than 1. */
+
 int DynArray_search(DynArray_T oDynArray, void *pvSoughtElement,
    int (*pfCompare)(const void *pvElement1, const void *pvElement2));
 /* Linear search oDynArray for *pvSoughtElement using *pfCompare to
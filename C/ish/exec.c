@@ -5,194 +5,394 @@
 
 #define _GNU_SOURCE
 #include "dynarray.h"
+#include "arena.h"
 #include "parse.h"
 #include "lexi.h"
+#include "hist.h"
 #include "exec.h"
+#include "builtin.h"
+#include "pathcache.h"
+#include "job.h"
+#include "smallarray.h"
+#include "var.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
 #include <wait.h>
+#include <time.h>
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <assert.h>
 #include <signal.h>
+#include <spawn.h>
 
 /*------------------------------------------------------------------*/
 
+enum {FALSE, TRUE};
+
 enum {PERMISSIONS = 0600};
 
+enum {SIGNAL_STATUS_BASE = 128};
+
+/* The lowest file descriptor that saves a standard one while a 
+   builtin runs with its redirections. */
+enum {SAVED_FD_BASE = 10};
+
+/*------------------------------------------------------------------*/
+
+/* TRUE iff external commands are launched with posix_spawn() rather
+   than with fork() and execvp(). */
+static int iSpawnEnabled = TRUE;
+
+/* The resource usage of the pipeline most recently executed in the
+   foreground. */
+static struct ExecStats sLastStats;
+
 /*------------------------------------------------------------------*/
 
-static void callSetenv(char **ppcArray, int iNumArg, char *pcProgName)
+static void exitChild(int iStatus)
+
+/* Flush stdout, and terminate the calling process, a child of the 
+   shell, with status iStatus. */
+
+/* _exit() is used because exit() would move the offset of a 
+   seekable stdin, which the child shares with the shell, back to
+   the child's copy of the stdin buffer, so the shell would read its
+   input again. */
 
-/* Call setenv() iff the number of arguments iNumArg in ppcArray is 1 
-   or 2. Print error message to stderr otherwise. pcProgName is used
-   in printing error messages. It is a checked runtime error for the
-   first element in ppcArray to not be "setenv". It is a checked 
-   runtime error for ppcArray or pcProgName to be NULL. It is a 
-   checked runtime error for iNumArg to be negative. */
+{
+   fflush(stdout);
+   _exit(iStatus);
+}
 
-{  
-   assert(ppcArray != NULL);
-   assert(strcmp(ppcArray[0], "setenv") == 0);
+/*------------------------------------------------------------------*/
+
+static void redirect(int iFd, int iStdFd, char *pcName, 
+                     char *pcProgName)
+
+/* Make file descriptor iStdFd refer to what file descriptor iFd 
+   refers to, and close iFd. pcName is used in printing error 
+   messages, after pcProgName. Exit the process if an error occurs.
+   It is a checked runtime error for pcName or pcProgName to be 
+   NULL. */
+
+{
+   int iRet;
+
+   assert(pcName != NULL);
    assert(pcProgName != NULL);
-   assert(iNumArg >= 0);
 
-   if(iNumArg == 0)
-      fprintf(stderr, "%s: setenv: Missing variable\n", pcProgName);
-   else if (iNumArg > 2) 
-      fprintf(stderr, "%s: setenv: Too many arguments\n", pcProgName);
-   else if(iNumArg == 1)
+   if(iFd == iStdFd)
+      return;
+
+   iRet = close(iStdFd);
+   if (iRet == -1)
    {
-      if(setenv(ppcArray[1], "\0", 1) == -1)
-         perror(pcProgName);
+      fprintf(stderr, "%s: ", pcProgName);
+      perror(pcName); 
+      exitChild(EXIT_FAILURE); 
+   }            
+   iRet = dup(iFd);
+   if (iRet == -1)
+   {
+      fprintf(stderr, "%s: ", pcProgName);
+      perror(pcName); 
+      exitChild(EXIT_FAILURE); 
    }
-   else if(iNumArg == 2)
+   iRet = close(iFd);
+   if (iRet == -1)
    {
-      if(setenv(ppcArray[1], ppcArray[2], 1) == -1)
-         perror(pcProgName);
+      fprintf(stderr, "%s: ", pcProgName);
+      perror(pcName); 
+      exitChild(EXIT_FAILURE); 
    }
 }
-   
+
 /*------------------------------------------------------------------*/
 
-static void callUnsetenv(char **ppcArray, int iNumArg, char *pcProgName)
+static int saveFd(int iStdFd, char *pcProgName)
 
-/* Call unsetenv() iff the number of arguments iNumArg in ppcArray is
-   1. Print error message to stderr otherwise. pcProgName is used in
-   printing error messages. It is a checked runtime error for the
-   first element in ppcArray to not be "unsetenv". It is a checked 
-   runtime error for ppcArray or pcProgName to be NULL. It is a 
-   checked runtime error for iNumArg to be negative. */
+/* Return a duplicate of file descriptor iStdFd that is not inherited
+   by children, or -1 if iStdFd is not open. pcProgName is used in 
+   printing error messages. It is a checked runtime error for 
+   pcProgName to be NULL. */
 
 {
-   assert(ppcArray != NULL);
-   assert(strcmp(ppcArray[0], "unsetenv") == 0);
+   int iSaved;
+
    assert(pcProgName != NULL);
-   assert(iNumArg >= 0);
-   
-   if(iNumArg == 0)
-      fprintf(stderr, "%s: unsetenv: Missing variable\n", pcProgName);
-   else if(iNumArg > 1)
-      fprintf(stderr, "%s: unsetenv: Too many arguments\n", pcProgName);
-   else if(unsetenv(ppcArray[1]) == -1)
+
+   iSaved = fcntl(iStdFd, F_DUPFD_CLOEXEC, SAVED_FD_BASE);
+   if(iSaved == -1 && errno != EBADF)
+   {
       perror(pcProgName);
+      exit(EXIT_FAILURE);
+   }
+   return iSaved;
 }
-   
+
 /*------------------------------------------------------------------*/
 
-static void callCd(char **ppcArray, int iNumArg, char *pcProgName)
+static void restoreFd(int iSaved, int iStdFd, char *pcProgName)
 
-/* Call chdir() iff the number of arguments iNumArg in ppcArray is 
-   0 or 1.  Print error message to stderr otherwise. pcProgName is
-   used in printing error messages. It is a checked runtime error 
-   for the first element in ppcArray to not be "cd". It is a checked 
-   runtime error for ppcArray or pcProgName to be NULL. It is a 
-   checked runtime error for iNumArg to be negative. */
+/* Make file descriptor iStdFd refer to what saveFd() saved in 
+   iSaved, and close iSaved. Close iStdFd if iSaved is -1. 
+   pcProgName is used in printing error messages. It is a checked 
+   runtime error for pcProgName to be NULL. */
 
 {
-   char *pcEnv;
-
-   assert(ppcArray != NULL);
-   assert(strcmp(ppcArray[0], "cd") == 0);
    assert(pcProgName != NULL);
-   assert(iNumArg >= 0);
 
-   pcEnv = getenv("HOME");
+   if(iSaved == -1)
+   {
+      (void)close(iStdFd);
+      return;
+   }
+   if(dup2(iSaved, iStdFd) == -1 || close(iSaved) == -1)
+   {
+      perror(pcProgName);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static int writeText(int iFd, const char *pcText, size_t uLength)
+
+/* Write pcText, of length uLength, to file descriptor iFd. Return 0
+   if successful, and -1 with errno set otherwise. */
 
-   if(iNumArg > 1)
-      fprintf(stderr, "%s: cd: Too many arguments\n", pcProgName);
-   else if(iNumArg == 0 && pcEnv == NULL)
-      fprintf(stderr, "%s: cd: HOME not set\n", pcProgName);
-   else if(iNumArg == 0 && pcEnv != NULL)
+{
+   ssize_t lWritten;
+
+   while(uLength > 0)
    {
-      if(chdir(pcEnv) == -1)
+      lWritten = write(iFd, pcText, uLength);
+      if(lWritten == -1 && errno == EINTR)
+         continue;
+      if(lWritten == -1)
+         return -1;
+      pcText += lWritten;
+      uLength -= (size_t)lWritten;
+   }
+   return 0;
+}
+
+/*------------------------------------------------------------------*/
+
+static int openHere(const char *pcText, size_t uLength)
+
+/* Return a new file descriptor, not inherited by children, from 
+   which pcText, of length uLength, can be read, or -1 with errno set
+   if an error occurs. It is a checked runtime error for pcText to be
+   NULL. */
+
+/* A text that a pipe takes in one write is written to a pipe, which
+   cannot block. A longer one is written to a memfd, which lives in
+   memory and never touches the filesystem, and then sealed, so the
+   reader sees exactly the text and the shell need not stay to feed
+   it. */
+
+{
+   int aiPipe[2];
+   int iFd;
+   int iErrno;
+
+   assert(pcText != NULL);
+
+   if(uLength <= PIPE_BUF)
+   {
+      if(pipe2(aiPipe, O_CLOEXEC) == -1)
+         return -1;
+      iFd = aiPipe[0];
+      if(writeText(aiPipe[1], pcText, uLength) == -1)
       {
-         fprintf(stderr, "%s: ", pcProgName);
-         perror(pcEnv);
+         iErrno = errno;
+         (void)close(aiPipe[0]);
+         errno = iErrno;
+         iFd = -1;
       }
-   }  
-   else if(chdir(ppcArray[1]) == -1)
+      (void)close(aiPipe[1]);
+      return iFd;
+   }
+
+   iFd = memfd_create("here", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+   if(iFd == -1)
+      return -1;
+   if(writeText(iFd, pcText, uLength) == -1 ||
+      fcntl(iFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | 
+            F_SEAL_WRITE | F_SEAL_SEAL) == -1 ||
+      lseek(iFd, 0, SEEK_SET) == -1)
    {
-      fprintf(stderr, "%s: ", pcProgName);
-      perror(ppcArray[1]);
-   }  
+      iErrno = errno;
+      (void)close(iFd);
+      errno = iErrno;
+      return -1;
+   }
+   return iFd;
 }
-   
+
 /*------------------------------------------------------------------*/
 
-static void callExit(char **ppcArray, int iNumArg, char *pcProgName)
+static void redirectFdInShell(int iFd, int iStdFd, int *piSaved,
+                              char *pcProgName)
 
-/* Call exit() iff the number of arguments iNumArg in ppcArray is 0.
-   Print error message to stderr otherwise. pcProgName is used in
-   printing error messages.  It is a checked runtime error for the
-   first element in ppcArray to not be "exit". It is a checked runtime
-   error for ppcArray or pcProgName to be NULL. It is a checked runtime
-   error for iNumArg to be negative. */
+/* Make file descriptor iStdFd refer to what iFd refers to, saving 
+   what iStdFd referred to in *piSaved, and close iFd. pcProgName is
+   used in printing error messages. It is a checked runtime error for
+   piSaved or pcProgName to be NULL. */
 
 {
-   assert(ppcArray != NULL);
-   assert(strcmp(ppcArray[0], "exit") == 0);
+   assert(piSaved != NULL);
    assert(pcProgName != NULL);
-   assert(iNumArg >= 0);
 
-   if(iNumArg > 0)
-      fprintf(stderr, "%s: exit: Too many arguments\n", pcProgName);
-   else
+   /* iFd can only be iStdFd if iStdFd was closed. */
+   *piSaved = -1;
+   if(iFd == iStdFd)
+      return;
+   *piSaved = saveFd(iStdFd, pcProgName);
+   if(dup2(iFd, iStdFd) == -1 || close(iFd) == -1)
    {
-      printf("\n");
-      exit(EXIT_SUCCESS);
+      perror(pcProgName);
+      exit(EXIT_FAILURE);
    }
 }
 
 /*------------------------------------------------------------------*/
 
-static void callHistory(char **ppcArray, DynArray_T oHistList, 
-                        int iNumArg, char *pcProgName)
+static int redirectInShell(const char *pcName, int iFlags, int iStdFd,
+                           int *piSaved, char *pcProgName)
 
-/* Print out the history list iff the number of arguments iNumArg in 
-   ppcArray is 0.  Print error message to stderr otherwise. pcProgName
-   is used in printing error messages. It is a checked runtime error
-   for ppcArray, oHistList, or pcProgName to be NULL. It is a checked 
-   runtime error for the first element in ppcArray to not be "history".
-   It is a checked runtime error for oHistList to be empty. It is a 
-   checked runtime error for iNumArg to be negative. */
+/* Open file pcName with iFlags and make file descriptor iStdFd refer
+   to it, saving what iStdFd referred to in *piSaved. Return TRUE if
+   successful, and FALSE if pcName cannot be opened; print an error
+   message to stderr in that case. pcProgName is used in printing 
+   error messages. It is a checked runtime error for pcName, piSaved,
+   or pcProgName to be NULL. */
 
 {
-   int i;
+   int iFd;
+
+   assert(pcName != NULL);
+   assert(piSaved != NULL);
+   assert(pcProgName != NULL);
+
+   iFd = open(pcName, iFlags, PERMISSIONS);
+   if(iFd == -1)
+   {
+      fprintf(stderr, "%s: ", pcProgName);
+      perror(pcName);
+      return FALSE;
+   }
+   redirectFdInShell(iFd, iStdFd, piSaved, pcProgName);
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static int runBuiltin(Command_T oCommand, History_T oHistList, 
+                      char *pcProgName)
+
+/* Run the builtin oCommand in the shell itself, and return its exit
+   status. Its redirections are applied to the shell's own stdin and
+   stdout, which are restored afterwards. Return EXIT_FAILURE without
+   running oCommand if a redirection fails. pcProgName is used in 
+   printing error messages. It is a checked runtime error for 
+   oCommand, oHistList, or pcProgName to be NULL. */
+
+/* Builtins do not read stdin through the stdio buffer, which holds
+   the shell's own input, so only the descriptors need switching. 
+   stdout is flushed on each side of the switch, so the shell's 
+   output and the builtin's go to their own files. */
+
+{
+   char *pcStdin;
+   char *pcStdout;
+   char *pcHere;
+   size_t uHereLength;
+   int iHereFd;
+   int iSavedStdin = -1;
+   int iSavedStdout = -1;
+   int iStatus = EXIT_FAILURE;
 
-   assert(ppcArray != NULL);
-   assert(strcmp(ppcArray[0], "history") == 0);
+   assert(oCommand != NULL);
    assert(oHistList != NULL);
-   assert(DynArray_getLength(oHistList) != 0);
-   assert(iNumArg >= 0);
    assert(pcProgName != NULL);
 
-   if(iNumArg > 0)
-      fprintf(stderr, "%s: history: Too many arguments\n", pcProgName);
-   else
-      for(i = 0; i < DynArray_getLength(oHistList); i++)
-         printf("%d\t%s\n", i, (char*)DynArray_get(oHistList, i));
-      
+   pcStdin = Command_getStdin(oCommand, NULL);
+   pcStdout = Command_getStdout(oCommand, NULL);
+   pcHere = Command_getHere(oCommand, &uHereLength);
+   if(pcStdin == NULL && pcStdout == NULL && pcHere == NULL)
+      return builtinRun(Command_getArray(oCommand, NULL), 
+                        Command_getNumArg(oCommand, NULL), oHistList,
+                        pcProgName);
+
+   fflush(stdout);
+   if(pcStdin != NULL && 
+      !redirectInShell(pcStdin, O_RDONLY, 0, &iSavedStdin, 
+                       pcProgName))
+      return EXIT_FAILURE;
+   if(pcHere != NULL)
+   {
+      iHereFd = openHere(pcHere, uHereLength);
+      if(iHereFd == -1)
+      {
+         fprintf(stderr, "%s: ", pcProgName);
+         perror("here-document");
+         return EXIT_FAILURE;
+      }
+      redirectFdInShell(iHereFd, 0, &iSavedStdin, pcProgName);
+   }
+   if(pcStdout == NULL ||
+      redirectInShell(pcStdout, O_WRONLY | O_CREAT | O_TRUNC, 1, 
+                      &iSavedStdout, pcProgName))
+   {
+      iStatus = builtinRun(Command_getArray(oCommand, NULL), 
+                           Command_getNumArg(oCommand, NULL), 
+                           oHistList, pcProgName);
+      fflush(stdout);
+      if(pcStdout != NULL)
+         restoreFd(iSavedStdout, 1, pcProgName);
+   }
+   if(pcStdin != NULL || pcHere != NULL)
+      restoreFd(iSavedStdin, 0, pcProgName);
+   return iStatus;
 }
-      
+
 /*------------------------------------------------------------------*/
 
-void execute(Command_T oCommand, DynArray_T oHistList, char *pcProgName)
+static void execStage(Command_T oCommand, char *pcPath, 
+                      int iPipeIn, int iPipeOut,
+                      int *piPipes, int iNumPipeFds, int iBackground,
+                      History_T oHistList, char *pcProgName)
+
+/* Run oCommand in the current process, which must be a child of the
+   shell. Read stdin from iPipeIn and write stdout to iPipeOut unless
+   they are -1, then apply the redirections of oCommand. The other
+   iNumPipeFds - 2 file descriptors in piPipes belong to other 
+   pipeline stages and are closed. Execute the file pcPath if it is
+   not NULL, and search PATH for the command name otherwise. A 
+   background stage keeps ignoring SIGINT, like the shell. Never
+   return. pcProgName is used in printing error messages. It is a 
+   checked runtime error for oCommand, oHistList, or pcProgName to 
+   be NULL. */
 
-/* Execute the command given by oCommand while properly handling any
-   necessary input/output redirection. pcProgName is used in printing
-   error messages. It is a checked runtime error for oCommand,
-   oHistList, or pcProgName to be NULL. */
 {
    char *pcStdin;
    char *pcStdout;
+   char *pcHere;
+   size_t uHereLength;
    char **ppcArray;
    int iNumArg;
-   pid_t iPid;
+   int iFd;
+   int i;
    void (*pfRet)(int);
 
    assert(oCommand != NULL);
@@ -204,106 +404,752 @@ void execute(Command_T oCommand, DynArray_T oHistList, char *pcProgName)
    pcStdin = Command_getStdin(oCommand, NULL);
    pcStdout = Command_getStdout(oCommand, NULL);
 
-   if(strcmp(ppcArray[0], "setenv") == 0)
-      callSetenv(ppcArray, iNumArg, pcProgName);
-   else if(strcmp(ppcArray[0], "unsetenv") == 0)
-      callUnsetenv(ppcArray, iNumArg, pcProgName);
-   else if(strcmp(ppcArray[0], "cd") == 0)
-      callCd(ppcArray, iNumArg, pcProgName);
-   else if(strcmp(ppcArray[0], "exit") == 0)
-      callExit(ppcArray, iNumArg, pcProgName);   
+   if(!iBackground)
+   {
+      pfRet = signal(SIGINT, SIG_DFL);
+      if(pfRet == SIG_ERR) {perror(pcProgName); exitChild(EXIT_FAILURE); }
+   }
+
+   for(i = 0; i < iNumPipeFds; i++)
+      if(piPipes[i] != iPipeIn && piPipes[i] != iPipeOut)
+         (void)close(piPipes[i]);
+   if(iPipeIn != -1)
+      redirect(iPipeIn, 0, "pipe", pcProgName);
+   if(iPipeOut != -1)
+      redirect(iPipeOut, 1, "pipe", pcProgName);
+
+   if(pcStdin != NULL)
+   {
+      iFd = open(pcStdin, O_RDONLY);
+      if (iFd == -1) 
+      {
+         fprintf(stderr, "%s: ", pcProgName);
+         perror(pcStdin); 
+         exitChild(EXIT_FAILURE); 
+      }
+      redirect(iFd, 0, pcStdin, pcProgName);
+   }
+   pcHere = Command_getHere(oCommand, &uHereLength);
+   if(pcHere != NULL)
+   {
+      iFd = openHere(pcHere, uHereLength);
+      if(iFd == -1)
+      {
+         fprintf(stderr, "%s: ", pcProgName);
+         perror("here-document");
+         exitChild(EXIT_FAILURE);
+      }
+      redirect(iFd, 0, "here-document", pcProgName);
+   }
+   if(pcStdout != NULL)
+   {
+      iFd = creat(pcStdout, PERMISSIONS);
+      if (iFd == -1) 
+      {
+         fprintf(stderr, "%s: ", pcProgName);
+         perror(pcStdout); 
+         exitChild(EXIT_FAILURE); 
+      }
+      redirect(iFd, 1, pcStdout, pcProgName);
+   }
+
+   /* Builtins that are part of a pipeline or in the background run
+      in the child, so they do not affect the shell itself. */
+   if(builtinIsBuiltin(ppcArray))
+   {
+      builtinSetChild();
+      exitChild(builtinRun(ppcArray, iNumArg, oHistList, pcProgName));
+   }
+
+   /* Variables set in the shell reach environ only now. */
+   (void)varExport();
+   if(pcPath != NULL)
+      execv(pcPath, ppcArray);
+   execvp(ppcArray[0], ppcArray);
+   fprintf(stderr, "%s: ", pcProgName);
+   perror(ppcArray[0]);
+   exitChild(EXIT_FAILURE);
+}
+
+/*------------------------------------------------------------------*/
+
+static pid_t spawnStage(Command_T oCommand, char *pcPath,
+                        int iPipeIn, int iPipeOut,
+                        int *piPipes, int iNumPipeFds, int iBackground,
+                        int *piError)
+
+/* Launch the external command oCommand with posix_spawn(), doing
+   the same work as execStage() but expressed as spawn file actions
+   and attributes, so the shell's address space is never copied.
+   Return the pid of the new process, or -1 if it could not be 
+   launched; no error message is printed in that case, but *piError
+   is set to the error that posix_spawn() reported, or to 0 if it 
+   was not called. It is a checked runtime error for oCommand, 
+   piPipes, or piError to be NULL. */
+
+{
+   char **ppcArray;
+   char *pcStdin;
+   char *pcStdout;
+   char *pcHere;
+   size_t uHereLength;
+   int iHereFd = -1;
+   posix_spawn_file_actions_t sActions;
+   posix_spawnattr_t sAttr;
+   sigset_t sDefault;
+   short sFlags;
+   pid_t iPid;
+   int iRet = 0;
+   int i;
+
+   assert(oCommand != NULL);
+   assert(piPipes != NULL);
+   assert(piError != NULL);
+
+   *piError = 0;
+   ppcArray = Command_getArray(oCommand, NULL);
+   pcStdin = Command_getStdin(oCommand, NULL);
+   pcStdout = Command_getStdout(oCommand, NULL);
+
+   /* The text of a here-document is opened in the shell and 
+      duplicated onto the child's stdin. One that landed on a 
+      standard file descriptor, which the file actions would 
+      clobber, is left to execStage(). */
+   pcHere = Command_getHere(oCommand, &uHereLength);
+   if(pcHere != NULL)
+   {
+      iHereFd = openHere(pcHere, uHereLength);
+      if(iHereFd <= 2)
+      {
+         if(iHereFd != -1)
+            (void)close(iHereFd);
+         return -1;
+      }
+   }
+
+   if(posix_spawn_file_actions_init(&sActions) != 0)
+   {
+      if(iHereFd != -1)
+         (void)close(iHereFd);
+      return -1;
+   }
+   if(posix_spawnattr_init(&sAttr) != 0)
+   {
+      (void)posix_spawn_file_actions_destroy(&sActions);
+      if(iHereFd != -1)
+         (void)close(iHereFd);
+      return -1;
+   }
+
+   if(iPipeIn != -1)
+      iRet |= posix_spawn_file_actions_adddup2(&sActions, iPipeIn, 0);
+   if(iPipeOut != -1)
+      iRet |= posix_spawn_file_actions_adddup2(&sActions, iPipeOut, 1);
+   for(i = 0; i < iNumPipeFds; i++)
+      iRet |= posix_spawn_file_actions_addclose(&sActions, piPipes[i]);
+   if(pcStdin != NULL)
+      iRet |= posix_spawn_file_actions_addopen(&sActions, 0, pcStdin,
+                                               O_RDONLY, 0);
+   if(iHereFd != -1)
+      iRet |= posix_spawn_file_actions_adddup2(&sActions, iHereFd, 0);
+   if(pcStdout != NULL)
+      iRet |= posix_spawn_file_actions_addopen(&sActions, 1, pcStdout,
+                 O_WRONLY | O_CREAT | O_TRUNC, PERMISSIONS);
+
+   /* The shell ignores SIGINT, but its foreground children should 
+      not. */
+   sFlags = POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_USEVFORK
+   sFlags |= POSIX_SPAWN_USEVFORK;
+#endif
+   iRet |= sigemptyset(&sDefault);
+   if(!iBackground)
+      iRet |= sigaddset(&sDefault, SIGINT);
+   iRet |= posix_spawnattr_setsigdefault(&sAttr, &sDefault);
+   iRet |= posix_spawnattr_setflags(&sAttr, sFlags);
+
+   if(iRet == 0 && pcPath != NULL)
+      iRet = *piError = posix_spawn(&iPid, pcPath, &sActions, &sAttr,
+                                    ppcArray, varExport());
+   else if(iRet == 0)
+      iRet = *piError = posix_spawnp(&iPid, ppcArray[0], &sActions, 
+                                     &sAttr, ppcArray, varExport());
+
+   (void)posix_spawnattr_destroy(&sAttr);
+   (void)posix_spawn_file_actions_destroy(&sActions);
+   if(iHereFd != -1)
+      (void)close(iHereFd);
+
+   if(iRet != 0)
+      return -1;
+   return iPid;
+}
+
+/*------------------------------------------------------------------*/
+
+static int isExecError(int iError)
+
+/* Return TRUE if iError, an error that posix_spawn() reported, may 
+   mean that the file it was to execute is gone or has changed, and
+   FALSE otherwise. */
+
+/* posix_spawn() reports the failure of an open of a redirection the
+   same way, so a missing input file gives ENOENT too; 
+   pathRevalidate() keeps the entry in that case, since the 
+   directory of the command is unchanged. */
+
+{
+   return iError == ENOENT || iError == EACCES || iError == ENOEXEC;
+}
+
+/*------------------------------------------------------------------*/
+
+static int canSpawn(Command_T oCommand, int *piPipes, int iNumPipeFds)
+
+/* Return TRUE if oCommand can be launched by spawnStage(), and FALSE
+   if it must run in a forked child. It is a checked runtime error
+   for oCommand or piPipes to be NULL. */
+
+{
+   int i;
+
+   assert(oCommand != NULL);
+   assert(piPipes != NULL);
+
+   if(!iSpawnEnabled || 
+      builtinIsBuiltin(Command_getArray(oCommand, NULL)))
+      return FALSE;
+
+   /* The file actions would clobber a pipe that happens to occupy
+      fd 0, 1, or 2. */
+   for(i = 0; i < iNumPipeFds; i++)
+      if(piPipes[i] <= 2)
+         return FALSE;
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static char *describePipeline(DynArray_T oCommands)
+
+/* Return a newly allocated string that spells out the pipeline 
+   oCommands, for the job table. It is a checked runtime error for
+   oCommands to be NULL. */
+
+{
+   Command_T oCommand;
+   char **ppcArray;
+   char *pcStdin;
+   char *pcStdout;
+   char *pcText;
+   size_t uHereLength;
+   size_t uLength = 1;
+   int i;
+   int j;
+
+   assert(oCommands != NULL);
+
+   for(i = 0; i < DynArray_getLength(oCommands); i++)
+   {
+      oCommand = (Command_T)DynArray_get(oCommands, i);
+      for(ppcArray = Command_getArray(oCommand, NULL); 
+          *ppcArray != NULL; ppcArray++)
+         uLength += strlen(*ppcArray) + 1;
+      pcStdin = Command_getStdin(oCommand, NULL);
+      pcStdout = Command_getStdout(oCommand, NULL);
+      if(pcStdin != NULL)
+         uLength += strlen(pcStdin) + 3;
+      if(Command_getHere(oCommand, &uHereLength) != NULL)
+         uLength += strlen(" <<...");
+      if(pcStdout != NULL)
+         uLength += strlen(pcStdout) + 3;
+      uLength += 3;
+   }
+
+   pcText = (char*)malloc(uLength);
+   assert(pcText != NULL);
+   pcText[0] = '\0';
+   for(i = 0; i < DynArray_getLength(oCommands); i++)
+   {
+      oCommand = (Command_T)DynArray_get(oCommands, i);
+      if(i > 0)
+         strcat(pcText, " | ");
+      ppcArray = Command_getArray(oCommand, NULL);
+      for(j = 0; ppcArray[j] != NULL; j++)
+      {
+         if(j > 0)
+            strcat(pcText, " ");
+         strcat(pcText, ppcArray[j]);
+      }
+      pcStdin = Command_getStdin(oCommand, NULL);
+      pcStdout = Command_getStdout(oCommand, NULL);
+      if(pcStdin != NULL)
+      {
+         strcat(pcText, " < ");
+         strcat(pcText, pcStdin);
+      }
+      if(Command_getHere(oCommand, &uHereLength) != NULL)
+         strcat(pcText, " <<...");
+      if(pcStdout != NULL)
+      {
+         strcat(pcText, " > ");
+         strcat(pcText, pcStdout);
+      }
+   }
+   return pcText;
+}
+
+/*------------------------------------------------------------------*/
+
+static double getNow(void)
+
+/* Return the current time of a monotonic clock, in seconds. */
+
+{
+   struct timespec sNow;
+
+   if(clock_gettime(CLOCK_MONOTONIC, &sNow) == -1)
+      return 0.0;
+   return (double)sNow.tv_sec + (double)sNow.tv_nsec / 1e9;
+}
+
+/*------------------------------------------------------------------*/
+
+static double getSeconds(const struct timeval *psTime)
+
+/* Return the length of time psTime, in seconds. */
+
+{
+   return (double)psTime->tv_sec + (double)psTime->tv_usec / 1e6;
+}
+
+/*------------------------------------------------------------------*/
+
+static void addUsage(struct ExecStats *psStats, 
+                     const struct rusage *psUsage)
+
+/* Add the CPU times in psUsage to those in psStats, and raise the 
+   maximum resident set size in psStats to that in psUsage if it is
+   greater. */
+
+{
+   psStats->dUser += getSeconds(&psUsage->ru_utime);
+   psStats->dSys += getSeconds(&psUsage->ru_stime);
+   if(psUsage->ru_maxrss > psStats->lMaxRss)
+      psStats->lMaxRss = psUsage->ru_maxrss;
+}
+
+/*------------------------------------------------------------------*/
+
+static int runBuiltinTimed(Command_T oCommand, History_T oHistList, 
+                           char *pcProgName)
+
+/* Run the builtin oCommand in the shell itself as runBuiltin() 
+   does, record its resource usage in sLastStats, and return its 
+   exit status. pcProgName is used in printing error messages. */
+
+/* The CPU time is the shell's own while the builtin runs, plus that
+   of any children the builtin reaps. The maximum resident set size
+   is the shell's, since getrusage() reports only a lifetime maximum
+   for children. */
+
+{
+   struct rusage sBefore;
+   struct rusage sAfter;
+   struct rusage sChildBefore;
+   struct rusage sChildAfter;
+   double dStart;
+
+   dStart = getNow();
+   (void)getrusage(RUSAGE_SELF, &sBefore);
+   (void)getrusage(RUSAGE_CHILDREN, &sChildBefore);
+   sLastStats.iStatus = runBuiltin(oCommand, oHistList, pcProgName);
+   (void)getrusage(RUSAGE_SELF, &sAfter);
+   (void)getrusage(RUSAGE_CHILDREN, &sChildAfter);
+   sLastStats.dWall = getNow() - dStart;
+   sLastStats.dUser = getSeconds(&sAfter.ru_utime) - 
+                      getSeconds(&sBefore.ru_utime) +
+                      getSeconds(&sChildAfter.ru_utime) - 
+                      getSeconds(&sChildBefore.ru_utime);
+   sLastStats.dSys = getSeconds(&sAfter.ru_stime) - 
+                     getSeconds(&sBefore.ru_stime) +
+                     getSeconds(&sChildAfter.ru_stime) - 
+                     getSeconds(&sChildBefore.ru_stime);
+   sLastStats.lMaxRss = sAfter.ru_maxrss;
+   return sLastStats.iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+const struct ExecStats *execGetStats(void)
+
+/* Return the resource usage of the pipeline most recently executed
+   in the foreground. It remains valid until the next one is 
+   executed. */
+
+{
+   return &sLastStats;
+}
+
+/*------------------------------------------------------------------*/
+
+void execPrintStats(const struct ExecStats *psStats, 
+                    const char *pcLabel, FILE *psFile)
+
+/* Write the times and maximum resident set size in psStats to 
+   psFile on one line, preceded by pcLabel if it is not NULL. A 
+   negative wall time is shown as unknown. It is a checked runtime 
+   error for psStats or psFile to be NULL. */
+
+{
+   assert(psStats != NULL);
+   assert(psFile != NULL);
+
+   if(pcLabel != NULL)
+      fprintf(psFile, "%-9s", pcLabel);
+   if(psStats->dWall < 0.0)
+      fprintf(psFile, "%9s real", "-");
    else
-   {      
-      fflush(NULL);
-      iPid = fork();
-      if (iPid == -1) {perror(pcProgName); exit(EXIT_FAILURE); }
- 
-      if (iPid == 0)
+      fprintf(psFile, "%9.3f real", psStats->dWall);
+   fprintf(psFile, " %9.3f user %9.3f sys %8ld KB maxrss\n",
+           psStats->dUser, psStats->dSys, psStats->lMaxRss);
+}
+
+/*------------------------------------------------------------------*/
+
+static int getExitStatus(int iWaitStatus)
+
+/* Return the exit status of a command whose process waitpid() 
+   reported as iWaitStatus: its exit code, or SIGNAL_STATUS_BASE plus
+   the signal number if a signal killed it. */
+
+{
+   if(WIFSIGNALED(iWaitStatus))
+      return SIGNAL_STATUS_BASE + WTERMSIG(iWaitStatus);
+   return WEXITSTATUS(iWaitStatus);
+}
+
+/*------------------------------------------------------------------*/
+
+void execSetSpawn(int iEnabled)
+
+/* Launch external commands with posix_spawn() if iEnabled is TRUE,
+   and with fork() and execvp() if iEnabled is FALSE. Spawning is
+   enabled by default. */
+
+{
+   iSpawnEnabled = iEnabled;
+}
+
+/*------------------------------------------------------------------*/
+
+int execute(DynArray_T oCommands, int iBackground, 
+            History_T oHistList, char *pcProgName)
+
+/* Execute the pipeline given by oCommands while properly handling
+   any necessary input/output redirection. A single builtin in the 
+   foreground runs in the shell itself. Otherwise all stages run 
+   concurrently, and the stdout of each stage is connected to the
+   stdin of the next one by a pipe. If iBackground is TRUE, add the
+   pipeline to the job table and return 0 at once; otherwise return
+   the exit status of the last stage when all stages have exited. 
+   pcProgName is used in printing error messages. It is a checked
+   runtime error for oCommands, oHistList, or pcProgName to be NULL.
+   It is a checked runtime error for oCommands to be empty. */
+
+{
+   Command_T oCommand;
+   int iNumStages;
+   char **ppcArray;
+   char *pcPath;
+   char *pcText;
+   int iNumPipeFds;
+   int iPipeIn;
+   int iPipeOut;
+   int iError;
+   struct SmallArray sPipes;
+   struct SmallArray sPids;
+   int *piPipes;
+   pid_t *piPids;
+   struct rusage sUsage;
+   size_t uHereLength;
+   double dStart;
+   int iStatus = 0;
+   int i;
+
+   assert(oCommands != NULL);
+   assert(oHistList != NULL);
+   assert(pcProgName != NULL);
+
+   iNumStages = DynArray_getLength(oCommands);
+   assert(iNumStages > 0);
+
+   /* A builtin in the background runs in a child like any other
+      command. */
+   if(iNumStages == 1 && !iBackground)
+   {
+      oCommand = (Command_T)DynArray_get(oCommands, 0);
+      ppcArray = Command_getArray(oCommand, NULL);
+      if(builtinIsBuiltin(ppcArray) &&
+         builtinRunsInShell(ppcArray, 
+                            Command_getStdin(oCommand, NULL) == NULL &&
+                            Command_getHere(oCommand, &uHereLength)
+                            == NULL && isatty(0)))
+         return runBuiltinTimed(oCommand, oHistList, pcProgName);
+   }
+
+   dStart = getNow();
+
+   /* Pipe i connects stage i to stage i + 1. Its read end is 
+      piPipes[2 * i] and its write end is piPipes[2 * i + 1]. Short
+      pipelines keep their pipes and pids on the stack. */
+   iNumPipeFds = 2 * (iNumStages - 1);
+   SmallArray_init(&sPipes, sizeof(int));
+   SmallArray_setLength(&sPipes, iNumPipeFds);
+   piPipes = (int*)SmallArray_getArray(&sPipes);
+   SmallArray_init(&sPids, sizeof(pid_t));
+   SmallArray_setLength(&sPids, iNumStages);
+   piPids = (pid_t*)SmallArray_getArray(&sPids);
+
+   for(i = 0; i < iNumStages - 1; i++)
+      if(pipe(&piPipes[2 * i]) == -1) 
+      {
+         perror(pcProgName); 
+         exit(EXIT_FAILURE); 
+      }
+
+   fflush(NULL);
+   for(i = 0; i < iNumStages; i++)
+   {
+      oCommand = (Command_T)DynArray_get(oCommands, i);
+      iPipeIn = (i > 0) ? piPipes[2 * (i - 1)] : -1;
+      iPipeOut = (i < iNumStages - 1) ? piPipes[2 * i + 1] : -1;
+
+      /* Resolve the command name in the shell, so the cache is
+         updated by every launch. */
+      pcPath = NULL;
+      ppcArray = Command_getArray(oCommand, NULL);
+      if(!builtinIsBuiltin(ppcArray))
+         pcPath = pathLookup(ppcArray[0]);
+
+      if(canSpawn(oCommand, piPipes, iNumPipeFds))
       {
-         int iFd;
-         int iRet;
-         
-         pfRet = signal(SIGINT, SIG_DFL);
-         if(pfRet == SIG_ERR) {perror(pcProgName); exit(EXIT_FAILURE); }
+         piPids[i] = spawnStage(oCommand, pcPath, iPipeIn, iPipeOut, 
+                                piPipes, iNumPipeFds, iBackground,
+                                &iError);
+         if(piPids[i] != -1)
+            continue;
 
-         if(pcStdin != NULL)
+         /* Fall through to fork(), so the child reports the failed
+            redirection or execvp() exactly as it always has. */
+         if(pcPath != NULL && isExecError(iError))
          {
-            iFd = open(pcStdin, O_RDONLY);
-            if (iFd == -1) 
-            {
-               fprintf(stderr, "%s: ", pcProgName);
-               perror(pcStdin); 
-               exit(EXIT_FAILURE); 
-            }
-            iRet = close(0);
-            if (iRet == -1)
-            {
-               fprintf(stderr, "%s: ", pcProgName);
-               perror(pcStdin); 
-               exit(EXIT_FAILURE); 
-            }            
-            iRet = dup(iFd);
-            if (iRet == -1)
-            {
-               fprintf(stderr, "%s: ", pcProgName);
-               perror(pcStdin); 
-               exit(EXIT_FAILURE); 
-            }
-            iRet = close(iFd);
-            if (iRet == -1)
-            {
-               fprintf(stderr, "%s: ", pcProgName);
-               perror(pcStdin); 
-               exit(EXIT_FAILURE); 
-            }
+            pathRevalidate(ppcArray[0]);
+            pcPath = NULL;
          }
-         if(pcStdout != NULL)
+      }
+
+      piPids[i] = fork();
+      if (piPids[i] == -1) {perror(pcProgName); exit(EXIT_FAILURE); }
+
+      if (piPids[i] == 0)
+         execStage(oCommand, pcPath, iPipeIn, iPipeOut, piPipes,
+                   iNumPipeFds, iBackground, oHistList, pcProgName);
+   }
+
+   /* Close the shell's copies of the pipes, so each stage sees EOF
+      once the stage before it exits. */
+   for(i = 0; i < iNumPipeFds; i++)
+      if(close(piPipes[i]) == -1) 
+      {
+         perror(pcProgName); 
+         exit(EXIT_FAILURE); 
+      }
+
+   if(iBackground)
+   {
+      pcText = describePipeline(oCommands);
+      (void)jobAdd(piPids, iNumStages, pcText);
+      free(pcText);
+   }
+   else
+   {
+      sLastStats.dUser = 0.0;
+      sLastStats.dSys = 0.0;
+      sLastStats.lMaxRss = 0;
+      for(i = 0; i < iNumStages; i++)
+      {
+         if(wait4(piPids[i], &iStatus, 0, &sUsage) == -1) 
          {
-            iFd = creat(pcStdout, PERMISSIONS);
-            if (iFd == -1) 
-            {
-               fprintf(stderr, "%s: ", pcProgName);
-               perror(pcStdout); 
-               exit(EXIT_FAILURE); 
-            }
-            iRet = close(1);
-            if (iRet == -1)
-            {
-               fprintf(stderr, "%s: ", pcProgName);
-               perror(pcStdout); 
-               exit(EXIT_FAILURE); 
-            }
-            iRet = dup(iFd);
-            if (iRet == -1)
-            {
-               fprintf(stderr, "%s: ", pcProgName);
-               perror(pcStdout); 
-               exit(EXIT_FAILURE); 
-            }
-            iRet = close(iFd);
-            if (iRet == -1) 
-            {
-               fprintf(stderr, "%s: ", pcProgName);
-               perror(pcStdout); 
-               exit(EXIT_FAILURE); 
-            }
+            perror(pcProgName); 
+            exit(EXIT_FAILURE); 
          }
-         
-         if(strcmp(ppcArray[0], "history") == 0)
+         addUsage(&sLastStats, &sUsage);
+      }
+      sLastStats.dWall = getNow() - dStart;
+   }
+
+   SmallArray_free(&sPipes);
+   SmallArray_free(&sPids);
+
+   iStatus = getExitStatus(iStatus);
+   if(!iBackground)
+      sLastStats.iStatus = iStatus;
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+pid_t executeStart(Command_T oCommand, int iOutFd, 
+                   History_T oHistList, char *pcProgName)
+
+/* Start oCommand alone in the foreground with its stdout written to
+   iOutFd, unless oCommand redirects its stdout, and return its pid
+   without waiting for it. A builtin runs in a child like any other
+   command. pcProgName is used in printing error messages. It is a 
+   checked runtime error for oCommand, oHistList, or pcProgName to be
+   NULL. It is a checked runtime error for iOutFd to be a standard 
+   file descriptor. */
+
+/* The command is launched exactly as a stage of execute() is, with
+   iOutFd in place of the pipe to the next stage. */
+
+{
+   char **ppcArray;
+   char *pcPath = NULL;
+   int aiFds[1];
+   int iError;
+   pid_t iPid;
+
+   assert(oCommand != NULL);
+   assert(iOutFd > 2);
+   assert(oHistList != NULL);
+   assert(pcProgName != NULL);
+
+   aiFds[0] = iOutFd;
+   ppcArray = Command_getArray(oCommand, NULL);
+   if(!builtinIsBuiltin(ppcArray))
+      pcPath = pathLookup(ppcArray[0]);
+
+   if(canSpawn(oCommand, aiFds, 1))
+   {
+      iPid = spawnStage(oCommand, pcPath, -1, iOutFd, aiFds, 1, FALSE,
+                        &iError);
+      if(iPid != -1)
+         return iPid;
+      if(pcPath != NULL && isExecError(iError))
+      {
+         pathRevalidate(ppcArray[0]);
+         pcPath = NULL;
+      }
+   }
+
+   fflush(NULL);
+   iPid = fork();
+   if(iPid == -1) {perror(pcProgName); exit(EXIT_FAILURE); }
+   if(iPid == 0)
+      execStage(oCommand, pcPath, -1, iOutFd, aiFds, 1, FALSE, 
+                oHistList, pcProgName);
+   return iPid;
+}
+
+/*------------------------------------------------------------------*/
+
+int executeWaitAny(const pid_t *piPids, int iNumPids, int *piStatus,
+                   char *pcProgName)
+
+/* Block until one of the processes in piPids, which were started by
+   executeStart(), exits. Store its exit status in *piStatus and 
+   return its index in piPids. Elements of piPids that are -1 are 
+   skipped. pcProgName is used in printing error messages. It is a 
+   checked runtime error for piPids, piStatus, or pcProgName to be 
+   NULL. It is a checked runtime error for piPids to hold no 
+   process. */
+
+/* Only the given processes are waited for, so background jobs are 
+   left for the job table to reap. SIGCHLD is blocked between 
+   polling them and sigsuspend(), so an exit in between still wakes
+   the shell; this relies on the handler jobInit() installs. */
+
+{
+   sigset_t sChild;
+   sigset_t sOld;
+   pid_t iPid;
+   int iWaitStatus;
+   int iLive;
+   int i;
+
+   assert(piPids != NULL);
+   assert(piStatus != NULL);
+   assert(pcProgName != NULL);
+
+   if(sigemptyset(&sChild) == -1 || sigaddset(&sChild, SIGCHLD) == -1
+      || sigprocmask(SIG_BLOCK, &sChild, &sOld) == -1)
+   {
+      perror(pcProgName);
+      exit(EXIT_FAILURE);
+   }
+
+   for(;;)
+   {
+      iLive = 0;
+      for(i = 0; i < iNumPids; i++)
+      {
+         if(piPids[i] == -1)
+            continue;
+         iLive++;
+         iPid = waitpid(piPids[i], &iWaitStatus, WNOHANG);
+         if(iPid == piPids[i])
          {
-            callHistory(ppcArray, oHistList, iNumArg, pcProgName);   
-            exit(EXIT_SUCCESS);
+            *piStatus = getExitStatus(iWaitStatus);
+            (void)sigprocmask(SIG_SETMASK, &sOld, NULL);
+            return i;
          }
-         else
+         if(iPid == -1 && errno != EINTR)
          {
-            execvp(ppcArray[0], ppcArray);
-            fprintf(stderr, "%s: ", pcProgName);
-            perror(ppcArray[0]);
+            perror(pcProgName);
             exit(EXIT_FAILURE);
          }
       }
-   
-      iPid = wait(NULL);
-      if (iPid == -1) {perror(pcProgName); exit(EXIT_FAILURE); }
+      assert(iLive > 0);
+      (void)sigsuspend(&sOld);
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+void executeFinal(DynArray_T oCommands, int iBackground,
+                  History_T oHistList, char *pcProgName)
+
+/* Execute the pipeline given by oCommands as the last thing the 
+   shell does, and exit with its status. If it is a single external
+   command in the foreground and no background jobs are running, 
+   replace the shell with it instead of forking. pcProgName is used
+   in printing error messages. It is a checked runtime error for 
+   oCommands, oHistList, or pcProgName to be NULL. It is a checked 
+   runtime error for oCommands to be empty. */
+
+{
+   Command_T oCommand;
+   char **ppcArray;
+   int iStatus;
+
+   assert(oCommands != NULL);
+   assert(oHistList != NULL);
+   assert(pcProgName != NULL);
+   assert(DynArray_getLength(oCommands) > 0);
+
+   oCommand = (Command_T)DynArray_get(oCommands, 0);
+   ppcArray = Command_getArray(oCommand, NULL);
+   if(DynArray_getLength(oCommands) > 1 || iBackground || 
+      builtinIsBuiltin(ppcArray) || jobCount() > 0)
+   {
+      iStatus = execute(oCommands, iBackground, oHistList, pcProgName);
+      fflush(NULL);
+      exit(iStatus);
    }
+
+   fflush(NULL);
+   execStage(oCommand, pathLookup(ppcArray[0]), -1, -1, NULL, 0, 
+             FALSE, oHistList, pcProgName);
 }
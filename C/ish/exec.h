@@ -6,11 +6,87 @@
 #ifndef EXEC_INCLUDED
 #define EXEC_INCLUDED
 
-void execute(Command_T oCommand, DynArray_T oHistList, 
-             char *pcProgName);
-/* Execute the command given by oCommand while properly handling any
-   necessary input/output redirection. pcProgName is used in printing
-   error messages. It is a checked runtime error for oCommand,
-   oHistList, or pcProgName to be NULL. */
+#include <stdio.h>
+#include <sys/types.h>
+
+/* The resource usage of an executed pipeline. */
+
+struct ExecStats
+{
+   /* The exit status of the pipeline. */
+   int iStatus;
+
+   /* The wall time, and the user and system CPU time summed over 
+      all stages, in seconds. */
+   double dWall;
+   double dUser;
+   double dSys;
+
+   /* The greatest maximum resident set size of any stage, in 
+      kilobytes. */
+   long lMaxRss;
+};
+
+int execute(DynArray_T oCommands, int iBackground, 
+            History_T oHistList, char *pcProgName);
+/* Execute the pipeline given by oCommands while properly handling
+   any necessary input/output redirection. A single builtin in the 
+   foreground runs in the shell itself. Otherwise all stages run 
+   concurrently, and the stdout of each stage is connected to the
+   stdin of the next one by a pipe. If iBackground is TRUE, add the
+   pipeline to the job table and return 0 at once; otherwise return
+   the exit status of the last stage when all stages have exited. 
+   pcProgName is used in printing error messages. It is a checked
+   runtime error for oCommands, oHistList, or pcProgName to be NULL.
+   It is a checked runtime error for oCommands to be empty. */
+
+void executeFinal(DynArray_T oCommands, int iBackground,
+                  History_T oHistList, char *pcProgName);
+/* Execute the pipeline given by oCommands as the last thing the 
+   shell does, and exit with its status. If it is a single external
+   command in the foreground and no background jobs are running, 
+   replace the shell with it instead of forking. pcProgName is used
+   in printing error messages. It is a checked runtime error for 
+   oCommands, oHistList, or pcProgName to be NULL. It is a checked 
+   runtime error for oCommands to be empty. */
+
+pid_t executeStart(Command_T oCommand, int iOutFd, 
+                   History_T oHistList, char *pcProgName);
+/* Start oCommand alone in the foreground with its stdout written to
+   iOutFd, unless oCommand redirects its stdout, and return its pid
+   without waiting for it. A builtin runs in a child like any other
+   command. pcProgName is used in printing error messages. It is a 
+   checked runtime error for oCommand, oHistList, or pcProgName to be
+   NULL. It is a checked runtime error for iOutFd to be a standard 
+   file descriptor. */
+
+int executeWaitAny(const pid_t *piPids, int iNumPids, int *piStatus,
+                   char *pcProgName);
+/* Block until one of the processes in piPids, which were started by
+   executeStart(), exits. Store its exit status in *piStatus and 
+   return its index in piPids. Elements of piPids that are -1 are 
+   skipped. Background jobs are not reaped. pcProgName is used in 
+   printing error messages. It is a checked runtime error for piPids,
+   piStatus, or pcProgName to be NULL. It is a checked runtime error
+   for piPids to hold no process. */
+
+const struct ExecStats *execGetStats(void);
+/* Return the resource usage of the pipeline most recently executed
+   in the foreground. It remains valid until the next one is 
+   executed. The processes of the pipeline are reaped with wait4(), 
+   which reports their usage; a builtin run in the shell is charged
+   the shell's own usage while it runs. */
+
+void execPrintStats(const struct ExecStats *psStats, 
+                    const char *pcLabel, FILE *psFile);
+/* Write the times and maximum resident set size in psStats to 
+   psFile on one line, preceded by pcLabel if it is not NULL. A 
+   negative wall time is shown as unknown. It is a checked runtime 
+   error for psStats or psFile to be NULL. */
+
+void execSetSpawn(int iEnabled);
+/* Launch external commands with posix_spawn() if iEnabled is TRUE,
+   and with fork() and execvp() if iEnabled is FALSE. Spawning is
+   enabled by default. */
 
 #endif                      /* EXEC_INCLUDED */
@@ -3,36 +3,147 @@
 /* Author: Mark Xia                                                 */
 /* -----------------------------------------------------------------*/
 
-#include "dynarray.h"
+#define _GNU_SOURCE
+#include "hist.h"
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 
 /*------------------------------------------------------------------*/
 
 enum {FALSE, TRUE};
-enum {MAX_LINE_SIZE = 1024};
+
+/* The smallest expansion buffer that histExpandLine() allocates. */
+enum {MIN_BUFFER_SIZE = 128};
+
+/* The number of entries a History holds at first. */
+enum {MIN_HISTORY_SIZE = 16};
+
+/* The permissions of a new history file. */
+enum {PERMISSIONS = 0600};
+
+/* The number of bytes in each length field of a history file 
+   record. */
+enum {LENGTH_SIZE = 4};
+
+/*------------------------------------------------------------------*/
+
+/* A HistNode is a node of the prefix trie of a History. The path 
+   from the root to a node spells a prefix of iCount entries, the 
+   most recent of which has event number lNumber. The children of a
+   node form a list linked by psSibling, so finding a child takes 
+   time proportional to their number. Only the first word of an 
+   entry is in the trie, and few characters follow a given prefix of
+   a command name, so the lists are short except near the root. */
+
+struct HistNode
+{
+   /* The last character of the prefix the node spells. */
+   char c;
+
+   /* The number of entries that have the prefix. */
+   int iCount;
+
+   /* The event number of the most recent entry with the prefix. */
+   long lNumber;
+
+   /* The first child of the node. */
+   struct HistNode *psChild;
+
+   /* The next child of the node's parent. */
+   struct HistNode *psSibling;
+};
+
+/*------------------------------------------------------------------*/
+
+/* A History is the most recent command lines, and a trie of their
+   prefixes. The lines of this session are kept in a ring. The lines
+   of earlier sessions are read from a history file, which is a 
+   sequence of records, each of which is a line preceded and 
+   followed by its length in LENGTH_SIZE little-endian bytes. The 
+   trailing length lets the file be read backwards from its end, so
+   only as many records are read as the History keeps.
+
+   The lines of this session are numbered from 0 in the order they
+   were added. The lines read from the file are older, so they are
+   numbered from -1 backwards. */
+
+struct History
+{
+   /* The entries of this session, oldest first starting at index 
+      iFirst. Each is a buffer of the size in the parallel array 
+      puSizes, reused when its entry is evicted. */
+   char **ppcLines;
+   size_t *puSizes;
+
+   /* The wall time in seconds and the exit status of the command of
+      each entry of this session, in arrays parallel to ppcLines. A
+      time of -1 means the result has not been recorded. */
+   double *pdSeconds;
+   int *piStatuses;
+
+   /* The number of elements allocated in ppcLines, puSizes, 
+      pdSeconds, and piStatuses. */
+   int iPhysLength;
+
+   /* The greatest number of entries to keep. */
+   int iMaxLength;
+
+   /* The number of entries of this session. */
+   int iLength;
+
+   /* The index of the oldest entry of this session. */
+   int iFirst;
+
+   /* The event number of the oldest entry of this session. */
+   long lFirstNumber;
+
+   /* The history file, open for appending, or -1 if there is 
+      none. */
+   int iFd;
+
+   /* The history file as it was when the History was created, 
+      mapped into memory, or NULL if it was empty. */
+   const unsigned char *pucMap;
+   size_t uMapSize;
+
+   /* TRUE iff the entries of the file have been found. */
+   int iFileLoaded;
+
+   /* TRUE iff the entries of the file are in the trie. */
+   int iFileIndexed;
+
+   /* The offsets in pucMap of the records of the entries of the 
+      file, oldest first. The oldest iFileFirst have been 
+      evicted. */
+   size_t *puFileOffsets;
+   int iFileLength;
+   int iFileFirst;
+
+   /* The root of the prefix trie, which spells the empty prefix. */
+   struct HistNode sRoot;
+};
 
 /*------------------------------------------------------------------*/
 
-int histHasCommandPrefix(char *pcLine)
+int histHasCommandPrefix(const char *pcLine, size_t uLength)
 
-/* Return TRUE if the string pointed to by pcLine contains a !, 
+/* Return TRUE if the first uLength characters of pcLine contain a !,
    or FALSE otherwise. It is a checked runtime error for pcLine to
    be NULL. */
 
 {
-   int i;
-   
    assert(pcLine != NULL);
 
-   for(i = 0; pcLine[i] != '\0'; i++)
-      if(pcLine[i] == '!')
-         return TRUE;
-
-   return FALSE;
+   return memchr(pcLine, '!', uLength) != NULL;
 }
 
 /*------------------------------------------------------------------*/
@@ -42,117 +153,767 @@ static int isTerminatorChar(char c)
 /* Return TRUE if c is a terminator character, and FALSE otherwise. */
 {
    return (c == ' ' || c == '\t' || c == '\n' || 
-           c == '>' || c == '<'  || c == '\0');
+           c == '>' || c == '<'  || c == '|'  || c == '&' ||
+           c == '\0');
 }
 
 /*------------------------------------------------------------------*/
 
-static char *findPrevCommand(char *pcLine, DynArray_T oHistList)
+static void reserve(char **ppcBuffer, size_t *puSize, size_t uNeeded)
 
-/* Return the most recently executed command that matches the
-   !commandprefix pcLine points to. Return NULL if a match cannot be 
-   found.  
-   It is a checked runtime error for pcLine or oHistList to be NULL.
-   It is a checked runtime error for pcLine to not point to ! of 
-   !commandprefix. It is a checked runtime error for pcLine to 
-   point to an empty commandprefix. */
+/* Make the buffer *ppcBuffer, of *puSize bytes, hold at least 
+   uNeeded bytes, growing it to at least twice its size if it must
+   grow at all. It is a checked runtime error for ppcBuffer or 
+   puSize to be NULL. */
+
+{
+   size_t uSize;
+
+   assert(ppcBuffer != NULL);
+   assert(puSize != NULL);
+
+   if(*ppcBuffer != NULL && *puSize >= uNeeded)
+      return;
+
+   uSize = (*ppcBuffer == NULL) ? 0 : *puSize * 2;
+   if(uSize < MIN_BUFFER_SIZE)
+      uSize = MIN_BUFFER_SIZE;
+   if(uSize < uNeeded)
+      uSize = uNeeded;
+   *ppcBuffer = (char*)realloc(*ppcBuffer, uSize);
+   assert(*ppcBuffer != NULL);
+   *puSize = uSize;
+}
+
+/*------------------------------------------------------------------*/
+
+History_T History_new(int iMaxLength, const char *pcFileName)
+
+/* Return a new History that keeps the iMaxLength most recent 
+   entries. If pcFileName is not NULL, the History starts with the
+   entries of the history file pcFileName, and each entry added is
+   appended to that file, which is created if necessary. Concurrent
+   shells may append to the same file. If the file cannot be opened,
+   the History is not saved. It is a checked runtime error for 
+   iMaxLength to be negative. */
+
+/* The file is mapped into memory but not read, so creating a 
+   History takes the same time however long the file is. */
+
+{
+   History_T oHistory;
+   struct stat sStat;
+   void *pvMap;
+
+   assert(iMaxLength >= 0);
+
+   oHistory = (History_T)calloc(1, sizeof(struct History));
+   assert(oHistory != NULL);
+   oHistory->iMaxLength = iMaxLength;
+   oHistory->iFd = -1;
+   oHistory->iFileLoaded = TRUE;
+
+   if(pcFileName == NULL || iMaxLength == 0)
+      return oHistory;
+
+   oHistory->iFd = open(pcFileName, 
+                        O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 
+                        PERMISSIONS);
+   if(oHistory->iFd == -1)
+      return oHistory;
+   if(fstat(oHistory->iFd, &sStat) == 0 && sStat.st_size > 0)
+   {
+      pvMap = mmap(NULL, (size_t)sStat.st_size, PROT_READ, MAP_SHARED,
+                   oHistory->iFd, 0);
+      if(pvMap != MAP_FAILED)
+      {
+         oHistory->pucMap = (const unsigned char*)pvMap;
+         oHistory->uMapSize = (size_t)sStat.st_size;
+         oHistory->iFileLoaded = FALSE;
+      }
+   }
+   return oHistory;
+}
+
+/*------------------------------------------------------------------*/
+
+static void freeTrie(struct HistNode *psNode)
+
+/* Free psNode, its siblings, and their descendants. */
+
+/* A child is moved to the front of the list being freed, ahead of
+   its parent, so deep paths need no recursion. */
+
+{
+   struct HistNode *psNext;
+
+   while(psNode != NULL)
+   {
+      if(psNode->psChild != NULL)
+      {
+         psNext = psNode->psChild;
+         psNode->psChild = psNext->psSibling;
+         psNext->psSibling = psNode;
+      }
+      else
+      {
+         psNext = psNode->psSibling;
+         free(psNode);
+      }
+      psNode = psNext;
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+void History_free(History_T oHistory)
+
+/* Free oHistory and its entries, and close its history file. Do 
+   nothing if oHistory is NULL. */
 
 {
-   int iLength;
    int i;
-   char *pc;
 
-   assert(pcLine != NULL);
-   assert(pcLine[0] == '!');
-   assert(!isTerminatorChar(pcLine[1]));
-   assert(oHistList != NULL);
+   if(oHistory == NULL)
+      return;
 
-   if(DynArray_getLength(oHistList) == 0)
-      return NULL;
-          
-   /* Note pcLine[1] is not a terminator character. */ 
-   iLength = 1;
+   for(i = 0; i < oHistory->iPhysLength; i++)
+      free(oHistory->ppcLines[i]);
+   free(oHistory->ppcLines);
+   free(oHistory->puSizes);
+   free(oHistory->pdSeconds);
+   free(oHistory->piStatuses);
+   free(oHistory->puFileOffsets);
+   if(oHistory->pucMap != NULL)
+      (void)munmap((void*)oHistory->pucMap, oHistory->uMapSize);
+   if(oHistory->iFd != -1)
+      (void)close(oHistory->iFd);
+   freeTrie(oHistory->sRoot.psChild);
+   free(oHistory);
+}
+
+/*------------------------------------------------------------------*/
+
+static size_t getRecordLength(const unsigned char *puc)
 
-   while(!isTerminatorChar(pcLine[iLength + 1]))
-      iLength++;
+/* Return the record length stored in the LENGTH_SIZE bytes at 
+   puc. */
 
-   /* Find a matching command starting from the end of oHistList 
-      because the end represents the most recent command. */
-   for(i = DynArray_getLength(oHistList) - 1; i >= 0; i--)
+{
+   return (size_t)puc[0] | (size_t)puc[1] << 8 | 
+          (size_t)puc[2] << 16 | (size_t)puc[3] << 24;
+}
+
+/*------------------------------------------------------------------*/
+
+static void loadFile(History_T oHistory)
+
+/* Find the records of the history file of oHistory, from the most 
+   recent back, until oHistory is full. Do nothing if they have been
+   found already. */
+
+/* A record whose two lengths disagree, as when a shell died while 
+   appending it, ends the search, since the records before it cannot
+   be found. */
+
+{
+   size_t uEnd;
+   size_t uLength;
+   int iLimit;
+   int iPhysLength = 0;
+   int i;
+   size_t uTemp;
+
+   if(oHistory->iFileLoaded)
+      return;
+   oHistory->iFileLoaded = TRUE;
+
+   iLimit = oHistory->iMaxLength - oHistory->iLength;
+   uEnd = oHistory->uMapSize;
+   while(oHistory->iFileLength < iLimit && uEnd >= 2 * LENGTH_SIZE)
    {
-      pc = (char*)DynArray_get(oHistList, i);
-      if(strncmp(&pcLine[1], pc, (size_t)iLength) == 0)
-         return pc;
+      uLength = getRecordLength(oHistory->pucMap + uEnd - LENGTH_SIZE);
+      if(uLength > uEnd - 2 * LENGTH_SIZE)
+         break;
+      uEnd -= uLength + 2 * LENGTH_SIZE;
+      if(getRecordLength(oHistory->pucMap + uEnd) != uLength)
+         break;
+
+      if(oHistory->iFileLength == iPhysLength)
+      {
+         iPhysLength = (iPhysLength == 0) ? MIN_HISTORY_SIZE 
+                                          : iPhysLength * 2;
+         oHistory->puFileOffsets = (size_t*)realloc(
+            oHistory->puFileOffsets, 
+            (size_t)iPhysLength * sizeof(size_t));
+         assert(oHistory->puFileOffsets != NULL);
+      }
+      oHistory->puFileOffsets[oHistory->iFileLength++] = uEnd;
+   }
+
+   /* The records were found newest first. */
+   for(i = 0; i < oHistory->iFileLength / 2; i++)
+   {
+      uTemp = oHistory->puFileOffsets[i];
+      oHistory->puFileOffsets[i] = 
+         oHistory->puFileOffsets[oHistory->iFileLength - 1 - i];
+      oHistory->puFileOffsets[oHistory->iFileLength - 1 - i] = uTemp;
    }
+}
+
+/*------------------------------------------------------------------*/
 
-   return NULL;
+static const char *getFileEntry(History_T oHistory, int iIndex, 
+                                size_t *puLength)
+
+/* Return the entry of the history file of oHistory at index iIndex
+   of puFileOffsets, and store its length in *puLength. The entry 
+   is not terminated by '\0'. */
+
+{
+   const unsigned char *puc;
+
+   puc = oHistory->pucMap + oHistory->puFileOffsets[iIndex];
+   *puLength = getRecordLength(puc);
+   return (const char*)(puc + LENGTH_SIZE);
+}
+
+/*------------------------------------------------------------------*/
+
+int History_getLength(History_T oHistory)
+
+/* Return the number of entries in oHistory. It is a checked runtime
+   error for oHistory to be NULL. */
+
+{
+   assert(oHistory != NULL);
+
+   loadFile(oHistory);
+   return oHistory->iFileLength - oHistory->iFileFirst + 
+          oHistory->iLength;
 }
 
 /*------------------------------------------------------------------*/
 
-int histExpandLine(char *pcLine, DynArray_T oHistList, char *pcProgName)
+const char *History_get(History_T oHistory, int iIndex, 
+                        size_t *puLength)
 
-/* If pcLine contains any !commandprefix, then properly expand
-   !commandprefix by matching it with the most recently executed
-   command that has commandprefix as a prefix. The resulting input
-   line is updated in pcLine. Return TRUE if successful, and FALSE
-   if !commandprefix could not be expanded. In the latter case, 
-   print an error message to stderr. pcProgName is used in printing
-   error messages. It is a checked runtime error for pcLine, oHistList,
-   or pcProgName to be NULL. */
+/* Return the entry of oHistory at index iIndex, where index 0 is 
+   the oldest entry, and store its length in *puLength. The entry 
+   may not be terminated by '\0'. It is a checked runtime error for
+   oHistory or puLength to be NULL. It is a checked runtime error 
+   for iIndex to be negative or not less than the number of 
+   entries. */
 
 {
-   char acLine[MAX_LINE_SIZE];
-   char *pcPrevCommand;
+   int iNumFileEntries;
+   char *pcLine;
+
+   assert(oHistory != NULL);
+   assert(puLength != NULL);
+   assert(iIndex >= 0);
+
+   loadFile(oHistory);
+   iNumFileEntries = oHistory->iFileLength - oHistory->iFileFirst;
+   if(iIndex < iNumFileEntries)
+      return getFileEntry(oHistory, oHistory->iFileFirst + iIndex, 
+                          puLength);
+
+   iIndex -= iNumFileEntries;
+   assert(iIndex < oHistory->iLength);
+   pcLine = oHistory->ppcLines[(oHistory->iFirst + iIndex) % 
+                               oHistory->iPhysLength];
+   *puLength = strlen(pcLine);
+   return pcLine;
+}
+
+/*------------------------------------------------------------------*/
+
+long History_getNumber(History_T oHistory, int iIndex)
+
+/* Return the event number of the entry of oHistory at index iIndex,
+   where index 0 is the oldest entry. Event numbers increase by one 
+   from entry to entry, and an entry keeps its number as older 
+   entries are evicted. It is a checked runtime error for oHistory 
+   to be NULL. It is a checked runtime error for iIndex to be 
+   negative or not less than the number of entries. */
+
+/* The entries of the file that were found are numbered from 0, and
+   those of this session follow them. Evicting an entry of either 
+   kind advances iFileFirst or lFirstNumber, which keeps the numbers
+   of the rest. */
+
+{
+   assert(oHistory != NULL);
+   assert(iIndex >= 0);
+   assert(iIndex < History_getLength(oHistory));
+
+   if(iIndex < oHistory->iFileLength - oHistory->iFileFirst)
+      return (long)oHistory->iFileFirst + iIndex;
+   return (long)oHistory->iFileFirst + oHistory->lFirstNumber + iIndex;
+}
+
+/*------------------------------------------------------------------*/
+
+static const char *getEntry(History_T oHistory, long lNumber, 
+                            size_t *puLength)
+
+/* Return the entry of oHistory whose event number is lNumber, and 
+   store its length in *puLength. */
+
+{
+   char *pcLine;
+
+   if(lNumber < 0)
+      return getFileEntry(oHistory, 
+                          oHistory->iFileLength + (int)lNumber, 
+                          puLength);
+
+   pcLine = oHistory->ppcLines[(oHistory->iFirst + 
+      (int)(lNumber - oHistory->lFirstNumber)) % oHistory->iPhysLength];
+   *puLength = strlen(pcLine);
+   return pcLine;
+}
+
+/*------------------------------------------------------------------*/
+
+static size_t getIndexLength(const char *pcLine, size_t uLength)
+
+/* Return the number of characters of pcLine, an entry of length 
+   uLength, that are added to the trie: those before its first 
+   terminator character. A !prefix ends at a terminator character, 
+   so no prefix that is looked up is longer. */
+
+{
+   size_t u;
+
+   for(u = 0; u < uLength && !isTerminatorChar(pcLine[u]); u++)
+      ;
+   return u;
+}
+
+/*------------------------------------------------------------------*/
+
+static void indexEntry(History_T oHistory, const char *pcLine, 
+                       size_t uLength, long lNumber)
+
+/* Add the prefixes of pcLine, the entry of oHistory of length 
+   uLength with event number lNumber, to the trie of oHistory. */
+
+{
+   struct HistNode *psParent = &oHistory->sRoot;
+   struct HistNode *psNode;
+   size_t u;
+
+   uLength = getIndexLength(pcLine, uLength);
+   for(u = 0; u < uLength; u++)
+   {
+      for(psNode = psParent->psChild; psNode != NULL; 
+          psNode = psNode->psSibling)
+         if(psNode->c == pcLine[u])
+            break;
+      if(psNode == NULL)
+      {
+         psNode = (struct HistNode*)calloc(1, sizeof(struct HistNode));
+         assert(psNode != NULL);
+         psNode->c = pcLine[u];
+         psNode->psSibling = psParent->psChild;
+         psParent->psChild = psNode;
+      }
+
+      /* The entries of the file are indexed after some entries of 
+         this session, which are newer. */
+      if(psNode->iCount == 0 || lNumber > psNode->lNumber)
+         psNode->lNumber = lNumber;
+      psNode->iCount++;
+      psParent = psNode;
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static void unindexEntry(History_T oHistory, const char *pcLine, 
+                         size_t uLength)
+
+/* Remove the prefixes of pcLine, the oldest entry of oHistory, of 
+   length uLength, from the trie of oHistory. */
+
+/* A prefix that other entries share is also the prefix of a newer
+   entry, since pcLine is the oldest, so its lNumber stays correct. 
+   A prefix that only pcLine has is removed, along with the rest of
+   pcLine's path, which no other entry shares either. */
+
+{
+   struct HistNode **ppsLink = &oHistory->sRoot.psChild;
+   struct HistNode *psNode;
+   size_t u;
+
+   uLength = getIndexLength(pcLine, uLength);
+   for(u = 0; u < uLength; u++)
+   {
+      while((*ppsLink)->c != pcLine[u])
+         ppsLink = &(*ppsLink)->psSibling;
+      psNode = *ppsLink;
+      if(--psNode->iCount == 0)
+      {
+         *ppsLink = psNode->psSibling;
+         psNode->psSibling = NULL;
+         freeTrie(psNode);
+         return;
+      }
+      ppsLink = &psNode->psChild;
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static void indexFile(History_T oHistory)
+
+/* Add the entries of the history file of oHistory to its trie. Do
+   nothing if they have been added already. */
+
+{
+   const char *pcLine;
+   size_t uLength;
    int i;
-   int j = 0;
-   int iLength;
+
+   if(oHistory->iFileIndexed)
+      return;
+   oHistory->iFileIndexed = TRUE;
+
+   loadFile(oHistory);
+   for(i = oHistory->iFileFirst; i < oHistory->iFileLength; i++)
+   {
+      pcLine = getFileEntry(oHistory, i, &uLength);
+      indexEntry(oHistory, pcLine, uLength, 
+                 (long)(i - oHistory->iFileLength));
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static void appendToFile(History_T oHistory, const char *pcLine, 
+                         size_t uLength)
+
+/* Append pcLine, of length uLength, to the history file of oHistory
+   as a record. */
+
+/* The record is written with one call of writev() to a file opened
+   with O_APPEND, so records that other shells append are not 
+   interleaved with it. If a record cannot be written whole, no more
+   are written. */
+
+{
+   unsigned char aucLength[LENGTH_SIZE];
+   struct iovec asIov[3];
+   ssize_t lWritten;
+
+   if(oHistory->iFd == -1)
+      return;
+
+   aucLength[0] = (unsigned char)(uLength & 0xFF);
+   aucLength[1] = (unsigned char)((uLength >> 8) & 0xFF);
+   aucLength[2] = (unsigned char)((uLength >> 16) & 0xFF);
+   aucLength[3] = (unsigned char)((uLength >> 24) & 0xFF);
+   asIov[0].iov_base = aucLength;
+   asIov[0].iov_len = LENGTH_SIZE;
+   asIov[1].iov_base = (void*)pcLine;
+   asIov[1].iov_len = uLength;
+   asIov[2].iov_base = aucLength;
+   asIov[2].iov_len = LENGTH_SIZE;
+
+   lWritten = writev(oHistory->iFd, asIov, 3);
+   if(lWritten != (ssize_t)(uLength + 2 * LENGTH_SIZE))
+   {
+      (void)close(oHistory->iFd);
+      oHistory->iFd = -1;
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+void History_add(History_T oHistory, const char *pcLine, 
+                 size_t uLength, int iSave)
+
+/* Add pcLine, of length uLength, to oHistory as its most recent 
+   entry, evicting the oldest entry if oHistory is full, and append
+   it to the history file of oHistory, if any, iff iSave is TRUE. It
+   is a checked runtime error for oHistory or pcLine to be NULL. */
+
+{
+   const char *pcOldest;
+   size_t uOldestLength;
+   int iIndex;
+   int iNewLength;
+
+   assert(oHistory != NULL);
+   assert(pcLine != NULL);
+
+   if(oHistory->iMaxLength == 0)
+      return;
+
+   if(iSave)
+      appendToFile(oHistory, pcLine, uLength);
+
+   if(oHistory->iFileLoaded && 
+      oHistory->iFileFirst < oHistory->iFileLength &&
+      History_getLength(oHistory) == oHistory->iMaxLength)
+   {
+      /* The oldest entry is from the file. */
+      pcOldest = getFileEntry(oHistory, oHistory->iFileFirst, 
+                              &uOldestLength);
+      if(oHistory->iFileIndexed)
+         unindexEntry(oHistory, pcOldest, uOldestLength);
+      oHistory->iFileFirst++;
+   }
+
+   if(oHistory->iLength == oHistory->iMaxLength)
+   {
+      /* Reuse the oldest entry's buffer for pcLine. */
+      iIndex = oHistory->iFirst;
+      unindexEntry(oHistory, oHistory->ppcLines[iIndex], 
+                   strlen(oHistory->ppcLines[iIndex]));
+      oHistory->iFirst = (iIndex + 1) % oHistory->iPhysLength;
+      oHistory->lFirstNumber++;
+   }
+   else
+   {
+      /* The ring has not wrapped yet, so it can grow in place. */
+      if(oHistory->iLength == oHistory->iPhysLength)
+      {
+         iNewLength = oHistory->iPhysLength * 2;
+         if(iNewLength < MIN_HISTORY_SIZE)
+            iNewLength = MIN_HISTORY_SIZE;
+         if(iNewLength > oHistory->iMaxLength)
+            iNewLength = oHistory->iMaxLength;
+         oHistory->ppcLines = (char**)realloc(oHistory->ppcLines,
+            (size_t)iNewLength * sizeof(char*));
+         assert(oHistory->ppcLines != NULL);
+         oHistory->puSizes = (size_t*)realloc(oHistory->puSizes,
+            (size_t)iNewLength * sizeof(size_t));
+         assert(oHistory->puSizes != NULL);
+         oHistory->pdSeconds = (double*)realloc(oHistory->pdSeconds,
+            (size_t)iNewLength * sizeof(double));
+         assert(oHistory->pdSeconds != NULL);
+         oHistory->piStatuses = (int*)realloc(oHistory->piStatuses,
+            (size_t)iNewLength * sizeof(int));
+         assert(oHistory->piStatuses != NULL);
+         for(iIndex = oHistory->iPhysLength; iIndex < iNewLength; 
+             iIndex++)
+         {
+            oHistory->ppcLines[iIndex] = NULL;
+            oHistory->puSizes[iIndex] = 0;
+         }
+         oHistory->iPhysLength = iNewLength;
+      }
+      iIndex = (oHistory->iFirst + oHistory->iLength) % 
+               oHistory->iPhysLength;
+      oHistory->iLength++;
+   }
+
+   reserve(&oHistory->ppcLines[iIndex], &oHistory->puSizes[iIndex],
+           uLength + 1);
+   memcpy(oHistory->ppcLines[iIndex], pcLine, uLength);
+   oHistory->ppcLines[iIndex][uLength] = '\0';
+   oHistory->pdSeconds[iIndex] = -1.0;
+   oHistory->piStatuses[iIndex] = 0;
+   indexEntry(oHistory, oHistory->ppcLines[iIndex], uLength,
+              oHistory->lFirstNumber + oHistory->iLength - 1);
+}
+
+/*------------------------------------------------------------------*/
+
+void History_setResult(History_T oHistory, double dSeconds, 
+                       int iStatus)
+
+/* Record that the command of the most recent entry of oHistory took
+   dSeconds seconds of wall time and exited with status iStatus. Do
+   nothing if no entry has been added since oHistory was created. It
+   is a checked runtime error for oHistory to be NULL. It is a 
+   checked runtime error for dSeconds to be negative. */
+
+{
+   int iIndex;
+
+   assert(oHistory != NULL);
+   assert(dSeconds >= 0.0);
+
+   if(oHistory->iLength == 0)
+      return;
+   iIndex = (oHistory->iFirst + oHistory->iLength - 1) % 
+            oHistory->iPhysLength;
+   oHistory->pdSeconds[iIndex] = dSeconds;
+   oHistory->piStatuses[iIndex] = iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+int History_getResult(History_T oHistory, int iIndex, 
+                      double *pdSeconds, int *piStatus)
+
+/* Store the wall time in seconds and the exit status recorded for
+   the entry of oHistory at index iIndex in *pdSeconds and 
+   *piStatus, and return TRUE. Return FALSE if no result was 
+   recorded for the entry, which is so for entries from the history
+   file. It is a checked runtime error for oHistory, pdSeconds, or 
+   piStatus to be NULL. It is a checked runtime error for iIndex to
+   be negative or not less than the number of entries. */
+
+/* Results are not saved in the history file, whose records other 
+   shells may read. */
+
+{
+   int iNumFileEntries;
+
+   assert(oHistory != NULL);
+   assert(pdSeconds != NULL);
+   assert(piStatus != NULL);
+   assert(iIndex >= 0);
+
+   loadFile(oHistory);
+   iNumFileEntries = oHistory->iFileLength - oHistory->iFileFirst;
+   if(iIndex < iNumFileEntries)
+      return FALSE;
+
+   iIndex -= iNumFileEntries;
+   assert(iIndex < oHistory->iLength);
+   iIndex = (oHistory->iFirst + iIndex) % oHistory->iPhysLength;
+   if(oHistory->pdSeconds[iIndex] < 0.0)
+      return FALSE;
+   *pdSeconds = oHistory->pdSeconds[iIndex];
+   *piStatus = oHistory->piStatuses[iIndex];
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static struct HistNode *findNode(History_T oHistory, 
+                                 const char *pcPrefix, size_t uLength)
+
+/* Return the node of the trie of oHistory that spells the uLength 
+   characters at pcPrefix, or NULL if there is none. */
+
+{
+   struct HistNode *psNode = &oHistory->sRoot;
+   size_t u;
+
+   for(u = 0; u < uLength; u++)
+   {
+      for(psNode = psNode->psChild; psNode != NULL; 
+          psNode = psNode->psSibling)
+         if(psNode->c == pcPrefix[u])
+            break;
+      if(psNode == NULL)
+         return NULL;
+   }
+   return psNode;
+}
+
+/*------------------------------------------------------------------*/
+
+static const char *findPrevCommand(const char *pcPrefix, 
+                                   size_t uLength, History_T oHistList,
+                                   size_t *puCommandLength)
+
+/* Return the most recently executed command that has the uLength
+   characters at pcPrefix as a prefix, and store its length in 
+   *puCommandLength. The command may not be terminated by '\0'. 
+   Return NULL if a match cannot be found. It is a checked runtime 
+   error for pcPrefix, oHistList, or puCommandLength to be NULL. It
+   is a checked runtime error for uLength to be 0. */
+
+/* The trie gives the match in time proportional to uLength, times 
+   the few children of each node, however long the history is. The
+   entries of the history file are older than those of this session,
+   so they are only added to the trie the first time a prefix is not
+   found among the latter. */
+
+{
+   struct HistNode *psNode;
+
+   assert(pcPrefix != NULL);
+   assert(uLength > 0);
+   assert(oHistList != NULL);
+   assert(puCommandLength != NULL);
+
+   psNode = findNode(oHistList, pcPrefix, uLength);
+   if(psNode == NULL && !oHistList->iFileIndexed)
+   {
+      indexFile(oHistList);
+      psNode = findNode(oHistList, pcPrefix, uLength);
+   }
+   if(psNode == NULL)
+      return NULL;
+
+   return getEntry(oHistList, psNode->lNumber, puCommandLength);
+}
+
+/*------------------------------------------------------------------*/
+
+long histExpandLine(const char *pcLine, size_t uLength, 
+                    History_T oHistList, char **ppcBuffer, 
+                    size_t *puSize, char *pcProgName)
+
+/* Expand each !commandprefix in the first uLength characters of 
+   pcLine by matching it with the most recently executed command
+   that has commandprefix as a prefix. Write the resulting input 
+   line, terminated by '\0', to the buffer *ppcBuffer of *puSize 
+   bytes, growing it with realloc() as getline() does; *ppcBuffer 
+   may be NULL initially. Return the length of the resulting line if
+   successful, and -1 if a !commandprefix could not be expanded. In
+   the latter case, print an error message to stderr. pcProgName is
+   used in printing error messages. It is a checked runtime error for
+   pcLine, oHistList, ppcBuffer, puSize, or pcProgName to be NULL. */
+
+{
+   const char *pcPrevCommand;
+   size_t uPrevLength;
+   size_t uPrefixLength;
+   size_t i;
+   size_t j = 0;
    
    assert(pcLine != NULL);
    assert(oHistList != NULL);
+   assert(ppcBuffer != NULL);
+   assert(puSize != NULL);
    assert(pcProgName != NULL);
 
-   for(i = 0; pcLine[i] != '\0'; i++)
+   reserve(ppcBuffer, puSize, uLength + 1);
+   for(i = 0; i < uLength; i++)
    {
-      if(pcLine[i] == '!')
+      /* Ignore the ! if commandprefix is empty. */
+      if(pcLine[i] == '!' && i + 1 < uLength && 
+         !isTerminatorChar(pcLine[i + 1]))
       {
-         /* Ignore the ! if commandprefix is empty. */
-         if(!isTerminatorChar(pcLine[i + 1]))
+         uPrefixLength = 1;
+         while(i + 1 + uPrefixLength < uLength && 
+               !isTerminatorChar(pcLine[i + 1 + uPrefixLength]))
+            uPrefixLength++;
+
+         pcPrevCommand = findPrevCommand(&pcLine[i + 1], uPrefixLength,
+                                         oHistList, &uPrevLength);
+         if(pcPrevCommand == NULL)
          {
-            pcPrevCommand = findPrevCommand(&pcLine[i], oHistList);
-            if(pcPrevCommand == NULL)
-            {
-               /* Make pcLine + i point to the !commandprefix that 
-                  did not have a match. */
-               iLength = i;
-               while(!isTerminatorChar(pcLine[iLength + 1]))
-                  iLength++;
-               pcLine[iLength + 1] = '\0';
-
-               fprintf(stderr, "%s: %s: Event not found\n", pcProgName,
-                       pcLine + i);
-               return FALSE;
-            }
-            else
-            {
-               strcpy(&acLine[j], pcPrevCommand);
-               j += strlen(pcPrevCommand);
-            
-               /* Jump to the the terminator character
-                  of the current !commandprefix. */
-               while(!isTerminatorChar(pcLine[i + 1]))
-                  i++;
-            }
+            fprintf(stderr, "%s: %.*s: Event not found\n", pcProgName,
+                    (int)(uPrefixLength + 1), pcLine + i);
+            return -1;
          }
+
+         /* The rest of pcLine may still need to fit after the
+            expansion. */
+         reserve(ppcBuffer, puSize, 
+                 j + uPrevLength + (uLength - i) + 1);
+         memcpy(*ppcBuffer + j, pcPrevCommand, uPrevLength);
+         j += uPrevLength;
+
+         /* Jump to the last character of the current 
+            !commandprefix. */
+         i += uPrefixLength;
       }
       else
-      {
-         acLine[j] = pcLine[i];
-         j++;
-      }
+         (*ppcBuffer)[j++] = pcLine[i];
    }
-   acLine[j] = '\0';
+   (*ppcBuffer)[j] = '\0';
 
-   strcpy(pcLine, acLine);
-   return TRUE;
+   return (long)j;
 }
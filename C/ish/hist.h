@@ -6,20 +6,88 @@
 #ifndef HIST_INCLUDED
 #define HIST_INCLUDED
 
-int histHasCommandPrefix(char *pcLine);
-/* Return TRUE if the string pointed to by pcLine contains a !, 
+#include <stddef.h>
+
+typedef struct History *History_T;
+/* A History_T is a bounded list of the most recent command lines,
+   indexed by prefix, and optionally saved in a history file. */
+
+History_T History_new(int iMaxLength, const char *pcFileName);
+/* Return a new History that keeps the iMaxLength most recent 
+   entries. If pcFileName is not NULL, the History starts with the
+   entries of the history file pcFileName, and each entry added is
+   appended to that file, which is created if necessary. Concurrent
+   shells may append to the same file. If the file cannot be opened,
+   the History is not saved. It is a checked runtime error for 
+   iMaxLength to be negative. */
+
+void History_free(History_T oHistory);
+/* Free oHistory and its entries, and close its history file. Do 
+   nothing if oHistory is NULL. */
+
+int History_getLength(History_T oHistory);
+/* Return the number of entries in oHistory. It is a checked runtime
+   error for oHistory to be NULL. */
+
+const char *History_get(History_T oHistory, int iIndex, 
+                        size_t *puLength);
+/* Return the entry of oHistory at index iIndex, where index 0 is 
+   the oldest entry, and store its length in *puLength. The entry 
+   may not be terminated by '\0'. It is a checked runtime error for
+   oHistory or puLength to be NULL. It is a checked runtime error 
+   for iIndex to be negative or not less than the number of 
+   entries. */
+
+long History_getNumber(History_T oHistory, int iIndex);
+/* Return the event number of the entry of oHistory at index iIndex,
+   where index 0 is the oldest entry. Event numbers increase by one 
+   from entry to entry, and an entry keeps its number as older 
+   entries are evicted. It is a checked runtime error for oHistory 
+   to be NULL. It is a checked runtime error for iIndex to be 
+   negative or not less than the number of entries. */
+
+void History_add(History_T oHistory, const char *pcLine, 
+                 size_t uLength, int iSave);
+/* Add pcLine, of length uLength, to oHistory as its most recent 
+   entry, evicting the oldest entry if oHistory is full, and append
+   it to the history file of oHistory, if any, iff iSave is TRUE. It
+   is a checked runtime error for oHistory or pcLine to be NULL. */
+
+void History_setResult(History_T oHistory, double dSeconds, 
+                       int iStatus);
+/* Record that the command of the most recent entry of oHistory took
+   dSeconds seconds of wall time and exited with status iStatus. Do
+   nothing if no entry has been added since oHistory was created. It
+   is a checked runtime error for oHistory to be NULL. It is a 
+   checked runtime error for dSeconds to be negative. */
+
+int History_getResult(History_T oHistory, int iIndex, 
+                      double *pdSeconds, int *piStatus);
+/* Store the wall time in seconds and the exit status recorded for
+   the entry of oHistory at index iIndex in *pdSeconds and 
+   *piStatus, and return TRUE. Return FALSE if no result was 
+   recorded for the entry, which is so for entries from the history
+   file. It is a checked runtime error for oHistory, pdSeconds, or 
+   piStatus to be NULL. It is a checked runtime error for iIndex to
+   be negative or not less than the number of entries. */
+
+int histHasCommandPrefix(const char *pcLine, size_t uLength);
+/* Return TRUE if the first uLength characters of pcLine contain a !,
    or FALSE otherwise. It is a checked runtime error for pcLine to
    be NULL. */
 
-int histExpandLine(char *pcLine, DynArray_T oHistList, 
-                   char *pcProgName);
-/* If pcLine contains any !commandprefix, then properly expand
-   !commandprefix by matching it with the most recently executed
-   command that has commandprefix as a prefix. The resulting input
-   line is updated in pcLine. Return TRUE if successful, and FALSE
-   if !commandprefix could not be expanded. In the latter case, 
-   print an error message to stderr. pcProgName is used in printing
-   error messages. It is a checked runtime error for pcLine, oHistList,
-   or pcProgName to be NULL. */
+long histExpandLine(const char *pcLine, size_t uLength, 
+                    History_T oHistList, char **ppcBuffer, 
+                    size_t *puSize, char *pcProgName);
+/* Expand each !commandprefix in the first uLength characters of 
+   pcLine by matching it with the most recently executed command
+   that has commandprefix as a prefix. Write the resulting input 
+   line, terminated by '\0', to the buffer *ppcBuffer of *puSize 
+   bytes, growing it with realloc() as getline() does; *ppcBuffer 
+   may be NULL initially. Return the length of the resulting line if
+   successful, and -1 if a !commandprefix could not be expanded. In
+   the latter case, print an error message to stderr. pcProgName is
+   used in printing error messages. It is a checked runtime error for
+   pcLine, oHistList, ppcBuffer, puSize, or pcProgName to be NULL. */
 
 #endif                      /* HIST_INCLUDED */
@@ -3,158 +3,820 @@
 /* Author: Mark Xia                                                 */
 /* -----------------------------------------------------------------*/
 
+#define _GNU_SOURCE
 #include "dynarray.h"
+#include "arena.h"
 #include "lexi.h"
 #include "parse.h"
-#include "exec.h"
 #include "hist.h"
+#include "exec.h"
+#include "job.h"
+#include "var.h"
+#include "rccache.h"
+#include "script.h"
+#include "vm.h"
+#include "server.h"
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <signal.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
 
 /*------------------------------------------------------------------*/
 
-enum {MAX_LINE_SIZE = 1024};
+enum {FALSE, TRUE};
+
+/* The number of history entries kept if HISTSIZE does not say. */
+enum {DEFAULT_HISTSIZE = 1000};
 
 /*------------------------------------------------------------------*/
 
-static char *getIshrc(void)
+static char *getHomeFile(const char *pcName)
 
-/* Return a string pointing to the file location of the .ishrc file
-   residing in the HOME directory. */
+/* Return a string pointing to the file location of the file pcName
+   residing in the HOME directory. The caller owns the string. It is
+   a checked runtime error for pcName to be NULL. */
 
 {
-   char *pcHome;
+   const char *pcHome;
    char *pcTemp;
 
-   pcHome = getenv("HOME");
-   pcTemp = malloc(strlen(pcHome) + strlen("/.ishrc") + 1);
+   assert(pcName != NULL);
+
+   pcHome = varGet("HOME", 4);
+   pcTemp = malloc(strlen(pcHome) + strlen(pcName) + 2);
    assert(pcTemp != NULL);
    strcpy(pcTemp, pcHome);
-   strcat(pcTemp, "/.ishrc");
+   strcat(pcTemp, "/");
+   strcat(pcTemp, pcName);
    return pcTemp;
 }
 
 /*------------------------------------------------------------------*/
 
-static void performCommand(char *acLine, DynArray_T oHistoryList, 
-                           char *pcProgName)
+static int getHistSize(void)
+
+/* Return the number of history entries to keep, which is the value
+   of the HISTSIZE environment variable if it is a non-negative 
+   integer, and DEFAULT_HISTSIZE otherwise. */
+
+{
+   const char *pcValue;
+   char *pcEnd;
+   long lValue;
+
+   pcValue = varGet("HISTSIZE", 8);
+   if(pcValue == NULL || *pcValue == '\0')
+      return DEFAULT_HISTSIZE;
+   lValue = strtol(pcValue, &pcEnd, 10);
+   if(*pcEnd != '\0' || lValue < 0 || lValue > INT_MAX)
+      return DEFAULT_HISTSIZE;
+   return (int)lValue;
+}
+
+/*------------------------------------------------------------------*/
+
+static size_t stripNewline(char *pcLine, size_t uLength)
+
+/* Remove '\n' if pcLine, of length uLength, ends with '\n', and 
+   return the resulting length. This is done so the commands in the
+   history list do not end with '\n', which is necessary to properly
+   expand !commandprefix. It is a checked runtime error for pcLine 
+   to be NULL. */
+
+{
+   assert(pcLine != NULL);
+
+   if(uLength > 0 && pcLine[uLength - 1] == '\n')
+      pcLine[--uLength] = '\0';
+   return uLength;
+}
+
+/*------------------------------------------------------------------*/
+
+/* An Input is a file that ish reads lines from, one at a time or 
+   one line ahead, so the last line is known to be last. */
+
+struct Input
+{
+   /* The file the lines are read from. */
+   FILE *psFile;
+
+   /* The line most recently read, without its newline, the size of
+      its buffer, and its length, which is -1 at EOF. */
+   char *pcLine;
+   size_t uLineSize;
+   ssize_t lLength;
+
+   /* TRUE iff the line after pcLine is read ahead. If so, it is kept
+      in the same form as pcLine. */
+   int iReadAhead;
+   char *pcNext;
+   size_t uNextSize;
+   ssize_t lNextLength;
+
+   /* The prompt for the lines that continue a command, those of a 
+      here-document or a compound command, or NULL if there is none,
+      and TRUE iff such lines are echoed after the prompt rather than
+      read after it. */
+   const char *pcPrompt;
+   int iEcho;
+
+   /* The number of lines read so far, which is the number of pcLine
+      counting from 1. */
+   long lLineNumber;
+};
+
+/*------------------------------------------------------------------*/
+
+static void initInput(struct Input *psInput, FILE *psFile, 
+                      int iReadAhead, const char *pcPrompt, int iEcho)
 
-/* Expand any !commandprefix in acLine. Insert acLine into 
-   oHistoryList iff the expanding succeeds and acLine does not consist
-   of entirely whitespace characters. Lexically and syntactically 
-   analyze acLine. Execute acLine if no errors are found. It is a 
-   checked runtime error for acLine, oHistory, or pcProgName to be
-   NULL. */
+/* Make psInput read lines from psFile, one line ahead iff iReadAhead
+   is TRUE, prompting for the lines that continue a command with
+   pcPrompt unless it is NULL, after reading them iff iEcho is TRUE.
+   It is a checked runtime error for psInput or psFile to be NULL. */
+
+{
+   assert(psInput != NULL);
+   assert(psFile != NULL);
+
+   psInput->psFile = psFile;
+   psInput->pcLine = NULL;
+   psInput->uLineSize = 0;
+   psInput->lLength = -1;
+   psInput->iReadAhead = iReadAhead;
+   psInput->pcNext = NULL;
+   psInput->uNextSize = 0;
+   psInput->lNextLength = -1;
+   psInput->pcPrompt = pcPrompt;
+   psInput->iEcho = iEcho;
+   psInput->lLineNumber = 0;
+
+   if(iReadAhead)
+   {
+      psInput->lNextLength = getline(&psInput->pcNext, 
+                                     &psInput->uNextSize, psFile);
+      if(psInput->lNextLength >= 0)
+         psInput->lNextLength = (ssize_t)stripNewline(
+            psInput->pcNext, (size_t)psInput->lNextLength);
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static ssize_t readLine(struct Input *psInput)
+
+/* Read the next line of psInput into psInput->pcLine, and return its
+   length without its newline, or -1 at EOF. It is a checked runtime
+   error for psInput to be NULL. */
+
+/* Two getline() buffers are swapped, so each keeps the capacity it
+   has grown to. */
 
 {
    char *pcTemp;
+   size_t uTemp;
+
+   assert(psInput != NULL);
+
+   if(!psInput->iReadAhead)
+   {
+      psInput->lLength = getline(&psInput->pcLine, &psInput->uLineSize,
+                                 psInput->psFile);
+      if(psInput->lLength >= 0)
+      {
+         psInput->lLength = (ssize_t)stripNewline(
+            psInput->pcLine, (size_t)psInput->lLength);
+         psInput->lLineNumber++;
+      }
+      return psInput->lLength;
+   }
+
+   pcTemp = psInput->pcLine;
+   psInput->pcLine = psInput->pcNext;
+   psInput->pcNext = pcTemp;
+   uTemp = psInput->uLineSize;
+   psInput->uLineSize = psInput->uNextSize;
+   psInput->uNextSize = uTemp;
+   psInput->lLength = psInput->lNextLength;
+   if(psInput->lLength >= 0)
+   {
+      psInput->lLineNumber++;
+      psInput->lNextLength = getline(&psInput->pcNext, 
+                                     &psInput->uNextSize, 
+                                     psInput->psFile);
+      if(psInput->lNextLength >= 0)
+         psInput->lNextLength = (ssize_t)stripNewline(
+            psInput->pcNext, (size_t)psInput->lNextLength);
+   }
+   return psInput->lLength;
+}
+
+/*------------------------------------------------------------------*/
+
+static int isLastLine(struct Input *psInput)
+
+/* Return TRUE if the line most recently read from psInput is known
+   to be its last, and FALSE otherwise. It is a checked runtime error
+   for psInput to be NULL. */
+
+{
+   assert(psInput != NULL);
+
+   return psInput->iReadAhead && psInput->lNextLength < 0;
+}
+
+/*------------------------------------------------------------------*/
+
+static void freeInput(struct Input *psInput)
+
+/* Free the buffers of psInput. The file is not closed. It is a 
+   checked runtime error for psInput to be NULL. */
+
+{
+   assert(psInput != NULL);
+
+   free(psInput->pcLine);
+   free(psInput->pcNext);
+}
+
+/*------------------------------------------------------------------*/
+
+static ssize_t readMoreLine(struct Input *psInput)
+
+/* Read a line of psInput that continues a command as readLine() 
+   does, prompting for it or echoing it after the prompt of psInput,
+   if any, and return its length, or -1 at EOF. It is a checked 
+   runtime error for psInput to be NULL. */
+
+{
+   ssize_t lLength;
+
+   assert(psInput != NULL);
+
+   if(psInput->pcPrompt != NULL && !psInput->iEcho)
+   {
+      printf("%s", psInput->pcPrompt);
+      fflush(stdout);
+   }
+   lLength = readLine(psInput);
+   if(lLength >= 0 && psInput->pcPrompt != NULL && psInput->iEcho)
+   {
+      printf("%s%s\n", psInput->pcPrompt, psInput->pcLine);
+      fflush(stdout);
+   }
+   return lLength;
+}
+
+/*------------------------------------------------------------------*/
+
+static long readScriptLine(void *pvInput, char **ppcLine)
+
+/* Read the next line of the Input pvInput, a line of a compound 
+   command, with readMoreLine(), point *ppcLine to it, and return its
+   length, or -1 at EOF. This is the callback of Script_compile(). */
+
+{
+   struct Input *psInput = (struct Input*)pvInput;
+   ssize_t lLength;
+
+   assert(psInput != NULL);
+   assert(ppcLine != NULL);
+
+   lLength = readMoreLine(psInput);
+   *ppcLine = psInput->pcLine;
+   return (long)lLength;
+}
+
+/*------------------------------------------------------------------*/
+
+static int readHereDoc(DynArray_T oCommands, struct Input *psInput,
+                       char *pcProgName)
+
+/* If the first Command in oCommands has a here-document whose body 
+   has not been read, read from psInput the lines up to one that is
+   its delimiter, and make them, each followed by a newline, its 
+   body. If EOF comes first, the body ends there, a warning is
+   written to stderr, and FALSE is returned; otherwise return TRUE.
+   pcProgName is used in printing error messages. It is a checked 
+   runtime error for oCommands, psInput, or pcProgName to be NULL. It
+   is a checked runtime error for oCommands to be empty. */
+
+/* Only the first stage of a pipeline can redirect stdin, so a line
+   has at most one here-document. Its body is kept in one buffer, 
+   which is reused by the next line and grows by doubling. */
+
+{
+   static char *pcBody = NULL;
+   static size_t uBodySize = 0;
    Command_T oCommand;
-   DynArray_T oTokens;
-   int iSuccessful;
+   char *pcEnd;
+   size_t uLength = 0;
+   size_t uLineLength;
+   ssize_t lLength;
+   int iDelimited = TRUE;
+
+   assert(oCommands != NULL);
+   assert(psInput != NULL);
+   assert(pcProgName != NULL);
+
+   oCommand = (Command_T)DynArray_get(oCommands, 0);
+   pcEnd = Command_getHereEnd(oCommand, NULL);
+   if(pcEnd == NULL)
+      return TRUE;
+
+   for(;;)
+   {
+      lLength = readMoreLine(psInput);
+      if(lLength < 0)
+      {
+         fprintf(stderr, "%s: Here-document delimited by end of file"
+                 " (wanted \"%s\")\n", pcProgName, pcEnd);
+         iDelimited = FALSE;
+         break;
+      }
+      if(strcmp(psInput->pcLine, pcEnd) == 0)
+         break;
+
+      uLineLength = (size_t)lLength;
+      if(uLength + uLineLength + 2 > uBodySize)
+      {
+         uBodySize = 2 * (uLength + uLineLength + 2);
+         pcBody = (char*)realloc(pcBody, uBodySize);
+         assert(pcBody != NULL);
+      }
+      memcpy(pcBody + uLength, psInput->pcLine, uLineLength);
+      uLength += uLineLength;
+      pcBody[uLength++] = '\n';
+   }
+
+   if(pcBody == NULL)
+   {
+      uBodySize = 1;
+      pcBody = (char*)malloc(uBodySize);
+      assert(pcBody != NULL);
+   }
+   pcBody[uLength] = '\0';
+   Command_setHere(oCommand, pcBody, uLength);
+   return iDelimited;
+}
+
+/*------------------------------------------------------------------*/
+
+static void skipHereDoc(struct Input *psInput, int iNumLines)
 
-   assert(acLine != NULL);
+/* Read from psInput the iNumLines lines of the body and delimiter of
+   a here-document whose text is already known, prompting for or
+   echoing them as readHereDoc() does. It is a checked runtime error
+   for psInput to be NULL. */
+
+{
+   int i;
+
+   assert(psInput != NULL);
+
+   for(i = 0; i < iNumLines; i++)
+      if(readMoreLine(psInput) < 0)
+         break;
+}
+
+/*------------------------------------------------------------------*/
+
+static int runPipeline(DynArray_T oCommands, int iBackground,
+                       struct Input *psInput, History_T oHistoryList,
+                       char *pcProgName)
+
+/* Execute the pipeline oCommands, in the background iff iBackground
+   is TRUE, or call the function it names, and return its exit 
+   status; see vmExecute(). Record the wall time and exit status of
+   a pipeline in the foreground, or of one in the background that
+   vmExecute() rejects for being timed, in oHistoryList. If the line
+   of the pipeline is known to be the last line of psInput, exit 
+   with its status instead of returning, replacing the shell with the
+   command if possible. pcProgName is used in printing error 
+   messages. It is a checked runtime error for oCommands, psInput, 
+   oHistoryList, or pcProgName to be NULL. */
+
+{
+   int iTimed;
+   int iStatus;
+
+   assert(oCommands != NULL);
+   assert(psInput != NULL);
    assert(oHistoryList != NULL);
    assert(pcProgName != NULL);
 
-   if(histHasCommandPrefix(acLine))
+   iTimed = vmIsTimed(oCommands);
+   if(isLastLine(psInput) && !iTimed && !vmIsCall(oCommands))
+      executeFinal(oCommands, iBackground, oHistoryList, pcProgName);
+   iStatus = vmExecute(oCommands, iBackground, oHistoryList, 
+                       pcProgName);
+   if(!iBackground)
+      History_setResult(oHistoryList, execGetStats()->dWall, iStatus);
+   else if(iTimed)
+      History_setResult(oHistoryList, 0.0, iStatus);
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static int performCommand(struct Input *psInput, 
+                          History_T oHistoryList, RcCache_T oCache,
+                          int iInteractive, int iSave,
+                          char *pcProgName)
+
+/* Expand any !commandprefix in pcLine, the line most recently read
+   from psInput. Insert pcLine into oHistoryList iff the expanding
+   succeeds and pcLine does not consist of entirely whitespace 
+   characters, and append it to the history file iff iSave is TRUE.
+   Lexically and syntactically analyze pcLine, and read the body of
+   its here-document, if any, from psInput. If pcLine begins a 
+   compound command, read its other lines from psInput, and execute
+   it as a whole; see script.h. Execute pcLine if no errors are 
+   found, and return its exit status; return EXIT_FAILURE if errors
+   are found. Record the wall time and exit 
+   status of a pipeline in the foreground in oHistoryList, and if 
+   pcLine starts with "time" followed by a command, write its 
+   resource usage to stderr. Write the expanded line to stdout iff
+   iInteractive is TRUE. If pcLine is then known to be the last line
+   of psInput, exit with its status instead of returning, replacing
+   the shell with the command if possible. If oCache is not NULL,
+   take the pipeline of pcLine from it instead of analyzing pcLine 
+   if it holds it, and otherwise record the pipeline in it if that 
+   does not depend on the state of the shell. It is a checked 
+   runtime error for psInput, oHistory, or pcProgName to be NULL. */
+
+/* The Commands of a line are allocated from an arena that is reset
+   once the line is done, and the array that holds them is reused, 
+   so a line needs no calls of malloc() once the arena has grown to
+   fit the longest line. The buffers that hold expanded lines and 
+   here-documents are reused in the same way. */
+
+{
+   static Arena_T oArena = NULL;
+   static DynArray_T oCommands = NULL;
+   static char *pcExpanded = NULL;
+   static size_t uExpandedSize = 0;
+   Script_T oScript;
+   char *pcLine;
+   size_t uLength;
+   char *pcCopy;
+   long lLength;
+   long lLine;
+   int iSuccessful = TRUE;
+   int iBackground;
+   int iNumTokens;
+   int iNumLines;
+   int iCacheable;
+   int iStatus = 0;
+
+   assert(psInput != NULL);
+   assert(psInput->lLength >= 0);
+   assert(oHistoryList != NULL);
+   assert(pcProgName != NULL);
+
+   pcLine = psInput->pcLine;
+   uLength = (size_t)psInput->lLength;
+   lLine = psInput->lLineNumber;
+   if(oArena == NULL)
    {
-      iSuccessful = histExpandLine(acLine, oHistoryList, pcProgName);
-      if(iSuccessful)
-         printf("%s\n", acLine);
-      else
-         return;
+      oArena = Arena_new();
+      oCommands = DynArray_new(0);
+   }
+
+   if(oCache != NULL &&
+      RcCache_getPipeline(oCache, lLine, oCommands, &iBackground,
+                          &iNumLines, oArena))
+   {
+      /* The line was analyzed by an earlier shell. */
+      History_add(oHistoryList, pcLine, uLength, iSave);
+      skipHereDoc(psInput, iNumLines - 1);
+      iStatus = runPipeline(oCommands, iBackground, psInput, 
+                            oHistoryList, pcProgName);
+      DynArray_clear(oCommands);
+      Arena_reset(oArena);
+      return iStatus;
+   }
+
+   /* Expanding history and variables depends on the state of the 
+      shell, so such lines are analyzed every time. */
+   iCacheable = (oCache != NULL && 
+                 memchr(pcLine, '$', uLength) == NULL);
+   if(histHasCommandPrefix(pcLine, uLength))
+   {
+      lLength = histExpandLine(pcLine, uLength, oHistoryList, 
+                               &pcExpanded, &uExpandedSize, pcProgName);
+      if(lLength < 0)
+         return EXIT_FAILURE;
+      pcLine = pcExpanded;
+      uLength = (size_t)lLength;
+      if(iInteractive)
+         printf("%s\n", pcLine);
+      iCacheable = FALSE;
    }
-   oTokens = DynArray_new(0);
-   iSuccessful = lexLine(acLine, oTokens, pcProgName);
-   if(DynArray_getLength(oTokens) > 0)
+
+   /* A compound command runs as a whole once all its lines are 
+      read, and is recorded in history by its first line. */
+   if(Script_isCompound(pcLine, uLength))
    {
-      /* Allocate memory to store command in oHistoryList iff 
-         command does not consist of entirely whitespace
-         characters. */
-      pcTemp = (char*)malloc(strlen(acLine) + 1);
-      assert(pcTemp != NULL);
-      strcpy(pcTemp, acLine);
-      DynArray_add(oHistoryList, pcTemp);
+      History_add(oHistoryList, pcLine, uLength, iSave);
+      oScript = Script_compile(pcLine, uLength, readScriptLine, 
+                               psInput, pcProgName);
+      if(oScript == NULL)
+         return EXIT_FAILURE;
+      iStatus = vmRun(oScript, oHistoryList, pcProgName);
+      Script_release(oScript);
+      return iStatus;
+   }
+
+   /* Parse a copy, since parseLine() terminates words in place. */
+   pcCopy = (char*)Arena_alloc(oArena, uLength + 1);
+   memcpy(pcCopy, pcLine, uLength + 1);
+   iSuccessful = parseLine(pcCopy, uLength, oCommands, &iBackground,
+                           &iNumTokens, oArena, pcProgName);
+
+   /* Store command in oHistoryList iff command does not consist of
+      entirely whitespace characters. */
+   if(iNumTokens > 0)
+   {
+      History_add(oHistoryList, pcLine, uLength, iSave);
 
       if(iSuccessful)
       {
-         oCommand = Command_new();
-         iSuccessful = parseToken(oTokens, oCommand, pcProgName);
-         if(iSuccessful)
-            execute(oCommand, oHistoryList, pcProgName);
-         Command_free(oCommand, NULL);
+         /* The body follows the line, so it is read only once the 
+            line is known to be valid. The pipeline is recorded 
+            before it runs, since "time" is removed from it. */
+         if(!readHereDoc(oCommands, psInput, pcProgName))
+            iCacheable = FALSE;
+         if(iCacheable)
+            RcCache_addPipeline(oCache, lLine, oCommands, iBackground,
+                                (int)(psInput->lLineNumber - lLine + 1));
+         iStatus = runPipeline(oCommands, iBackground, psInput, 
+                               oHistoryList, pcProgName);
+      }
+   }
+   DynArray_clear(oCommands);
+   Arena_reset(oArena);
+
+   if(!iSuccessful)
+      iStatus = EXIT_FAILURE;
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static int runBatch(FILE *psFile, History_T oHistoryList, 
+                    char *pcProgName)
+
+/* Read lines from psFile until EOF is reached, and execute each 
+   line without writing prompts or echoing lines. stdout is fully
+   buffered. psFile is read one line ahead, so the last line may 
+   replace the shell. Return the exit status of the last line, or 0
+   if psFile is empty. It is a checked runtime error for psFile, 
+   oHistoryList, or pcProgName to be NULL. */
+
+{
+   struct Input sInput;
+   int iStatus = 0;
+
+   assert(psFile != NULL);
+   assert(oHistoryList != NULL);
+   assert(pcProgName != NULL);
+
+   if(setvbuf(stdout, NULL, _IOFBF, BUFSIZ) != 0) 
+   {
+      perror(pcProgName); 
+      exit(EXIT_FAILURE); 
+   }
+
+   initInput(&sInput, psFile, TRUE, NULL, FALSE);
+   while(readLine(&sInput) >= 0)
+   {
+      iStatus = performCommand(&sInput, oHistoryList, NULL, FALSE, 
+                               TRUE, pcProgName);
+      jobReap();
+   }
+   freeInput(&sInput);
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static void runRc(History_T oHistoryList, int iEcho, char *pcProgName)
+
+/* Read lines from the .ishrc file residing in the HOME directory, if
+   any, until EOF is reached, and execute each line, taking the 
+   pipelines of lines that an earlier shell analyzed from the 
+   .ishrc.cache file there, and recording them there otherwise. 
+   Write each line that is read to stdout, after a prompt, iff iEcho
+   is TRUE. The lines are inserted into oHistoryList but not 
+   appended to its file, so the file does not grow at every start.
+   It is a checked runtime error for oHistoryList or pcProgName to 
+   be NULL. */
+
+{
+   struct Input sInput;
+   char *pcName;
+   char *pcCacheName;
+   RcCache_T oCache;
+   FILE *psFile;
+
+   assert(oHistoryList != NULL);
+   assert(pcProgName != NULL);
+
+   pcName = getHomeFile(".ishrc");
+   psFile = fopen(pcName, "r");
+
+   if(psFile != NULL)
+   {
+      pcCacheName = getHomeFile(".ishrc.cache");
+      oCache = RcCache_new(pcCacheName, pcName, fileno(psFile));
+      free(pcCacheName);
+
+      initInput(&sInput, psFile, FALSE, iEcho ? "> " : NULL, TRUE);
+      while(readLine(&sInput) >= 0)
+      {
+         if(iEcho)
+         {
+            printf("%% %s\n", sInput.pcLine);
+            /* Explicitly flush the stdout buffer so we can test ish
+               properly by redirecting the output to a file. */
+            fflush(stdout);
+         }
+
+         (void)performCommand(&sInput, oHistoryList, oCache, iEcho,
+                              FALSE, pcProgName);
+         jobReap();
+      }
+      if(oCache != NULL)
+         RcCache_free(oCache);
+      freeInput(&sInput);
+      fclose(psFile);
+   }
+   free(pcName);
+}
+
+/*------------------------------------------------------------------*/
+
+static int runRequest(FILE *psFile, void *pvHistoryList, 
+                      char *pcProgName)
+
+/* Execute the lines of psFile, the command text of a client of the
+   server, as runBatch() does with the History_T pvHistoryList, and
+   return the exit status of the last line. This is the callback of
+   serverRun(). */
+
+{
+   assert(psFile != NULL);
+   assert(pvHistoryList != NULL);
+   assert(pcProgName != NULL);
+
+   return runBatch(psFile, (History_T)pvHistoryList, pcProgName);
+}
+
+/*------------------------------------------------------------------*/
+
+static int serve(int argc, char *argv[])
+
+/* Run as the server of "ish -s socket [-j N]", whose arguments are 
+   argc and argv: read the .ishrc file without echoing it, and then
+   serve the clients of socket with at most N workers at a time, N 
+   being the number of processors by default, until SIGTERM or 
+   SIGINT arrives. Return the exit status of the server. */
+
+/* Each worker is a child of the server, so it starts from the state
+   the .ishrc built, and its history is its own. */
+
+{
+   History_T oHistoryList;
+   char *pcEnd;
+   long lMaxWorkers;
+   int iStatus;
+
+   assert(argv != NULL);
+
+   if(argc == 3)
+   {
+      lMaxWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+      if(lMaxWorkers <= 0)
+         lMaxWorkers = 1;
+   }
+   else if(argc == 5 && strcmp(argv[3], "-j") == 0)
+   {
+      lMaxWorkers = strtol(argv[4], &pcEnd, 10);
+      if(*argv[4] == '\0' || *pcEnd != '\0' || lMaxWorkers <= 0 ||
+         lMaxWorkers > INT_MAX)
+      {
+         fprintf(stderr, "%s: -j: Positive number required\n", 
+                 argv[0]);
+         return EXIT_FAILURE;
       }
    }
-   DynArray_map(oTokens, Token_free, NULL);
-   DynArray_free(oTokens);
+   else
+   {
+      fprintf(stderr, "Usage: %s -s socket [-j N]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   oHistoryList = History_new(getHistSize(), NULL);
+   runRc(oHistoryList, FALSE, argv[0]);
+   fflush(stdout);
+   iStatus = serverRun(argv[2], (int)lMaxWorkers, runRequest, 
+                       oHistoryList, argv[0]);
+   History_free(oHistoryList);
+   return iStatus;
 }
 
 /*------------------------------------------------------------------*/
 
 int main(int argc, char *argv[])
 
-/* Read lines from the .ishrc file residing in the HOME directory
-   until EOF is reached. Write each line that is read to
-   stdout and execute each line. Read a line from stdin and
-   execute it. Repeat until EOF. Return 0. */
+/* If argv[1] is "-s", run as an exec server listening on the socket
+   argv[2]; see serve() and server.h. If argv[1] is "-c", execute the
+   lines in argv[2]. Otherwise, if argv[1] is given, execute the 
+   lines of that file. In either case, do not read the .ishrc file,
+   write prompts, echo lines, or save history, and return the exit 
+   status of the last line. Otherwise, keep history in the 
+   .ish_history file residing in the HOME directory, and read lines
+   from the .ishrc file residing there until EOF is reached, taking
+   the pipelines of lines that an earlier shell analyzed from the 
+   .ishrc.cache file there, and recording them there otherwise. 
+   Write each line that is read to stdout and execute each line. 
+   Read a line from stdin and execute it. Repeat until EOF. Return 
+   0. */
 
 {
-   char acLine[MAX_LINE_SIZE];
+   struct Input sInput;
    char *pcTemp;
-   DynArray_T oHistoryList; 
+   History_T oHistoryList; 
    FILE *psFile;
-   int i;
+   int iStatus;
    void (*pfRet)(int);
 
    pfRet = signal(SIGINT, SIG_IGN);
    if(pfRet == SIG_ERR) {perror(argv[0]); exit(EXIT_FAILURE); }
 
-   oHistoryList = DynArray_new(0);
+   jobInit(argc == 1, argv[0]);
 
-   pcTemp = getIshrc();
-   psFile = fopen(pcTemp, "r");
-   free(pcTemp);
+   if(argc > 1 && strcmp(argv[1], "-s") == 0)
+      return serve(argc, argv);
+
+   if(argc > 1)
+   {
+      /* Scripts keep a history of their own lines only. */
+      oHistoryList = History_new(getHistSize(), NULL);
+
+      /* An empty command string has nothing to run. */
+      if(strcmp(argv[1], "-c") == 0 && argc > 2 && argv[2][0] == '\0')
+         return 0;
+      else if(strcmp(argv[1], "-c") == 0 && argc > 2)
+         psFile = fmemopen(argv[2], strlen(argv[2]), "r");
+      else if(strcmp(argv[1], "-c") == 0)
+      {
+         fprintf(stderr, "%s: -c: Missing command\n", argv[0]);
+         exit(EXIT_FAILURE);
+      }
+      else
+         psFile = fopen(argv[1], "r");
+      if(psFile == NULL)
+      {
+         fprintf(stderr, "%s: ", argv[0]);
+         perror(argv[1]);
+         exit(EXIT_FAILURE);
+      }
 
-   while (psFile != NULL && 
-          fgets(acLine, MAX_LINE_SIZE, psFile) != NULL)
-   {
-      /* Remove '\n' if acLine ends with '\n'. This is done so 
-         the commands in the history list do not end with '\n',
-         which is necessary to properly expand !commandprefix. */
-      if(acLine[strlen(acLine)-1] == '\n')
-         acLine[strlen(acLine)-1] = '\0';
-     
-      printf("%% %s\n", acLine);
-      /* Explicitly flush the stdout buffer so we can test ish
-         properly by redirecting the output to a file. */
+      iStatus = runBatch(psFile, oHistoryList, argv[0]);
+      fclose(psFile);
       fflush(stdout);
-      
-      performCommand(acLine, oHistoryList, argv[0]);
+      return iStatus;
    }
+
+   pcTemp = getHomeFile(".ish_history");
+   oHistoryList = History_new(getHistSize(), pcTemp);
+   free(pcTemp);
+
+   runRc(oHistoryList, TRUE, argv[0]);
    printf("%% ");
    fflush(stdout);
-   while (fgets(acLine, MAX_LINE_SIZE, stdin) != NULL)
+   initInput(&sInput, stdin, FALSE, "> ", FALSE);
+   while(readLine(&sInput) >= 0)
    {
-      /* Remove '\n' if acLine ends with '\n'. This is done so 
-         the commands in the history list do not end with '\n',
-         which is necessary to properly expand !commandprefix. */
-      if(acLine[strlen(acLine)-1] == '\n')
-         acLine[strlen(acLine)-1] = '\0';
-      
-      performCommand(acLine, oHistoryList, argv[0]);
+      (void)performCommand(&sInput, oHistoryList, NULL, TRUE, TRUE,
+                           argv[0]);
 
+      jobReap();
       printf("%% ");
       fflush(stdout);
    }
    printf("\n");
    fflush(stdout);
 
-   for(i = 0; i < DynArray_getLength(oHistoryList); i++)
-      free(DynArray_get(oHistoryList, i));
-   DynArray_free(oHistoryList);
+   freeInput(&sInput);
+   History_free(oHistoryList);
    return 0;
 }
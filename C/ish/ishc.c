@@ -0,0 +1,64 @@
+/*------------------------------------------------------------------*/
+/* ishc.c                                                           */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#include "server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+/*------------------------------------------------------------------*/
+
+static void usage(char *pcProgName)
+
+/* Write a usage message to stderr and exit with EXIT_FAILURE. */
+
+{
+   assert(pcProgName != NULL);
+
+   fprintf(stderr, "Usage: %s [-t] socket command\n", pcProgName);
+   exit(EXIT_FAILURE);
+}
+
+/*------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+
+/* Have the ish server listening on the socket argv[1] run the
+   command text in argv[2], which may hold several lines, with the
+   stdin, stdout, and stderr of ishc, and return its exit status. If
+   -t comes first, write the times and maximum resident set size the
+   server reports to stderr, as the "time" prefix of ish does. Return
+   EXIT_FAILURE if the server cannot be reached. */
+
+{
+   struct ServerReply sReply;
+   int iTimed = FALSE;
+   int iArg = 1;
+
+   if(argc > 1 && strcmp(argv[1], "-t") == 0)
+   {
+      iTimed = TRUE;
+      iArg++;
+   }
+   if(argc - iArg != 2)
+      usage(argv[0]);
+
+   if(!serverRequest(argv[iArg], argv[iArg + 1], strlen(argv[iArg + 1]),
+                     &sReply))
+   {
+      fprintf(stderr, "%s: ", argv[0]);
+      perror(argv[iArg]);
+      return EXIT_FAILURE;
+   }
+   if(iTimed)
+      fprintf(stderr, "%9.3f real %9.3f user %9.3f sys %8ld KB maxrss\n",
+              sReply.dWall, sReply.dUser, sReply.dSys, sReply.lMaxRss);
+   return sReply.iStatus;
+}
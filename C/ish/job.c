@@ -0,0 +1,327 @@
+/*------------------------------------------------------------------*/
+/* job.c                                                            */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "dynarray.h"
+#include "job.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+enum {SIGNAL_STATUS_BASE = 128};
+
+/*------------------------------------------------------------------*/
+
+/* A Job is a pipeline running in the background. */
+
+struct Job
+{
+   /* The job number that the user refers to the job by. */
+   int iNumber;
+
+   /* The processes of the pipeline. Reaped processes are set to 
+      -1. */
+   pid_t *piPids;
+
+   /* The number of processes in piPids. */
+   int iNumPids;
+
+   /* The number of processes in piPids that have not been reaped. */
+   int iNumLive;
+
+   /* The exit status of the last process of the pipeline, once it 
+      has been reaped. */
+   int iStatus;
+
+   /* The text of the pipeline. */
+   char *pcText;
+};
+
+/*------------------------------------------------------------------*/
+
+/* The background jobs, in the order they were started. */
+static DynArray_T oJobs = NULL;
+
+/* TRUE iff jobs are announced when they start and finish. */
+static int iNotifying = TRUE;
+
+/* Set by the SIGCHLD handler when some child may have exited. */
+static volatile sig_atomic_t iChildExited = FALSE;
+
+/* The exit status of the job that finished most recently, or 0 if
+   none has. */
+static int iLastStatus = 0;
+
+/*------------------------------------------------------------------*/
+
+static void handleChild(int iSignal)
+
+/* Note that a child process has changed state. iSignal is unused. */
+
+{
+   iChildExited = TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+void jobInit(int iNotify, char *pcProgName)
+
+/* Install the SIGCHLD handler that the job table relies on. Jobs are
+   announced on stdout when they start and finish iff iNotify is 
+   TRUE. pcProgName is used in printing error messages. It is a 
+   checked runtime error for pcProgName to be NULL. */
+
+{
+   struct sigaction sAction;
+
+   assert(pcProgName != NULL);
+
+   if(oJobs == NULL)
+      oJobs = DynArray_new(0);
+   iNotifying = iNotify;
+
+   /* Restart interrupted system calls, so a background job that 
+      exits does not disturb a read or a foreground wait. */
+   memset(&sAction, 0, sizeof(sAction));
+   sAction.sa_handler = handleChild;
+   sAction.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+   sigemptyset(&sAction.sa_mask);
+   if(sigaction(SIGCHLD, &sAction, NULL) == -1)
+   {
+      perror(pcProgName);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static void freeJob(struct Job *psJob)
+
+/* Free psJob. It is a checked runtime error for psJob to be 
+   NULL. */
+
+{
+   assert(psJob != NULL);
+
+   free(psJob->piPids);
+   free(psJob->pcText);
+   free(psJob);
+}
+
+/*------------------------------------------------------------------*/
+
+int jobAdd(const pid_t *piPids, int iNumPids, const char *pcText)
+
+/* Add a background job consisting of the iNumPids processes in 
+   piPids, described by pcText, to the job table and announce it. 
+   Return its job number. It is a checked runtime error for
+   piPids or pcText to be NULL. It is a checked runtime error for
+   iNumPids to be non-positive. */
+
+{
+   struct Job *psJob;
+   struct Job *psLast;
+   int iLength;
+
+   assert(piPids != NULL);
+   assert(iNumPids > 0);
+   assert(pcText != NULL);
+
+   if(oJobs == NULL)
+      oJobs = DynArray_new(0);
+
+   psJob = (struct Job*)malloc(sizeof(struct Job));
+   assert(psJob != NULL);
+   psJob->piPids = (pid_t*)malloc((size_t)iNumPids * sizeof(pid_t));
+   assert(psJob->piPids != NULL);
+   memcpy(psJob->piPids, piPids, (size_t)iNumPids * sizeof(pid_t));
+   psJob->iNumPids = iNumPids;
+   psJob->iNumLive = iNumPids;
+   psJob->iStatus = 0;
+   psJob->pcText = (char*)malloc(strlen(pcText) + 1);
+   assert(psJob->pcText != NULL);
+   strcpy(psJob->pcText, pcText);
+
+   /* Number jobs after the most recent one still in the table. */
+   iLength = DynArray_getLength(oJobs);
+   if(iLength == 0)
+      psJob->iNumber = 1;
+   else
+   {
+      psLast = (struct Job*)DynArray_get(oJobs, iLength - 1);
+      psJob->iNumber = psLast->iNumber + 1;
+   }
+   DynArray_add(oJobs, psJob);
+
+   if(iNotifying)
+      printf("[%d] %d\n", psJob->iNumber, (int)piPids[iNumPids - 1]);
+   return psJob->iNumber;
+}
+
+/*------------------------------------------------------------------*/
+
+static int getExitStatus(int iWaitStatus)
+
+/* Return the exit status of a command whose process waitpid() 
+   reported as iWaitStatus: its exit code, or SIGNAL_STATUS_BASE plus
+   the signal number if a signal killed it. */
+
+{
+   if(WIFSIGNALED(iWaitStatus))
+      return SIGNAL_STATUS_BASE + WTERMSIG(iWaitStatus);
+   return WEXITSTATUS(iWaitStatus);
+}
+
+/*------------------------------------------------------------------*/
+
+static void reapJob(struct Job *psJob, int iOptions)
+
+/* Call waitpid() with iOptions on each process of psJob that has 
+   not been reaped yet, and update psJob accordingly. Once all have
+   been, record the status of psJob as that of the job that finished
+   most recently. It is a checked runtime error for psJob to be 
+   NULL. */
+
+{
+   pid_t iPid;
+   int iWaitStatus;
+   int i;
+
+   assert(psJob != NULL);
+
+   for(i = 0; i < psJob->iNumPids; i++)
+   {
+      if(psJob->piPids[i] == -1)
+         continue;
+      do
+         iPid = waitpid(psJob->piPids[i], &iWaitStatus, iOptions);
+      while(iPid == -1 && errno == EINTR);
+
+      /* ECHILD means someone else reaped it; either way it is 
+         gone. */
+      if(iPid == psJob->piPids[i] || iPid == -1)
+      {
+         if(iPid != -1 && i == psJob->iNumPids - 1)
+            psJob->iStatus = getExitStatus(iWaitStatus);
+         psJob->piPids[i] = -1;
+         psJob->iNumLive--;
+      }
+   }
+   if(psJob->iNumLive == 0)
+      iLastStatus = psJob->iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+void jobReap(void)
+
+/* Reap, without blocking, every background process that has exited
+   since the last call. Announce each job whose processes have all
+   exited, and remove it from the job table. */
+
+{
+   struct Job *psJob;
+   int i;
+
+   if(!iChildExited || oJobs == NULL)
+      return;
+
+   /* Clear the flag first, so an exit during the scan is seen next
+      time. */
+   iChildExited = FALSE;
+
+   for(i = 0; i < DynArray_getLength(oJobs); i++)
+   {
+      psJob = (struct Job*)DynArray_get(oJobs, i);
+      reapJob(psJob, WNOHANG);
+      if(psJob->iNumLive == 0)
+      {
+         if(iNotifying)
+            printf("[%d] Done\t%s\n", psJob->iNumber, psJob->pcText);
+         (void)DynArray_removeAt(oJobs, i);
+         freeJob(psJob);
+         i--;
+      }
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+int jobCount(void)
+
+/* Return the number of jobs in the job table. */
+
+{
+   if(oJobs == NULL)
+      return 0;
+   return DynArray_getLength(oJobs);
+}
+
+/*------------------------------------------------------------------*/
+
+void jobPrint(void)
+
+/* Write the job table to stdout. */
+
+{
+   struct Job *psJob;
+   int i;
+
+   if(oJobs == NULL)
+      return;
+
+   for(i = 0; i < DynArray_getLength(oJobs); i++)
+   {
+      psJob = (struct Job*)DynArray_get(oJobs, i);
+      printf("[%d] Running\t%s\n", psJob->iNumber, psJob->pcText);
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+int jobWait(int iJob, int *piStatus)
+
+/* Block until every process of job number iJob has exited, or until
+   every background job has if iJob is 0, and remove the job(s) from
+   the job table. Store in *piStatus the exit status of the job that
+   finished most recently, which is job iJob if it is not 0, or 0 if
+   no job has finished yet. Return TRUE if successful, and FALSE if 
+   there is no job number iJob. It is a checked runtime error for 
+   piStatus to be NULL. */
+
+{
+   struct Job *psJob;
+   int iFound = FALSE;
+   int i;
+
+   assert(piStatus != NULL);
+
+   *piStatus = iLastStatus;
+   if(oJobs == NULL)
+      return iJob == 0;
+
+   for(i = 0; i < DynArray_getLength(oJobs); i++)
+   {
+      psJob = (struct Job*)DynArray_get(oJobs, i);
+      if(iJob != 0 && psJob->iNumber != iJob)
+         continue;
+      iFound = TRUE;
+      reapJob(psJob, 0);
+      (void)DynArray_removeAt(oJobs, i);
+      freeJob(psJob);
+      i--;
+   }
+   *piStatus = iLastStatus;
+   return iFound || iJob == 0;
+}
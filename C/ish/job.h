@@ -0,0 +1,48 @@
+/*------------------------------------------------------------------*/
+/* job.h                                                            */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef JOB_INCLUDED
+#define JOB_INCLUDED
+
+#include <sys/types.h>
+
+/* The job table tracks pipelines that run in the background. 
+   Finished jobs are reaped without blocking, in response to 
+   SIGCHLD, the next time jobReap() is called. */
+
+void jobInit(int iNotify, char *pcProgName);
+/* Install the SIGCHLD handler that the job table relies on. Jobs are
+   announced on stdout when they start and finish iff iNotify is 
+   TRUE. pcProgName is used in printing error messages. It is a 
+   checked runtime error for pcProgName to be NULL. */
+
+int jobAdd(const pid_t *piPids, int iNumPids, const char *pcText);
+/* Add a background job consisting of the iNumPids processes in 
+   piPids, described by pcText, to the job table and announce it. 
+   Return its job number. It is a checked runtime error for
+   piPids or pcText to be NULL. It is a checked runtime error for
+   iNumPids to be non-positive. */
+
+void jobReap(void);
+/* Reap, without blocking, every background process that has exited
+   since the last call. Announce each job whose processes have all
+   exited, and remove it from the job table. */
+
+int jobCount(void);
+/* Return the number of jobs in the job table. */
+
+void jobPrint(void);
+/* Write the job table to stdout. */
+
+int jobWait(int iJob, int *piStatus);
+/* Block until every process of job number iJob has exited, or until
+   every background job has if iJob is 0, and remove the job(s) from
+   the job table. Store in *piStatus the exit status of the job that
+   finished most recently, which is job iJob if it is not 0, or 0 if
+   no job has finished yet. Return TRUE if successful, and FALSE if 
+   there is no job number iJob. It is a checked runtime error for 
+   piStatus to be NULL. */
+
+#endif                      /* JOB_INCLUDED */
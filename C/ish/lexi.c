@@ -4,293 +4,569 @@
 /* -----------------------------------------------------------------*/
 
 #include "dynarray.h"
+#include "arena.h"
 #include "lexi.h"
+#include "smallarray.h"
+#include "var.h"
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define LEX_USE_SSE2
+#endif
 
 /*------------------------------------------------------------------*/
 
-enum {MAX_LINE_SIZE = 1024};
-
 enum {FALSE, TRUE};
 
-enum TokenType {TOKEN_WORD, TOKEN_STDIN, TOKEN_STDOUT};
-
-enum LexState {STATE_START, STATE_IN_WORD, STATE_IN_QUOTE, 
-               STATE_ERROR, STATE_EXIT};
+/* The lexical classes of characters. */
+enum CharClass {CLASS_WORD, CLASS_BLANK, CLASS_END, CLASS_QUOTE, 
+                CLASS_DOLLAR, CLASS_STDIN, CLASS_STDOUT, CLASS_PIPE, 
+                CLASS_BACKGROUND, CLASS_ERROR};
 
 /*------------------------------------------------------------------*/
 
-/* A Token is a word, a '<', or a '>', expressed as a string. */
-
-struct Token
+#define W CLASS_WORD
+#define B CLASS_BLANK
+#define E CLASS_END
+#define Q CLASS_QUOTE
+#define D CLASS_DOLLAR
+#define I CLASS_STDIN
+#define O CLASS_STDOUT
+#define P CLASS_PIPE
+#define G CLASS_BACKGROUND
+#define X CLASS_ERROR
+
+/* The class of each character, indexed by its unsigned value. Words
+   consist of the printable ASCII characters other than the ones
+   with classes of their own. */
+
+static const unsigned char aucClass[256] =
 {
-   /* The type of the token. */  
-   enum TokenType eType;
-      
-   /* The string which is the token's value. */
-   char *pcValue;
+   E, X, X, X, X, X, X, X, X, B, E, X, X, X, X, X,   /* 0x00 */
+   X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,   /* 0x10 */
+   B, W, Q, W, D, W, G, W, W, W, W, W, W, W, W, W,   /* 0x20 */
+   W, W, W, W, W, W, W, W, W, W, W, W, I, W, O, W,   /* 0x30 */
+   W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,   /* 0x40 */
+   W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,   /* 0x50 */
+   W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,   /* 0x60 */
+   W, W, W, W, W, W, W, W, W, W, W, W, P, W, W, X,   /* 0x70 */
+   X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,   /* 0x80 */
+   X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,   /* 0x90 */
+   X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,   /* 0xA0 */
+   X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,   /* 0xB0 */
+   X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,   /* 0xC0 */
+   X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,   /* 0xD0 */
+   X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,   /* 0xE0 */
+   X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X    /* 0xF0 */
 };
 
+#undef W
+#undef B
+#undef E
+#undef Q
+#undef D
+#undef I
+#undef O
+#undef P
+#undef G
+#undef X
+
 /*------------------------------------------------------------------*/
 
-void Token_free(void *pvItem, void *pvExtra)
+static size_t skipWordChars(const char *pcStart, const char *pcEnd)
+
+/* Return the number of characters at the beginning of pcStart, up
+   to pcEnd, that are of class CLASS_WORD. It is a checked runtime
+   error for pcStart or pcEnd to be NULL. */
 
-/* Free token pvItem. pvExtra is unused. It is a checked runtime
-   error for pvItem to be NULL. */
+/* With SSE2, sixteen characters are classified at once: a character
+   is a word character iff it lies in 0x21 through 0x7E and is none 
+   of '"', '$', '<', '>', '|', and '&'. */
 
 {
-   struct Token *psToken;
+   const char *pc = pcStart;
+#ifdef LEX_USE_SSE2
+   __m128i vChars;
+   __m128i vWord;
+   unsigned int uMask;
 
-   assert(pvItem != NULL);
+   assert(pcStart != NULL);
+   assert(pcEnd != NULL);
 
-   psToken = (struct Token*)pvItem;
-   free(psToken->pcValue);
-   free(psToken);
+   while(pcEnd - pc >= 16)
+   {
+      vChars = _mm_loadu_si128((const __m128i*)pc);
+
+      /* Bytes of 0x80 and above compare as negative. */
+      vWord = _mm_and_si128(
+         _mm_cmpgt_epi8(vChars, _mm_set1_epi8(0x20)),
+         _mm_cmplt_epi8(vChars, _mm_set1_epi8(0x7F)));
+      vWord = _mm_andnot_si128(
+         _mm_or_si128(
+            _mm_or_si128(
+               _mm_or_si128(
+                  _mm_cmpeq_epi8(vChars, _mm_set1_epi8('"')),
+                  _mm_cmpeq_epi8(vChars, _mm_set1_epi8('$'))),
+               _mm_cmpeq_epi8(vChars, _mm_set1_epi8('<'))),
+            _mm_or_si128(
+               _mm_or_si128(
+                  _mm_cmpeq_epi8(vChars, _mm_set1_epi8('>')),
+                  _mm_cmpeq_epi8(vChars, _mm_set1_epi8('|'))),
+               _mm_cmpeq_epi8(vChars, _mm_set1_epi8('&')))),
+         vWord);
+
+      uMask = ~(unsigned int)_mm_movemask_epi8(vWord) & 0xFFFFu;
+      if(uMask != 0)
+         return (size_t)(pc - pcStart) + (size_t)__builtin_ctz(uMask);
+      pc += 16;
+   }
+#else
+   assert(pcStart != NULL);
+   assert(pcEnd != NULL);
+#endif
+
+   while(pc < pcEnd && aucClass[(unsigned char)*pc] == CLASS_WORD)
+      pc++;
+   return (size_t)(pc - pcStart);
 }
 
 /*------------------------------------------------------------------*/
 
-int Token_getType(void *pvItem, void *pvExtra)
+static void emitStdin(char **ppcRead,
+                      void (*pfToken)(enum TokenType eType,
+                                      char *pcValue,
+                                      size_t uValueLength,
+                                      void *pvExtra),
+                      void *pvExtra)
 
-/* Return the eType of token pvItem. It is a checked runtime
-   error for pvItem to be NULL. */
+/* *ppcRead points just past a '<'. Call (*pfToken)(eType, pcValue,
+   uValueLength, pvExtra) for a "<<<" if two more '<'s follow, for a
+   "<<" if one does, and for a '<' otherwise, and advance *ppcRead 
+   past the '<'s. It is a checked runtime error for ppcRead, 
+   *ppcRead, or pfToken to be NULL. */
 
-{
-   struct Token *psToken;
+/* Only the first '<' may have been overwritten by the terminator of
+   the word before it, so the ones after it can still be read. */
 
-   assert(pvItem != NULL);
+{
+   assert(ppcRead != NULL);
+   assert(*ppcRead != NULL);
+   assert(pfToken != NULL);
 
-   psToken = (struct Token*)pvItem;
-   return psToken->eType;
+   if((*ppcRead)[0] != '<')
+      (*pfToken)(TOKEN_STDIN, "<", 1, pvExtra);
+   else if((*ppcRead)[1] != '<')
+   {
+      (*pfToken)(TOKEN_HEREDOC, "<<", 2, pvExtra);
+      *ppcRead += 1;
+   }
+   else
+   {
+      (*pfToken)(TOKEN_HERESTRING, "<<<", 3, pvExtra);
+      *ppcRead += 2;
+   }
 }
 
 /*------------------------------------------------------------------*/
 
-char *Token_getValue(void *pvItem, void *pvExtra)
+static int isNameChar(char c, int iFirst)
 
-/* Return the pcValue of token pvItem. It is a checked runtime
-   error for pvItem to be NULL. */
+/* Return TRUE if c may be part of a variable name, as its first
+   character if iFirst is TRUE, and FALSE otherwise. */
 
 {
-   struct Token *psToken;
-   
-   assert(pvItem != NULL);
-
-   psToken = (struct Token*)pvItem;
-   return psToken->pcValue;
+   return c == '_' || isalpha((unsigned char)c) ||
+          (!iFirst && isdigit((unsigned char)c));
 }
 
 /*------------------------------------------------------------------*/
-     
-static struct Token *makeToken(enum TokenType eTokenType,
-                               char *pcValue)
 
-/* Create and return a Token whose type is eTokenType and whose
-   value consists of string pcValue. It is a checked runtime error
-   for eTokenType to not equal a TokenType. It is a checked runtime
-   error for pcValue to be NULL. */
+static int isSpecialName(char c)
+
+/* Return TRUE if c by itself names a special parameter, a digit for
+   a positional parameter or '#' for their number, and FALSE
+   otherwise. */
 
 {
-   struct Token *psToken;
+   return isdigit((unsigned char)c) || c == '#';
+}
 
-   assert(eTokenType == TOKEN_WORD || eTokenType == TOKEN_STDOUT ||
-          eTokenType == TOKEN_STDIN);
-   assert(pcValue != NULL);
+/*------------------------------------------------------------------*/
 
-   psToken = (struct Token*)malloc(sizeof(struct Token));
-   assert(psToken != NULL);
+static int expandVariable(char **ppcRead, SmallArray_T oBuffer,
+                          int iExpand, char *pcProgName)
+
+/* *ppcRead points to a '$'. Add to oBuffer the value of the variable
+   that "$NAME" or "${NAME}" there refers to, which is empty if it is
+   not set, and advance *ppcRead past the reference. NAME may also be
+   one of the special parameters "1" through "9" and "#". A '$' that
+   is followed by neither a name nor '{' is added as it is. If 
+   iExpand is FALSE, add the reference in the form lexExpand() reads
+   instead: "${NAME}" for a reference, and "$$" for a '$' as it is.
+   Return TRUE if successful, and FALSE if a "${" is not followed by
+   a name and a '}'. pcProgName is used in printing error messages.
+   It is a checked runtime error for ppcRead, *ppcRead, oBuffer, or 
+   pcProgName to be NULL. */
 
-   psToken->eType = eTokenType;
+{
+   char *pcName;
+   char *pc;
+   const char *pcValue;
+   int iBraced;
+
+   assert(ppcRead != NULL);
+   assert(*ppcRead != NULL);
+   assert(**ppcRead == '$');
+   assert(oBuffer != NULL);
+   assert(pcProgName != NULL);
+
+   iBraced = ((*ppcRead)[1] == '{');
+   pcName = *ppcRead + 1 + iBraced;
+   if(!iBraced && !isNameChar(*pcName, TRUE) && 
+      !isSpecialName(*pcName))
+   {
+      SmallArray_addAll(oBuffer, "$$", iExpand ? 1 : 2);
+      *ppcRead += 1;
+      return TRUE;
+   }
 
-   psToken->pcValue = (char*)malloc(strlen(pcValue) + 1);
-   assert(psToken->pcValue != NULL);
-   strcpy(psToken->pcValue, pcValue);
+   if(isSpecialName(*pcName))
+      pc = pcName + 1;
+   else
+      for(pc = pcName; isNameChar(*pc, pc == pcName); pc++)
+         ;
+   if(iBraced && (pc == pcName || *pc != '}'))
+   {
+      fprintf(stderr, "%s: Bad substitution\n", pcProgName);
+      return FALSE;
+   }
 
-   return psToken;
+   if(!iExpand)
+   {
+      SmallArray_addAll(oBuffer, "${", 2);
+      SmallArray_addAll(oBuffer, pcName, (int)(pc - pcName));
+      (void)SmallArray_add(oBuffer, "}");
+   }
+   else
+   {
+      pcValue = varGet(pcName, (size_t)(pc - pcName));
+      if(pcValue != NULL)
+         SmallArray_addAll(oBuffer, pcValue, (int)strlen(pcValue));
+   }
+   *ppcRead = pc + iBraced;
+   return TRUE;
 }
 
 /*------------------------------------------------------------------*/
 
-int lexLine(const char *pcLine, DynArray_T oTokens, char *pcProgName)
+static char *finishExpanded(SmallArray_T oBuffer, size_t *puLength,
+                            Arena_T oArena)
+
+/* Return a copy of the characters in oBuffer, terminated and 
+   allocated from oArena, store their number in *puLength, and free
+   oBuffer. It is a checked runtime error for oBuffer, puLength, or
+   oArena to be NULL. */
+
+{
+   char *pcValue;
+
+   assert(oBuffer != NULL);
+   assert(puLength != NULL);
+   assert(oArena != NULL);
 
-/* Lexically analyze string pcLine.  Populate oTokens with the 
-   tokens that pcLine contains.  Return TRUE if successful, and FALSE
-   if pcLine contains a lexical error.  In the latter case, oTokens
-   may contain tokens that were discovered before the lexical error.
-   pcProgName is used in printing error messages. It is a checked
-   runtime error for pcLine, oTokens, or pcProgName to be NULL. It 
-   is a checked runtime error for the size of pcLine to be greater
-   than MAX_LINE_SIZE. */
+   *puLength = (size_t)SmallArray_getLength(oBuffer);
+   pcValue = (char*)Arena_alloc(oArena, *puLength + 1);
+   memcpy(pcValue, SmallArray_getArray(oBuffer), *puLength);
+   pcValue[*puLength] = '\0';
+   SmallArray_free(oBuffer);
+   return pcValue;
+}
+
+/*------------------------------------------------------------------*/
 
-/* lexLine() uses a DFA approach. It "reads" its characters from
-   pcLine. */
+int lexScan(char *pcLine, size_t uLength, 
+            void (*pfToken)(enum TokenType eType, char *pcValue,
+                            size_t uValueLength, void *pvExtra),
+            void *pvExtra, int iExpand, Arena_T oArena, 
+            char *pcProgName)
+
+/* Lexically analyze string pcLine, of length uLength, calling 
+   (*pfToken)(eType, pcValue, uValueLength, pvExtra) for each token
+   it contains, in order. If iExpand is TRUE, variable references in
+   words, "$NAME" and "${NAME}", are replaced by the values of the 
+   variables, within quotes as well as outside them; a word that 
+   consists only of unquoted references to unset or empty variables
+   is dropped. NAME may also be a digit, naming a positional 
+   parameter, or '#', their number; see varGet(). If iExpand is 
+   FALSE, the value of a word that contains a '$' is instead a 
+   template, which lexExpand() expands the same way later. The 
+   values of word tokens point into pcLine, which is modified to 
+   terminate and unquote them, or into oArena if they contain a '$',
+   so pcLine must remain unchanged and oArena must not be reset 
+   while the values are in use; each value is terminated before it
+   is passed. Return TRUE if successful, and FALSE if pcLine 
+   contains a lexical error. In the latter case, *pfToken has been 
+   called for the tokens that were discovered before the lexical 
+   error. pcProgName is used in printing error messages. It
+   is a checked runtime error for pcLine, pfToken, oArena, or 
+   pcProgName to be NULL. */
+
+/* lexScan() classifies characters with a table instead of walking a
+   DFA one character at a time. Runs of plain word characters are 
+   skipped in bulk by skipWordChars(). Only a word that contains 
+   quotes is copied, and then only within itself, since removing the
+   quotes never makes it longer. A word that contains a reference may
+   grow, so from its first reference on it is built in a SmallArray
+   instead, and copied to oArena once it ends. */
 
 {
-   char acValue[MAX_LINE_SIZE];
-   char c;
-   int iLineIndex = 0;
-   int iValueIndex = 0;
-   enum LexState eState = STATE_START;
-   struct Token *psToken;
+   char *pcEnd;
+   char *pcRead;
+   char *pcWrite;
+   char *pcWord;
+   enum CharClass eClass;
+   int iInQuote;
+   int iQuoted;
+   int iExpanded;
+   struct SmallArray sBuffer;
+   size_t uWordLength;
 
    assert(pcLine != NULL);
-   assert(strlen(pcLine) + 1 <= MAX_LINE_SIZE);
-   assert(oTokens != NULL);
+   assert(pcLine[uLength] == '\0');
+   assert(pfToken != NULL);
+   assert(oArena != NULL);
    assert(pcProgName != NULL);
 
-   while ((eState != STATE_EXIT) && (eState != STATE_ERROR))
+   pcEnd = pcLine + uLength;
+   pcRead = pcLine;
+   for(;;)
    {
-      /* "Read" the next character from pcLine. */
-      c = pcLine[iLineIndex++];
-
-      switch (eState)
+      eClass = (enum CharClass)aucClass[(unsigned char)*pcRead];
+      switch(eClass)
       {
-         case STATE_START:
-            if ((c == '\n') || (c == '\0'))
-               eState = STATE_EXIT;
-            else if (c == '<')
-            {
-               /* Create a STDIN token. */
-               acValue[iValueIndex++] = c;
-               acValue[iValueIndex] = '\0';
-               psToken = makeToken(TOKEN_STDIN, acValue);
-               DynArray_add(oTokens, psToken);
-               iValueIndex = 0;
-
-               eState = STATE_START;
-            }
-            else if (c == '>')
-            {
-               /* Create a STDOUT token. */
-               acValue[iValueIndex++] = c;               
-               acValue[iValueIndex] = '\0';
-               psToken = makeToken(TOKEN_STDOUT, acValue);
-               DynArray_add(oTokens, psToken);
-               iValueIndex = 0;
-
-               eState = STATE_START;
-            }
-            else if (c == '"')
-            {
-               eState = STATE_IN_QUOTE;
-            }
-            else if ((int)c > 0x20 && (int)c < 0x7F)
-            {
-               acValue[iValueIndex++] = c;
-               eState = STATE_IN_WORD;
-            }
-            else if ((c == ' ') || (c == '\t'))
-               eState = STATE_START;
-            else
-               eState = STATE_ERROR;
+         case CLASS_BLANK:
+            pcRead++;
             break;
 
-         case STATE_IN_WORD:
-            if ((c == '\n') || (c == '\0'))
-            {
-               /* Create a WORD token. */
-               acValue[iValueIndex] = '\0';
-               psToken = makeToken(TOKEN_WORD, acValue);
-               DynArray_add(oTokens, psToken);
-               iValueIndex = 0;
-               
-               eState = STATE_EXIT;
-            }
-            else if ((c == ' ') || (c == '\t'))
-            {
-               /* Create a WORD token. */
-               acValue[iValueIndex] = '\0';
-               psToken = makeToken(TOKEN_WORD, acValue);
-               DynArray_add(oTokens, psToken);
-               iValueIndex = 0;
-               
-               eState = STATE_START;
-            }
-            else if (c == '<')
-            {
-               /* Create a WORD token. */
-               acValue[iValueIndex] = '\0';
-               psToken = makeToken(TOKEN_WORD, acValue);
-               DynArray_add(oTokens, psToken);
-               iValueIndex = 0;
-               
-               /* Create a STDIN token. */
-               acValue[iValueIndex++] = c;
-               acValue[iValueIndex] = '\0';
-               psToken = makeToken(TOKEN_STDIN, acValue);
-               DynArray_add(oTokens, psToken);
-               iValueIndex = 0;
-
-               eState = STATE_START;
-            }
-            else if (c == '>')
-            {
-               /* Create a WORD token. */
-               acValue[iValueIndex] = '\0';
-               psToken = makeToken(TOKEN_WORD, acValue);
-               DynArray_add(oTokens, psToken);
-               iValueIndex = 0;
-               
-               /* Create a STDOUT token. */
-               acValue[iValueIndex++] = c;               
-               acValue[iValueIndex] = '\0';
-               psToken = makeToken(TOKEN_STDOUT, acValue);
-               DynArray_add(oTokens, psToken);
-               iValueIndex = 0;
-               
-               eState = STATE_START;
-            }
-            else if (c == '"')
-            {
-               eState = STATE_IN_QUOTE;
-            }
-            else if ((int)c > 0x20 && (int)c < 0x7F)
-            {
-               acValue[iValueIndex++] = c;               
-               eState = STATE_IN_WORD;
-            }
-            else
-               eState = STATE_ERROR;
+         case CLASS_END:
+            return TRUE;
+
+         case CLASS_ERROR:
+            return FALSE;
+
+         case CLASS_STDIN:
+            pcRead++;
+            emitStdin(&pcRead, pfToken, pvExtra);
+            break;
+
+         case CLASS_STDOUT:
+            (*pfToken)(TOKEN_STDOUT, ">", 1, pvExtra);
+            pcRead++;
+            break;
+
+         case CLASS_PIPE:
+            (*pfToken)(TOKEN_PIPE, "|", 1, pvExtra);
+            pcRead++;
             break;
 
-         case STATE_IN_QUOTE:
-            if ((c == '\n') || (c == '\0'))
+         case CLASS_BACKGROUND:
+            (*pfToken)(TOKEN_BACKGROUND, "&", 1, pvExtra);
+            pcRead++;
+            break;
+
+         case CLASS_WORD:
+         case CLASS_QUOTE:
+         case CLASS_DOLLAR:
+            /* Skip the plain prefix of the word in bulk. Until a
+               quote or a reference is seen, the word needs no 
+               copying. */
+            pcWord = pcRead;
+            pcRead += skipWordChars(pcRead, pcEnd);
+            pcWrite = pcRead;
+            iInQuote = FALSE;
+            iQuoted = FALSE;
+            iExpanded = FALSE;
+            for(;;)
             {
-               /* Create a token so we know command did not consist of
-                  entirely white spaces. The eType TOKEN_WORD is 
-                  chosen arbitrarily. */
-               acValue[iValueIndex] = '\0';
-               psToken = makeToken(TOKEN_WORD, acValue);
-               DynArray_add(oTokens, psToken);
-               iValueIndex = 0;
-               
-               fprintf(stderr, "%s: Unmatched quote\n", pcProgName);
-               eState = STATE_ERROR;
+               eClass = (enum CharClass)aucClass[(unsigned char)*pcRead];
+               if(eClass == CLASS_QUOTE)
+               {
+                  iInQuote = !iInQuote;
+                  iQuoted = TRUE;
+               }
+               else if(eClass == CLASS_END && iInQuote)
+               {
+                  /* Create a token so we know command did not 
+                     consist of entirely white spaces. */
+                  if(iExpanded)
+                     pcWord = finishExpanded(&sBuffer, &uWordLength,
+                                             oArena);
+                  else
+                  {
+                     *pcWrite = '\0';
+                     uWordLength = (size_t)(pcWrite - pcWord);
+                  }
+                  (*pfToken)(TOKEN_WORD, pcWord, uWordLength, pvExtra);
+                  fprintf(stderr, "%s: Unmatched quote\n", pcProgName);
+                  return FALSE;
+               }
+               else if(eClass == CLASS_DOLLAR)
+               {
+                  if(!iExpanded)
+                  {
+                     SmallArray_init(&sBuffer, 1);
+                     SmallArray_addAll(&sBuffer, pcWord,
+                                       (int)(pcWrite - pcWord));
+                     iExpanded = TRUE;
+                  }
+                  if(!expandVariable(&pcRead, &sBuffer, iExpand,
+                                     pcProgName))
+                  {
+                     SmallArray_free(&sBuffer);
+                     return FALSE;
+                  }
+                  continue;
+               }
+               else if(eClass == CLASS_WORD || 
+                       (iInQuote && eClass != CLASS_ERROR))
+               {
+                  if(iExpanded)
+                     (void)SmallArray_add(&sBuffer, pcRead);
+                  else
+                     *pcWrite++ = *pcRead;
+               }
+               else if(eClass == CLASS_ERROR)
+               {
+                  if(iExpanded)
+                     SmallArray_free(&sBuffer);
+                  return FALSE;
+               }
+               else
+                  break;
+               pcRead++;
             }
-            else if (c == '"')
+
+            /* A word with references was built apart from pcLine, so
+               the character that ended it is left for the next pass
+               of the outer loop. */
+            if(iExpanded)
             {
-               eState = STATE_IN_WORD;
+               /* A template records that its word was quoted, since
+                  that decides whether it may be dropped. */
+               if(!iExpand && iQuoted)
+                  SmallArray_addAll(&sBuffer, "$\"", 2);
+               if(SmallArray_getLength(&sBuffer) == 0 && !iQuoted)
+                  SmallArray_free(&sBuffer);
+               else
+               {
+                  pcWord = finishExpanded(&sBuffer, &uWordLength,
+                                          oArena);
+                  (*pfToken)(TOKEN_WORD, pcWord, uWordLength, pvExtra);
+               }
+               break;
             }
-            else if ((c == ' ') || (c == '\t') 
-                                || ((int)c > 0x20 && (int)c < 0x7F))
+
+            /* pcRead is at the character that ended the word, whose
+               class is in eClass, so the terminator may overwrite
+               it before the word is passed on. */
+            *pcWrite = '\0';
+            (*pfToken)(TOKEN_WORD, pcWord, (size_t)(pcWrite - pcWord),
+                       pvExtra);
+            if(eClass == CLASS_END)
+               return TRUE;
+            if(pcWrite == pcRead)
             {
-               acValue[iValueIndex++] = c;
-               eState = STATE_IN_QUOTE;
+               /* The character that ended the word was overwritten.
+                  If it was an operator, emit it now. */
+               pcRead++;
+               switch(eClass)
+               {
+                  case CLASS_BLANK:
+                     break;
+                  case CLASS_STDIN:
+                     emitStdin(&pcRead, pfToken, pvExtra);
+                     break;
+                  case CLASS_STDOUT:
+                     (*pfToken)(TOKEN_STDOUT, ">", 1, pvExtra);
+                     break;
+                  case CLASS_PIPE:
+                     (*pfToken)(TOKEN_PIPE, "|", 1, pvExtra);
+                     break;
+                  case CLASS_BACKGROUND:
+                     (*pfToken)(TOKEN_BACKGROUND, "&", 1, pvExtra);
+                     break;
+                  default:
+                     assert(0);
+               }
             }
-            else 
-               eState = STATE_ERROR;
             break;
 
          default:
             assert(0);
       }
    }
+}
 
-   if (eState == STATE_ERROR)
-      return FALSE;
-   return TRUE;
+/*------------------------------------------------------------------*/
+
+char *lexExpand(const char *pcTemplate, size_t *puLength, 
+                Arena_T oArena)
+
+/* Expand pcTemplate, the value of a word that lexScan() passed with
+   its references unexpanded, as lexScan() would have expanded the
+   word, using the values the variables have now. Return the result,
+   allocated from oArena, and store its length in *puLength, or 
+   return NULL if the word is dropped. It is a checked runtime error
+   for pcTemplate, puLength, or oArena to be NULL. */
+
+/* A template is the unquoted word with each reference written as
+   "${NAME}", each '$' that stands for itself as "$$", and "$\"" 
+   added if the word was quoted, so expanding it needs no lexing. */
+
+{
+   struct SmallArray sBuffer;
+   const char *pc;
+   const char *pcName;
+   const char *pcValue;
+   int iQuoted = FALSE;
+
+   assert(pcTemplate != NULL);
+   assert(puLength != NULL);
+   assert(oArena != NULL);
+
+   SmallArray_init(&sBuffer, 1);
+   for(pc = pcTemplate; *pc != '\0'; pc++)
+   {
+      if(*pc != '$')
+      {
+         (void)SmallArray_add(&sBuffer, pc);
+         continue;
+      }
+      pc++;
+      if(*pc == '"')
+         iQuoted = TRUE;
+      else if(*pc == '$')
+         (void)SmallArray_add(&sBuffer, pc);
+      else
+      {
+         assert(*pc == '{');
+         pcName = pc + 1;
+         pc = strchr(pcName, '}');
+         assert(pc != NULL);
+         pcValue = varGet(pcName, (size_t)(pc - pcName));
+         if(pcValue != NULL)
+            SmallArray_addAll(&sBuffer, pcValue, (int)strlen(pcValue));
+      }
+   }
+
+   if(SmallArray_getLength(&sBuffer) == 0 && !iQuoted)
+   {
+      SmallArray_free(&sBuffer);
+      return NULL;
+   }
+   return finishExpanded(&sBuffer, puLength, oArena);
 }
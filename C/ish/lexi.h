@@ -6,32 +6,49 @@
 #ifndef LEXI_INCLUDED
 #define LEXI_INCLUDED
 
-typedef struct Token *Token_T;
-/* A Token_T is a word, a '<', or a '>', expressed as a string. */
-
-void Token_free(void *pvItem, void *pvExtra);
-/* Free token pvItem. pvExtra is unused. It is a checked runtime
-   error for pvItem to be NULL. */
-
-int Token_getType(void *pvItem, void *pvExtra);
-/* Return the eType of token pvItem. It is a checked runtime
-   error for pvItem to be NULL. */
-
-char *Token_getValue(void *pvItem, void *pvExtra);
-/* Return the pcValue of token pvItem. It is a checked runtime
-   error for pvItem to be NULL. */
-
-int lexLine(const char *pcLine, DynArray_T oTokens, char *pcProgName);
-/* Lexically analyze string pcLine.  Populate oTokens with the 
-   tokens that pcLine contains.  Return TRUE if successful, and FALSE
-   if pcLine contains a lexical error.  In the latter case, oTokens
-   may contain tokens that were discovered before the lexical error.
-   pcProgName is used in printing error messages. It is a checked
-   runtime error for pcLine, oTokens, or pcProgName to be NULL. It 
-   is a checked runtime error for the size of pcLine to be greater
-   than MAX_LINE_SIZE. */
-
-/* lexLine() uses a DFA approach. It "reads" its characters from
-   pcLine. */
+#include <stddef.h>
+
+enum TokenType {TOKEN_WORD, TOKEN_STDIN, TOKEN_STDOUT, TOKEN_PIPE,
+                TOKEN_BACKGROUND, TOKEN_HEREDOC, TOKEN_HERESTRING};
+/* The types of tokens that lexScan() produces: a word, a '<', a 
+   '>', a '|', a '&', a "<<", and a "<<<". */
+
+int lexScan(char *pcLine, size_t uLength, 
+            void (*pfToken)(enum TokenType eType, char *pcValue,
+                            size_t uValueLength, void *pvExtra),
+            void *pvExtra, int iExpand, Arena_T oArena, 
+            char *pcProgName);
+/* Lexically analyze string pcLine, of length uLength, calling 
+   (*pfToken)(eType, pcValue, uValueLength, pvExtra) for each token
+   it contains, in order. If iExpand is TRUE, variable references in
+   words, "$NAME" and "${NAME}", are replaced by the values of the 
+   variables, within quotes as well as outside them; a word that 
+   consists only of unquoted references to unset or empty variables
+   is dropped. NAME may also be a digit, naming a positional 
+   parameter, or '#', their number; see varGet(). If iExpand is 
+   FALSE, the value of a word that contains a '$' is instead a 
+   template, which lexExpand() expands the same way later. The 
+   values of word tokens point into pcLine, which is modified to 
+   terminate and unquote them, or into oArena if they contain a '$',
+   so pcLine must remain unchanged and oArena must not be reset 
+   while the values are in use; each value is terminated before it
+   is passed. Return TRUE if successful, and FALSE if pcLine 
+   contains a lexical error. In the latter case, *pfToken has been 
+   called for the tokens that were discovered before the lexical 
+   error. pcProgName is used in printing error messages. It
+   is a checked runtime error for pcLine, pfToken, oArena, or 
+   pcProgName to be NULL. */
+
+char *lexExpand(const char *pcTemplate, size_t *puLength, 
+                Arena_T oArena);
+/* Expand pcTemplate, the value of a word that lexScan() passed with
+   its references unexpanded, as lexScan() would have expanded the
+   word, using the values the variables have now. Return the result,
+   allocated from oArena, and store its length in *puLength, or 
+   return NULL if the word is dropped. It is a checked runtime error
+   for pcTemplate, puLength, or oArena to be NULL. */
+
+/* lexScan() classifies characters with a table, and skips runs of
+   word characters sixteen at a time where SSE2 is available. */
 
 #endif                      /* LEXI_INCLUDED */
@@ -0,0 +1,122 @@
+/*------------------------------------------------------------------*/
+/* mkhash.c                                                         */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+/* The largest seed tried before the table size is doubled. Seeds 
+   stay within the range of an int, so they fit in an enum. */
+enum {MAX_SEED = 32767};
+
+/*------------------------------------------------------------------*/
+
+/* The names of the builtins, in the order of builtin.def. */
+
+#define BUILTIN(pcName, pfRun, pfAccepts, iMinArg, iMaxArg, pcMissing, \
+                iFlags) \
+   pcName,
+
+static const char *apcNames[] =
+{
+#include "builtin.def"
+};
+
+#undef BUILTIN
+
+enum {NUM_NAMES = sizeof(apcNames) / sizeof(apcNames[0])};
+
+/*------------------------------------------------------------------*/
+
+static unsigned long hashName(const char *pcName, unsigned long ulSeed)
+
+/* Return the FNV-1a hash of pcName, starting from ulSeed, with its
+   high bits folded into the low bits that select a slot. This must
+   match hashName() in builtin.c. */
+
+{
+   unsigned long ulHash = ulSeed ^ 2166136261UL;
+
+   for(; *pcName != '\0'; pcName++)
+      ulHash = ((ulHash ^ (unsigned char)*pcName) * 16777619UL) 
+               & 0xffffffffUL;
+   return ulHash ^ (ulHash >> 16);
+}
+
+/*------------------------------------------------------------------*/
+
+static int tryHash(unsigned long ulSeed, int iSize, int *piSlots)
+
+/* Fill piSlots, an array of iSize slots, with the index of the name
+   that hashes to each slot with seed ulSeed, or -1 for an empty 
+   slot. Return TRUE if no two names hash to the same slot, and 
+   FALSE otherwise. iSize must be a power of 2. */
+
+{
+   int iSlot;
+   int i;
+
+   for(i = 0; i < iSize; i++)
+      piSlots[i] = -1;
+   for(i = 0; i < NUM_NAMES; i++)
+   {
+      iSlot = (int)(hashName(apcNames[i], ulSeed) & (unsigned long)
+                    (iSize - 1));
+      if(piSlots[iSlot] != -1)
+         return FALSE;
+      piSlots[iSlot] = i;
+   }
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+int main(void)
+
+/* Write to stdout a header that defines a perfect hash of the names
+   of the builtins in builtin.def: the seed, the table size, and the
+   index of the builtin in each slot. The table is the smallest power
+   of 2 at least twice the number of builtins for which some seed 
+   works. Return 0. */
+
+{
+   int *piSlots;
+   int iSize = 1;
+   unsigned long ulSeed = 0;
+   int i;
+
+   while(iSize < 2 * NUM_NAMES)
+      iSize *= 2;
+   for(;;)
+   {
+      piSlots = (int*)calloc((size_t)iSize, sizeof(int));
+      assert(piSlots != NULL);
+      for(ulSeed = 0; ulSeed <= MAX_SEED; ulSeed++)
+         if(tryHash(ulSeed, iSize, piSlots))
+            break;
+      if(ulSeed <= MAX_SEED)
+         break;
+      free(piSlots);
+      iSize *= 2;
+   }
+
+   printf("/* Generated by mkhash from builtin.def. Do not edit. */\n\n");
+   printf("enum {BUILTIN_HASH_SEED = %lu, BUILTIN_HASH_SIZE = %d};\n\n",
+          ulSeed, iSize);
+   printf("static const signed char aiBuiltinSlots[BUILTIN_HASH_SIZE]"
+          " =\n{");
+   for(i = 0; i < iSize; i++)
+      printf("%s%s%d", (i == 0) ? "" : ",", 
+             (i % 16 == 0) ? "\n   " : " ", piSlots[i]);
+   printf("\n};\n");
+
+   free(piSlots);
+   return 0;
+}
@@ -0,0 +1,418 @@
+/*------------------------------------------------------------------*/
+/* parallel.c                                                       */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "dynarray.h"
+#include "arena.h"
+#include "parse.h"
+#include "hist.h"
+#include "exec.h"
+#include "util.h"
+#include "parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+/* The greatest exit status parallel reports, as GNU parallel does,
+   so that it is not taken for a signal. */
+enum {MAX_FAILURES = 101};
+
+/* The exit status of a job that SIGINT killed. */
+enum {INTERRUPTED_STATUS = 128 + SIGINT};
+
+enum {MIN_BUFFER_SIZE = 4096};
+
+/* The string in a command that stands for the item. */
+#define PLACEHOLDER "{}"
+
+/*------------------------------------------------------------------*/
+
+/* A Parallel is one run of the parallel builtin. */
+
+struct Parallel
+{
+   /* The command and its arguments, with placeholders, followed by
+      NULL. */
+   char **ppcTemplate;
+   int iNumWords;
+
+   /* TRUE iff some word of ppcTemplate contains PLACEHOLDER. */
+   int iHasPlaceholder;
+
+   /* The items, each a char*. */
+   DynArray_T oItems;
+
+   /* The file that holds the stdout of each job, or -1 if the job 
+      has not started or its output has been written. */
+   int *piOutFds;
+
+   /* TRUE for each job that has exited. */
+   char *pcDone;
+
+   /* The jobs running, as pids and job indices, with -1 for free 
+      slots. */
+   pid_t *piPids;
+   int *piJobs;
+   int iMaxJobs;
+
+   /* Where the job arrays and Commands are allocated. */
+   Arena_T oArena;
+};
+
+/*------------------------------------------------------------------*/
+
+static char *substitute(const char *pcWord, const char *pcItem,
+                        Arena_T oArena)
+
+/* Return a copy of pcWord, allocated from oArena, in which each 
+   PLACEHOLDER is replaced by pcItem. */
+
+{
+   const char *pc;
+   const char *pcFound;
+   char *pcResult;
+   char *pcOut;
+   size_t uItemLength;
+   size_t uLength;
+
+   uItemLength = strlen(pcItem);
+   uLength = strlen(pcWord);
+   for(pc = pcWord; (pcFound = strstr(pc, PLACEHOLDER)) != NULL; 
+       pc = pcFound + 2)
+      uLength = uLength - 2 + uItemLength;
+
+   pcResult = (char*)Arena_alloc(oArena, uLength + 1);
+   pcOut = pcResult;
+   for(pc = pcWord; (pcFound = strstr(pc, PLACEHOLDER)) != NULL; 
+       pc = pcFound + 2)
+   {
+      memcpy(pcOut, pc, (size_t)(pcFound - pc));
+      pcOut += pcFound - pc;
+      memcpy(pcOut, pcItem, uItemLength);
+      pcOut += uItemLength;
+   }
+   strcpy(pcOut, pc);
+   return pcResult;
+}
+
+/*------------------------------------------------------------------*/
+
+static Command_T makeCommand(struct Parallel *psRun, const char *pcItem)
+
+/* Return the Command that runs the template of psRun on pcItem, 
+   allocated from the arena of psRun. */
+
+{
+   Command_T oCommand;
+   char **ppcArray;
+   int iLength;
+   int i;
+
+   iLength = psRun->iNumWords + (psRun->iHasPlaceholder ? 0 : 1);
+   ppcArray = (char**)Arena_alloc(psRun->oArena, 
+                                  (size_t)(iLength + 1) * sizeof(char*));
+   for(i = 0; i < psRun->iNumWords; i++)
+      ppcArray[i] = substitute(psRun->ppcTemplate[i], pcItem, 
+                               psRun->oArena);
+   if(!psRun->iHasPlaceholder)
+      ppcArray[i] = Arena_strdup(psRun->oArena, pcItem);
+   ppcArray[iLength] = NULL;
+
+   oCommand = Command_new(psRun->oArena);
+   Command_setArray(oCommand, ppcArray, iLength - 1);
+   return oCommand;
+}
+
+/*------------------------------------------------------------------*/
+
+static int readItems(DynArray_T oItems, Arena_T oArena, 
+                     char *pcProgName)
+
+/* Add each nonempty line of stdin to oItems, as a string allocated
+   from oArena. Return TRUE if successful, and FALSE otherwise; print
+   an error message to stderr in that case. */
+
+/* stdin is read with read(), since the stdio buffer of stdin holds
+   the shell's own input. */
+
+{
+   char *pcBuffer;
+   char *pcLine;
+   char *pcEnd;
+   size_t uSize = MIN_BUFFER_SIZE;
+   size_t uLength = 0;
+   ssize_t lRead;
+
+   pcBuffer = (char*)malloc(uSize);
+   assert(pcBuffer != NULL);
+   for(;;)
+   {
+      if(uLength == uSize)
+      {
+         uSize *= 2;
+         pcBuffer = (char*)realloc(pcBuffer, uSize);
+         assert(pcBuffer != NULL);
+      }
+      lRead = read(0, pcBuffer + uLength, uSize - uLength);
+      if(lRead == 0)
+         break;
+      if(lRead == -1 && errno == EINTR)
+         continue;
+      if(lRead == -1)
+      {
+         fprintf(stderr, "%s: parallel: ", pcProgName);
+         perror("stdin");
+         free(pcBuffer);
+         return FALSE;
+      }
+      uLength += (size_t)lRead;
+   }
+
+   for(pcLine = pcBuffer; pcLine < pcBuffer + uLength; pcLine = pcEnd + 1)
+   {
+      pcEnd = (char*)memchr(pcLine, '\n', 
+                            (size_t)(pcBuffer + uLength - pcLine));
+      if(pcEnd == NULL)
+         pcEnd = pcBuffer + uLength;
+      if(pcEnd == pcLine)
+         continue;
+      *pcEnd = '\0';
+      DynArray_add(oItems, Arena_strdup(oArena, pcLine));
+   }
+   free(pcBuffer);
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static void startJob(struct Parallel *psRun, int iJob, 
+                     History_T oHistList, char *pcProgName)
+
+/* Start job iJob of psRun in a free slot, with its stdout written to
+   a new anonymous file. */
+
+{
+   int iFd;
+   int iSlot;
+
+   for(iSlot = 0; psRun->piPids[iSlot] != -1; iSlot++)
+      assert(iSlot < psRun->iMaxJobs);
+
+   iFd = memfd_create("parallel", MFD_CLOEXEC);
+   if(iFd == -1)
+   {
+      perror(pcProgName);
+      exit(EXIT_FAILURE);
+   }
+   psRun->piOutFds[iJob] = iFd;
+   psRun->piPids[iSlot] = executeStart(
+      makeCommand(psRun, (char*)DynArray_get(psRun->oItems, iJob)),
+      iFd, oHistList, pcProgName);
+   psRun->piJobs[iSlot] = iJob;
+}
+
+/*------------------------------------------------------------------*/
+
+static void writeOutput(struct Parallel *psRun, int iJob, 
+                        char *pcProgName)
+
+/* Write the stdout of the finished job iJob of psRun to stdout, and
+   close the file that held it. */
+
+{
+   int iFd;
+
+   iFd = psRun->piOutFds[iJob];
+   if(lseek(iFd, 0, SEEK_SET) == -1 || utilCopyFd(iFd, 1) == -1)
+   {
+      fprintf(stderr, "%s: parallel: ", pcProgName);
+      perror("stdout");
+   }
+   (void)close(iFd);
+   psRun->piOutFds[iJob] = -1;
+}
+
+/*------------------------------------------------------------------*/
+
+static int getMaxJobs(const char *pcArg, char *pcProgName)
+
+/* Return the number of jobs that pcArg gives, or 0 if it is not a
+   positive integer; print an error message to stderr in that 
+   case. */
+
+{
+   char *pcEnd;
+   long lJobs;
+
+   errno = 0;
+   lJobs = strtol(pcArg, &pcEnd, 10);
+   if(*pcArg == '\0' || *pcEnd != '\0' || errno != 0 || lJobs <= 0 ||
+      lJobs > 4096)
+   {
+      fprintf(stderr, "%s: parallel: %s: Invalid number of jobs\n",
+              pcProgName, pcArg);
+      return 0;
+   }
+   return (int)lJobs;
+}
+
+/*------------------------------------------------------------------*/
+
+static int runJobs(struct Parallel *psRun, History_T oHistList,
+                   char *pcProgName)
+
+/* Run every job of psRun, at most psRun->iMaxJobs at a time, writing
+   the output of each in order once it and all before it have 
+   finished. Return the number of jobs that failed or were not 
+   started. */
+
+/* A job that SIGINT killed stops new jobs from starting, so ^C 
+   interrupts the whole run. */
+
+{
+   int iNumJobs;
+   int iNext = 0;
+   int iNextOut = 0;
+   int iRunning = 0;
+   int iInterrupted = FALSE;
+   int iFailures = 0;
+   int iSlot;
+   int iStatus;
+
+   iNumJobs = DynArray_getLength(psRun->oItems);
+   while(iNextOut < iNumJobs)
+   {
+      while(!iInterrupted && iRunning < psRun->iMaxJobs && 
+            iNext < iNumJobs)
+      {
+         startJob(psRun, iNext++, oHistList, pcProgName);
+         iRunning++;
+      }
+      if(iRunning == 0)
+         break;
+
+      iSlot = executeWaitAny(psRun->piPids, psRun->iMaxJobs, &iStatus,
+                             pcProgName);
+      psRun->pcDone[psRun->piJobs[iSlot]] = TRUE;
+      psRun->piPids[iSlot] = -1;
+      iRunning--;
+      if(iStatus != 0)
+         iFailures++;
+      if(iStatus == INTERRUPTED_STATUS)
+         iInterrupted = TRUE;
+
+      while(iNextOut < iNext && psRun->pcDone[iNextOut])
+         writeOutput(psRun, iNextOut++, pcProgName);
+   }
+   return iFailures + iNumJobs - iNext;
+}
+
+/*------------------------------------------------------------------*/
+
+int parallelRun(char **ppcArray, int iNumArg, History_T oHistList,
+                char *pcProgName)
+
+/* Run the builtin "parallel [-j N] command [argument...] ::: 
+   item...", which runs the command once per item with at most N 
+   jobs at a time, N being the number of processors by default. Each
+   "{}" in the command and its arguments is replaced by the item, or
+   the item is appended if there is no "{}". Without ":::", the 
+   items are the nonempty lines of stdin. The stdout of each job is
+   written to stdout whole, in the order of the items. Return the 
+   number of jobs that failed or were not started, at most 101. 
+   pcProgName is used in printing error messages. It is a checked 
+   runtime error for ppcArray, oHistList, or pcProgName to be 
+   NULL. */
+
+{
+   struct Parallel sRun;
+   int iFirst = 1;
+   int iSeparator;
+   int iNumJobs;
+   int iFailures;
+   int i;
+
+   assert(ppcArray != NULL);
+   assert(oHistList != NULL);
+   assert(pcProgName != NULL);
+
+   memset(&sRun, 0, sizeof(sRun));
+   sRun.iMaxJobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   if(sRun.iMaxJobs <= 0)
+      sRun.iMaxJobs = 1;
+   if(iNumArg >= 1 && strncmp(ppcArray[1], "-j", 2) == 0)
+   {
+      if(ppcArray[1][2] != '\0')
+         sRun.iMaxJobs = getMaxJobs(ppcArray[1] + 2, pcProgName);
+      else if(iNumArg >= 2)
+         sRun.iMaxJobs = getMaxJobs(ppcArray[++iFirst], pcProgName);
+      else
+         sRun.iMaxJobs = getMaxJobs("", pcProgName);
+      if(sRun.iMaxJobs == 0)
+         return EXIT_FAILURE;
+      iFirst++;
+   }
+
+   for(iSeparator = iFirst; iSeparator <= iNumArg; iSeparator++)
+      if(strcmp(ppcArray[iSeparator], ":::") == 0)
+         break;
+   if(iSeparator == iFirst)
+   {
+      fprintf(stderr, "%s: parallel: Missing command\n", pcProgName);
+      return EXIT_FAILURE;
+   }
+   sRun.ppcTemplate = &ppcArray[iFirst];
+   sRun.iNumWords = iSeparator - iFirst;
+   for(i = 0; i < sRun.iNumWords; i++)
+      if(strstr(sRun.ppcTemplate[i], PLACEHOLDER) != NULL)
+         sRun.iHasPlaceholder = TRUE;
+
+   sRun.oArena = Arena_new();
+   sRun.oItems = DynArray_new(0);
+   if(iSeparator <= iNumArg)
+      for(i = iSeparator + 1; i <= iNumArg; i++)
+         DynArray_add(sRun.oItems, ppcArray[i]);
+   else if(!readItems(sRun.oItems, sRun.oArena, pcProgName))
+   {
+      DynArray_free(sRun.oItems);
+      Arena_free(sRun.oArena);
+      return EXIT_FAILURE;
+   }
+
+   iNumJobs = DynArray_getLength(sRun.oItems);
+   if(sRun.iMaxJobs > iNumJobs)
+      sRun.iMaxJobs = (iNumJobs > 0) ? iNumJobs : 1;
+   sRun.piOutFds = (int*)Arena_alloc(sRun.oArena, 
+                                     (size_t)iNumJobs * sizeof(int));
+   sRun.pcDone = (char*)Arena_alloc(sRun.oArena, (size_t)iNumJobs);
+   memset(sRun.pcDone, FALSE, (size_t)iNumJobs);
+   sRun.piPids = (pid_t*)Arena_alloc(sRun.oArena, 
+                                     (size_t)sRun.iMaxJobs * sizeof(pid_t));
+   sRun.piJobs = (int*)Arena_alloc(sRun.oArena, 
+                                   (size_t)sRun.iMaxJobs * sizeof(int));
+   for(i = 0; i < sRun.iMaxJobs; i++)
+      sRun.piPids[i] = -1;
+
+   /* The jobs' output is copied below the stdout buffer. */
+   fflush(stdout);
+   iFailures = runJobs(&sRun, oHistList, pcProgName);
+   if(iFailures > 0)
+      fprintf(stderr, "%s: parallel: %d of %d jobs failed\n", 
+              pcProgName, iFailures, iNumJobs);
+
+   DynArray_free(sRun.oItems);
+   Arena_free(sRun.oArena);
+   return (iFailures > MAX_FAILURES) ? MAX_FAILURES : iFailures;
+}
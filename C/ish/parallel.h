@@ -0,0 +1,23 @@
+/*------------------------------------------------------------------*/
+/* parallel.h                                                       */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef PARALLEL_INCLUDED
+#define PARALLEL_INCLUDED
+
+int parallelRun(char **ppcArray, int iNumArg, History_T oHistList,
+                char *pcProgName);
+/* Run the builtin "parallel [-j N] command [argument...] ::: 
+   item...", which runs the command once per item with at most N 
+   jobs at a time, N being the number of processors by default. Each
+   "{}" in the command and its arguments is replaced by the item, or
+   the item is appended if there is no "{}". Without ":::", the 
+   items are the nonempty lines of stdin. The stdout of each job is
+   written to stdout whole, in the order of the items. Return the 
+   number of jobs that failed or were not started, at most 101. 
+   pcProgName is used in printing error messages. It is a checked 
+   runtime error for ppcArray, oHistList, or pcProgName to be 
+   NULL. */
+
+#endif                      /* PARALLEL_INCLUDED */
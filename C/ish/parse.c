@@ -4,6 +4,7 @@
 /* -----------------------------------------------------------------*/
 
 #include "dynarray.h"
+#include "arena.h"
 #include "parse.h"
 #include "lexi.h"
 #include <ctype.h>
@@ -16,8 +17,6 @@
 
 enum {FALSE, TRUE};
 
-enum TokenType {TOKEN_WORD, TOKEN_STDIN, TOKEN_STDOUT};
-
 /*------------------------------------------------------------------*/
 
 /* A Command consists of a command name, a list of arguments, an 
@@ -41,6 +40,17 @@ struct Command
    /* The stream to which stdin should be redirected. */
    char *pcStdin;   
 
+   /* The text that stdin should be redirected from, given by a 
+      here-string or a here-document, and its length. It is NULL if
+      there is none, or if the body of the here-document has not 
+      been read yet. */
+   char *pcHere;
+   size_t uHereLength;
+
+   /* The delimiter of the here-document whose body has not been 
+      read yet, or NULL if there is none. */
+   char *pcHereEnd;
+
    /* The stream to which stdout should be redirected. */
    char *pcStdout;   
 
@@ -48,46 +58,31 @@ struct Command
 
 /*------------------------------------------------------------------*/
 
-Command_T Command_new(void)
+Command_T Command_new(Arena_T oArena)
 
 /* Create and return a Command whose oCommand, pcStdin, and pcStdout
-   all point to NULL. */
+   all point to NULL, allocated from oArena. */
 
 {
    Command_T oCommand;
 
-   oCommand = (struct Command*)malloc(sizeof(struct Command));
-   assert(oCommand != NULL);
+   assert(oArena != NULL);
 
+   oCommand = (struct Command*)Arena_alloc(oArena, 
+                                           sizeof(struct Command));
    oCommand->ppcArray = NULL;
    oCommand->iNumArg = 0;
    oCommand->pcStdin = NULL;
    oCommand->pcStdout = NULL;
+   oCommand->pcHere = NULL;
+   oCommand->uHereLength = 0;
+   oCommand->pcHereEnd = NULL;
 
    return oCommand;
 }
 
 /*------------------------------------------------------------------*/
 
-void Command_free(void *pvItem, void *pvExtra)
-
-/* Free command pvItem. pvExtra is unused. It is a checked
-   runtime error for pvItem to be NULL. */
-
-{
-   struct Command *psCommand;
-
-   assert(pvItem != NULL);
-
-   psCommand = (struct Command*)pvItem;
-   free(psCommand->ppcArray);
-   free(psCommand->pcStdin);
-   free(psCommand->pcStdout);
-   free(psCommand);
-}
-
-/*------------------------------------------------------------------*/
-
 char **Command_getArray(void *pvItem, void *pvExtra)
 
 /* Return the ppcArray pointed to by command pvItem. pvExtra is 
@@ -153,134 +148,508 @@ char *Command_getStdout(void *pvItem, void *pvExtra)
 
 /*------------------------------------------------------------------*/
 
-static char **toCharArray(DynArray_T oTokens)
+char *Command_getHere(void *pvItem, size_t *puLength)
 
-/* Return an array of char pointers consisting of the token value of
-   each token in oTokens. It is a checked runtime error for oTokens
-   to be NULL. */
+/* Return the text that the stdin of command pvItem is redirected 
+   from by a here-string or a here-document, and store its length in
+   *puLength, or return NULL if there is none. It is a checked 
+   runtime error for pvItem or puLength to be NULL. */
 
 {
-   char *pcValue;
-   char **ppcArray;
-   DynArray_T oTemp;
-   int i;
-   int iLength;
-   void *pvToken;
-   
-   assert(oTokens != NULL);
+   struct Command *psCommand;
 
-   oTemp = DynArray_new(0);
-   for(i = 0; i < DynArray_getLength(oTokens); i++)
-   {
-      pvToken = DynArray_get(oTokens, i);
-      pcValue = Token_getValue(pvToken, NULL);
-      DynArray_add(oTemp, pcValue);
-   }
+   assert(pvItem != NULL);
+   assert(puLength != NULL);
+
+   psCommand = (struct Command*)pvItem;
+   *puLength = psCommand->uHereLength;
+   return psCommand->pcHere;
+}
+
+/*------------------------------------------------------------------*/
+
+char *Command_getHereEnd(void *pvItem, void *pvExtra)
+
+/* Return the delimiter of the here-document of command pvItem whose
+   body has not been read yet, or NULL if there is none. pvExtra is 
+   unused. It is a checked runtime error for pvItem to be NULL. */
+
+{
+   struct Command *psCommand;
+
+   assert(pvItem != NULL);
+
+   psCommand = (struct Command*)pvItem;
+   return psCommand->pcHereEnd;
+}
+
+/*------------------------------------------------------------------*/
+
+void Command_setHere(Command_T oCommand, char *pcText, 
+                     size_t uLength)
+
+/* Make pcText, of length uLength, the body of the here-document of
+   oCommand, which has then been read. pcText must remain valid as 
+   long as oCommand is used. It is a checked runtime error for 
+   oCommand or pcText to be NULL. It is a checked runtime error for
+   oCommand to have no here-document whose body is unread. */
+
+{
+   assert(oCommand != NULL);
+   assert(pcText != NULL);
+   assert(oCommand->pcHereEnd != NULL);
+
+   oCommand->pcHere = pcText;
+   oCommand->uHereLength = uLength;
+   oCommand->pcHereEnd = NULL;
+}
 
-   iLength = DynArray_getLength(oTemp);
-   ppcArray = (char**)calloc((size_t)iLength + 1, sizeof(char*));
+/*------------------------------------------------------------------*/
+
+void Command_setRedirections(Command_T oCommand, char *pcStdin,
+                             char *pcHere, size_t uHereLength,
+                             char *pcStdout)
+
+/* Make the stdin of oCommand redirected from the stream pcStdin, or
+   from the text pcHere of length uHereLength, and its stdout 
+   redirected to the stream pcStdout, each only if it is not NULL, 
+   and make oCommand have no here-document whose body is unread. The
+   strings must remain valid as long as oCommand is used. It is a 
+   checked runtime error for oCommand to be NULL. It is a checked 
+   runtime error for pcStdin and pcHere to both not be NULL. */
+
+{
+   assert(oCommand != NULL);
+   assert(pcStdin == NULL || pcHere == NULL);
+
+   oCommand->pcStdin = pcStdin;
+   oCommand->pcHere = pcHere;
+   oCommand->uHereLength = (pcHere == NULL) ? 0 : uHereLength;
+   oCommand->pcHereEnd = NULL;
+   oCommand->pcStdout = pcStdout;
+}
+
+/*------------------------------------------------------------------*/
+
+void Command_setArray(Command_T oCommand, char **ppcArray, 
+                      int iNumArg)
+
+/* Make ppcArray, whose first element is a command name followed by
+   iNumArg arguments and NULL, the ppcArray of oCommand. ppcArray 
+   must remain valid as long as oCommand is used. It is a checked 
+   runtime error for oCommand or ppcArray to be NULL. It is a checked
+   runtime error for iNumArg to be negative. */
+
+{
+   assert(oCommand != NULL);
    assert(ppcArray != NULL);
-   DynArray_toArray(oTemp, (void**)ppcArray);
-   ppcArray[iLength] = NULL;
-   DynArray_free(oTemp);
-   return ppcArray;
+   assert(iNumArg >= 0);
+   assert(ppcArray[iNumArg + 1] == NULL);
+
+   oCommand->ppcArray = ppcArray;
+   oCommand->iNumArg = iNumArg;
+}
+/*------------------------------------------------------------------*/
+
+void Command_removeName(Command_T oCommand)
+
+/* Remove the command name from the ppcArray of oCommand, so that its
+   first argument becomes its command name. It is a checked runtime
+   error for oCommand to be NULL. It is a checked runtime error for
+   oCommand to have no arguments. */
+
+{
+   assert(oCommand != NULL);
+   assert(oCommand->iNumArg > 0);
+
+   oCommand->ppcArray++;
+   oCommand->iNumArg--;
 }
 
 /*------------------------------------------------------------------*/
 
-int parseToken(const DynArray_T oTokens, Command_T oCommand, 
-               char *pcProgName)
+static const char *getStdinError(enum TokenType eType)
 
-/* Syntactically analyze oTokens. Make command point to a newly 
-   created command that corresponds to oTokens. Return TRUE if 
-   successful, and FALSE if oTokens contains a syntactical error.  
-   In the latter case, print an error to stderr. pcProgName is used
-   in printing error messages.
-   It is a checked runtime error for oTokens, oCommand, and pcProgName
-   to be NULL. */
+/* Return the error message for a redirection of stdin of type eType
+   that is not followed by a word. */
 
 {
-   int i = 0;
-   char **ppcArray;
-   struct Token *psToken;
-   struct Token *psNextToken;
+   if(eType == TOKEN_HEREDOC)
+      return "Here-document without delimiter";
+   if(eType == TOKEN_HERESTRING)
+      return "Here-string without word";
+   return "Standard input redirection without file name";
+}
+
+/*------------------------------------------------------------------*/
+
+static int setStdin(Command_T oCommand, enum TokenType eType,
+                    char *pcWord, size_t uLength, Arena_T oArena)
 
-   assert(oTokens != NULL);
+/* Redirect the stdin of oCommand as the redirection of type eType,
+   followed by pcWord of length uLength, says: from the file pcWord,
+   from the here-document delimited by pcWord, or from pcWord and a
+   newline. Allocate the latter from oArena. Return TRUE if 
+   successful, and FALSE if stdin of oCommand is already redirected.
+   It is a checked runtime error for oCommand, pcWord, or oArena to
+   be NULL. */
+
+{
    assert(oCommand != NULL);
-   assert(pcProgName != NULL);
+   assert(pcWord != NULL);
+   assert(oArena != NULL);
 
-   psToken = (struct Token*)DynArray_get(oTokens, i);
-   if(Token_getType(psToken, NULL) != TOKEN_WORD)
-   {
-      fprintf(stderr, "%s: Missing command name\n", pcProgName);
+   if(oCommand->pcStdin != NULL || oCommand->pcHere != NULL ||
+      oCommand->pcHereEnd != NULL)
       return FALSE;
+   if(eType == TOKEN_HEREDOC)
+      oCommand->pcHereEnd = pcWord;
+   else if(eType == TOKEN_HERESTRING)
+   {
+      oCommand->pcHere = (char*)Arena_alloc(oArena, uLength + 2);
+      memcpy(oCommand->pcHere, pcWord, uLength);
+      oCommand->pcHere[uLength] = '\n';
+      oCommand->pcHere[uLength + 1] = '\0';
+      oCommand->uHereLength = uLength + 1;
    }
+   else
+      oCommand->pcStdin = pcWord;
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static int checkRedirections(DynArray_T oCommands, char *pcProgName)
+
+/* Return TRUE if only the first Command in oCommands redirects 
+   stdin and only the last redirects stdout, and FALSE otherwise. In 
+   the latter case, print an error to stderr. pcProgName is used in 
+   printing error messages. It is a checked runtime error for 
+   oCommands or pcProgName to be NULL. */
+
+/* Only the first stage reads from a file, and only the last stage 
+   writes to one. The others are connected by pipes. */
+
+{
+   int i;
+   int iNumStages;
+   Command_T oCommand;
+
+   assert(oCommands != NULL);
+   assert(pcProgName != NULL);
 
-   for(i = 1; i < DynArray_getLength(oTokens); i++)
+   iNumStages = DynArray_getLength(oCommands);
+   for(i = 0; i < iNumStages; i++)
    {
-      psToken = (struct Token*)(DynArray_get(oTokens, i));
-      if(Token_getType(psToken, NULL) == TOKEN_STDIN)
+      oCommand = (Command_T)DynArray_get(oCommands, i);
+      if(i > 0 && (oCommand->pcStdin != NULL || 
+                   oCommand->pcHere != NULL || 
+                   oCommand->pcHereEnd != NULL))
       {
-         (void)DynArray_removeAt(oTokens, i);
-         Token_free(psToken, NULL);
-         if(i == DynArray_getLength(oTokens))
-         {
-            fprintf(stderr, "%s: Standard input ", pcProgName);
-            fprintf(stderr, "redirection without file name\n");
-            return FALSE;
-         }
-         psNextToken = (struct Token*)DynArray_removeAt(oTokens, i);
-         if(Token_getType(psNextToken, NULL) != TOKEN_WORD)
-         {
-            fprintf(stderr, "%s: Standard input ", pcProgName);
-            fprintf(stderr, "redirection without file name\n");
-            Token_free(psNextToken, NULL);
-            return FALSE;
-         }
-         if(oCommand->pcStdin != NULL)
-         {
-            fprintf(stderr, "%s: Multiple redirection of ", pcProgName);
-            fprintf(stderr, "standard input\n");
-            Token_free(psNextToken, NULL);
-            return FALSE;
-         }
-         oCommand->pcStdin = Token_getValue(psNextToken, NULL);
-         free(psNextToken);
-         i--;
+         fprintf(stderr, "%s: Ambiguous input redirection\n", 
+                 pcProgName);
+         return FALSE;
       }
-      else if(Token_getType(psToken, NULL) == TOKEN_STDOUT)
+      if(oCommand->pcStdout != NULL && i < iNumStages - 1)
       {
-         (void)DynArray_removeAt(oTokens, i);
-         Token_free(psToken, NULL);
-         if(i == DynArray_getLength(oTokens))
-         {
-            fprintf(stderr, "%s: Standard output ", pcProgName);
-            fprintf(stderr, "redirection without file name\n");
-            return FALSE;
-         }
-         psNextToken = (struct Token*)DynArray_removeAt(oTokens, i);
-         if(Token_getType(psNextToken, NULL) != TOKEN_WORD)
+         fprintf(stderr, "%s: Ambiguous output redirection\n", 
+                 pcProgName);
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+/* The state of parseLine() between tokens. */
+
+struct LineParser
+{
+   /* The Commands made so far, and where they are allocated from. */
+   DynArray_T oCommands;
+   Arena_T oArena;
+
+   /* The Command of the current stage, or NULL if there is none. */
+   Command_T oCommand;
+
+   /* The first element of the current stage's array, and the next 
+      free element, in an array allocated once for the whole line. */
+   char **ppcStage;
+   char **ppcNext;
+
+   /* The number of tokens in the line, and in the current stage. */
+   int iNumTokens;
+   int iNumStageTokens;
+
+   /* The type of the last token if it was a redirection, which 
+      awaits its word, and TOKEN_WORD otherwise. */
+   enum TokenType eRedirect;
+
+   /* TRUE iff the last token was a '&'. */
+   int iBackground;
+
+   /* The first error in the current stage, reported when the stage
+      ends, and the first error in the line. Both are NULL if there
+      is none. */
+   const char *pcStageError;
+   const char *pcError;
+};
+
+/*------------------------------------------------------------------*/
+
+static void setStageError(struct LineParser *psParser,
+                          const char *pcError)
+
+/* Record pcError as the error of the current stage of psParser, 
+   unless the stage already has one. */
+
+{
+   assert(psParser != NULL);
+   assert(pcError != NULL);
+
+   if(psParser->pcStageError == NULL)
+      psParser->pcStageError = pcError;
+}
+
+/*------------------------------------------------------------------*/
+
+static void endStage(struct LineParser *psParser)
+
+/* End the current stage of psParser: report its error, if any, or 
+   terminate its array and give the array to its Command. */
+
+{
+   int iNumWords;
+
+   assert(psParser != NULL);
+   assert(psParser->oCommand != NULL);
+
+   if(psParser->pcError != NULL)
+      return;
+   if(psParser->iNumStageTokens == 0)
+      setStageError(psParser, "Missing command name");
+   else if(psParser->eRedirect == TOKEN_STDOUT)
+      setStageError(psParser,
+                    "Standard output redirection without file name");
+   else if(psParser->eRedirect != TOKEN_WORD)
+      setStageError(psParser, getStdinError(psParser->eRedirect));
+   if(psParser->pcStageError != NULL)
+   {
+      psParser->pcError = psParser->pcStageError;
+      return;
+   }
+
+   iNumWords = (int)(psParser->ppcNext - psParser->ppcStage);
+   *psParser->ppcNext++ = NULL;
+   Command_setArray(psParser->oCommand, psParser->ppcStage, 
+                    iNumWords - 1);
+}
+
+/*------------------------------------------------------------------*/
+
+static void beginStage(struct LineParser *psParser)
+
+/* Begin a new stage of psParser, with a new Command whose array 
+   starts at the next free element. */
+
+{
+   assert(psParser != NULL);
+
+   psParser->oCommand = Command_new(psParser->oArena);
+   DynArray_add(psParser->oCommands, psParser->oCommand);
+   psParser->ppcStage = psParser->ppcNext;
+   psParser->iNumStageTokens = 0;
+   psParser->eRedirect = TOKEN_WORD;
+   psParser->pcStageError = NULL;
+}
+
+/*------------------------------------------------------------------*/
+
+static void parseToken(enum TokenType eType, char *pcValue,
+                       size_t uValueLength, void *pvExtra)
+
+/* Add the token whose type is eType and whose value is pcValue, of 
+   length uValueLength, to the Commands of LineParser pvExtra. */
+
+/* Errors are recorded rather than printed, since a lexical error 
+   later in the line takes precedence. Only the first is reported: 
+   an error within a stage when the stage ends, and a misplaced '&'
+   when the token after it arrives. */
+
+{
+   struct LineParser *psParser = (struct LineParser*)pvExtra;
+
+   assert(psParser != NULL);
+   assert(pcValue != NULL);
+
+   psParser->iNumTokens++;
+   if(psParser->pcError != NULL)
+      return;
+   if(psParser->iBackground)
+   {
+      psParser->pcError = "Background operator not at end of command";
+      return;
+   }
+   if(psParser->oCommand == NULL)
+      beginStage(psParser);
+
+   if(psParser->iNumStageTokens++ == 0 && eType != TOKEN_WORD &&
+      eType != TOKEN_PIPE && eType != TOKEN_BACKGROUND)
+      setStageError(psParser, "Missing command name");
+
+   switch(eType)
+   {
+      case TOKEN_WORD:
+         if(psParser->eRedirect == TOKEN_STDIN ||
+            psParser->eRedirect == TOKEN_HEREDOC ||
+            psParser->eRedirect == TOKEN_HERESTRING)
          {
-            fprintf(stderr, "%s: Standard output ", pcProgName);
-            fprintf(stderr, "redirection without file name\n");
-            Token_free(psNextToken, NULL);
-            return FALSE;
+            if(!setStdin(psParser->oCommand, psParser->eRedirect,
+                         pcValue, uValueLength, psParser->oArena))
+               setStageError(psParser,
+                             "Multiple redirection of standard input");
          }
-         if(oCommand->pcStdout != NULL)
+         else if(psParser->eRedirect == TOKEN_STDOUT)
          {
-            fprintf(stderr, "%s: Multiple redirection of ", pcProgName);
-            fprintf(stderr, "standard output\n");
-            Token_free(psNextToken, NULL);
-            return FALSE;
+            if(psParser->oCommand->pcStdout != NULL)
+               setStageError(psParser,
+                             "Multiple redirection of standard output");
+            psParser->oCommand->pcStdout = pcValue;
          }
-         oCommand->pcStdout = Token_getValue(psNextToken, NULL);
-         free(psNextToken);
-         i--;
-      }
+         else
+            *psParser->ppcNext++ = pcValue;
+         psParser->eRedirect = TOKEN_WORD;
+         break;
+
+      case TOKEN_STDIN:
+      case TOKEN_STDOUT:
+      case TOKEN_HEREDOC:
+      case TOKEN_HERESTRING:
+         if(psParser->eRedirect == TOKEN_STDOUT)
+            setStageError(psParser,
+                          "Standard output redirection without file name");
+         else if(psParser->eRedirect != TOKEN_WORD)
+            setStageError(psParser, getStdinError(psParser->eRedirect));
+         psParser->eRedirect = eType;
+         break;
+
+      case TOKEN_PIPE:
+         /* The '|' itself belongs to neither stage. */
+         psParser->iNumStageTokens--;
+         endStage(psParser);
+         beginStage(psParser);
+         break;
+
+      case TOKEN_BACKGROUND:
+         psParser->iNumStageTokens--;
+         psParser->iBackground = TRUE;
+         break;
+
+      default:
+         assert(0);
    }
+}
 
-   ppcArray = toCharArray(oTokens);
-   oCommand->ppcArray = ppcArray;
-   oCommand->iNumArg = DynArray_getLength(oTokens) - 1;
-   return TRUE;
+/*------------------------------------------------------------------*/
+
+static int parseWith(char *pcLine, size_t uLength, 
+                     DynArray_T oCommands, int *piBackground,
+                     int *piNumTokens, int iExpand, Arena_T oArena,
+                     char *pcProgName)
+
+/* Do what parseLine() does, expanding variable references iff 
+   iExpand is TRUE, as lexScan() does. */
+
+/* The words are written straight into one array of pointers, 
+   allocated for the whole line before lexing begins, and each stage
+   takes the next run of it, ended by NULL. A line of uLength 
+   characters holds at most uLength words and '|'s together, so 
+   uLength + 1 elements hold every word and one NULL per stage. No 
+   tokens are made, and nothing is moved once written. */
+
+{
+   struct LineParser sParser;
+   int iSuccessful;
+
+   assert(pcLine != NULL);
+   assert(oCommands != NULL);
+   assert(piBackground != NULL);
+   assert(piNumTokens != NULL);
+   assert(oArena != NULL);
+   assert(pcProgName != NULL);
+
+   sParser.oCommands = oCommands;
+   sParser.oArena = oArena;
+   sParser.oCommand = NULL;
+   sParser.ppcNext = (char**)Arena_alloc(oArena, 
+                                         (uLength + 1) * sizeof(char*));
+   sParser.ppcStage = sParser.ppcNext;
+   sParser.iNumTokens = 0;
+   sParser.iNumStageTokens = 0;
+   sParser.eRedirect = TOKEN_WORD;
+   sParser.iBackground = FALSE;
+   sParser.pcStageError = NULL;
+   sParser.pcError = NULL;
+
+   iSuccessful = lexScan(pcLine, uLength, parseToken, &sParser,
+                         iExpand, oArena, pcProgName);
+   *piNumTokens = sParser.iNumTokens;
+   *piBackground = sParser.iBackground;
+   if(!iSuccessful)
+      return FALSE;
+   if(sParser.iNumTokens == 0)
+      return TRUE;
+
+   endStage(&sParser);
+   if(sParser.pcError != NULL)
+   {
+      fprintf(stderr, "%s: %s\n", pcProgName, sParser.pcError);
+      return FALSE;
+   }
+   return checkRedirections(oCommands, pcProgName);
+}
+
+/*------------------------------------------------------------------*/
+
+int parseLine(char *pcLine, size_t uLength, DynArray_T oCommands,
+              int *piBackground, int *piNumTokens, Arena_T oArena,
+              char *pcProgName)
+
+/* Lexically and syntactically analyze string pcLine, of length 
+   uLength, in one pass. Populate oCommands with one newly created 
+   Command per pipeline stage, in order, allocated from oArena. Set
+   *piBackground to TRUE if the pipeline ends with '&' and to FALSE 
+   otherwise, and *piNumTokens to the number of tokens in pcLine. 
+   The body of a here-document is not read; see Command_getHereEnd().
+   Return TRUE if successful, and FALSE if pcLine contains a lexical
+   or syntactical error. In the latter case, print an error to 
+   stderr; a syntactical error is not printed if there is also a 
+   lexical error. A line with no tokens is successful and yields no
+   Commands. pcLine is modified as by lexScan(), and must remain 
+   unchanged while the Commands are in use. pcProgName is used in 
+   printing error messages. It is a checked runtime error for pcLine,
+   oCommands, piBackground, piNumTokens, oArena, or pcProgName to be
+   NULL. */
+
+{
+   return parseWith(pcLine, uLength, oCommands, piBackground, 
+                    piNumTokens, TRUE, oArena, pcProgName);
+}
+
+/*------------------------------------------------------------------*/
+
+int parseTemplate(char *pcLine, size_t uLength, DynArray_T oCommands,
+                  int *piBackground, int *piNumTokens, Arena_T oArena,
+                  char *pcProgName)
+
+/* Do what parseLine() does, but leave variable references 
+   unexpanded: each word that contains a '$' is a template for 
+   lexExpand() instead, allocated from oArena. A Command that is 
+   redirected from a here-string whose word contains a '$' holds the
+   template of the word, followed by a newline, as its text. */
+
+{
+   return parseWith(pcLine, uLength, oCommands, piBackground, 
+                    piNumTokens, FALSE, oArena, pcProgName);
 }
@@ -9,17 +9,14 @@
 typedef struct Command *Command_T;
 /* A Command_T is a sequence of tokens. A Command_T consists of a
    command name, a list of arguments, an indication of whether stdin
-   should be redirected (and if so, to which stream), and an 
-   indication of whether stdout should be redirected (and if so, to
-   which stream). */
+   should be redirected (and if so, to which stream, or to which 
+   here-document or here-string), and an indication of whether 
+   stdout should be redirected (and if so, to which stream). */
 
-Command_T Command_new(void);
+Command_T Command_new(Arena_T oArena);
 /* Create and return a Command whose oCommand, pcStdin, and pcStdout
-   all point to NULL. The caller owns the Command. */
-
-void Command_free(void *pvItem, void *pvExtra);
-/* Free command pvItem. pvExtra is unused. It is a checked
-   runtime error for pvItem to be NULL. */
+   all point to NULL. The Command is allocated from oArena, and 
+   remains valid until oArena is reset. */
 
 char **Command_getArray(void *pvItem, void *pvExtra);
 /* Return the ppcArray pointed to by command pvItem. pvExtra is 
@@ -38,15 +35,80 @@ char *Command_getStdout(void *pvItem, void *pvExtra);
 /* Return the string pcStdout pointed to by command pvItem. pvExtra
    is unused. It is a checked runtime error for pvItem to be NULL. */
 
-int parseToken(const DynArray_T oTokens, Command_T command, 
-               char *pcProgName);
-/* Syntactically analyze oTokens. Make command point to a newly 
-   created command that corresponds to oTokens. Return TRUE if 
-   successful, and FALSE if oTokens contains a syntactical error.  
-   In the latter case, print an error to stderr. pcProgName is used
-   in printing error messages.
-   It is a checked runtime error for oTokens, oCommand, and pcProgname
-   to be NULL. */
+char *Command_getHere(void *pvItem, size_t *puLength);
+/* Return the text that the stdin of command pvItem is redirected 
+   from by a here-string or a here-document, and store its length in
+   *puLength, or return NULL if there is none. It is a checked 
+   runtime error for pvItem or puLength to be NULL. */
+
+char *Command_getHereEnd(void *pvItem, void *pvExtra);
+/* Return the delimiter of the here-document of command pvItem whose
+   body has not been read yet, or NULL if there is none. pvExtra is 
+   unused. It is a checked runtime error for pvItem to be NULL. */
+
+void Command_setHere(Command_T oCommand, char *pcText, 
+                     size_t uLength);
+/* Make pcText, of length uLength, the body of the here-document of
+   oCommand, which has then been read. pcText must remain valid as 
+   long as oCommand is used. It is a checked runtime error for 
+   oCommand or pcText to be NULL. It is a checked runtime error for
+   oCommand to have no here-document whose body is unread. */
+
+void Command_setRedirections(Command_T oCommand, char *pcStdin,
+                             char *pcHere, size_t uHereLength,
+                             char *pcStdout);
+/* Make the stdin of oCommand redirected from the stream pcStdin, or
+   from the text pcHere of length uHereLength, and its stdout 
+   redirected to the stream pcStdout, each only if it is not NULL, 
+   and make oCommand have no here-document whose body is unread. The
+   strings must remain valid as long as oCommand is used. It is a 
+   checked runtime error for oCommand to be NULL. It is a checked 
+   runtime error for pcStdin and pcHere to both not be NULL. */
+
+void Command_setArray(Command_T oCommand, char **ppcArray, 
+                      int iNumArg);
+/* Make ppcArray, whose first element is a command name followed by
+   iNumArg arguments and NULL, the ppcArray of oCommand. ppcArray 
+   must remain valid as long as oCommand is used. It is a checked 
+   runtime error for oCommand or ppcArray to be NULL. It is a checked
+   runtime error for iNumArg to be negative. */
+
+void Command_removeName(Command_T oCommand);
+/* Remove the command name from the ppcArray of oCommand, so that its
+   first argument becomes its command name. It is a checked runtime
+   error for oCommand to be NULL. It is a checked runtime error for
+   oCommand to have no arguments. */
+
+int parseLine(char *pcLine, size_t uLength, DynArray_T oCommands,
+              int *piBackground, int *piNumTokens, Arena_T oArena,
+              char *pcProgName);
+/* Lexically and syntactically analyze string pcLine, of length 
+   uLength, in one pass. Populate oCommands with one newly created 
+   Command per pipeline stage, in order, allocated from oArena. Set
+   *piBackground to TRUE if the pipeline ends with '&' and to FALSE 
+   otherwise, and *piNumTokens to the number of tokens in pcLine. 
+   The body of a here-document is not read; see Command_getHereEnd().
+   Return TRUE if successful, and FALSE if pcLine contains a lexical
+   or syntactical error. In the latter case, print an error to 
+   stderr; a syntactical error is not printed if there is also a 
+   lexical error. A line with no tokens is successful and yields no
+   Commands. pcLine is modified as by lexScan(), and must remain 
+   unchanged while the Commands are in use. pcProgName is used in 
+   printing error messages. It is a checked runtime error for pcLine,
+   oCommands, piBackground, piNumTokens, oArena, or pcProgName to be
+   NULL. */
+
+int parseTemplate(char *pcLine, size_t uLength, DynArray_T oCommands,
+                  int *piBackground, int *piNumTokens, Arena_T oArena,
+                  char *pcProgName);
+/* Do what parseLine() does, but leave variable references 
+   unexpanded: each word that contains a '$' is a template for 
+   lexExpand() instead, allocated from oArena. A Command that is 
+   redirected from a here-string whose word contains a '$' holds the
+   template of the word, followed by a newline, as its text. */
+
+/* parseLine() makes no tokens: each word is written once, into an
+   array allocated for the whole line, and no element is moved. */
 
 #endif                      /* PARSE_INCLUDED */
 
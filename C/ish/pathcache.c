@@ -0,0 +1,294 @@
+/*------------------------------------------------------------------*/
+/* pathcache.c                                                      */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "pathcache.h"
+#include "var.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+enum {BUCKET_COUNT = 256};
+
+/*------------------------------------------------------------------*/
+
+/* A PathEntry maps a command name to the absolute path it resolves 
+   to, and records the state of the directory it was found in. */
+
+struct PathEntry
+{
+   /* The command name, as typed. */
+   char *pcName;
+
+   /* The absolute path of the executable file. */
+   char *pcPath;
+
+   /* The directory of pcPath. */
+   char *pcDir;
+
+   /* The modification time of that directory when pcName was
+      resolved. */
+   struct timespec sDirMtime;
+
+   /* The number of times the entry has been used. */
+   long lHits;
+
+   /* The next entry in the same bucket. */
+   struct PathEntry *psNext;
+};
+
+/*------------------------------------------------------------------*/
+
+/* The hash table of cached entries, chained by bucket. */
+static struct PathEntry *apsBuckets[BUCKET_COUNT];
+
+/*------------------------------------------------------------------*/
+
+static unsigned int hash(const char *pcName)
+
+/* Return the bucket index of command name pcName. */
+
+{
+   unsigned int uHash = 5381;
+
+   assert(pcName != NULL);
+
+   while(*pcName != '\0')
+      uHash = uHash * 33 + (unsigned char)*pcName++;
+   return uHash % BUCKET_COUNT;
+}
+
+/*------------------------------------------------------------------*/
+
+static void freeEntry(struct PathEntry *psEntry)
+
+/* Free psEntry. It is a checked runtime error for psEntry to be
+   NULL. */
+
+{
+   assert(psEntry != NULL);
+
+   free(psEntry->pcName);
+   free(psEntry->pcPath);
+   free(psEntry->pcDir);
+   free(psEntry);
+}
+
+/*------------------------------------------------------------------*/
+
+static int getDirMtime(const char *pcDir, struct timespec *psMtime)
+
+/* Store in *psMtime the modification time of the directory pcDir.
+   Return TRUE if successful, and FALSE if the directory cannot be 
+   examined. It is a checked runtime error for pcDir or psMtime to 
+   be NULL. */
+
+{
+   struct stat sStat;
+
+   assert(pcDir != NULL);
+   assert(psMtime != NULL);
+
+   if(stat(pcDir, &sStat) == -1)
+      return FALSE;
+   *psMtime = sStat.st_mtim;
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static struct PathEntry *resolve(const char *pcName)
+
+/* Search the directories in PATH for an executable file named 
+   pcName, as execvp() does. Return a new PathEntry for the first one
+   found, or NULL if none is found or it was found through a relative
+   directory. It is a checked runtime error for pcName to be NULL. */
+
+{
+   const char *pcPathVar;
+   const char *pcDir;
+   const char *pcEnd;
+   char *pcPath;
+   size_t uDirLength;
+   size_t uNameLength;
+   struct stat sStat;
+   struct PathEntry *psEntry;
+
+   assert(pcName != NULL);
+
+   pcPathVar = varGet("PATH", 4);
+   if(pcPathVar == NULL)
+      pcPathVar = "/bin:/usr/bin";
+
+   uNameLength = strlen(pcName);
+   for(pcDir = pcPathVar; ; pcDir = pcEnd + 1)
+   {
+      pcEnd = strchr(pcDir, ':');
+      if(pcEnd == NULL)
+         pcEnd = pcDir + strlen(pcDir);
+      uDirLength = (size_t)(pcEnd - pcDir);
+
+      pcPath = (char*)malloc(uDirLength + uNameLength + 2);
+      assert(pcPath != NULL);
+      memcpy(pcPath, pcDir, uDirLength);
+      pcPath[uDirLength] = '/';
+      strcpy(pcPath + uDirLength + 1, pcName);
+
+      if(stat(pcPath, &sStat) == 0 && S_ISREG(sStat.st_mode) &&
+         access(pcPath, X_OK) == 0)
+      {
+         /* A relative directory such as "." or "" would make the 
+            entry depend on the working directory. */
+         if(pcDir[0] != '/')
+         {
+            free(pcPath);
+            return NULL;
+         }
+
+         psEntry = (struct PathEntry*)malloc(sizeof(struct PathEntry));
+         assert(psEntry != NULL);
+         psEntry->pcName = (char*)malloc(uNameLength + 1);
+         assert(psEntry->pcName != NULL);
+         strcpy(psEntry->pcName, pcName);
+         psEntry->pcPath = pcPath;
+         psEntry->pcDir = (char*)malloc(uDirLength + 1);
+         assert(psEntry->pcDir != NULL);
+         memcpy(psEntry->pcDir, pcDir, uDirLength);
+         psEntry->pcDir[uDirLength] = '\0';
+         psEntry->lHits = 0;
+         psEntry->psNext = NULL;
+         if(!getDirMtime(psEntry->pcDir, &psEntry->sDirMtime))
+         {
+            freeEntry(psEntry);
+            return NULL;
+         }
+         return psEntry;
+      }
+      free(pcPath);
+
+      if(*pcEnd == '\0')
+         return NULL;
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+char *pathLookup(const char *pcName)
+
+/* Return the absolute path of the executable file that command name
+   pcName resolves to through PATH, consulting and updating the 
+   cache. Return NULL if pcName contains a '/', if no such file 
+   exists, or if it was found through a relative PATH directory; the
+   caller should then let execvp() search PATH itself. The returned
+   string is owned by the cache and remains valid until the next
+   call of a path cache function. It is a checked runtime error for
+   pcName to be NULL. */
+
+{
+   struct PathEntry *psEntry;
+   unsigned int uBucket;
+
+   assert(pcName != NULL);
+
+   if(pcName[0] == '\0' || strchr(pcName, '/') != NULL)
+      return NULL;
+
+   uBucket = hash(pcName);
+   for(psEntry = apsBuckets[uBucket]; psEntry != NULL; 
+       psEntry = psEntry->psNext)
+      if(strcmp(psEntry->pcName, pcName) == 0)
+         break;
+
+   if(psEntry == NULL)
+   {
+      psEntry = resolve(pcName);
+      if(psEntry == NULL)
+         return NULL;
+      psEntry->psNext = apsBuckets[uBucket];
+      apsBuckets[uBucket] = psEntry;
+   }
+
+   psEntry->lHits++;
+   return psEntry->pcPath;
+}
+
+/*------------------------------------------------------------------*/
+
+void pathRevalidate(const char *pcName)
+
+/* Remove the cache entry for command name pcName if the directory 
+   it was found in has been modified since, or can no longer be 
+   examined. It is a checked runtime error for pcName to be NULL. */
+
+/* A modified directory may no longer hold the file, or may hold 
+   another one. An unmodified one still holds it, so the launch 
+   failed for another reason, and the entry is kept. */
+
+{
+   struct PathEntry **ppsEntry;
+   struct PathEntry *psEntry;
+   struct timespec sMtime;
+
+   assert(pcName != NULL);
+
+   for(ppsEntry = &apsBuckets[hash(pcName)]; *ppsEntry != NULL;
+       ppsEntry = &(*ppsEntry)->psNext)
+      if(strcmp((*ppsEntry)->pcName, pcName) == 0)
+      {
+         psEntry = *ppsEntry;
+         if(getDirMtime(psEntry->pcDir, &sMtime) &&
+            sMtime.tv_sec == psEntry->sDirMtime.tv_sec &&
+            sMtime.tv_nsec == psEntry->sDirMtime.tv_nsec)
+            return;
+         *ppsEntry = psEntry->psNext;
+         freeEntry(psEntry);
+         return;
+      }
+}
+
+/*------------------------------------------------------------------*/
+
+void pathReset(void)
+
+/* Remove every entry from the cache. */
+
+{
+   struct PathEntry *psEntry;
+   int i;
+
+   for(i = 0; i < BUCKET_COUNT; i++)
+      while(apsBuckets[i] != NULL)
+      {
+         psEntry = apsBuckets[i];
+         apsBuckets[i] = psEntry->psNext;
+         freeEntry(psEntry);
+      }
+}
+
+/*------------------------------------------------------------------*/
+
+void pathPrint(void)
+
+/* Write the cache entries and the number of times each was used
+   to stdout. */
+
+{
+   struct PathEntry *psEntry;
+   int i;
+
+   printf("hits\tcommand\n");
+   for(i = 0; i < BUCKET_COUNT; i++)
+      for(psEntry = apsBuckets[i]; psEntry != NULL; 
+          psEntry = psEntry->psNext)
+         printf("%ld\t%s\n", psEntry->lHits, psEntry->pcPath);
+}
@@ -0,0 +1,39 @@
+/*------------------------------------------------------------------*/
+/* pathcache.h                                                      */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef PATHCACHE_INCLUDED
+#define PATHCACHE_INCLUDED
+
+/* The path cache remembers which directory in PATH each command 
+   name was found in, so launching a command does not have to try
+   every directory again. A hit costs no system call: an entry is 
+   trusted until launching its command fails and the directory it 
+   was found in turns out to have been modified, or until PATH 
+   changes or the cache is reset. A command installed in an earlier
+   directory of PATH is thus not found until then. */
+
+char *pathLookup(const char *pcName);
+/* Return the absolute path of the executable file that command name
+   pcName resolves to through PATH, consulting and updating the 
+   cache. Return NULL if pcName contains a '/', if no such file 
+   exists, or if it was found through a relative PATH directory; the
+   caller should then let execvp() search PATH itself. The returned
+   string is owned by the cache and remains valid until the next
+   call of a path cache function. It is a checked runtime error for
+   pcName to be NULL. */
+
+void pathRevalidate(const char *pcName);
+/* Remove the cache entry for command name pcName if the directory 
+   it was found in has been modified since, or can no longer be 
+   examined. It is a checked runtime error for pcName to be NULL. */
+
+void pathReset(void);
+/* Remove every entry from the cache. */
+
+void pathPrint(void);
+/* Write the cache entries and the number of times each was used
+   to stdout. */
+
+#endif                      /* PATHCACHE_INCLUDED */
@@ -0,0 +1,635 @@
+/*------------------------------------------------------------------*/
+/* rccache.c                                                        */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "dynarray.h"
+#include "arena.h"
+#include "parse.h"
+#include "smallarray.h"
+#include "rccache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+/* The first bytes of a cache file. The last digits are the version
+   of the format, which changes whenever the format does, or the way
+   lines are analyzed does. */
+static const char acMagic[8] = "ishrc02";
+
+/*------------------------------------------------------------------*/
+
+/* The key of a startup file: what must not have changed for a cache
+   of it to be used. */
+
+struct RcKey
+{
+   dev_t iDev;
+   ino_t iIno;
+   off_t lSize;
+   time_t lMtimeSec;
+   long lMtimeNsec;
+};
+
+/* The header of a cache file. It is followed by the path of the
+   startup file, terminated and padded to a multiple of
+   sizeof(size_t) bytes, and then by uDataLength bytes of records.
+   Since the file is only read by the machine that wrote it, numbers
+   are written as they are in memory. */
+
+struct RcHeader
+{
+   char acMagic[8];
+   size_t uHeaderSize;
+   struct RcKey sKey;
+   size_t uPathLength;
+   size_t uDataLength;
+};
+
+/* A record is the pipeline of one line, as a sequence of words of
+   type size_t: the number of the line, the number of lines it spans,
+   TRUE iff it runs in the background, and the number of its stages.
+   Each stage follows as its number of arguments, its command name
+   and arguments, its stdin stream, its here-text, and its stdout
+   stream. Each string is a word that is 0 if the string is NULL and
+   one more than its length otherwise, followed by its characters, a
+   '\0', and padding up to a whole word. */
+
+/*------------------------------------------------------------------*/
+
+/* An RcCache is either a cache file mapped into memory, which is
+   read a record at a time, or the records of a new cache file. */
+
+struct RcCache
+{
+   /* The name of the cache file, the path of the startup file, and
+      the file descriptor it is open as. */
+   char *pcCacheName;
+   char *pcRcName;
+   int iRcFd;
+
+   /* The key of the startup file when the RcCache was created. */
+   struct RcKey sKey;
+
+   /* TRUE iff the cache file was mapped. If so, its mapping, the
+      size of the mapping, the next record to read, and the end of
+      the records. */
+   int iHit;
+   char *pcMap;
+   size_t uMapSize;
+   char *pcNext;
+   char *pcEnd;
+
+   /* The records of a new cache file, and the number of the last
+      line recorded. */
+   struct SmallArray sData;
+   long lLastLine;
+};
+
+/*------------------------------------------------------------------*/
+
+static size_t roundUp(size_t uLength)
+
+/* Return uLength rounded up to a multiple of sizeof(size_t). */
+
+{
+   return (uLength + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+}
+
+/*------------------------------------------------------------------*/
+
+static int getKey(int iFd, struct RcKey *psKey)
+
+/* Fill *psKey with the key of the file open as file descriptor iFd.
+   Return TRUE if successful, and FALSE otherwise. It is a checked
+   runtime error for psKey to be NULL. */
+
+{
+   struct stat sStat;
+
+   assert(psKey != NULL);
+
+   if(fstat(iFd, &sStat) == -1)
+      return FALSE;
+
+   /* Zero the padding, since keys are compared with memcmp(). */
+   memset(psKey, 0, sizeof(struct RcKey));
+   psKey->iDev = sStat.st_dev;
+   psKey->iIno = sStat.st_ino;
+   psKey->lSize = sStat.st_size;
+   psKey->lMtimeSec = sStat.st_mtim.tv_sec;
+   psKey->lMtimeNsec = sStat.st_mtim.tv_nsec;
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static int mapCache(struct RcCache *psCache)
+
+/* Map the cache file of psCache, and make psCache read its records,
+   if the file is a cache of the startup file of psCache as it is
+   now. Return TRUE if so, and FALSE otherwise. It is a checked
+   runtime error for psCache to be NULL. */
+
+{
+   const struct RcHeader *psHeader;
+   struct stat sStat;
+   size_t uPathSize;
+   char *pcMap;
+   int iFd;
+
+   assert(psCache != NULL);
+
+   iFd = open(psCache->pcCacheName, O_RDONLY | O_CLOEXEC);
+   if(iFd == -1)
+      return FALSE;
+   if(fstat(iFd, &sStat) == -1 || !S_ISREG(sStat.st_mode) ||
+      (size_t)sStat.st_size < sizeof(struct RcHeader))
+   {
+      (void)close(iFd);
+      return FALSE;
+   }
+
+   /* The Commands made from the records hold char pointers into the
+      mapping, so it is private and writable. */
+   pcMap = (char*)mmap(NULL, (size_t)sStat.st_size,
+                       PROT_READ | PROT_WRITE, MAP_PRIVATE, iFd, 0);
+   (void)close(iFd);
+   if(pcMap == (char*)MAP_FAILED)
+      return FALSE;
+
+   psHeader = (const struct RcHeader*)pcMap;
+   uPathSize = roundUp(strlen(psCache->pcRcName) + 1);
+   if(memcmp(psHeader->acMagic, acMagic, sizeof(acMagic)) != 0 ||
+      psHeader->uHeaderSize != sizeof(struct RcHeader) ||
+      memcmp(&psHeader->sKey, &psCache->sKey, sizeof(struct RcKey))
+         != 0 ||
+      psHeader->uPathLength != strlen(psCache->pcRcName) ||
+      (size_t)sStat.st_size != sizeof(struct RcHeader) + uPathSize +
+         psHeader->uDataLength ||
+      strcmp(pcMap + sizeof(struct RcHeader), psCache->pcRcName) != 0)
+   {
+      (void)munmap(pcMap, (size_t)sStat.st_size);
+      return FALSE;
+   }
+
+   psCache->pcMap = pcMap;
+   psCache->uMapSize = (size_t)sStat.st_size;
+   psCache->pcNext = pcMap + sizeof(struct RcHeader) + uPathSize;
+   psCache->pcEnd = pcMap + psCache->uMapSize;
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+RcCache_T RcCache_new(const char *pcCacheName, const char *pcRcName,
+                      int iRcFd)
+
+/* Create and return an RcCache for the startup file named pcRcName,
+   which is open as file descriptor iRcFd, kept in the cache file
+   named pcCacheName. If that file holds a cache of the startup file
+   as it is now, the RcCache maps it and is a hit; see
+   RcCache_getPipeline(). Otherwise the RcCache is empty and records
+   pipelines; see RcCache_addPipeline(). Return NULL if the startup
+   file cannot be examined. It is a checked runtime error for
+   pcCacheName or pcRcName to be NULL. */
+
+{
+   struct RcCache *psCache;
+
+   assert(pcCacheName != NULL);
+   assert(pcRcName != NULL);
+
+   psCache = (struct RcCache*)malloc(sizeof(struct RcCache));
+   assert(psCache != NULL);
+   if(!getKey(iRcFd, &psCache->sKey))
+   {
+      free(psCache);
+      return NULL;
+   }
+   psCache->pcCacheName = strdup(pcCacheName);
+   psCache->pcRcName = strdup(pcRcName);
+   assert(psCache->pcCacheName != NULL);
+   assert(psCache->pcRcName != NULL);
+   psCache->iRcFd = iRcFd;
+   psCache->pcMap = NULL;
+   psCache->uMapSize = 0;
+   psCache->pcNext = NULL;
+   psCache->pcEnd = NULL;
+   SmallArray_init(&psCache->sData, 1);
+   psCache->lLastLine = 0;
+   psCache->iHit = mapCache(psCache);
+   return psCache;
+}
+
+/*------------------------------------------------------------------*/
+
+static int writeAll(int iFd, const void *pvData, size_t uLength)
+
+/* Write the uLength bytes at pvData to file descriptor iFd. Return
+   TRUE if successful, and FALSE otherwise. */
+
+{
+   const char *pc = (const char*)pvData;
+   ssize_t lWritten;
+
+   while(uLength > 0)
+   {
+      lWritten = write(iFd, pc, uLength);
+      if(lWritten <= 0)
+         return FALSE;
+      pc += lWritten;
+      uLength -= (size_t)lWritten;
+   }
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static void writeCache(struct RcCache *psCache)
+
+/* Write the records of psCache to a new cache file, and rename it to
+   the cache file of psCache, so a shell that starts meanwhile sees
+   either the old file or the new one. Do nothing if the startup file
+   has changed since psCache was created. It is a checked runtime
+   error for psCache to be NULL. */
+
+{
+   struct RcHeader sHeader;
+   struct RcKey sKey;
+   char *pcTemp;
+   char acPad[sizeof(size_t)];
+   size_t uPathLength;
+   int iFd;
+   int iOk;
+
+   assert(psCache != NULL);
+
+   if(!getKey(psCache->iRcFd, &sKey) ||
+      memcmp(&sKey, &psCache->sKey, sizeof(struct RcKey)) != 0)
+      return;
+
+   pcTemp = (char*)malloc(strlen(psCache->pcCacheName) + 8);
+   assert(pcTemp != NULL);
+   strcpy(pcTemp, psCache->pcCacheName);
+   strcat(pcTemp, ".XXXXXX");
+   iFd = mkstemp(pcTemp);
+   if(iFd == -1)
+   {
+      free(pcTemp);
+      return;
+   }
+
+   uPathLength = strlen(psCache->pcRcName);
+   memset(&sHeader, 0, sizeof(sHeader));
+   memcpy(sHeader.acMagic, acMagic, sizeof(acMagic));
+   sHeader.uHeaderSize = sizeof(struct RcHeader);
+   memcpy(&sHeader.sKey, &psCache->sKey, sizeof(struct RcKey));
+   sHeader.uPathLength = uPathLength;
+   sHeader.uDataLength =
+      (size_t)SmallArray_getLength(&psCache->sData);
+   memset(acPad, 0, sizeof(acPad));
+
+   iOk = writeAll(iFd, &sHeader, sizeof(sHeader)) &&
+         writeAll(iFd, psCache->pcRcName, uPathLength) &&
+         writeAll(iFd, acPad,
+                  roundUp(uPathLength + 1) - uPathLength) &&
+         writeAll(iFd, SmallArray_getArray(&psCache->sData),
+                  sHeader.uDataLength);
+   if(close(iFd) == -1)
+      iOk = FALSE;
+   if(!iOk || rename(pcTemp, psCache->pcCacheName) == -1)
+      (void)unlink(pcTemp);
+   free(pcTemp);
+}
+
+/*------------------------------------------------------------------*/
+
+void RcCache_free(RcCache_T oCache)
+
+/* If oCache is not a hit, write the pipelines it recorded to its
+   cache file, replacing the file as a whole. Then free oCache. The
+   cache is only an optimization, so a failure to write it is
+   ignored. It is a checked runtime error for oCache to be NULL. */
+
+{
+   assert(oCache != NULL);
+
+   if(oCache->iHit)
+      (void)munmap(oCache->pcMap, oCache->uMapSize);
+   else
+      writeCache(oCache);
+   SmallArray_free(&oCache->sData);
+   free(oCache->pcCacheName);
+   free(oCache->pcRcName);
+   free(oCache);
+}
+
+/*------------------------------------------------------------------*/
+
+int RcCache_isHit(RcCache_T oCache)
+
+/* Return TRUE if oCache was read from its cache file, and FALSE
+   otherwise. It is a checked runtime error for oCache to be NULL. */
+
+{
+   assert(oCache != NULL);
+
+   return oCache->iHit;
+}
+
+/*------------------------------------------------------------------*/
+
+static int readWord(char **ppc, char *pcEnd, size_t *puWord)
+
+/* Read into *puWord the word at *ppc, which must end by pcEnd, and
+   advance *ppc past it. Return TRUE if successful, and FALSE if the
+   word does not fit. */
+
+{
+   assert(ppc != NULL);
+   assert(puWord != NULL);
+
+   if((size_t)(pcEnd - *ppc) < sizeof(size_t))
+      return FALSE;
+   *puWord = *(const size_t*)*ppc;
+   *ppc += sizeof(size_t);
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static int readString(char **ppc, char *pcEnd, char **ppcString,
+                      size_t *puLength)
+
+/* Read the string at *ppc, which must end by pcEnd, store a pointer
+   to its characters, or NULL, in *ppcString and its length in
+   *puLength, and advance *ppc past it. Return TRUE if successful,
+   and FALSE if the string does not fit or is not terminated. */
+
+{
+   size_t uWord;
+
+   assert(ppcString != NULL);
+   assert(puLength != NULL);
+
+   if(!readWord(ppc, pcEnd, &uWord))
+      return FALSE;
+   *ppcString = NULL;
+   *puLength = 0;
+   if(uWord == 0)
+      return TRUE;
+   if(uWord > (size_t)(pcEnd - *ppc) ||
+      roundUp(uWord) > (size_t)(pcEnd - *ppc) ||
+      (*ppc)[uWord - 1] != '\0')
+      return FALSE;
+   *ppcString = *ppc;
+   *puLength = uWord - 1;
+   *ppc += roundUp(uWord);
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static char *readPipeline(char *pc, char *pcEnd, DynArray_T oCommands,
+                          int *piBackground, int *piNumLines,
+                          Arena_T oArena)
+
+/* Read the record at pc, which must end by pcEnd, after its line
+   number. If oCommands is not NULL, add to it the Commands of the
+   record, allocated from oArena, and set *piBackground and
+   *piNumLines. Return a pointer past the record, or NULL if the
+   record is malformed. */
+
+{
+   Command_T oCommand;
+   char **ppcArray;
+   char *pcStdin;
+   char *pcHere;
+   char *pcStdout;
+   size_t uHereLength;
+   size_t uLength;
+   size_t uNumLines;
+   size_t uBackground;
+   size_t uNumStages;
+   size_t uNumArg;
+   size_t uStage;
+   size_t u;
+
+   if(!readWord(&pc, pcEnd, &uNumLines) ||
+      !readWord(&pc, pcEnd, &uBackground) ||
+      !readWord(&pc, pcEnd, &uNumStages))
+      return NULL;
+   if(oCommands != NULL)
+   {
+      *piBackground = (int)uBackground;
+      *piNumLines = (int)uNumLines;
+   }
+
+   for(uStage = 0; uStage < uNumStages; uStage++)
+   {
+      /* A record cannot hold more strings than it has words. */
+      if(!readWord(&pc, pcEnd, &uNumArg) ||
+         uNumArg >= (size_t)(pcEnd - pc) / sizeof(size_t))
+         return NULL;
+      ppcArray = NULL;
+      if(oCommands != NULL)
+         ppcArray = (char**)Arena_alloc(oArena,
+                                        (uNumArg + 2) * sizeof(char*));
+      for(u = 0; u <= uNumArg; u++)
+      {
+         if(!readString(&pc, pcEnd, &pcStdin, &uLength) ||
+            pcStdin == NULL)
+            return NULL;
+         if(ppcArray != NULL)
+            ppcArray[u] = pcStdin;
+      }
+      if(!readString(&pc, pcEnd, &pcStdin, &uLength) ||
+         !readString(&pc, pcEnd, &pcHere, &uHereLength) ||
+         !readString(&pc, pcEnd, &pcStdout, &uLength) ||
+         (pcStdin != NULL && pcHere != NULL))
+         return NULL;
+
+      if(oCommands != NULL)
+      {
+         ppcArray[uNumArg + 1] = NULL;
+         oCommand = Command_new(oArena);
+         Command_setArray(oCommand, ppcArray, (int)uNumArg);
+         Command_setRedirections(oCommand, pcStdin, pcHere,
+                                 uHereLength, pcStdout);
+         DynArray_add(oCommands, oCommand);
+      }
+   }
+   return pc;
+}
+
+/*------------------------------------------------------------------*/
+
+int RcCache_getPipeline(RcCache_T oCache, long lLine,
+                        DynArray_T oCommands, int *piBackground,
+                        int *piNumLines, Arena_T oArena)
+
+/* If oCache holds the pipeline of the line numbered lLine, counting
+   from 1, add to oCommands one Command per stage of it, allocated
+   from oArena, set *piBackground to TRUE iff it runs in the
+   background, and set *piNumLines to the number of lines it spans,
+   counting the body of its here-document, and return TRUE. Return
+   FALSE otherwise. The strings of the Commands point into oCache,
+   so they remain valid until oCache is freed. Lines must be asked
+   for in increasing order. It is a checked runtime error for
+   oCache, oCommands, piBackground, piNumLines, or oArena to be
+   NULL. */
+
+/* Records are in increasing order of line, so the ones before lLine
+   are skipped, and the one for lLine, if any, is the next. A record
+   is checked before any Command is made from it, and a malformed one
+   ends the cache. */
+
+{
+   char *pc;
+   char *pcRecord;
+   size_t uLine;
+
+   assert(oCache != NULL);
+   assert(oCommands != NULL);
+   assert(piBackground != NULL);
+   assert(piNumLines != NULL);
+   assert(oArena != NULL);
+
+   if(!oCache->iHit)
+      return FALSE;
+
+   for(;;)
+   {
+      pc = oCache->pcNext;
+      if(!readWord(&pc, oCache->pcEnd, &uLine) ||
+         uLine > (size_t)lLine)
+         return FALSE;
+      pcRecord = pc;
+      pc = readPipeline(pc, oCache->pcEnd, NULL, NULL, NULL, NULL);
+      if(pc == NULL)
+      {
+         oCache->pcNext = oCache->pcEnd;
+         return FALSE;
+      }
+      oCache->pcNext = pc;
+      if(uLine == (size_t)lLine)
+         break;
+   }
+
+   (void)readPipeline(pcRecord, oCache->pcEnd, oCommands,
+                      piBackground, piNumLines, oArena);
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static void addWord(struct RcCache *psCache, size_t uWord)
+
+/* Add uWord to the records of psCache. */
+
+{
+   assert(psCache != NULL);
+
+   SmallArray_addAll(&psCache->sData, &uWord, (int)sizeof(size_t));
+}
+
+/*------------------------------------------------------------------*/
+
+static void addString(struct RcCache *psCache, const char *pcString,
+                      size_t uLength)
+
+/* Add pcString, of length uLength, or NULL, to the records of
+   psCache. */
+
+{
+   size_t uPadded;
+   int iEnd;
+
+   assert(psCache != NULL);
+
+   if(pcString == NULL)
+   {
+      addWord(psCache, 0);
+      return;
+   }
+   addWord(psCache, uLength + 1);
+   SmallArray_addAll(&psCache->sData, pcString, (int)uLength);
+
+   /* The terminator and the padding are all zero. */
+   uPadded = roundUp(uLength + 1);
+   iEnd = SmallArray_getLength(&psCache->sData);
+   SmallArray_setLength(&psCache->sData,
+                        iEnd + (int)(uPadded - uLength));
+}
+
+/*------------------------------------------------------------------*/
+
+void RcCache_addPipeline(RcCache_T oCache, long lLine,
+                         DynArray_T oCommands, int iBackground,
+                         int iNumLines)
+
+/* Record in oCache the pipeline oCommands of the line numbered
+   lLine, which runs in the background iff iBackground is TRUE, and
+   which spans iNumLines lines, counting the body of its
+   here-document. Its strings are copied. Do nothing if oCache is a
+   hit. Lines must be added in increasing order. It is a checked
+   runtime error for oCache or oCommands to be NULL. It is a checked
+   runtime error for oCommands to be empty, or to have a Command
+   whose here-document body is unread. */
+
+{
+   Command_T oCommand;
+   char **ppcArray;
+   char *pcString;
+   size_t uLength;
+   int iNumStages;
+   int iNumArg;
+   int i;
+   int j;
+
+   assert(oCache != NULL);
+   assert(oCommands != NULL);
+   assert(DynArray_getLength(oCommands) > 0);
+   assert(lLine > oCache->lLastLine);
+   assert(iNumLines > 0);
+
+   if(oCache->iHit)
+      return;
+   oCache->lLastLine = lLine;
+
+   iNumStages = DynArray_getLength(oCommands);
+   addWord(oCache, (size_t)lLine);
+   addWord(oCache, (size_t)iNumLines);
+   addWord(oCache, (size_t)(iBackground != 0));
+   addWord(oCache, (size_t)iNumStages);
+   for(i = 0; i < iNumStages; i++)
+   {
+      oCommand = (Command_T)DynArray_get(oCommands, i);
+      assert(Command_getHereEnd(oCommand, NULL) == NULL);
+      ppcArray = Command_getArray(oCommand, NULL);
+      iNumArg = Command_getNumArg(oCommand, NULL);
+      addWord(oCache, (size_t)iNumArg);
+      for(j = 0; j <= iNumArg; j++)
+         addString(oCache, ppcArray[j], strlen(ppcArray[j]));
+      pcString = Command_getStdin(oCommand, NULL);
+      addString(oCache, pcString,
+                (pcString == NULL) ? 0 : strlen(pcString));
+      pcString = Command_getHere(oCommand, &uLength);
+      addString(oCache, pcString, uLength);
+      pcString = Command_getStdout(oCommand, NULL);
+      addString(oCache, pcString,
+                (pcString == NULL) ? 0 : strlen(pcString));
+   }
+}
@@ -0,0 +1,67 @@
+/*------------------------------------------------------------------*/
+/* rccache.h                                                        */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef RCCACHE_INCLUDED
+#define RCCACHE_INCLUDED
+
+/* An RcCache_T is the parsed form of the lines of a startup file,
+   kept in a cache file so later shells can execute them without
+   lexing and parsing them. The cache file records the path,
+   modification time, and size of the startup file it was made from,
+   and is used only while they still match. Only lines whose parse
+   does not depend on the state of the shell are cached: a line that
+   contains a '!' or a '$', or that has an error, is left out, and is
+   lexed and parsed each time as usual. */
+
+typedef struct RcCache *RcCache_T;
+
+RcCache_T RcCache_new(const char *pcCacheName, const char *pcRcName,
+                      int iRcFd);
+/* Create and return an RcCache for the startup file named pcRcName,
+   which is open as file descriptor iRcFd, kept in the cache file
+   named pcCacheName. If that file holds a cache of the startup file
+   as it is now, the RcCache maps it and is a hit; see
+   RcCache_getPipeline(). Otherwise the RcCache is empty and records
+   pipelines; see RcCache_addPipeline(). Return NULL if the startup
+   file cannot be examined. It is a checked runtime error for
+   pcCacheName or pcRcName to be NULL. */
+
+void RcCache_free(RcCache_T oCache);
+/* If oCache is not a hit, write the pipelines it recorded to its
+   cache file, replacing the file as a whole. Then free oCache. The
+   cache is only an optimization, so a failure to write it is
+   ignored. It is a checked runtime error for oCache to be NULL. */
+
+int RcCache_isHit(RcCache_T oCache);
+/* Return TRUE if oCache was read from its cache file, and FALSE
+   otherwise. It is a checked runtime error for oCache to be NULL. */
+
+int RcCache_getPipeline(RcCache_T oCache, long lLine,
+                        DynArray_T oCommands, int *piBackground,
+                        int *piNumLines, Arena_T oArena);
+/* If oCache holds the pipeline of the line numbered lLine, counting
+   from 1, add to oCommands one Command per stage of it, allocated
+   from oArena, set *piBackground to TRUE iff it runs in the
+   background, and set *piNumLines to the number of lines it spans,
+   counting the body of its here-document, and return TRUE. Return
+   FALSE otherwise. The strings of the Commands point into oCache,
+   so they remain valid until oCache is freed. Lines must be asked
+   for in increasing order. It is a checked runtime error for
+   oCache, oCommands, piBackground, piNumLines, or oArena to be
+   NULL. */
+
+void RcCache_addPipeline(RcCache_T oCache, long lLine,
+                         DynArray_T oCommands, int iBackground,
+                         int iNumLines);
+/* Record in oCache the pipeline oCommands of the line numbered
+   lLine, which runs in the background iff iBackground is TRUE, and
+   which spans iNumLines lines, counting the body of its
+   here-document. Its strings are copied. Do nothing if oCache is a
+   hit. Lines must be added in increasing order. It is a checked
+   runtime error for oCache or oCommands to be NULL. It is a checked
+   runtime error for oCommands to be empty, or to have a Command
+   whose here-document body is unread. */
+
+#endif                      /* RCCACHE_INCLUDED */
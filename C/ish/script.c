@@ -0,0 +1,1188 @@
+/*------------------------------------------------------------------*/
+/* script.c                                                         */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#include "dynarray.h"
+#include "arena.h"
+#include "lexi.h"
+#include "parse.h"
+#include "smallarray.h"
+#include "script.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+/* The keywords that may start a line of a compound command.
+   KEYWORD_FUNCTION is "NAME()", and KEYWORD_EOF stands for the end
+   of the lines. */
+enum Keyword {KEYWORD_NONE, KEYWORD_IF, KEYWORD_THEN, KEYWORD_ELIF,
+              KEYWORD_ELSE, KEYWORD_FI, KEYWORD_WHILE, KEYWORD_FOR,
+              KEYWORD_DO, KEYWORD_DONE, KEYWORD_BREAK,
+              KEYWORD_CONTINUE, KEYWORD_RETURN, KEYWORD_OPEN,
+              KEYWORD_CLOSE, KEYWORD_FUNCTION, KEYWORD_EOF};
+
+/* The words of the keywords, indexed by Keyword. */
+static const char *apcKeywords[] =
+{
+   NULL, "if", "then", "elif", "else", "fi", "while", "for", "do",
+   "done", "break", "continue", "return", "{", "}", NULL, NULL
+};
+
+/* The set of keywords that end a list of lines, given to
+   parseList(). */
+#define STOP(eKeyword) (1u << (eKeyword))
+
+/* The types of the nodes of the tree a compound command is parsed
+   into. */
+enum NodeType {NODE_PIPELINE, NODE_IF, NODE_WHILE, NODE_FOR,
+               NODE_FUNCTION, NODE_BREAK, NODE_CONTINUE, NODE_RETURN};
+
+/*------------------------------------------------------------------*/
+
+/* A Node is a command of a compound command, as parsed. The commands
+   of a list are linked in order by psNext. */
+
+struct Node
+{
+   enum NodeType eType;
+
+   /* The index of the pipeline of a NODE_PIPELINE, or of the
+      condition of a NODE_IF or NODE_WHILE; of the word list of a
+      NODE_FOR, or of a NODE_RETURN, for which it is -1 if there is
+      none; or of the function of a NODE_FUNCTION. */
+   int iIndex;
+
+   /* The index of the variable name of a NODE_FOR. */
+   int iName;
+
+   /* The commands run if the condition of a NODE_IF is true, or the
+      body of a NODE_WHILE, NODE_FOR, or NODE_FUNCTION. */
+   struct Node *psBody;
+
+   /* The commands run if the condition of a NODE_IF is false, which
+      are a single NODE_IF for an elif. */
+   struct Node *psElse;
+
+   struct Node *psNext;
+};
+
+/*------------------------------------------------------------------*/
+
+/* A Compiler is the state of Script_compile(). */
+
+struct Compiler
+{
+   /* Where lines are read from, and the program name for error
+      messages. */
+   long (*pfReadLine)(void *pvExtra, char **ppcLine);
+   void *pvExtra;
+   char *pcProgName;
+
+   /* Where the Script is allocated from, and the array the Commands
+      of a line are parsed into. */
+   Arena_T oArena;
+   DynArray_T oCommands;
+
+   /* The current line, copied to oArena, its keyword, and what
+      follows the keyword. iPending is TRUE iff the line has been
+      looked at but not consumed, which it always is at EOF. */
+   char *pcLine;
+   enum Keyword eKeyword;
+   char *pcRest;
+   int iPending;
+
+   /* The number of loops, and of functions, that the current line is
+      within. The body of a function is within no loop. */
+   int iLoopDepth;
+   int iFunctionDepth;
+
+   /* TRUE iff an error has been found. */
+   int iError;
+
+   /* The arrays of the Script as they grow: of struct
+      ScriptPipeline, struct ScriptList, char*, struct ScriptFunction,
+      and int. */
+   struct SmallArray sPipelines;
+   struct SmallArray sLists;
+   struct SmallArray sNames;
+   struct SmallArray sFunctions;
+   struct SmallArray sCode;
+
+   /* The offsets in sCode of the targets of the jumps of break
+      commands that are not yet known, the index in sBreaks where
+      those of the innermost loop begin, and the target of the
+      continue commands of the innermost loop. */
+   struct SmallArray sBreaks;
+   int iLoopBreaks;
+   int iLoopTop;
+};
+
+/*------------------------------------------------------------------*/
+
+static int isName(const char *pcName, size_t uLength)
+
+/* Return TRUE if the uLength characters at pcName form a variable
+   or function name, and FALSE otherwise. */
+
+{
+   size_t u;
+
+   assert(pcName != NULL);
+
+   if(uLength == 0 ||
+      !(pcName[0] == '_' || isalpha((unsigned char)pcName[0])))
+      return FALSE;
+   for(u = 1; u < uLength; u++)
+      if(!(pcName[u] == '_' || isalnum((unsigned char)pcName[u])))
+         return FALSE;
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static int isBlank(const char *pc)
+
+/* Return TRUE if string pc consists of blanks only, and FALSE
+   otherwise. */
+
+{
+   assert(pc != NULL);
+
+   return pc[strspn(pc, " \t")] == '\0';
+}
+
+/*------------------------------------------------------------------*/
+
+static enum Keyword getKeyword(const char *pcLine,
+                               const char **ppcRest)
+
+/* Return the keyword that the first word of pcLine is, or
+   KEYWORD_NONE if it is none, and point *ppcRest just past the word.
+   A word ends at a blank or an operator, so a quoted keyword is no
+   keyword. */
+
+{
+   const char *pcWord;
+   size_t uLength;
+   int i;
+
+   assert(pcLine != NULL);
+   assert(ppcRest != NULL);
+
+   pcWord = pcLine + strspn(pcLine, " \t");
+   uLength = strcspn(pcWord, " \t<>|&");
+   *ppcRest = pcWord + uLength;
+
+   for(i = KEYWORD_IF; i <= KEYWORD_CLOSE; i++)
+      if(strlen(apcKeywords[i]) == uLength &&
+         memcmp(apcKeywords[i], pcWord, uLength) == 0)
+         return (enum Keyword)i;
+   if(uLength > 2 && memcmp(pcWord + uLength - 2, "()", 2) == 0 &&
+      isName(pcWord, uLength - 2))
+      return KEYWORD_FUNCTION;
+   return KEYWORD_NONE;
+}
+
+/*------------------------------------------------------------------*/
+
+int Script_isCompound(const char *pcLine, size_t uLength)
+
+/* Return TRUE if pcLine, of length uLength, starts with a keyword of
+   a compound command, which Script_compile() is to read, and FALSE
+   otherwise. It is a checked runtime error for pcLine to be NULL. */
+
+{
+   const char *pcRest;
+
+   assert(pcLine != NULL);
+   assert(pcLine[uLength] == '\0');
+
+   return getKeyword(pcLine, &pcRest) != KEYWORD_NONE;
+}
+
+/*------------------------------------------------------------------*/
+
+static void reportError(struct Compiler *psC, const char *pcFormat,
+                        const char *pcArg)
+
+/* Write to stderr the error message pcFormat, in which pcArg
+   replaces a "%s", and record that psC has found an error. */
+
+{
+   assert(psC != NULL);
+   assert(pcFormat != NULL);
+
+   fprintf(stderr, "%s: ", psC->pcProgName);
+   fprintf(stderr, pcFormat, pcArg);
+   fprintf(stderr, "\n");
+   psC->iError = TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static void setLine(struct Compiler *psC, const char *pcLine,
+                    size_t uLength)
+
+/* Make a copy of pcLine, of length uLength, the current line of
+   psC, not yet consumed. */
+
+{
+   const char *pcRest;
+
+   assert(psC != NULL);
+   assert(pcLine != NULL);
+
+   psC->pcLine = (char*)Arena_alloc(psC->oArena, uLength + 1);
+   memcpy(psC->pcLine, pcLine, uLength);
+   psC->pcLine[uLength] = '\0';
+   psC->eKeyword = getKeyword(psC->pcLine, &pcRest);
+   psC->pcRest = psC->pcLine + (pcRest - psC->pcLine);
+   psC->iPending = TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static void setEof(struct Compiler *psC)
+
+/* Record that psC has read all of its lines. */
+
+{
+   assert(psC != NULL);
+
+   psC->eKeyword = KEYWORD_EOF;
+   psC->pcRest = NULL;
+   psC->iPending = TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static enum Keyword peekLine(struct Compiler *psC)
+
+/* Return the keyword of the current line of psC, first reading the
+   next line if the current one has been consumed. Return KEYWORD_EOF
+   if there is no line left. */
+
+{
+   char *pcNext;
+   long lLength;
+
+   assert(psC != NULL);
+
+   if(!psC->iPending)
+   {
+      lLength = (*psC->pfReadLine)(psC->pvExtra, &pcNext);
+      if(lLength < 0)
+         setEof(psC);
+      else
+         setLine(psC, pcNext, (size_t)lLength);
+   }
+   return psC->eKeyword;
+}
+
+/*------------------------------------------------------------------*/
+
+static void consumeLine(struct Compiler *psC)
+
+/* Record that the current line of psC has been dealt with. */
+
+{
+   assert(psC != NULL);
+   assert(psC->iPending);
+   assert(psC->eKeyword != KEYWORD_EOF);
+
+   psC->iPending = FALSE;
+}
+
+/*------------------------------------------------------------------*/
+
+static void readHereDoc(struct Compiler *psC, Command_T oCommand)
+
+/* Read the lines of psC up to one that is the delimiter of the
+   here-document of oCommand, and make them, each followed by a
+   newline, its body. If EOF comes first, the body ends there, and a
+   warning is written to stderr. */
+
+/* A delimiter that refers to variables is expanded now, as it is
+   when the line runs by itself. */
+
+{
+   struct SmallArray sBody;
+   char *pcEnd;
+   char *pcNext;
+   char *pcBody;
+   long lLength;
+   size_t uLength;
+
+   assert(psC != NULL);
+   assert(oCommand != NULL);
+
+   pcEnd = Command_getHereEnd(oCommand, NULL);
+   if(strchr(pcEnd, '$') != NULL)
+   {
+      pcEnd = lexExpand(pcEnd, &uLength, psC->oArena);
+      if(pcEnd == NULL)
+         pcEnd = "";
+   }
+
+   SmallArray_init(&sBody, 1);
+   for(;;)
+   {
+      lLength = (*psC->pfReadLine)(psC->pvExtra, &pcNext);
+      if(lLength < 0)
+      {
+         fprintf(stderr, "%s: Here-document delimited by end of file"
+                 " (wanted \"%s\")\n", psC->pcProgName, pcEnd);
+         setEof(psC);
+         break;
+      }
+      if(strcmp(pcNext, pcEnd) == 0)
+         break;
+      SmallArray_addAll(&sBody, pcNext, (int)lLength);
+      (void)SmallArray_add(&sBody, "\n");
+   }
+
+   uLength = (size_t)SmallArray_getLength(&sBody);
+   pcBody = (char*)Arena_alloc(psC->oArena, uLength + 1);
+   memcpy(pcBody, SmallArray_getArray(&sBody), uLength);
+   pcBody[uLength] = '\0';
+   SmallArray_free(&sBody);
+   Command_setHere(oCommand, pcBody, uLength);
+}
+
+/*------------------------------------------------------------------*/
+
+static int addPipeline(struct Compiler *psC, char *pcText,
+                       int *piIndex)
+
+/* Parse pcText, which is the current line of psC or its end, as a
+   pipeline, read the body of its here-document, if any, and add the
+   pipeline to psC. Set *piIndex to its index, or to -1 if pcText
+   has no tokens. Return TRUE if successful, and FALSE if pcText has
+   an error, which is then recorded. */
+
+{
+   struct ScriptPipeline sPipeline;
+   struct ScriptStage *psStage;
+   Command_T oCommand;
+   int iNumTokens;
+   int iHereIsDoc;
+   int i;
+
+   assert(psC != NULL);
+   assert(pcText != NULL);
+   assert(piIndex != NULL);
+
+   *piIndex = -1;
+   DynArray_clear(psC->oCommands);
+   if(!parseTemplate(pcText, strlen(pcText), psC->oCommands,
+                     &sPipeline.iBackground, &iNumTokens, psC->oArena,
+                     psC->pcProgName))
+   {
+      psC->iError = TRUE;
+      return FALSE;
+   }
+   if(iNumTokens == 0)
+      return TRUE;
+
+   sPipeline.iNumStages = DynArray_getLength(psC->oCommands);
+   sPipeline.psStages = (struct ScriptStage*)Arena_alloc(psC->oArena,
+      (size_t)sPipeline.iNumStages * sizeof(struct ScriptStage));
+   for(i = 0; i < sPipeline.iNumStages; i++)
+   {
+      oCommand = (Command_T)DynArray_get(psC->oCommands, i);
+      psStage = &sPipeline.psStages[i];
+      psStage->ppcWords = Command_getArray(oCommand, NULL);
+      psStage->iNumWords = Command_getNumArg(oCommand, NULL) + 1;
+      psStage->pcStdin = Command_getStdin(oCommand, NULL);
+      psStage->pcStdout = Command_getStdout(oCommand, NULL);
+      iHereIsDoc = (Command_getHereEnd(oCommand, NULL) != NULL);
+      if(iHereIsDoc)
+         readHereDoc(psC, oCommand);
+      psStage->pcHere = Command_getHere(oCommand,
+                                        &psStage->uHereLength);
+      psStage->iHereIsTemplate =
+         (!iHereIsDoc && psStage->pcHere != NULL &&
+          strchr(psStage->pcHere, '$') != NULL);
+   }
+   DynArray_clear(psC->oCommands);
+
+   (void)SmallArray_add(&psC->sPipelines, &sPipeline);
+   *piIndex = SmallArray_getLength(&psC->sPipelines) - 1;
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static int addList(struct Compiler *psC, char *pcText,
+                   enum Keyword eKeyword, int *piIndex)
+
+/* Parse pcText, which follows the keyword eKeyword on the current
+   line of psC, as a list of words, and add the list to psC. Set
+   *piIndex to its index, or to -1 if pcText has no words. Return
+   TRUE if successful, and FALSE if pcText has an error, which is
+   then recorded. */
+
+{
+   struct ScriptList sList;
+   Command_T oCommand;
+   size_t uHereLength;
+   int iBackground;
+   int iNumTokens;
+
+   assert(psC != NULL);
+   assert(pcText != NULL);
+   assert(piIndex != NULL);
+
+   *piIndex = -1;
+   DynArray_clear(psC->oCommands);
+   if(!parseTemplate(pcText, strlen(pcText), psC->oCommands,
+                     &iBackground, &iNumTokens, psC->oArena,
+                     psC->pcProgName))
+   {
+      psC->iError = TRUE;
+      return FALSE;
+   }
+   if(iNumTokens == 0)
+      return TRUE;
+
+   oCommand = (Command_T)DynArray_get(psC->oCommands, 0);
+   if(DynArray_getLength(psC->oCommands) > 1 || iBackground ||
+      Command_getStdin(oCommand, NULL) != NULL ||
+      Command_getStdout(oCommand, NULL) != NULL ||
+      Command_getHere(oCommand, &uHereLength) != NULL ||
+      Command_getHereEnd(oCommand, NULL) != NULL)
+   {
+      DynArray_clear(psC->oCommands);
+      reportError(psC, "%s: Only words may follow",
+                  apcKeywords[eKeyword]);
+      return FALSE;
+   }
+   sList.ppcWords = Command_getArray(oCommand, NULL);
+   sList.iNumWords = Command_getNumArg(oCommand, NULL) + 1;
+   DynArray_clear(psC->oCommands);
+
+   (void)SmallArray_add(&psC->sLists, &sList);
+   *piIndex = SmallArray_getLength(&psC->sLists) - 1;
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static struct Node *newNode(struct Compiler *psC,
+                            enum NodeType eType)
+
+/* Create and return a Node of type eType, allocated from the arena
+   of psC, with no index, name, or commands. */
+
+{
+   struct Node *psNode;
+
+   assert(psC != NULL);
+
+   psNode = (struct Node*)Arena_alloc(psC->oArena, sizeof(struct Node));
+   psNode->eType = eType;
+   psNode->iIndex = -1;
+   psNode->iName = -1;
+   psNode->psBody = NULL;
+   psNode->psElse = NULL;
+   psNode->psNext = NULL;
+   return psNode;
+}
+
+/*------------------------------------------------------------------*/
+
+static struct Node *parseSimple(struct Compiler *psC, char *pcText)
+
+/* Parse pcText, which is the current line of psC or its end, as a
+   pipeline, and return its Node, or NULL if it has no tokens or an
+   error. */
+
+{
+   struct Node *psNode;
+   int iIndex;
+
+   assert(psC != NULL);
+   assert(pcText != NULL);
+
+   if(!addPipeline(psC, pcText, &iIndex) || iIndex < 0)
+      return NULL;
+   psNode = newNode(psC, NODE_PIPELINE);
+   psNode->iIndex = iIndex;
+   return psNode;
+}
+
+/*------------------------------------------------------------------*/
+
+static int parseCondition(struct Compiler *psC)
+
+/* Consume the current line of psC, which starts with "if", "elif",
+   or "while", and return the index of the pipeline that follows the
+   keyword, or -1 if there is an error. */
+
+{
+   enum Keyword eKeyword;
+   int iIndex;
+
+   assert(psC != NULL);
+
+   eKeyword = psC->eKeyword;
+   consumeLine(psC);
+   if(addPipeline(psC, psC->pcRest, &iIndex) && iIndex < 0)
+      reportError(psC, "%s: Missing condition", apcKeywords[eKeyword]);
+   return iIndex;
+}
+
+/*------------------------------------------------------------------*/
+
+static struct Node *parseCommand(struct Compiler *psC);
+
+/*------------------------------------------------------------------*/
+
+static struct Node *parseList(struct Compiler *psC, unsigned int uStops)
+
+/* Parse the lines of psC up to one whose keyword is in the set
+   uStops, or up to EOF, and return the list of their commands. The
+   line that ends the list is not consumed. */
+
+{
+   struct Node *psFirst = NULL;
+   struct Node **ppsLast = &psFirst;
+   struct Node *psNode;
+   enum Keyword eKeyword;
+
+   assert(psC != NULL);
+
+   for(;;)
+   {
+      eKeyword = peekLine(psC);
+      if(eKeyword == KEYWORD_EOF || (uStops & STOP(eKeyword)) != 0)
+         return psFirst;
+      psNode = parseCommand(psC);
+      if(psNode != NULL)
+      {
+         *ppsLast = psNode;
+         ppsLast = &psNode->psNext;
+      }
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static struct Node *parseBody(struct Compiler *psC,
+                              enum Keyword eOpen, unsigned int uStops)
+
+/* Parse the lines of psC from one that starts with eOpen up to one
+   whose keyword is in the set uStops, and return the list of their
+   commands, which starts with the command that follows eOpen, if
+   any. The line that ends the list is not consumed. */
+
+/* What follows eOpen is made a line of its own, so it may be a
+   keyword as well. */
+
+{
+   assert(psC != NULL);
+
+   if(peekLine(psC) != eOpen)
+      reportError(psC, "Missing %s", apcKeywords[eOpen]);
+   else
+   {
+      consumeLine(psC);
+      if(!isBlank(psC->pcRest))
+         setLine(psC, psC->pcRest, strlen(psC->pcRest));
+   }
+   return parseList(psC, uStops);
+}
+
+/*------------------------------------------------------------------*/
+
+static void parseEnd(struct Compiler *psC, enum Keyword eClose)
+
+/* Consume the current line of psC if it is eClose by itself, which
+   ends a compound command. Otherwise record an error. */
+
+{
+   assert(psC != NULL);
+
+   if(peekLine(psC) != eClose)
+   {
+      reportError(psC, "Missing %s", apcKeywords[eClose]);
+      return;
+   }
+   consumeLine(psC);
+   if(!isBlank(psC->pcRest))
+      reportError(psC, "%s: Unexpected words", apcKeywords[eClose]);
+}
+
+/*------------------------------------------------------------------*/
+
+static struct Node *parseIf(struct Compiler *psC)
+
+/* Parse the if command, or the rest of one from an elif, that the
+   current line of psC begins, up to and including its fi, and
+   return its Node. */
+
+{
+   struct Node *psNode;
+
+   assert(psC != NULL);
+
+   psNode = newNode(psC, NODE_IF);
+   psNode->iIndex = parseCondition(psC);
+   psNode->psBody = parseBody(psC, KEYWORD_THEN, STOP(KEYWORD_ELIF) |
+                              STOP(KEYWORD_ELSE) | STOP(KEYWORD_FI));
+   if(peekLine(psC) == KEYWORD_ELIF)
+   {
+      psNode->psElse = parseIf(psC);
+      return psNode;
+   }
+   if(psC->eKeyword == KEYWORD_ELSE)
+      psNode->psElse = parseBody(psC, KEYWORD_ELSE, STOP(KEYWORD_FI));
+   parseEnd(psC, KEYWORD_FI);
+   return psNode;
+}
+
+/*------------------------------------------------------------------*/
+
+static struct Node *parseWhile(struct Compiler *psC)
+
+/* Parse the while command that the current line of psC begins, up
+   to and including its done, and return its Node. */
+
+{
+   struct Node *psNode;
+
+   assert(psC != NULL);
+
+   psNode = newNode(psC, NODE_WHILE);
+   psNode->iIndex = parseCondition(psC);
+   psC->iLoopDepth++;
+   psNode->psBody = parseBody(psC, KEYWORD_DO, STOP(KEYWORD_DONE));
+   psC->iLoopDepth--;
+   parseEnd(psC, KEYWORD_DONE);
+   return psNode;
+}
+
+/*------------------------------------------------------------------*/
+
+static struct Node *parseFor(struct Compiler *psC)
+
+/* Parse the for command that the current line of psC begins, up to
+   and including its done, and return its Node. */
+
+/* The words of "NAME in WORD..." are parsed as one list, whose
+   first two words are then dropped, so the list is the loop's. */
+
+{
+   struct Node *psNode;
+   struct ScriptList *psList = NULL;
+   char *pcName;
+
+   assert(psC != NULL);
+
+   psNode = newNode(psC, NODE_FOR);
+   consumeLine(psC);
+   if(addList(psC, psC->pcRest, KEYWORD_FOR, &psNode->iIndex) &&
+      psNode->iIndex >= 0)
+      psList = (struct ScriptList*)SmallArray_get(&psC->sLists,
+                                                  psNode->iIndex);
+   if(psList == NULL || psList->iNumWords < 2 ||
+      !isName(psList->ppcWords[0], strlen(psList->ppcWords[0])) ||
+      strcmp(psList->ppcWords[1], "in") != 0)
+   {
+      if(!psC->iError)
+         reportError(psC, "%s: Expected NAME in WORD...", "for");
+   }
+   else
+   {
+      pcName = psList->ppcWords[0];
+      (void)SmallArray_add(&psC->sNames, &pcName);
+      psNode->iName = SmallArray_getLength(&psC->sNames) - 1;
+      psList->ppcWords += 2;
+      psList->iNumWords -= 2;
+   }
+
+   psC->iLoopDepth++;
+   psNode->psBody = parseBody(psC, KEYWORD_DO, STOP(KEYWORD_DONE));
+   psC->iLoopDepth--;
+   parseEnd(psC, KEYWORD_DONE);
+   return psNode;
+}
+
+/*------------------------------------------------------------------*/
+
+static struct Node *parseFunction(struct Compiler *psC)
+
+/* Parse the function definition that the current line of psC
+   begins, up to and including its "}", and return its Node, or NULL
+   if it has no "{". The "{" may end the first line or be a line by
+   itself. */
+
+{
+   struct Node *psNode;
+   struct ScriptFunction sFunction;
+   char *pcWord;
+   size_t uLength;
+   int iLoopDepth;
+
+   assert(psC != NULL);
+
+   psNode = newNode(psC, NODE_FUNCTION);
+   consumeLine(psC);
+   pcWord = psC->pcLine + strspn(psC->pcLine, " \t");
+   uLength = (size_t)(psC->pcRest - pcWord) - 2;
+   sFunction.pcName = (char*)Arena_alloc(psC->oArena, uLength + 1);
+   memcpy(sFunction.pcName, pcWord, uLength);
+   sFunction.pcName[uLength] = '\0';
+   sFunction.iEntry = -1;
+   (void)SmallArray_add(&psC->sFunctions, &sFunction);
+   psNode->iIndex = SmallArray_getLength(&psC->sFunctions) - 1;
+
+   /* Without its "{", the line is not taken to begin a body, so an
+      error reads no further. */
+   if(isBlank(psC->pcRest))
+   {
+      if(peekLine(psC) != KEYWORD_OPEN)
+      {
+         reportError(psC, "%s(): Expected {", sFunction.pcName);
+         return NULL;
+      }
+      parseEnd(psC, KEYWORD_OPEN);
+   }
+   else
+   {
+      pcWord = psC->pcRest + strspn(psC->pcRest, " \t");
+      if(pcWord[0] != '{' || !isBlank(pcWord + 1))
+      {
+         reportError(psC, "%s(): Expected {", sFunction.pcName);
+         return NULL;
+      }
+   }
+
+   iLoopDepth = psC->iLoopDepth;
+   psC->iLoopDepth = 0;
+   psC->iFunctionDepth++;
+   psNode->psBody = parseList(psC, STOP(KEYWORD_CLOSE));
+   psC->iFunctionDepth--;
+   psC->iLoopDepth = iLoopDepth;
+   parseEnd(psC, KEYWORD_CLOSE);
+   return psNode;
+}
+
+/*------------------------------------------------------------------*/
+
+static struct Node *parseJump(struct Compiler *psC)
+
+/* Parse the break, continue, or return command that is the current
+   line of psC, and return its Node, or NULL if it has an error. */
+
+{
+   struct Node *psNode;
+   struct ScriptList *psList;
+   enum Keyword eKeyword;
+
+   assert(psC != NULL);
+
+   eKeyword = psC->eKeyword;
+   consumeLine(psC);
+   if(eKeyword == KEYWORD_RETURN)
+   {
+      psNode = newNode(psC, NODE_RETURN);
+      if(!addList(psC, psC->pcRest, eKeyword, &psNode->iIndex))
+         return NULL;
+      if(psNode->iIndex >= 0)
+      {
+         psList = (struct ScriptList*)SmallArray_get(&psC->sLists,
+                                                     psNode->iIndex);
+         if(psList->iNumWords > 1)
+         {
+            reportError(psC, "%s: Too many arguments", "return");
+            return NULL;
+         }
+      }
+      if(psC->iFunctionDepth == 0)
+      {
+         reportError(psC, "%s: Not in a function", "return");
+         return NULL;
+      }
+      return psNode;
+   }
+
+   if(!isBlank(psC->pcRest))
+   {
+      reportError(psC, "%s: Unexpected words", apcKeywords[eKeyword]);
+      return NULL;
+   }
+   if(psC->iLoopDepth == 0)
+   {
+      reportError(psC, "%s: Not in a loop", apcKeywords[eKeyword]);
+      return NULL;
+   }
+   return newNode(psC, (eKeyword == KEYWORD_BREAK) ?
+                  NODE_BREAK : NODE_CONTINUE);
+}
+
+/*------------------------------------------------------------------*/
+
+static struct Node *parseCommand(struct Compiler *psC)
+
+/* Parse the command that the current line of psC begins, consuming
+   all of its lines, and return its Node, or NULL if it has no
+   tokens or an error. */
+
+{
+   assert(psC != NULL);
+   assert(psC->iPending);
+
+   switch(psC->eKeyword)
+   {
+      case KEYWORD_NONE:
+         consumeLine(psC);
+         return parseSimple(psC, psC->pcLine);
+
+      case KEYWORD_IF:
+         return parseIf(psC);
+
+      case KEYWORD_WHILE:
+         return parseWhile(psC);
+
+      case KEYWORD_FOR:
+         return parseFor(psC);
+
+      case KEYWORD_FUNCTION:
+         return parseFunction(psC);
+
+      case KEYWORD_BREAK:
+      case KEYWORD_CONTINUE:
+      case KEYWORD_RETURN:
+         return parseJump(psC);
+
+      case KEYWORD_EOF:
+         assert(0);
+         return NULL;
+
+      default:
+         consumeLine(psC);
+         reportError(psC, "Unexpected %s", apcKeywords[psC->eKeyword]);
+         return NULL;
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static int emit(struct Compiler *psC, int iWord)
+
+/* Append iWord to the bytecode of psC, and return its offset. */
+
+{
+   assert(psC != NULL);
+
+   (void)SmallArray_add(&psC->sCode, &iWord);
+   return SmallArray_getLength(&psC->sCode) - 1;
+}
+
+/*------------------------------------------------------------------*/
+
+static void patch(struct Compiler *psC, int iOffset)
+
+/* Make the target at offset iOffset in the bytecode of psC the end
+   of the bytecode, where the next instruction will be. */
+
+{
+   assert(psC != NULL);
+
+   *(int*)SmallArray_get(&psC->sCode, iOffset) =
+      SmallArray_getLength(&psC->sCode);
+}
+
+/*------------------------------------------------------------------*/
+
+static void lowerList(struct Compiler *psC, struct Node *psNode);
+
+/*------------------------------------------------------------------*/
+
+static void lowerLoop(struct Compiler *psC, int iTop,
+                      struct Node *psBody)
+
+/* Append to the bytecode of psC the body psBody of a loop whose
+   continue commands go to iTop, followed by a jump to iTop, and make
+   its break commands go to the end of the bytecode after that. */
+
+{
+   int iLoopTop;
+   int iLoopBreaks;
+   int i;
+
+   assert(psC != NULL);
+
+   iLoopTop = psC->iLoopTop;
+   iLoopBreaks = psC->iLoopBreaks;
+   psC->iLoopTop = iTop;
+   psC->iLoopBreaks = SmallArray_getLength(&psC->sBreaks);
+
+   lowerList(psC, psBody);
+   (void)emit(psC, OP_JUMP);
+   (void)emit(psC, iTop);
+   for(i = psC->iLoopBreaks; i < SmallArray_getLength(&psC->sBreaks);
+       i++)
+      patch(psC, *(int*)SmallArray_get(&psC->sBreaks, i));
+   SmallArray_setLength(&psC->sBreaks, psC->iLoopBreaks);
+
+   psC->iLoopTop = iLoopTop;
+   psC->iLoopBreaks = iLoopBreaks;
+}
+
+/*------------------------------------------------------------------*/
+
+static void lowerList(struct Compiler *psC, struct Node *psNode)
+
+/* Append to the bytecode of psC the instructions of the list of
+   commands that starts with psNode. */
+
+/* A jump whose target is not known yet is emitted with a target of
+   0, and its offset kept until patch() can fill it in. */
+
+{
+   struct ScriptFunction *psFunction;
+   int iJump;
+   int iEnd;
+   int iTop;
+   int iBreak;
+
+   assert(psC != NULL);
+
+   for(; psNode != NULL; psNode = psNode->psNext)
+      switch(psNode->eType)
+      {
+         case NODE_PIPELINE:
+            (void)emit(psC, OP_RUN);
+            (void)emit(psC, psNode->iIndex);
+            break;
+
+         case NODE_IF:
+            (void)emit(psC, OP_RUN);
+            (void)emit(psC, psNode->iIndex);
+            (void)emit(psC, OP_JUMP_FALSE);
+            iJump = emit(psC, 0);
+            lowerList(psC, psNode->psBody);
+            if(psNode->psElse == NULL)
+               patch(psC, iJump);
+            else
+            {
+               (void)emit(psC, OP_JUMP);
+               iEnd = emit(psC, 0);
+               patch(psC, iJump);
+               lowerList(psC, psNode->psElse);
+               patch(psC, iEnd);
+            }
+            break;
+
+         case NODE_WHILE:
+            iTop = emit(psC, OP_RUN);
+            (void)emit(psC, psNode->iIndex);
+            (void)emit(psC, OP_JUMP_FALSE);
+            iJump = emit(psC, 0);
+            lowerLoop(psC, iTop, psNode->psBody);
+            patch(psC, iJump);
+            break;
+
+         case NODE_FOR:
+            /* The loop ends at its OP_FOR_END, whether it runs out
+               of words or breaks. */
+            (void)emit(psC, OP_FOR_BEGIN);
+            (void)emit(psC, psNode->iIndex);
+            iTop = emit(psC, OP_FOR_NEXT);
+            (void)emit(psC, psNode->iName);
+            iJump = emit(psC, 0);
+            lowerLoop(psC, iTop, psNode->psBody);
+            patch(psC, iJump);
+            (void)emit(psC, OP_FOR_END);
+            break;
+
+         case NODE_FUNCTION:
+            /* The body is skipped where it is defined, and entered
+               only by calls. */
+            (void)emit(psC, OP_DEFINE);
+            (void)emit(psC, psNode->iIndex);
+            (void)emit(psC, OP_JUMP);
+            iJump = emit(psC, 0);
+            psFunction = (struct ScriptFunction*)SmallArray_get(
+               &psC->sFunctions, psNode->iIndex);
+            psFunction->iEntry = SmallArray_getLength(&psC->sCode);
+            lowerList(psC, psNode->psBody);
+            (void)emit(psC, OP_RETURN);
+            (void)emit(psC, -1);
+            patch(psC, iJump);
+            break;
+
+         case NODE_BREAK:
+            (void)emit(psC, OP_JUMP);
+            iBreak = emit(psC, 0);
+            (void)SmallArray_add(&psC->sBreaks, &iBreak);
+            break;
+
+         case NODE_CONTINUE:
+            (void)emit(psC, OP_JUMP);
+            (void)emit(psC, psC->iLoopTop);
+            break;
+
+         case NODE_RETURN:
+            (void)emit(psC, OP_RETURN);
+            (void)emit(psC, psNode->iIndex);
+            break;
+
+         default:
+            assert(0);
+      }
+}
+
+/*------------------------------------------------------------------*/
+
+static void *copyArray(SmallArray_T oArray, size_t uElementSize,
+                       Arena_T oArena)
+
+/* Return a copy of the elements of oArray, whose size is
+   uElementSize, allocated from oArena, or NULL if it has none. */
+
+{
+   size_t uSize;
+   void *pvCopy;
+
+   assert(oArray != NULL);
+   assert(oArena != NULL);
+
+   uSize = (size_t)SmallArray_getLength(oArray) * uElementSize;
+   if(uSize == 0)
+      return NULL;
+   pvCopy = Arena_alloc(oArena, uSize);
+   memcpy(pvCopy, SmallArray_getArray(oArray), uSize);
+   return pvCopy;
+}
+
+/*------------------------------------------------------------------*/
+
+Script_T Script_compile(const char *pcLine, size_t uLength,
+                        long (*pfReadLine)(void *pvExtra,
+                                           char **ppcLine),
+                        void *pvExtra, char *pcProgName)
+
+/* Compile the compound command that pcLine, of length uLength,
+   begins, reading the rest of its lines, and the bodies of its
+   here-documents, by calling (*pfReadLine)(pvExtra, &pcNext), which
+   returns the length of the next line, without its newline, and
+   points pcNext to it, or returns -1 at EOF. Return the Script, with
+   one reference, or NULL if the command has an error, which is
+   printed to stderr. Its lines are read to its end even then.
+   pcProgName is used in printing error messages. It is a checked
+   runtime error for pcLine, pfReadLine, or pcProgName to be NULL. */
+
+/* The whole command is parsed into a tree before any of it is
+   lowered, since an error anywhere means none of it runs. Each
+   line is copied to the arena of the Script, where the words parsed
+   from it stay. The tree is left in the arena as well, which is
+   simpler than freeing it and costs a few nodes per line. */
+
+{
+   struct Compiler sC;
+   struct Node *psNode;
+   Script_T oScript = NULL;
+
+   assert(pcLine != NULL);
+   assert(pfReadLine != NULL);
+   assert(pcProgName != NULL);
+
+   sC.pfReadLine = pfReadLine;
+   sC.pvExtra = pvExtra;
+   sC.pcProgName = pcProgName;
+   sC.oArena = Arena_new();
+   sC.oCommands = DynArray_new(0);
+   sC.iLoopDepth = 0;
+   sC.iFunctionDepth = 0;
+   sC.iError = FALSE;
+   SmallArray_init(&sC.sPipelines, sizeof(struct ScriptPipeline));
+   SmallArray_init(&sC.sLists, sizeof(struct ScriptList));
+   SmallArray_init(&sC.sNames, sizeof(char*));
+   SmallArray_init(&sC.sFunctions, sizeof(struct ScriptFunction));
+   SmallArray_init(&sC.sCode, sizeof(int));
+   SmallArray_init(&sC.sBreaks, sizeof(int));
+   sC.iLoopBreaks = 0;
+   sC.iLoopTop = -1;
+
+   setLine(&sC, pcLine, uLength);
+   assert(sC.eKeyword != KEYWORD_NONE);
+   psNode = parseCommand(&sC);
+
+   if(!sC.iError)
+   {
+      lowerList(&sC, psNode);
+      (void)emit(&sC, OP_END);
+
+      oScript = (Script_T)malloc(sizeof(struct Script));
+      assert(oScript != NULL);
+      oScript->iCodeLength = SmallArray_getLength(&sC.sCode);
+      oScript->piCode = (int*)malloc((size_t)oScript->iCodeLength *
+                                     sizeof(int));
+      assert(oScript->piCode != NULL);
+      memcpy(oScript->piCode, SmallArray_getArray(&sC.sCode),
+             (size_t)oScript->iCodeLength * sizeof(int));
+      oScript->psPipelines = (struct ScriptPipeline*)copyArray(
+         &sC.sPipelines, sizeof(struct ScriptPipeline), sC.oArena);
+      oScript->psLists = (struct ScriptList*)copyArray(
+         &sC.sLists, sizeof(struct ScriptList), sC.oArena);
+      oScript->ppcNames = (char**)copyArray(
+         &sC.sNames, sizeof(char*), sC.oArena);
+      oScript->psFunctions = (struct ScriptFunction*)copyArray(
+         &sC.sFunctions, sizeof(struct ScriptFunction), sC.oArena);
+      oScript->iRefs = 1;
+      oScript->oArena = sC.oArena;
+   }
+   else
+      Arena_free(sC.oArena);
+
+   DynArray_free(sC.oCommands);
+   SmallArray_free(&sC.sPipelines);
+   SmallArray_free(&sC.sLists);
+   SmallArray_free(&sC.sNames);
+   SmallArray_free(&sC.sFunctions);
+   SmallArray_free(&sC.sCode);
+   SmallArray_free(&sC.sBreaks);
+   return oScript;
+}
+
+/*------------------------------------------------------------------*/
+
+void Script_retain(Script_T oScript)
+
+/* Add a reference to oScript. It is a checked runtime error for
+   oScript to be NULL. */
+
+{
+   assert(oScript != NULL);
+   assert(oScript->iRefs > 0);
+
+   oScript->iRefs++;
+}
+
+/*------------------------------------------------------------------*/
+
+void Script_release(Script_T oScript)
+
+/* Remove a reference to oScript, and free it if none is left. It is
+   a checked runtime error for oScript to be NULL. */
+
+{
+   assert(oScript != NULL);
+   assert(oScript->iRefs > 0);
+
+   if(--oScript->iRefs > 0)
+      return;
+   free(oScript->piCode);
+   Arena_free(oScript->oArena);
+   free(oScript);
+}
@@ -0,0 +1,169 @@
+/*------------------------------------------------------------------*/
+/* script.h                                                         */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef SCRIPT_INCLUDED
+#define SCRIPT_INCLUDED
+
+#include <stddef.h>
+
+/* A Script_T is a compound command, compiled: an if, while, or for
+   command, or the definition of a function. Each keyword starts a
+   line of its own:
+
+      if PIPELINE          while PIPELINE       for NAME in WORD...
+      then                 do                   do
+         LINES                LINES                LINES
+      elif PIPELINE        done                 done
+      then
+         LINES             NAME() {
+      else                    LINES
+         LINES             }
+      fi
+
+   Any number of elifs, and one else, may be given. "then", "else",
+   and "do" may be followed by the first command of the lines after
+   them. Within LINES, "break" and "continue" act on the innermost
+   loop, and "return [STATUS]" returns from the function. A
+   condition is true iff its exit status is 0. The words of a for
+   command are each one item, after expanding variables.
+
+   The lines of a compound command are lexed and parsed once, as it
+   is compiled, into a tree of nodes that is lowered to bytecode. The
+   words of its commands are kept as templates, which lexExpand()
+   expands each time a command runs, so no line is lexed or parsed
+   again however often it runs. vmRun() executes the bytecode. The
+   fields below are written by script.c and read by vm.c only. */
+
+enum Opcode
+{
+   /* Operand: a pipeline. Run it, setting the status. */
+   OP_RUN,
+
+   /* Operand: a target. Continue there. */
+   OP_JUMP,
+
+   /* Operand: a target. If the status is not 0, make it 0 and
+      continue at the target. */
+   OP_JUMP_FALSE,
+
+   /* Operand: a word list. Begin iterating over its words, expanded,
+      and make the status 0. */
+   OP_FOR_BEGIN,
+
+   /* Operands: a name and a target. Set the variable of that name to
+      the next word of the innermost iteration. If none is left,
+      continue at the target instead. */
+   OP_FOR_NEXT,
+
+   /* End the innermost iteration. */
+   OP_FOR_END,
+
+   /* Operand: a function. Define it. */
+   OP_DEFINE,
+
+   /* Operand: a word list of one word, or -1. Return from the
+      function, making the word the status if there is one. */
+   OP_RETURN,
+
+   /* Finish the Script. */
+   OP_END
+};
+
+/* A stage of a pipeline of a Script. Each string that contains a
+   '$' is a template for lexExpand(). */
+
+struct ScriptStage
+{
+   /* The command name and arguments, followed by NULL, and their
+      number. */
+   char **ppcWords;
+   int iNumWords;
+
+   /* The redirections, each NULL if there is none, and the length of
+      pcHere. */
+   char *pcStdin;
+   char *pcHere;
+   size_t uHereLength;
+   char *pcStdout;
+
+   /* TRUE iff pcHere is the template of a here-string, rather than
+      the body of a here-document, which is never expanded. */
+   int iHereIsTemplate;
+};
+
+struct ScriptPipeline
+{
+   struct ScriptStage *psStages;
+   int iNumStages;
+   int iBackground;
+};
+
+/* A list of words, each of which may be a template. */
+
+struct ScriptList
+{
+   char **ppcWords;
+   int iNumWords;
+};
+
+struct ScriptFunction
+{
+   char *pcName;
+
+   /* The offset in the bytecode where the body of the function
+      begins. */
+   int iEntry;
+};
+
+struct Script
+{
+   /* The bytecode: each instruction is an Opcode followed by its
+      operands, all ints, and a target is an offset in piCode. */
+   int *piCode;
+   int iCodeLength;
+
+   /* What the operands of the instructions refer to, by index. */
+   struct ScriptPipeline *psPipelines;
+   struct ScriptList *psLists;
+   char **ppcNames;
+   struct ScriptFunction *psFunctions;
+
+   /* The number of references to the Script; see Script_retain(). */
+   int iRefs;
+
+   /* Where all of the above except piCode is allocated from. */
+   Arena_T oArena;
+};
+
+typedef struct Script *Script_T;
+
+int Script_isCompound(const char *pcLine, size_t uLength);
+/* Return TRUE if pcLine, of length uLength, starts with a keyword of
+   a compound command, which Script_compile() is to read, and FALSE
+   otherwise. It is a checked runtime error for pcLine to be NULL. */
+
+Script_T Script_compile(const char *pcLine, size_t uLength,
+                        long (*pfReadLine)(void *pvExtra,
+                                           char **ppcLine),
+                        void *pvExtra, char *pcProgName);
+/* Compile the compound command that pcLine, of length uLength,
+   begins, reading the rest of its lines, and the bodies of its
+   here-documents, by calling (*pfReadLine)(pvExtra, &pcNext), which
+   returns the length of the next line, without its newline, and
+   points pcNext to it, or returns -1 at EOF. Return the Script, with
+   one reference, or NULL if the command has an error, which is
+   printed to stderr. Its lines are read to its end even then.
+   pcProgName is used in printing error messages. It is a checked
+   runtime error for pcLine, pfReadLine, or pcProgName to be NULL. */
+
+void Script_retain(Script_T oScript);
+/* Add a reference to oScript. It is a checked runtime error for
+   oScript to be NULL. */
+
+void Script_release(Script_T oScript);
+/* Remove a reference to oScript, and free it if none is left. It is
+   a checked runtime error for oScript to be NULL. */
+
+#endif                      /* SCRIPT_INCLUDED */
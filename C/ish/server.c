@@ -0,0 +1,781 @@
+/*------------------------------------------------------------------*/
+/* server.c                                                         */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+/* The number of file descriptors a client sends: its stdin, stdout,
+   and stderr. */
+enum {NUM_FDS = 3};
+
+/* The exit status of a worker that a signal killed is this plus the
+   signal number, as for any command. */
+enum {SIGNAL_STATUS_BASE = 128};
+
+/* The number of clients that may wait to be accepted. */
+enum {BACKLOG = 128};
+
+/* The longest command text a worker accepts. */
+enum {MAX_TEXT_LENGTH = 16 * 1024 * 1024};
+
+enum {MIN_BUFFER_SIZE = 4096};
+
+/*------------------------------------------------------------------*/
+
+/* A Worker is a child of the server that runs the request of one
+   client. */
+
+struct Worker
+{
+   /* The pid, or -1 if the slot is free. */
+   pid_t iPid;
+
+   /* The connection to the client, which the reply is written to. */
+   int iConn;
+
+   /* When the Worker was started, in seconds. */
+   double dStart;
+};
+
+/*------------------------------------------------------------------*/
+
+/* A pipe that the signal handler writes to, so that poll() wakes up
+   when a signal arrives however close it comes to the call. */
+static int aiWakeFds[2] = {-1, -1};
+
+/* Set by the signal handler when the server is to stop. */
+static volatile sig_atomic_t iStopping = FALSE;
+
+/* The actions the signals had before the server replaced them, which
+   workers restore. */
+static struct sigaction sOldChild;
+static struct sigaction sOldTerm;
+static struct sigaction sOldInt;
+
+/*------------------------------------------------------------------*/
+
+static void handleSignal(int iSignal)
+
+/* Wake up the server, and make it stop unless iSignal is SIGCHLD. */
+
+{
+   int iErrno = errno;
+
+   if(iSignal != SIGCHLD)
+      iStopping = TRUE;
+   (void)write(aiWakeFds[1], "", 1);
+   errno = iErrno;
+}
+
+/*------------------------------------------------------------------*/
+
+static double getNow(void)
+
+/* Return the current time of a monotonic clock, in seconds. */
+
+{
+   struct timespec sNow;
+
+   if(clock_gettime(CLOCK_MONOTONIC, &sNow) == -1)
+      return 0.0;
+   return (double)sNow.tv_sec + (double)sNow.tv_nsec / 1e9;
+}
+
+/*------------------------------------------------------------------*/
+
+static double getSeconds(const struct timeval *psTime)
+
+/* Return psTime in seconds. */
+
+{
+   return (double)psTime->tv_sec + (double)psTime->tv_usec / 1e6;
+}
+
+/*------------------------------------------------------------------*/
+
+static int setAddress(struct sockaddr_un *psAddress, const char *pcPath)
+
+/* Make *psAddress the address of the Unix domain socket pcPath.
+   Return TRUE if successful, and FALSE with errno set if pcPath is
+   too long. */
+
+{
+   assert(psAddress != NULL);
+   assert(pcPath != NULL);
+
+   if(strlen(pcPath) >= sizeof(psAddress->sun_path))
+   {
+      errno = ENAMETOOLONG;
+      return FALSE;
+   }
+   memset(psAddress, 0, sizeof(*psAddress));
+   psAddress->sun_family = AF_UNIX;
+   strcpy(psAddress->sun_path, pcPath);
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static int bindSocket(int iSocket, const struct sockaddr_un *psAddress)
+
+/* Bind iSocket to *psAddress, making a socket file that only the
+   owner of the server can connect to. Return 0 if successful, and -1
+   with errno set otherwise. */
+
+/* The mode is set by the umask at bind(), so that no other user can
+   connect between making the file and a chmod(). */
+
+{
+   mode_t iOldMask;
+   int iStatus;
+
+   assert(psAddress != NULL);
+
+   iOldMask = umask(S_IRWXG | S_IRWXO);
+   iStatus = bind(iSocket, (const struct sockaddr*)psAddress,
+                  sizeof(*psAddress));
+   (void)umask(iOldMask);
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static int makeSocket(const char *pcPath, char *pcProgName)
+
+/* Return a socket that listens on pcPath, replacing any socket there
+   that no server listens on, or write an error to stderr and return
+   -1. Only the owner of the server may connect to the socket. */
+
+{
+   struct sockaddr_un sAddress;
+   struct stat sStat;
+   int iSocket;
+   int iProbe;
+   int iStatus;
+
+   assert(pcPath != NULL);
+   assert(pcProgName != NULL);
+
+   if(!setAddress(&sAddress, pcPath))
+   {
+      fprintf(stderr, "%s: ", pcProgName);
+      perror(pcPath);
+      return -1;
+   }
+   iSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+   if(iSocket == -1)
+   {
+      perror(pcProgName);
+      return -1;
+   }
+
+   iStatus = bindSocket(iSocket, &sAddress);
+   if(iStatus == -1 && errno == EADDRINUSE)
+   {
+      /* Only a socket is the server's to replace. */
+      if(lstat(pcPath, &sStat) == -1 || !S_ISSOCK(sStat.st_mode))
+      {
+         fprintf(stderr, "%s: %s: File exists\n", pcProgName, pcPath);
+         (void)close(iSocket);
+         return -1;
+      }
+
+      /* A socket left by a server that has exited refuses
+         connections. */
+      iProbe = socket(AF_UNIX, SOCK_STREAM, 0);
+      if(iProbe != -1 &&
+         connect(iProbe, (struct sockaddr*)&sAddress,
+                 sizeof(sAddress)) == 0)
+      {
+         fprintf(stderr, "%s: %s: A server is already listening\n",
+                 pcProgName, pcPath);
+         (void)close(iProbe);
+         (void)close(iSocket);
+         return -1;
+      }
+      if(iProbe != -1)
+         (void)close(iProbe);
+      (void)unlink(pcPath);
+      iStatus = bindSocket(iSocket, &sAddress);
+   }
+   if(iStatus == -1 || listen(iSocket, BACKLOG) == -1)
+   {
+      fprintf(stderr, "%s: ", pcProgName);
+      perror(pcPath);
+      (void)close(iSocket);
+      return -1;
+   }
+   return iSocket;
+}
+
+/*------------------------------------------------------------------*/
+
+static int isFromOwner(int iConn)
+
+/* Return TRUE if the client on the connection iConn runs as the
+   user the server runs as, and FALSE otherwise. */
+
+/* The mode of the socket file already keeps other users out, unless
+   the file was replaced or its mode changed; a client that gets in
+   would run commands as the owner of the server. */
+
+{
+   struct ucred sCred;
+   socklen_t iLength = sizeof(sCred);
+
+   if(getsockopt(iConn, SOL_SOCKET, SO_PEERCRED, &sCred,
+                 &iLength) == -1)
+      return FALSE;
+   return sCred.uid == geteuid();
+}
+
+/*------------------------------------------------------------------*/
+
+static int setSignals(void)
+
+/* Make the signals the server waits for write to the wake pipe,
+   saving their old actions. Return TRUE if successful, and FALSE
+   with errno set otherwise. */
+
+/* SA_RESTART is not set, so no system call hides a signal, though
+   poll() returns at the write to the pipe in any case. */
+
+{
+   struct sigaction sAction;
+
+   memset(&sAction, 0, sizeof(sAction));
+   sAction.sa_handler = handleSignal;
+   (void)sigemptyset(&sAction.sa_mask);
+   sAction.sa_flags = SA_NOCLDSTOP;
+   return sigaction(SIGCHLD, &sAction, &sOldChild) == 0 &&
+          sigaction(SIGTERM, &sAction, &sOldTerm) == 0 &&
+          sigaction(SIGINT, &sAction, &sOldInt) == 0;
+}
+
+/*------------------------------------------------------------------*/
+
+static void restoreSignals(void)
+
+/* Give the signals the server waits for their old actions. */
+
+{
+   (void)sigaction(SIGCHLD, &sOldChild, NULL);
+   (void)sigaction(SIGTERM, &sOldTerm, NULL);
+   (void)sigaction(SIGINT, &sOldInt, NULL);
+}
+
+/*------------------------------------------------------------------*/
+
+static char *readRequest(int iConn, int *piFds, size_t *puLength)
+
+/* Read from the connection iConn the file descriptors of a request
+   into piFds, which has room for NUM_FDS, and its command text,
+   which is returned, terminated, in memory the caller owns, with its
+   length in *puLength. Return NULL if the request is malformed. */
+
+/* The file descriptors arrive with the first byte, so they are read
+   with recvmsg(); the text is then read with read(). */
+
+{
+   union
+   {
+      struct cmsghdr sHeader;
+      char ac[CMSG_SPACE(NUM_FDS * sizeof(int))];
+   } uControl;
+   struct msghdr sMessage;
+   struct cmsghdr *psHeader;
+   struct iovec sVector;
+   char *pcText;
+   char cFirst;
+   size_t uLength = 0;
+   size_t uSize = MIN_BUFFER_SIZE;
+   ssize_t lCount;
+   int iNumFds = 0;
+   int i;
+
+   assert(piFds != NULL);
+   assert(puLength != NULL);
+
+   memset(&sMessage, 0, sizeof(sMessage));
+   sVector.iov_base = &cFirst;
+   sVector.iov_len = 1;
+   sMessage.msg_iov = &sVector;
+   sMessage.msg_iovlen = 1;
+   sMessage.msg_control = uControl.ac;
+   sMessage.msg_controllen = sizeof(uControl.ac);
+   do
+      lCount = recvmsg(iConn, &sMessage, 0);
+   while(lCount == -1 && errno == EINTR);
+   if(lCount != 1)
+      return NULL;
+
+   for(psHeader = CMSG_FIRSTHDR(&sMessage); psHeader != NULL;
+       psHeader = CMSG_NXTHDR(&sMessage, psHeader))
+      if(psHeader->cmsg_level == SOL_SOCKET &&
+         psHeader->cmsg_type == SCM_RIGHTS)
+      {
+         iNumFds = (int)((psHeader->cmsg_len - CMSG_LEN(0)) /
+                         sizeof(int));
+         if(iNumFds > NUM_FDS)
+            iNumFds = NUM_FDS;
+         memcpy(piFds, CMSG_DATA(psHeader),
+                (size_t)iNumFds * sizeof(int));
+      }
+   if(iNumFds != NUM_FDS || (sMessage.msg_flags & MSG_CTRUNC))
+   {
+      for(i = 0; i < iNumFds; i++)
+         (void)close(piFds[i]);
+      return NULL;
+   }
+
+   pcText = (char*)malloc(uSize);
+   assert(pcText != NULL);
+   for(;;)
+   {
+      if(uLength + 1 == uSize)
+      {
+         uSize *= 2;
+         pcText = (char*)realloc(pcText, uSize);
+         assert(pcText != NULL);
+      }
+      lCount = read(iConn, pcText + uLength, uSize - uLength - 1);
+      if(lCount == -1 && errno == EINTR)
+         continue;
+      if(lCount <= 0)
+         break;
+      uLength += (size_t)lCount;
+      if(uLength > MAX_TEXT_LENGTH)
+      {
+         lCount = -1;
+         break;
+      }
+   }
+   if(lCount < 0)
+   {
+      for(i = 0; i < NUM_FDS; i++)
+         (void)close(piFds[i]);
+      free(pcText);
+      return NULL;
+   }
+   pcText[uLength] = '\0';
+   *puLength = uLength;
+   return pcText;
+}
+
+/*------------------------------------------------------------------*/
+
+static void runWorker(int iConn,
+                      int (*pfRun)(FILE *psFile, void *pvExtra,
+                                   char *pcProgName),
+                      void *pvExtra, char *pcProgName)
+
+/* Read the request of the client on the connection iConn, and run
+   it as the worker that serverRun() describes. Never return. */
+
+{
+   FILE *psFile;
+   char *pcText;
+   size_t uLength;
+   int aiFds[NUM_FDS];
+   int iStatus;
+   int i;
+
+   assert(pfRun != NULL);
+   assert(pcProgName != NULL);
+
+   restoreSignals();
+   (void)close(aiWakeFds[0]);
+   (void)close(aiWakeFds[1]);
+
+   pcText = readRequest(iConn, aiFds, &uLength);
+   (void)close(iConn);
+   if(pcText == NULL)
+   {
+      fprintf(stderr, "%s: Malformed request\n", pcProgName);
+      exit(EXIT_FAILURE);
+   }
+
+   for(i = 0; i < NUM_FDS; i++)
+      if(aiFds[i] != i && dup2(aiFds[i], i) == -1)
+      {
+         perror(pcProgName);
+         exit(EXIT_FAILURE);
+      }
+   for(i = 0; i < NUM_FDS; i++)
+      if(aiFds[i] >= NUM_FDS)
+         (void)close(aiFds[i]);
+
+   /* An empty text has nothing to run, and fmemopen() rejects it. */
+   if(uLength == 0)
+      exit(0);
+   psFile = fmemopen(pcText, uLength, "r");
+   if(psFile == NULL)
+   {
+      perror(pcProgName);
+      exit(EXIT_FAILURE);
+   }
+   iStatus = (*pfRun)(psFile, pvExtra, pcProgName);
+   (void)fclose(psFile);
+   exit(iStatus);
+}
+
+/*------------------------------------------------------------------*/
+
+static void startWorker(struct Worker *psWorker, int iListen,
+                        int iConn,
+                        int (*pfRun)(FILE *psFile, void *pvExtra,
+                                     char *pcProgName),
+                        void *pvExtra, char *pcProgName)
+
+/* Start in the free slot psWorker a worker for the client on the
+   connection iConn, accepted from the socket iListen. If it cannot
+   be started, write an error to stderr and close iConn, so the
+   client gets no reply. */
+
+{
+   pid_t iPid;
+
+   assert(psWorker != NULL);
+   assert(psWorker->iPid == -1);
+
+   /* Anything buffered would otherwise be written again by the
+      worker, to the client. */
+   fflush(NULL);
+   psWorker->dStart = getNow();
+   iPid = fork();
+   if(iPid == -1)
+   {
+      perror(pcProgName);
+      (void)close(iConn);
+      return;
+   }
+   if(iPid == 0)
+   {
+      (void)close(iListen);
+      runWorker(iConn, pfRun, pvExtra, pcProgName);
+   }
+   psWorker->iPid = iPid;
+   psWorker->iConn = iConn;
+}
+
+/*------------------------------------------------------------------*/
+
+static void finishWorker(struct Worker *psWorker, int iWaitStatus,
+                         const struct rusage *psUsage)
+
+/* Write to the client of psWorker, which exited with the wait status
+   iWaitStatus and the resource usage *psUsage, its reply, and free
+   its slot. */
+
+/* The usage that wait4() reports includes that of the processes the
+   worker waited for, so it covers every command of the request. A
+   client that has gone away is ignored: MSG_NOSIGNAL keeps SIGPIPE
+   from killing the server. */
+
+{
+   struct ServerReply sReply;
+
+   assert(psWorker != NULL);
+   assert(psUsage != NULL);
+
+   memset(&sReply, 0, sizeof(sReply));
+   if(WIFSIGNALED(iWaitStatus))
+      sReply.iStatus = SIGNAL_STATUS_BASE + WTERMSIG(iWaitStatus);
+   else
+      sReply.iStatus = WEXITSTATUS(iWaitStatus);
+   sReply.dWall = getNow() - psWorker->dStart;
+   sReply.dUser = getSeconds(&psUsage->ru_utime);
+   sReply.dSys = getSeconds(&psUsage->ru_stime);
+   sReply.lMaxRss = psUsage->ru_maxrss;
+   (void)send(psWorker->iConn, &sReply, sizeof(sReply), MSG_NOSIGNAL);
+   (void)close(psWorker->iConn);
+   psWorker->iPid = -1;
+}
+
+/*------------------------------------------------------------------*/
+
+static int reapWorkers(struct Worker *psWorkers, int iMaxWorkers)
+
+/* Reap, without blocking, every child of the server that has exited,
+   finishing those that are among the iMaxWorkers slots of
+   psWorkers, and return the number of them. */
+
+/* Background jobs of the .ishrc are children of the server as well;
+   they are simply reaped. */
+
+{
+   struct rusage sUsage;
+   pid_t iPid;
+   int iWaitStatus;
+   int iNumReaped = 0;
+   int i;
+
+   assert(psWorkers != NULL);
+
+   while((iPid = wait4(-1, &iWaitStatus, WNOHANG, &sUsage)) > 0)
+      for(i = 0; i < iMaxWorkers; i++)
+         if(psWorkers[i].iPid == iPid)
+         {
+            finishWorker(&psWorkers[i], iWaitStatus, &sUsage);
+            iNumReaped++;
+            break;
+         }
+   return iNumReaped;
+}
+
+/*------------------------------------------------------------------*/
+
+int serverRun(const char *pcPath, int iMaxWorkers,
+              int (*pfRun)(FILE *psFile, void *pvExtra,
+                           char *pcProgName),
+              void *pvExtra, char *pcProgName)
+
+/* Listen on a Unix domain socket bound to pcPath, and serve clients
+   with at most iMaxWorkers workers at a time until SIGTERM or SIGINT
+   arrives; then wait for the workers, remove the socket, and return
+   0. Each worker runs the command text of its client by calling
+   (*pfRun)(psFile, pvExtra, pcProgName), where psFile reads the
+   text, and exits with the status that it returns, if it returns.
+   Only clients of the user the server runs as are served. Return
+   EXIT_FAILURE if the socket cannot be made, if another server is
+   listening on pcPath, or if a file other than a socket is there; a
+   socket that no server listens on is replaced. pcProgName is used
+   in printing error messages. It is a checked runtime error for
+   pcPath, pfRun, or pcProgName to be NULL. It is a checked runtime
+   error for iMaxWorkers to be non-positive. */
+
+/* The server is a single loop around poll(): it waits for a client
+   only while a slot is free, and for the wake pipe always. The
+   limit thus holds the rest of the clients in the listen queue,
+   where they cost the server nothing. */
+
+{
+   struct Worker *psWorkers;
+   struct pollfd asPoll[2];
+   char acDrain[MIN_BUFFER_SIZE];
+   int iNumWorkers = 0;
+   int iNumPoll;
+   int iListen;
+   int iConn;
+   int iStatus = 0;
+   int i;
+
+   assert(pcPath != NULL);
+   assert(iMaxWorkers > 0);
+   assert(pfRun != NULL);
+   assert(pcProgName != NULL);
+
+   iListen = makeSocket(pcPath, pcProgName);
+   if(iListen == -1)
+      return EXIT_FAILURE;
+   if(pipe(aiWakeFds) == -1 ||
+      fcntl(aiWakeFds[0], F_SETFL, O_NONBLOCK) == -1 ||
+      fcntl(aiWakeFds[1], F_SETFL, O_NONBLOCK) == -1 ||
+      !setSignals())
+   {
+      perror(pcProgName);
+      exit(EXIT_FAILURE);
+   }
+
+   psWorkers = (struct Worker*)malloc((size_t)iMaxWorkers *
+                                      sizeof(struct Worker));
+   assert(psWorkers != NULL);
+   for(i = 0; i < iMaxWorkers; i++)
+      psWorkers[i].iPid = -1;
+
+   for(;;)
+   {
+      iNumWorkers -= reapWorkers(psWorkers, iMaxWorkers);
+      if(iStopping && iNumWorkers == 0)
+         break;
+
+      asPoll[0].fd = aiWakeFds[0];
+      asPoll[0].events = POLLIN;
+      asPoll[1].fd = iListen;
+      asPoll[1].events = POLLIN;
+      asPoll[1].revents = 0;
+      iNumPoll = (!iStopping && iNumWorkers < iMaxWorkers) ? 2 : 1;
+      if(poll(asPoll, (nfds_t)iNumPoll, -1) == -1)
+      {
+         if(errno == EINTR)
+            continue;
+         perror(pcProgName);
+         iStatus = EXIT_FAILURE;
+         break;
+      }
+      if(asPoll[0].revents & POLLIN)
+         while(read(aiWakeFds[0], acDrain, sizeof(acDrain)) > 0)
+            ;
+      if(iStopping || !(asPoll[1].revents & POLLIN))
+         continue;
+
+      iConn = accept(iListen, NULL, NULL);
+      if(iConn == -1)
+      {
+         /* A client may give up before it is accepted. */
+         if(errno != EINTR && errno != ECONNABORTED)
+            perror(pcProgName);
+         continue;
+      }
+      if(!isFromOwner(iConn))
+      {
+         fprintf(stderr, "%s: Refused a client of another user\n",
+                 pcProgName);
+         (void)close(iConn);
+         continue;
+      }
+      for(i = 0; psWorkers[i].iPid != -1; i++)
+         ;
+      startWorker(&psWorkers[i], iListen, iConn, pfRun, pvExtra,
+                  pcProgName);
+      if(psWorkers[i].iPid != -1)
+         iNumWorkers++;
+   }
+
+   /* Workers still running after a failure are left to finish, but
+      their clients get no reply. */
+   for(i = 0; i < iMaxWorkers; i++)
+      if(psWorkers[i].iPid != -1)
+         (void)close(psWorkers[i].iConn);
+   free(psWorkers);
+   restoreSignals();
+   (void)close(aiWakeFds[0]);
+   (void)close(aiWakeFds[1]);
+   (void)close(iListen);
+   (void)unlink(pcPath);
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static int exchange(int iSocket, const char *pcText, size_t uLength,
+                    struct ServerReply *psReply)
+
+/* Send a request of the command text pcText, of length uLength, on
+   the connected socket iSocket, and read its reply into *psReply.
+   Return TRUE if successful, and FALSE with errno set otherwise. */
+
+{
+   union
+   {
+      struct cmsghdr sHeader;
+      char ac[CMSG_SPACE(NUM_FDS * sizeof(int))];
+   } uControl;
+   struct msghdr sMessage;
+   struct cmsghdr *psHeader;
+   struct iovec sVector;
+   int aiFds[NUM_FDS];
+   char cFirst = '\0';
+   size_t uDone;
+   ssize_t lCount;
+   int i;
+
+   assert(pcText != NULL);
+   assert(psReply != NULL);
+
+   for(i = 0; i < NUM_FDS; i++)
+      aiFds[i] = i;
+   memset(&sMessage, 0, sizeof(sMessage));
+   memset(&uControl, 0, sizeof(uControl));
+   sVector.iov_base = &cFirst;
+   sVector.iov_len = 1;
+   sMessage.msg_iov = &sVector;
+   sMessage.msg_iovlen = 1;
+   sMessage.msg_control = uControl.ac;
+   sMessage.msg_controllen = sizeof(uControl.ac);
+   psHeader = CMSG_FIRSTHDR(&sMessage);
+   psHeader->cmsg_level = SOL_SOCKET;
+   psHeader->cmsg_type = SCM_RIGHTS;
+   psHeader->cmsg_len = CMSG_LEN(NUM_FDS * sizeof(int));
+   memcpy(CMSG_DATA(psHeader), aiFds, sizeof(aiFds));
+   if(sendmsg(iSocket, &sMessage, MSG_NOSIGNAL) != 1)
+      return FALSE;
+
+   for(uDone = 0; uDone < uLength; uDone += (size_t)lCount)
+   {
+      lCount = send(iSocket, pcText + uDone, uLength - uDone,
+                    MSG_NOSIGNAL);
+      if(lCount == -1 && errno == EINTR)
+         lCount = 0;
+      else if(lCount == -1)
+         return FALSE;
+   }
+   if(shutdown(iSocket, SHUT_WR) == -1)
+      return FALSE;
+
+   for(uDone = 0; uDone < sizeof(*psReply); uDone += (size_t)lCount)
+   {
+      lCount = read(iSocket, (char*)psReply + uDone,
+                    sizeof(*psReply) - uDone);
+      if(lCount == -1 && errno == EINTR)
+         lCount = 0;
+      else if(lCount == -1)
+         return FALSE;
+      else if(lCount == 0)
+      {
+         /* The server closed the connection without replying. */
+         errno = ECONNRESET;
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+int serverRequest(const char *pcPath, const char *pcText,
+                  size_t uLength, struct ServerReply *psReply)
+
+/* Send the command text pcText, of length uLength, to the server
+   listening on pcPath, with the stdin, stdout, and stderr of the
+   calling process, wait for the server to run it, and store its
+   reply in *psReply. Return TRUE if successful, and FALSE with errno
+   set otherwise. It is a checked runtime error for pcPath, pcText,
+   or psReply to be NULL. */
+
+{
+   struct sockaddr_un sAddress;
+   int iSocket;
+   int iSuccessful;
+   int iErrno;
+
+   assert(pcPath != NULL);
+   assert(pcText != NULL);
+   assert(psReply != NULL);
+
+   if(!setAddress(&sAddress, pcPath))
+      return FALSE;
+   iSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+   if(iSocket == -1)
+      return FALSE;
+   iSuccessful = connect(iSocket, (struct sockaddr*)&sAddress,
+                         sizeof(sAddress)) == 0 &&
+                 exchange(iSocket, pcText, uLength, psReply);
+   iErrno = errno;
+   (void)close(iSocket);
+   errno = iErrno;
+   return iSuccessful;
+}
@@ -0,0 +1,73 @@
+/*------------------------------------------------------------------*/
+/* server.h                                                         */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef SERVER_INCLUDED
+#define SERVER_INCLUDED
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* An exec server is a shell that has read its .ishrc once and then
+   runs the command text of each client that connects to its Unix
+   domain socket, so no client pays for starting a shell. Each
+   request runs in a worker, a child of the server that inherits its
+   state, with the client's stdin, stdout, and stderr; at most a
+   fixed number of workers run at a time, and further clients wait
+   to be accepted.
+
+   A client connects, and sends its stdin, stdout, and stderr with
+   SCM_RIGHTS along with one byte, which is not part of the command
+   text, since file descriptors cannot be sent without data. It then
+   sends the text, and shuts down its side of the connection for
+   writing, which ends the text. The server writes one struct
+   ServerReply once the worker has exited. */
+
+/* What the server tells a client about its request. */
+
+struct ServerReply
+{
+   /* The exit status of the command text: that of its last line, or
+      128 plus the signal number if a signal killed the worker. */
+   int iStatus;
+
+   /* The wall time of the worker, and the user and system CPU time
+      of it and the processes it waited for, in seconds. */
+   double dWall;
+   double dUser;
+   double dSys;
+
+   /* The maximum resident set size of the worker and the processes
+      it waited for, in kilobytes. */
+   long lMaxRss;
+};
+
+int serverRun(const char *pcPath, int iMaxWorkers,
+              int (*pfRun)(FILE *psFile, void *pvExtra,
+                           char *pcProgName),
+              void *pvExtra, char *pcProgName);
+/* Listen on a Unix domain socket bound to pcPath, and serve clients
+   with at most iMaxWorkers workers at a time until SIGTERM or SIGINT
+   arrives; then wait for the workers, remove the socket, and return
+   0. Each worker runs the command text of its client by calling
+   (*pfRun)(psFile, pvExtra, pcProgName), where psFile reads the
+   text, and exits with the status that it returns, if it returns.
+   Only clients of the user the server runs as are served. Return
+   EXIT_FAILURE if the socket cannot be made, if another server is
+   listening on pcPath, or if a file other than a socket is there; a
+   socket that no server listens on is replaced. pcProgName is used
+   in printing error messages. It is a checked runtime error for
+   pcPath, pfRun, or pcProgName to be NULL. It is a checked runtime
+   error for iMaxWorkers to be non-positive. */
+
+int serverRequest(const char *pcPath, const char *pcText,
+                  size_t uLength, struct ServerReply *psReply);
+/* Send the command text pcText, of length uLength, to the server
+   listening on pcPath, with the stdin, stdout, and stderr of the
+   calling process, wait for the server to run it, and store its
+   reply in *psReply. Return TRUE if successful, and FALSE with errno
+   set otherwise. It is a checked runtime error for pcPath, pcText,
+   or psReply to be NULL. */
+
+#endif                      /* SERVER_INCLUDED */
@@ -0,0 +1,234 @@
+/*------------------------------------------------------------------*/
+/* smallarray.c                                                     */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#include "smallarray.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+enum {GROWTH_FACTOR = 2};
+
+/*------------------------------------------------------------------*/
+
+#ifndef NDEBUG
+static int isValid(SmallArray_T oArray)
+
+/* Check the invariants of oArray. Return TRUE iff oArray is in a 
+   valid state. */
+
+{
+   if(oArray->uElementSize == 0) return FALSE;
+   if(oArray->iLength < 0) return FALSE;
+   if(oArray->iLength > oArray->iPhysLength) return FALSE;
+   if(oArray->pcElements == NULL) return FALSE;
+   if(oArray->pcElements == oArray->uInline.ac &&
+      (size_t)oArray->iPhysLength * oArray->uElementSize > 
+      SMALLARRAY_INLINE_SIZE) return FALSE;
+   return TRUE;
+}
+#endif
+
+/*------------------------------------------------------------------*/
+
+void SmallArray_init(SmallArray_T oArray, size_t uElementSize)
+
+/* Make oArray an empty SmallArray of elements of uElementSize 
+   bytes. It is a checked runtime error for oArray to be NULL. It is
+   a checked runtime error for uElementSize to be 0. */
+
+{
+   assert(oArray != NULL);
+   assert(uElementSize > 0);
+
+   oArray->uElementSize = uElementSize;
+   oArray->iLength = 0;
+   oArray->iPhysLength = (int)(SMALLARRAY_INLINE_SIZE / uElementSize);
+   oArray->pcElements = oArray->uInline.ac;
+}
+
+/*------------------------------------------------------------------*/
+
+void SmallArray_free(SmallArray_T oArray)
+
+/* Free the heap memory of oArray, if any, and make it empty. It may
+   be used again. It is a checked runtime error for oArray to be 
+   NULL. */
+
+{
+   assert(oArray != NULL);
+   assert(isValid(oArray));
+
+   if(oArray->pcElements != oArray->uInline.ac)
+      free(oArray->pcElements);
+   SmallArray_init(oArray, oArray->uElementSize);
+}
+
+/*------------------------------------------------------------------*/
+
+int SmallArray_getLength(SmallArray_T oArray)
+
+/* Return the length of oArray. It is a checked runtime error for 
+   oArray to be NULL. */
+
+{
+   assert(oArray != NULL);
+   assert(isValid(oArray));
+
+   return oArray->iLength;
+}
+
+/*------------------------------------------------------------------*/
+
+void *SmallArray_get(SmallArray_T oArray, int iIndex)
+
+/* Return a pointer to the iIndex'th element of oArray. It remains 
+   valid until oArray grows. It is a checked runtime error for oArray
+   to be NULL. It is a checked runtime error for iIndex to be less 
+   than 0 or greater than or equal to the length of oArray. */
+
+{
+   assert(oArray != NULL);
+   assert(isValid(oArray));
+   assert(iIndex >= 0);
+   assert(iIndex < oArray->iLength);
+
+   return oArray->pcElements + (size_t)iIndex * oArray->uElementSize;
+}
+
+/*------------------------------------------------------------------*/
+
+void *SmallArray_getArray(SmallArray_T oArray)
+
+/* Return a pointer to the first element of oArray, which its other
+   elements follow contiguously. It remains valid until oArray grows.
+   It is a checked runtime error for oArray to be NULL. */
+
+{
+   assert(oArray != NULL);
+   assert(isValid(oArray));
+
+   return oArray->pcElements;
+}
+
+/*------------------------------------------------------------------*/
+
+void SmallArray_reserve(SmallArray_T oArray, int iLength)
+
+/* Make oArray able to hold iLength elements without growing. It is
+   a checked runtime error for oArray to be NULL. It is a checked 
+   runtime error for iLength to be negative. */
+
+/* The physical length at least doubles, so adding elements one at a
+   time takes amortized constant time. Elements move to the heap the
+   first time the array outgrows its inline storage. */
+
+{
+   int iPhysLength;
+   char *pcElements;
+
+   assert(oArray != NULL);
+   assert(isValid(oArray));
+   assert(iLength >= 0);
+
+   if(iLength <= oArray->iPhysLength)
+      return;
+
+   iPhysLength = oArray->iPhysLength * GROWTH_FACTOR;
+   if(iPhysLength < iLength)
+      iPhysLength = iLength;
+   if(oArray->pcElements == oArray->uInline.ac)
+   {
+      pcElements = (char*)malloc((size_t)iPhysLength * 
+                                 oArray->uElementSize);
+      assert(pcElements != NULL);
+      memcpy(pcElements, oArray->uInline.ac, 
+             (size_t)oArray->iLength * oArray->uElementSize);
+   }
+   else
+   {
+      pcElements = (char*)realloc(oArray->pcElements, 
+                                  (size_t)iPhysLength * 
+                                  oArray->uElementSize);
+      assert(pcElements != NULL);
+   }
+   oArray->pcElements = pcElements;
+   oArray->iPhysLength = iPhysLength;
+}
+
+/*------------------------------------------------------------------*/
+
+void SmallArray_setLength(SmallArray_T oArray, int iLength)
+
+/* Make the length of oArray iLength, removing elements from its end
+   or adding elements whose bytes are all 0. It is a checked runtime
+   error for oArray to be NULL. It is a checked runtime error for 
+   iLength to be negative. */
+
+{
+   assert(oArray != NULL);
+   assert(isValid(oArray));
+   assert(iLength >= 0);
+
+   if(iLength > oArray->iLength)
+   {
+      SmallArray_reserve(oArray, iLength);
+      memset(oArray->pcElements + 
+             (size_t)oArray->iLength * oArray->uElementSize, 0,
+             (size_t)(iLength - oArray->iLength) * 
+             oArray->uElementSize);
+   }
+   oArray->iLength = iLength;
+}
+
+/*------------------------------------------------------------------*/
+
+void *SmallArray_add(SmallArray_T oArray, const void *pvElement)
+
+/* Add a copy of the element at pvElement to the end of oArray, thus
+   incrementing its length, and return a pointer to the copy. It is a
+   checked runtime error for oArray or pvElement to be NULL. */
+
+{
+   char *pcElement;
+
+   assert(oArray != NULL);
+   assert(isValid(oArray));
+   assert(pvElement != NULL);
+
+   if(oArray->iLength == oArray->iPhysLength)
+      SmallArray_reserve(oArray, oArray->iLength + 1);
+   pcElement = oArray->pcElements + 
+      (size_t)oArray->iLength * oArray->uElementSize;
+   memcpy(pcElement, pvElement, oArray->uElementSize);
+   oArray->iLength++;
+   return pcElement;
+}
+
+/*------------------------------------------------------------------*/
+
+void SmallArray_addAll(SmallArray_T oArray, const void *pvElements,
+                       int iCount)
+
+/* Add copies of the iCount consecutive elements at pvElements to the
+   end of oArray, thus increasing its length by iCount. It is a 
+   checked runtime error for oArray or pvElements to be NULL. It is a
+   checked runtime error for iCount to be negative. */
+
+{
+   assert(oArray != NULL);
+   assert(isValid(oArray));
+   assert(pvElements != NULL);
+   assert(iCount >= 0);
+
+   SmallArray_reserve(oArray, oArray->iLength + iCount);
+   memcpy(oArray->pcElements + 
+          (size_t)oArray->iLength * oArray->uElementSize,
+          pvElements, (size_t)iCount * oArray->uElementSize);
+   oArray->iLength += iCount;
+}
@@ -0,0 +1,87 @@
+/*------------------------------------------------------------------*/
+/* smallarray.h                                                     */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef SMALLARRAY_INCLUDED
+#define SMALLARRAY_INCLUDED
+
+#include <stddef.h>
+
+/* The number of bytes of elements a SmallArray holds within 
+   itself. */
+enum {SMALLARRAY_INLINE_SIZE = 128};
+
+/* A SmallArray is an array of fixed-size elements stored by value,
+   whose length can expand dynamically. Its first elements are stored
+   within the SmallArray, so one that is declared as a local variable
+   and stays short needs no heap memory. Its fields are private to 
+   smallarray.c. A SmallArray must not be copied, since it may point
+   into itself. */
+
+struct SmallArray
+{
+   size_t uElementSize;
+   int iLength;
+   int iPhysLength;
+   char *pcElements;
+   union
+   {
+      char ac[SMALLARRAY_INLINE_SIZE];
+      long l;
+      double d;
+      void *pv;
+   } uInline;
+};
+
+typedef struct SmallArray *SmallArray_T;
+
+void SmallArray_init(SmallArray_T oArray, size_t uElementSize);
+/* Make oArray an empty SmallArray of elements of uElementSize 
+   bytes. It is a checked runtime error for oArray to be NULL. It is
+   a checked runtime error for uElementSize to be 0. */
+
+void SmallArray_free(SmallArray_T oArray);
+/* Free the heap memory of oArray, if any, and make it empty. It may
+   be used again. It is a checked runtime error for oArray to be 
+   NULL. */
+
+int SmallArray_getLength(SmallArray_T oArray);
+/* Return the length of oArray. It is a checked runtime error for 
+   oArray to be NULL. */
+
+void *SmallArray_get(SmallArray_T oArray, int iIndex);
+/* Return a pointer to the iIndex'th element of oArray. It remains 
+   valid until oArray grows. It is a checked runtime error for oArray
+   to be NULL. It is a checked runtime error for iIndex to be less 
+   than 0 or greater than or equal to the length of oArray. */
+
+void *SmallArray_getArray(SmallArray_T oArray);
+/* Return a pointer to the first element of oArray, which its other
+   elements follow contiguously. It remains valid until oArray grows.
+   It is a checked runtime error for oArray to be NULL. */
+
+void SmallArray_reserve(SmallArray_T oArray, int iLength);
+/* Make oArray able to hold iLength elements without growing. It is
+   a checked runtime error for oArray to be NULL. It is a checked 
+   runtime error for iLength to be negative. */
+
+void SmallArray_setLength(SmallArray_T oArray, int iLength);
+/* Make the length of oArray iLength, removing elements from its end
+   or adding elements whose bytes are all 0. It is a checked runtime
+   error for oArray to be NULL. It is a checked runtime error for 
+   iLength to be negative. */
+
+void *SmallArray_add(SmallArray_T oArray, const void *pvElement);
+/* Add a copy of the element at pvElement to the end of oArray, thus
+   incrementing its length, and return a pointer to the copy. It is a
+   checked runtime error for oArray or pvElement to be NULL. */
+
+void SmallArray_addAll(SmallArray_T oArray, const void *pvElements,
+                       int iCount);
+/* Add copies of the iCount consecutive elements at pvElements to the
+   end of oArray, thus increasing its length by iCount. It is a 
+   checked runtime error for oArray or pvElements to be NULL. It is a
+   checked runtime error for iCount to be negative. */
+
+#endif                      /* SMALLARRAY_INCLUDED */
@@ -0,0 +1,739 @@
+/*------------------------------------------------------------------*/
+/* util.c                                                           */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "hist.h"
+#include "util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+/* The exit status of test for an invalid expression. */
+enum {TEST_ERROR = 2};
+
+/* The size of the buffer that cat copies through when the kernel
+   cannot copy for it. */
+enum {COPY_BUFFER_SIZE = 65536};
+
+/* The most bytes that one call of copy_file_range() or sendfile()
+   is asked to copy. */
+enum {MAX_COPY_CHUNK = 1 << 30};
+
+/* The longest printf conversion specification that is accepted. */
+enum {MAX_SPEC_SIZE = 32};
+
+/*------------------------------------------------------------------*/
+
+int utilEchoAccepts(char **ppcArray)
+
+/* Return TRUE if utilEcho() handles the arguments in ppcArray, and
+   FALSE if they need another echo's options. It is a checked
+   runtime error for ppcArray to be NULL. */
+
+{
+   assert(ppcArray != NULL);
+
+   return ppcArray[1] == NULL || ppcArray[1][0] != '-' ||
+          strcmp(ppcArray[1], "-n") == 0 ||
+          strcmp(ppcArray[1], "-") == 0;
+}
+
+/*------------------------------------------------------------------*/
+
+int utilEcho(char **ppcArray, int iNumArg, History_T oHistList,
+             char *pcProgName)
+
+/* Write the arguments in ppcArray to stdout, separated by spaces and
+   followed by a newline, which is omitted if the first argument is
+   "-n". Return 0. It is a checked runtime error for ppcArray or
+   pcProgName to be NULL. */
+
+{
+   int iNewline = TRUE;
+   int i = 1;
+
+   assert(ppcArray != NULL);
+   assert(pcProgName != NULL);
+
+   if(iNumArg > 0 && strcmp(ppcArray[1], "-n") == 0)
+   {
+      iNewline = FALSE;
+      i++;
+   }
+   for(; i <= iNumArg; i++)
+   {
+      fputs(ppcArray[i], stdout);
+      if(i < iNumArg)
+         putchar(' ');
+   }
+   if(iNewline)
+      putchar('\n');
+   return 0;
+}
+
+/*------------------------------------------------------------------*/
+
+static const char *writeEscape(const char *pc)
+
+/* Write the character that the escape sequence after the backslash
+   at pc stands for to stdout, and return a pointer to the character
+   after the sequence. */
+
+{
+   int iValue;
+   int i;
+
+   pc++;
+   switch(*pc)
+   {
+      case 'a': putchar('\a'); return pc + 1;
+      case 'b': putchar('\b'); return pc + 1;
+      case 'f': putchar('\f'); return pc + 1;
+      case 'n': putchar('\n'); return pc + 1;
+      case 'r': putchar('\r'); return pc + 1;
+      case 't': putchar('\t'); return pc + 1;
+      case 'v': putchar('\v'); return pc + 1;
+      case '\\': putchar('\\'); return pc + 1;
+      case '\0': putchar('\\'); return pc;
+      default: break;
+   }
+   if(*pc >= '0' && *pc <= '7')
+   {
+      iValue = 0;
+      for(i = 0; i < 3 && *pc >= '0' && *pc <= '7'; i++, pc++)
+         iValue = iValue * 8 + (*pc - '0');
+      putchar(iValue);
+      return pc;
+   }
+   putchar('\\');
+   putchar(*pc);
+   return pc + 1;
+}
+
+/*------------------------------------------------------------------*/
+
+static int getNumber(const char *pcArg, long *plValue,
+                     unsigned long *pulValue, char *pcProgName)
+
+/* Store the number pcArg spells in *plValue if plValue is not NULL,
+   and in *pulValue otherwise. A leading quote stands for the value
+   of the character after it. Return TRUE if pcArg is a valid
+   number, and FALSE otherwise; print an error message to stderr in
+   that case. pcProgName is used in printing error messages. */
+
+{
+   char *pcEnd;
+
+   if(pcArg[0] == '"' || pcArg[0] == '\'')
+   {
+      if(plValue != NULL)
+         *plValue = (unsigned char)pcArg[1];
+      else
+         *pulValue = (unsigned char)pcArg[1];
+      return TRUE;
+   }
+
+   errno = 0;
+   if(plValue != NULL)
+      *plValue = strtol(pcArg, &pcEnd, 0);
+   else
+      *pulValue = strtoul(pcArg, &pcEnd, 0);
+   if(*pcArg == '\0' || *pcEnd != '\0' || errno != 0)
+   {
+      fprintf(stderr, "%s: printf: %s: Invalid number\n", pcProgName,
+              pcArg);
+      return FALSE;
+   }
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static const char *writeConversion(const char *pc, const char *pcArg,
+                                   int *piStatus, char *pcProgName)
+
+/* Write pcArg to stdout as the conversion specification at pc, just
+   after its '%', describes, and return a pointer to the character
+   after the specification. pcArg is "" if there is no argument. Set
+   *piStatus to 1 if the specification or pcArg is invalid, and print
+   an error message to stderr in that case. pcProgName is used in
+   printing error messages. */
+
+{
+   char acSpec[MAX_SPEC_SIZE + 2];
+   const char *pcStart = pc - 1;
+   size_t uLength;
+   long lValue;
+   unsigned long ulValue;
+   double dValue;
+   char *pcEnd;
+
+   pc += strspn(pc, "-+ #0");
+   while(isdigit((unsigned char)*pc))
+      pc++;
+   if(*pc == '.')
+   {
+      pc++;
+      while(isdigit((unsigned char)*pc))
+         pc++;
+   }
+
+   /* Copy the flags, width, and precision, leaving room for an 'l'
+      and the conversion character. */
+   uLength = (size_t)(pc - pcStart);
+   if(*pc == '\0' || uLength > MAX_SPEC_SIZE - 1 ||
+      strchr("diouxXcsbeEfgG", *pc) == NULL)
+   {
+      fprintf(stderr, "%s: printf: %.*s: Invalid conversion\n",
+              pcProgName, (int)(uLength + (*pc != '\0')), pcStart);
+      *piStatus = 1;
+      return (*pc == '\0') ? pc : pc + 1;
+   }
+   memcpy(acSpec, pcStart, uLength);
+
+   switch(*pc)
+   {
+      case 'd': case 'i':
+         acSpec[uLength] = 'l';
+         acSpec[uLength + 1] = *pc;
+         acSpec[uLength + 2] = '\0';
+         lValue = 0;
+         if(*pcArg != '\0' &&
+            !getNumber(pcArg, &lValue, NULL, pcProgName))
+            *piStatus = 1;
+         printf(acSpec, lValue);
+         break;
+      case 'o': case 'u': case 'x': case 'X':
+         acSpec[uLength] = 'l';
+         acSpec[uLength + 1] = *pc;
+         acSpec[uLength + 2] = '\0';
+         ulValue = 0;
+         if(*pcArg != '\0' &&
+            !getNumber(pcArg, NULL, &ulValue, pcProgName))
+            *piStatus = 1;
+         printf(acSpec, ulValue);
+         break;
+      case 'e': case 'E': case 'f': case 'g': case 'G':
+         acSpec[uLength] = *pc;
+         acSpec[uLength + 1] = '\0';
+         dValue = strtod(pcArg, &pcEnd);
+         if(*pcEnd != '\0')
+         {
+            fprintf(stderr, "%s: printf: %s: Invalid number\n",
+                    pcProgName, pcArg);
+            *piStatus = 1;
+         }
+         printf(acSpec, dValue);
+         break;
+      case 'c':
+         acSpec[uLength] = 'c';
+         acSpec[uLength + 1] = '\0';
+         if(*pcArg != '\0')
+            printf(acSpec, *pcArg);
+         break;
+      case 's':
+         acSpec[uLength] = 's';
+         acSpec[uLength + 1] = '\0';
+         printf(acSpec, pcArg);
+         break;
+      case 'b':
+         while(*pcArg != '\0')
+         {
+            if(*pcArg == '\\')
+               pcArg = writeEscape(pcArg);
+            else
+               putchar(*pcArg++);
+         }
+         break;
+      default:
+         assert(FALSE);
+   }
+   return pc + 1;
+}
+
+/*------------------------------------------------------------------*/
+
+int utilPrintf(char **ppcArray, int iNumArg, History_T oHistList,
+               char *pcProgName)
+
+/* Write the arguments in ppcArray after the first to stdout as the
+   first describes, reusing it while arguments remain. Return 0 if
+   successful, and 1 if the format or an argument is invalid. It is
+   a checked runtime error for ppcArray or pcProgName to be NULL. It
+   is a checked runtime error for iNumArg to not be positive. */
+
+{
+   const char *pcFormat;
+   const char *pc;
+   int iNext = 2;
+   int iUsed;
+   int iStatus = 0;
+
+   assert(ppcArray != NULL);
+   assert(pcProgName != NULL);
+   assert(iNumArg > 0);
+
+   pcFormat = ppcArray[1];
+   do
+   {
+      iUsed = FALSE;
+      pc = pcFormat;
+      while(*pc != '\0')
+      {
+         if(*pc == '\\')
+            pc = writeEscape(pc);
+         else if(*pc == '%' && pc[1] == '%')
+         {
+            putchar('%');
+            pc += 2;
+         }
+         else if(*pc == '%')
+         {
+            pc = writeConversion(pc + 1,
+                   (iNext <= iNumArg) ? ppcArray[iNext] : "",
+                   &iStatus, pcProgName);
+            if(iNext <= iNumArg)
+            {
+               iNext++;
+               iUsed = TRUE;
+            }
+         }
+         else
+            putchar(*pc++);
+      }
+   } while(iUsed && iNext <= iNumArg);
+
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static int getInteger(const char *pcArg, long *plValue,
+                      char *pcProgName)
+
+/* Store the integer pcArg spells, which may have leading and
+   trailing blanks, in *plValue. Return TRUE if pcArg is an integer,
+   and FALSE otherwise; print an error message to stderr in that
+   case. pcProgName is used in printing error messages. */
+
+{
+   char *pcEnd;
+
+   errno = 0;
+   *plValue = strtol(pcArg, &pcEnd, 10);
+   while(isspace((unsigned char)*pcEnd))
+      pcEnd++;
+   if(pcEnd == pcArg || *pcEnd != '\0' || errno != 0)
+   {
+      fprintf(stderr, "%s: test: %s: Integer expression expected\n",
+              pcProgName, pcArg);
+      return FALSE;
+   }
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static int testUnary(const char *pcOp, const char *pcArg,
+                     char *pcProgName)
+
+/* Return the status of test for unary primary pcOp with operand
+   pcArg: 0 if it is true, 1 if it is false, and TEST_ERROR if pcOp
+   is not a unary primary. pcProgName is used in printing error
+   messages. */
+
+{
+   struct stat sStat;
+   int iFound;
+
+   if(strcmp(pcOp, "-n") == 0)
+      return *pcArg == '\0';
+   if(strcmp(pcOp, "-z") == 0)
+      return *pcArg != '\0';
+   if(strcmp(pcOp, "-t") == 0)
+      return !isatty(atoi(pcArg));
+   if(strcmp(pcOp, "-r") == 0)
+      return access(pcArg, R_OK) != 0;
+   if(strcmp(pcOp, "-w") == 0)
+      return access(pcArg, W_OK) != 0;
+   if(strcmp(pcOp, "-x") == 0)
+      return access(pcArg, X_OK) != 0;
+
+   if(strcmp(pcOp, "-h") == 0 || strcmp(pcOp, "-L") == 0)
+      return lstat(pcArg, &sStat) != 0 || !S_ISLNK(sStat.st_mode);
+
+   if(pcOp[0] != '-' || pcOp[1] == '\0' || pcOp[2] != '\0' ||
+      strchr("bcdefgpsSu", pcOp[1]) == NULL)
+   {
+      fprintf(stderr, "%s: test: %s: Unary operator expected\n",
+              pcProgName, pcOp);
+      return TEST_ERROR;
+   }
+
+   iFound = (stat(pcArg, &sStat) == 0);
+   if(!iFound)
+      return 1;
+   switch(pcOp[1])
+   {
+      case 'b': return !S_ISBLK(sStat.st_mode);
+      case 'c': return !S_ISCHR(sStat.st_mode);
+      case 'd': return !S_ISDIR(sStat.st_mode);
+      case 'e': return 0;
+      case 'f': return !S_ISREG(sStat.st_mode);
+      case 'g': return (sStat.st_mode & S_ISGID) == 0;
+      case 'p': return !S_ISFIFO(sStat.st_mode);
+      case 's': return sStat.st_size == 0;
+      case 'S': return !S_ISSOCK(sStat.st_mode);
+      case 'u': return (sStat.st_mode & S_ISUID) == 0;
+      default: assert(FALSE); return TEST_ERROR;
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static int isBinaryOp(const char *pcOp)
+
+/* Return TRUE if pcOp is a binary primary of test, and FALSE
+   otherwise. */
+
+{
+   return strcmp(pcOp, "=") == 0 || strcmp(pcOp, "!=") == 0 ||
+          strcmp(pcOp, "-eq") == 0 || strcmp(pcOp, "-ne") == 0 ||
+          strcmp(pcOp, "-gt") == 0 || strcmp(pcOp, "-ge") == 0 ||
+          strcmp(pcOp, "-lt") == 0 || strcmp(pcOp, "-le") == 0;
+}
+
+/*------------------------------------------------------------------*/
+
+static int testBinary(const char *pcLeft, const char *pcOp,
+                      const char *pcRight, char *pcProgName)
+
+/* Return the status of test for binary primary pcOp with operands
+   pcLeft and pcRight: 0 if it is true, 1 if it is false, and
+   TEST_ERROR if an integer operand is invalid. pcProgName is used in
+   printing error messages. pcOp must satisfy isBinaryOp(). */
+
+{
+   long lLeft;
+   long lRight;
+
+   if(strcmp(pcOp, "=") == 0)
+      return strcmp(pcLeft, pcRight) != 0;
+   if(strcmp(pcOp, "!=") == 0)
+      return strcmp(pcLeft, pcRight) == 0;
+
+   if(!getInteger(pcLeft, &lLeft, pcProgName) ||
+      !getInteger(pcRight, &lRight, pcProgName))
+      return TEST_ERROR;
+   if(strcmp(pcOp, "-eq") == 0)
+      return !(lLeft == lRight);
+   if(strcmp(pcOp, "-ne") == 0)
+      return !(lLeft != lRight);
+   if(strcmp(pcOp, "-gt") == 0)
+      return !(lLeft > lRight);
+   if(strcmp(pcOp, "-ge") == 0)
+      return !(lLeft >= lRight);
+   if(strcmp(pcOp, "-lt") == 0)
+      return !(lLeft < lRight);
+   return !(lLeft <= lRight);
+}
+
+/*------------------------------------------------------------------*/
+
+static int negate(int iStatus)
+
+/* Return the status of test for the negation of an expression whose
+   status is iStatus. */
+
+{
+   return (iStatus == TEST_ERROR) ? TEST_ERROR : !iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static int evalTest(char **ppcArgs, int iNumArgs, char *pcProgName)
+
+/* Return the status of test for the expression given by the
+   iNumArgs arguments in ppcArgs: 0 if it is true, 1 if it is false,
+   and TEST_ERROR if it is invalid. pcProgName is used in printing
+   error messages. */
+
+/* The expression is parsed by the number of its arguments, as POSIX
+   specifies for up to four arguments. */
+
+{
+   switch(iNumArgs)
+   {
+      case 0:
+         return 1;
+      case 1:
+         return ppcArgs[0][0] == '\0';
+      case 2:
+         if(strcmp(ppcArgs[0], "!") == 0)
+            return negate(evalTest(ppcArgs + 1, 1, pcProgName));
+         return testUnary(ppcArgs[0], ppcArgs[1], pcProgName);
+      case 3:
+         if(isBinaryOp(ppcArgs[1]))
+            return testBinary(ppcArgs[0], ppcArgs[1], ppcArgs[2],
+                              pcProgName);
+         if(strcmp(ppcArgs[0], "!") == 0)
+            return negate(evalTest(ppcArgs + 1, 2, pcProgName));
+         if(strcmp(ppcArgs[0], "(") == 0 &&
+            strcmp(ppcArgs[2], ")") == 0)
+            return evalTest(ppcArgs + 1, 1, pcProgName);
+         break;
+      case 4:
+         if(strcmp(ppcArgs[0], "!") == 0)
+            return negate(evalTest(ppcArgs + 1, 3, pcProgName));
+         if(strcmp(ppcArgs[0], "(") == 0 &&
+            strcmp(ppcArgs[3], ")") == 0)
+            return evalTest(ppcArgs + 1, 2, pcProgName);
+         break;
+      default:
+         fprintf(stderr, "%s: test: Too many arguments\n", pcProgName);
+         return TEST_ERROR;
+   }
+   fprintf(stderr, "%s: test: %s: Binary operator expected\n",
+           pcProgName, ppcArgs[1]);
+   return TEST_ERROR;
+}
+
+/*------------------------------------------------------------------*/
+
+int utilTest(char **ppcArray, int iNumArg, History_T oHistList,
+             char *pcProgName)
+
+/* Evaluate the expression given by the arguments in ppcArray, and
+   return 0 if it is true, 1 if it is false, and 2 if it is invalid.
+   If the first element in ppcArray is "[", the last argument must
+   be "]". It is a checked runtime error for ppcArray or pcProgName
+   to be NULL. */
+
+{
+   assert(ppcArray != NULL);
+   assert(pcProgName != NULL);
+
+   if(strcmp(ppcArray[0], "[") == 0)
+   {
+      if(iNumArg == 0 || strcmp(ppcArray[iNumArg], "]") != 0)
+      {
+         fprintf(stderr, "%s: [: Missing ']'\n", pcProgName);
+         return TEST_ERROR;
+      }
+      iNumArg--;
+   }
+   return evalTest(ppcArray + 1, iNumArg, pcProgName);
+}
+
+/*------------------------------------------------------------------*/
+
+int utilTrue(char **ppcArray, int iNumArg, History_T oHistList,
+             char *pcProgName)
+
+/* Return 0. */
+
+{
+   return 0;
+}
+
+/*------------------------------------------------------------------*/
+
+int utilFalse(char **ppcArray, int iNumArg, History_T oHistList,
+              char *pcProgName)
+
+/* Return 1. */
+
+{
+   return 1;
+}
+
+/*------------------------------------------------------------------*/
+
+int utilPwd(char **ppcArray, int iNumArg, History_T oHistList,
+            char *pcProgName)
+
+/* Write the working directory to stdout. Return 0 if successful,
+   and 1 otherwise. It is a checked runtime error for ppcArray or
+   pcProgName to be NULL. */
+
+{
+   char *pcDir;
+
+   assert(ppcArray != NULL);
+   assert(pcProgName != NULL);
+
+   pcDir = getcwd(NULL, 0);
+   if(pcDir == NULL)
+   {
+      fprintf(stderr, "%s: pwd: ", pcProgName);
+      perror(NULL);
+      return 1;
+   }
+   puts(pcDir);
+   free(pcDir);
+   return 0;
+}
+
+/*------------------------------------------------------------------*/
+
+int utilCopyFd(int iIn, int iOut)
+
+/* Copy the rest of the file open as iIn to iOut. Return 0 if
+   successful, and -1 with errno set otherwise. */
+
+/* Between two regular files, copy_file_range() copies within the
+   kernel, sharing extents where the file system can. From any other
+   regular file, sendfile() avoids copying through the shell. Each
+   falls back to the next way if the kernel refuses the first chunk,
+   and read() and write() always work. */
+
+{
+   static char acBuffer[COPY_BUFFER_SIZE];
+   struct stat sIn;
+   struct stat sOut;
+   ssize_t lRead;
+   ssize_t lWritten;
+   ssize_t lDone;
+   int iInRegular = FALSE;
+   int iOutRegular = FALSE;
+
+   if(fstat(iIn, &sIn) == 0)
+      iInRegular = S_ISREG(sIn.st_mode);
+   if(fstat(iOut, &sOut) == 0)
+      iOutRegular = S_ISREG(sOut.st_mode);
+
+   if(iInRegular && iOutRegular)
+   {
+      while((lDone = copy_file_range(iIn, NULL, iOut, NULL,
+                                     MAX_COPY_CHUNK, 0)) > 0)
+         iInRegular = FALSE;
+      if(lDone == 0)
+         return 0;
+      if(!iInRegular)
+         return -1;
+   }
+   if(iInRegular)
+   {
+      while((lDone = sendfile(iOut, iIn, NULL, MAX_COPY_CHUNK)) > 0)
+         iInRegular = FALSE;
+      if(lDone == 0)
+         return 0;
+      if(!iInRegular)
+         return -1;
+   }
+
+   while((lRead = read(iIn, acBuffer, sizeof(acBuffer))) != 0)
+   {
+      if(lRead == -1 && errno == EINTR)
+         continue;
+      if(lRead == -1)
+         return -1;
+      for(lDone = 0; lDone < lRead; lDone += lWritten)
+      {
+         lWritten = write(iOut, acBuffer + lDone,
+                          (size_t)(lRead - lDone));
+         if(lWritten == -1 && errno == EINTR)
+            lWritten = 0;
+         else if(lWritten == -1)
+            return -1;
+      }
+   }
+   return 0;
+}
+
+/*------------------------------------------------------------------*/
+
+int utilCatAccepts(char **ppcArray)
+
+/* Return TRUE if utilCat() handles the arguments in ppcArray, and
+   FALSE if they need another cat's options. It is a checked runtime
+   error for ppcArray to be NULL. */
+
+{
+   int i;
+
+   assert(ppcArray != NULL);
+
+   for(i = 1; ppcArray[i] != NULL; i++)
+      if(ppcArray[i][0] == '-' && ppcArray[i][1] != '\0' &&
+         strcmp(ppcArray[i], "-u") != 0)
+         return FALSE;
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+int utilCat(char **ppcArray, int iNumArg, History_T oHistList,
+            char *pcProgName)
+
+/* Copy each file named in ppcArray, or stdin if there are none or
+   the name is "-", to stdout. Ignore "-u", since the copy is not
+   buffered. Return 0 if successful, and 1 if any file could not be
+   copied. It is a checked runtime error for ppcArray or pcProgName
+   to be NULL. */
+
+{
+   char *pcName;
+   int iFd;
+   int iFiles = 0;
+   int iStatus = 0;
+   int i;
+
+   assert(ppcArray != NULL);
+   assert(pcProgName != NULL);
+
+   /* The copy bypasses the stdout buffer. */
+   fflush(stdout);
+   for(i = 1; i <= iNumArg + 1; i++)
+   {
+      if(i > iNumArg)
+      {
+         if(iFiles > 0)
+            break;
+         pcName = "-";
+      }
+      else
+         pcName = ppcArray[i];
+      if(strcmp(pcName, "-u") == 0)
+         continue;
+      iFiles++;
+
+      if(strcmp(pcName, "-") == 0)
+         iFd = 0;
+      else
+      {
+         iFd = open(pcName, O_RDONLY | O_CLOEXEC);
+         if(iFd == -1)
+         {
+            fprintf(stderr, "%s: cat: ", pcProgName);
+            perror(pcName);
+            iStatus = 1;
+            continue;
+         }
+      }
+
+      if(utilCopyFd(iFd, 1) == -1)
+      {
+         fprintf(stderr, "%s: cat: ", pcProgName);
+         perror(pcName);
+         iStatus = 1;
+      }
+      if(iFd != 0)
+         (void)close(iFd);
+   }
+   return iStatus;
+}
@@ -0,0 +1,67 @@
+/*------------------------------------------------------------------*/
+/* util.h                                                           */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef UTIL_INCLUDED
+#define UTIL_INCLUDED
+
+/* Utilities are builtins that stand in for common programs, so that
+   running them needs no new process. Each behaves like the POSIX
+   utility of the same name for the arguments it accepts; the others
+   are left to the program. Each takes the command's argument array
+   ppcArray, its number of arguments iNumArg, the history list, and
+   the program name pcProgName for error messages, and returns the
+   command's exit status. It is a checked runtime error for ppcArray
+   or pcProgName to be NULL. */
+
+int utilEcho(char **ppcArray, int iNumArg, History_T oHistList,
+             char *pcProgName);
+/* Write the arguments in ppcArray to stdout, separated by spaces and
+   followed by a newline, which is omitted if the first argument is
+   "-n". */
+
+int utilEchoAccepts(char **ppcArray);
+/* Return TRUE if utilEcho() handles the arguments in ppcArray, and
+   FALSE if they need another echo's options. */
+
+int utilPrintf(char **ppcArray, int iNumArg, History_T oHistList,
+               char *pcProgName);
+/* Write the arguments in ppcArray after the first to stdout as the
+   first describes, reusing it while arguments remain. It is a 
+   checked runtime error for iNumArg to not be positive. */
+
+int utilTest(char **ppcArray, int iNumArg, History_T oHistList,
+             char *pcProgName);
+/* Evaluate the expression given by the arguments in ppcArray, and
+   return 0 if it is true, 1 if it is false, and 2 if it is invalid.
+   If the first element in ppcArray is "[", the last argument must
+   be "]". */
+
+int utilTrue(char **ppcArray, int iNumArg, History_T oHistList,
+             char *pcProgName);
+/* Return 0. */
+
+int utilFalse(char **ppcArray, int iNumArg, History_T oHistList,
+              char *pcProgName);
+/* Return 1. */
+
+int utilPwd(char **ppcArray, int iNumArg, History_T oHistList,
+            char *pcProgName);
+/* Write the working directory to stdout. */
+
+int utilCat(char **ppcArray, int iNumArg, History_T oHistList,
+            char *pcProgName);
+/* Copy each file named in ppcArray, or stdin if there are none or
+   the name is "-", to stdout. */
+
+int utilCatAccepts(char **ppcArray);
+/* Return TRUE if utilCat() handles the arguments in ppcArray, and
+   FALSE if they need another cat's options. */
+
+int utilCopyFd(int iIn, int iOut);
+/* Copy the rest of the file open as iIn to iOut, within the kernel
+   where it can. Return 0 if successful, and -1 with errno set 
+   otherwise. */
+
+#endif                      /* UTIL_INCLUDED */
@@ -0,0 +1,385 @@
+/*------------------------------------------------------------------*/
+/* var.c                                                            */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include "var.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+enum {BUCKET_COUNT = 256};
+
+/*------------------------------------------------------------------*/
+
+/* A Var is a variable, kept in the form environ holds it in. */
+
+struct Var
+{
+   /* The string "name=value". */
+   char *pcEntry;
+
+   /* The length of the name. */
+   size_t uNameLength;
+
+   /* TRUE iff environ points to pcEntry. */
+   int iExported;
+
+   /* The next variable in the same bucket. */
+   struct Var *psNext;
+};
+
+/*------------------------------------------------------------------*/
+
+/* The hash table of variables, chained by bucket. */
+static struct Var *apsBuckets[BUCKET_COUNT];
+
+/* TRUE iff the table has been read from environ. */
+static int iInitialized = FALSE;
+
+/* The number of variables in the table. */
+static size_t uNumVars = 0;
+
+/* TRUE iff a variable was set or unset since environ was last
+   rebuilt. */
+static int iChanged = FALSE;
+
+/* The array that environ was last rebuilt into, or NULL if it has
+   not been, and its number of elements. */
+static char **ppcEnviron = NULL;
+static size_t uEnvironSize = 0;
+
+/* The entries that were replaced or removed since environ was last
+   rebuilt, and that environ points to, so they are freed only once 
+   it no longer does. */
+static char **ppcStale = NULL;
+static size_t uNumStale = 0;
+static size_t uStaleSize = 0;
+
+/* The positional parameters, and their number. */
+static char **ppcArgs = NULL;
+static int iNumArgs = 0;
+
+/*------------------------------------------------------------------*/
+
+static unsigned int hash(const char *pcName, size_t uLength)
+
+/* Return the bucket index of the variable name that is the uLength
+   characters at pcName. */
+
+{
+   unsigned int uHash = 5381;
+
+   assert(pcName != NULL);
+
+   while(uLength-- > 0)
+      uHash = uHash * 33 + (unsigned char)*pcName++;
+   return uHash % BUCKET_COUNT;
+}
+
+/*------------------------------------------------------------------*/
+
+static struct Var **findVar(const char *pcName, size_t uLength)
+
+/* Return a pointer to the link that points to the variable whose
+   name is the uLength characters at pcName, or to the NULL link at
+   the end of its bucket if there is none. */
+
+{
+   struct Var **ppsVar;
+
+   assert(pcName != NULL);
+
+   for(ppsVar = &apsBuckets[hash(pcName, uLength)]; *ppsVar != NULL;
+       ppsVar = &(*ppsVar)->psNext)
+      if((*ppsVar)->uNameLength == uLength &&
+         memcmp((*ppsVar)->pcEntry, pcName, uLength) == 0)
+         break;
+   return ppsVar;
+}
+
+/*------------------------------------------------------------------*/
+
+static void retire(struct Var *psVar)
+
+/* Free the entry of psVar, which is being replaced or removed, at 
+   once if environ does not point to it, and once it no longer does
+   otherwise. */
+
+/* Only the first change to a variable after environ is rebuilt
+   leaves an entry behind, so a loop that sets a variable over and 
+   over holds one stale entry, not one per iteration. */
+
+{
+   char *pcEntry;
+
+   assert(psVar != NULL);
+
+   pcEntry = psVar->pcEntry;
+   if(!psVar->iExported)
+   {
+      free(pcEntry);
+      return;
+   }
+   psVar->iExported = FALSE;
+   if(uNumStale == uStaleSize)
+   {
+      uStaleSize = (uStaleSize == 0) ? 16 : 2 * uStaleSize;
+      ppcStale = (char**)realloc(ppcStale, uStaleSize * sizeof(char*));
+      assert(ppcStale != NULL);
+   }
+   ppcStale[uNumStale++] = pcEntry;
+}
+
+/*------------------------------------------------------------------*/
+
+static void insert(const char *pcName, size_t uNameLength,
+                   const char *pcValue)
+
+/* Set the variable whose name is the uNameLength characters at
+   pcName to pcValue, creating it if need be. */
+
+{
+   struct Var **ppsVar;
+   struct Var *psVar;
+   size_t uValueLength;
+   char *pcEntry;
+
+   assert(pcName != NULL);
+   assert(pcValue != NULL);
+
+   uValueLength = strlen(pcValue);
+   pcEntry = (char*)malloc(uNameLength + uValueLength + 2);
+   assert(pcEntry != NULL);
+   memcpy(pcEntry, pcName, uNameLength);
+   pcEntry[uNameLength] = '=';
+   memcpy(pcEntry + uNameLength + 1, pcValue, uValueLength + 1);
+
+   ppsVar = findVar(pcName, uNameLength);
+   if(*ppsVar != NULL)
+   {
+      retire(*ppsVar);
+      (*ppsVar)->pcEntry = pcEntry;
+      return;
+   }
+   psVar = (struct Var*)malloc(sizeof(struct Var));
+   assert(psVar != NULL);
+   psVar->pcEntry = pcEntry;
+   psVar->uNameLength = uNameLength;
+   psVar->iExported = FALSE;
+   psVar->psNext = NULL;
+   *ppsVar = psVar;
+   uNumVars++;
+}
+
+/*------------------------------------------------------------------*/
+
+static void initialize(void)
+
+/* Read the table from environ, unless it has been. As getenv()
+   does, the first of several entries with the same name wins. */
+
+{
+   char **ppc;
+   char *pcEquals;
+
+   if(iInitialized)
+      return;
+   iInitialized = TRUE;
+
+   for(ppc = environ; ppc != NULL && *ppc != NULL; ppc++)
+   {
+      pcEquals = strchr(*ppc, '=');
+      if(pcEquals == NULL || pcEquals == *ppc ||
+         *findVar(*ppc, (size_t)(pcEquals - *ppc)) != NULL)
+         continue;
+      insert(*ppc, (size_t)(pcEquals - *ppc), pcEquals + 1);
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static int isValidName(const char *pcName)
+
+/* Return TRUE if pcName may name a variable, as setenv() requires,
+   and FALSE otherwise. */
+
+{
+   assert(pcName != NULL);
+
+   return pcName[0] != '\0' && strchr(pcName, '=') == NULL;
+}
+
+/*------------------------------------------------------------------*/
+
+const char *varGet(const char *pcName, size_t uLength)
+
+/* Return the value of the variable whose name is the uLength
+   characters at pcName, or NULL if there is no such variable. The
+   name "1" through "9" gives the positional parameter of that 
+   number, and "#" gives their number. The value remains valid until
+   the variable is next set or unset. It is a checked runtime error
+   for pcName to be NULL. */
+
+/* The special parameters are not in the table, since they are not
+   part of the environment. */
+
+{
+   static char acNumArgs[sizeof(int) * 3 + 1];
+   struct Var *psVar;
+
+   assert(pcName != NULL);
+
+   if(uLength == 1 && pcName[0] >= '1' && pcName[0] <= '9')
+      return (pcName[0] - '0' <= iNumArgs) ? 
+         ppcArgs[pcName[0] - '1'] : NULL;
+   if(uLength == 1 && pcName[0] == '#')
+   {
+      sprintf(acNumArgs, "%d", iNumArgs);
+      return acNumArgs;
+   }
+
+   initialize();
+   psVar = *findVar(pcName, uLength);
+   if(psVar == NULL)
+      return NULL;
+   return psVar->pcEntry + psVar->uNameLength + 1;
+}
+
+/*------------------------------------------------------------------*/
+
+int varSet(const char *pcName, const char *pcValue)
+
+/* Set the variable named pcName to pcValue, creating it if need be.
+   Return 0 if successful, and -1 with errno set to EINVAL if pcName
+   is empty or contains '='. It is a checked runtime error for pcName
+   or pcValue to be NULL. */
+
+{
+   assert(pcName != NULL);
+   assert(pcValue != NULL);
+
+   if(!isValidName(pcName))
+   {
+      errno = EINVAL;
+      return -1;
+   }
+   initialize();
+   insert(pcName, strlen(pcName), pcValue);
+   iChanged = TRUE;
+   return 0;
+}
+
+/*------------------------------------------------------------------*/
+
+int varUnset(const char *pcName)
+
+/* Remove the variable named pcName, if there is one. Return 0 if
+   successful, and -1 with errno set to EINVAL if pcName is empty or
+   contains '='. It is a checked runtime error for pcName to be
+   NULL. */
+
+{
+   struct Var **ppsVar;
+   struct Var *psVar;
+
+   assert(pcName != NULL);
+
+   if(!isValidName(pcName))
+   {
+      errno = EINVAL;
+      return -1;
+   }
+   initialize();
+   ppsVar = findVar(pcName, strlen(pcName));
+   if(*ppsVar == NULL)
+      return 0;
+   psVar = *ppsVar;
+   *ppsVar = psVar->psNext;
+   retire(psVar);
+   free(psVar);
+   uNumVars--;
+   iChanged = TRUE;
+   return 0;
+}
+
+/*------------------------------------------------------------------*/
+
+char **varExport(void)
+
+/* Make environ hold the variables, rebuilding it only if one was
+   set or unset since the last call, and return it. */
+
+/* The new environ points to the entries in the table, so nothing
+   is copied but the pointers. */
+
+{
+   struct Var *psVar;
+   size_t u = 0;
+   int i;
+
+   if(!iChanged)
+      return environ;
+
+   if(uNumVars + 1 > uEnvironSize)
+   {
+      uEnvironSize = 2 * (uNumVars + 1);
+      free(ppcEnviron);
+      ppcEnviron = (char**)malloc(uEnvironSize * sizeof(char*));
+      assert(ppcEnviron != NULL);
+   }
+   for(i = 0; i < BUCKET_COUNT; i++)
+      for(psVar = apsBuckets[i]; psVar != NULL; psVar = psVar->psNext)
+      {
+         ppcEnviron[u++] = psVar->pcEntry;
+         psVar->iExported = TRUE;
+      }
+   ppcEnviron[u] = NULL;
+   environ = ppcEnviron;
+
+   while(uNumStale > 0)
+      free(ppcStale[--uNumStale]);
+   iChanged = FALSE;
+   return environ;
+}
+
+/*------------------------------------------------------------------*/
+
+void varSetArgs(char **ppcNewArgs, int iNumNewArgs)
+
+/* Make the iNumNewArgs strings in ppcNewArgs the positional 
+   parameters. They are not copied, so they must remain valid while
+   they are the positional parameters. It is a checked runtime error
+   for ppcNewArgs to be NULL unless iNumNewArgs is 0. It is a checked
+   runtime error for iNumNewArgs to be negative. */
+
+{
+   assert(ppcNewArgs != NULL || iNumNewArgs == 0);
+   assert(iNumNewArgs >= 0);
+
+   ppcArgs = ppcNewArgs;
+   iNumArgs = iNumNewArgs;
+}
+
+/*------------------------------------------------------------------*/
+
+char **varGetArgs(int *piNumArgs)
+
+/* Return the positional parameters, and store their number in 
+   *piNumArgs. It is a checked runtime error for piNumArgs to be 
+   NULL. */
+
+{
+   assert(piNumArgs != NULL);
+
+   *piNumArgs = iNumArgs;
+   return ppcArgs;
+}
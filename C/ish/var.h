@@ -0,0 +1,55 @@
+/*------------------------------------------------------------------*/
+/* var.h                                                            */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef VAR_INCLUDED
+#define VAR_INCLUDED
+
+#include <stddef.h>
+
+/* The shell's variables are its environment, kept in a hash table
+   that is read from environ when it is first used. Changes are made
+   to the table alone, and reach environ only when varExport() is
+   called before a command is launched, so looking up a variable
+   does not scan environ and setting one does not rebuild it. The
+   positional parameters of a function, which are not part of the
+   environment, are kept here as well. */
+
+const char *varGet(const char *pcName, size_t uLength);
+/* Return the value of the variable whose name is the uLength
+   characters at pcName, or NULL if there is no such variable. The
+   name "1" through "9" gives the positional parameter of that 
+   number, and "#" gives their number. The value remains valid until
+   the variable is next set or unset. It is a checked runtime error
+   for pcName to be NULL. */
+
+int varSet(const char *pcName, const char *pcValue);
+/* Set the variable named pcName to pcValue, creating it if need be.
+   Return 0 if successful, and -1 with errno set to EINVAL if pcName
+   is empty or contains '='. It is a checked runtime error for pcName
+   or pcValue to be NULL. */
+
+int varUnset(const char *pcName);
+/* Remove the variable named pcName, if there is one. Return 0 if
+   successful, and -1 with errno set to EINVAL if pcName is empty or
+   contains '='. It is a checked runtime error for pcName to be
+   NULL. */
+
+char **varExport(void);
+/* Make environ hold the variables, rebuilding it only if one was
+   set or unset since the last call, and return it. */
+
+void varSetArgs(char **ppcNewArgs, int iNumNewArgs);
+/* Make the iNumNewArgs strings in ppcNewArgs the positional 
+   parameters. They are not copied, so they must remain valid while
+   they are the positional parameters. It is a checked runtime error
+   for ppcNewArgs to be NULL unless iNumNewArgs is 0. It is a checked
+   runtime error for iNumNewArgs to be negative. */
+
+char **varGetArgs(int *piNumArgs);
+/* Return the positional parameters, and store their number in 
+   *piNumArgs. It is a checked runtime error for piNumArgs to be 
+   NULL. */
+
+#endif                      /* VAR_INCLUDED */
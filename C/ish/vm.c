@@ -0,0 +1,710 @@
+/*------------------------------------------------------------------*/
+/* vm.c                                                             */
+/* Author: Mark Xia                                                 */
+/* -----------------------------------------------------------------*/
+
+#include "dynarray.h"
+#include "arena.h"
+#include "lexi.h"
+#include "parse.h"
+#include "hist.h"
+#include "exec.h"
+#include "job.h"
+#include "smallarray.h"
+#include "script.h"
+#include "var.h"
+#include "vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <assert.h>
+
+/*------------------------------------------------------------------*/
+
+enum {FALSE, TRUE};
+
+/* The exit status of a command that SIGINT killed. */
+enum {INTERRUPTED_STATUS = 128 + SIGINT};
+
+/* The greatest depth of nested function calls, which bounds the
+   stack that a runaway recursion can use. */
+enum {MAX_CALL_DEPTH = 1000};
+
+/*------------------------------------------------------------------*/
+
+/* A Function is a defined function: where its body is in the
+   bytecode of the Script that defined it. */
+
+struct Function
+{
+   /* The name, which points into oScript. */
+   char *pcName;
+
+   /* The Script, of which the Function holds a reference, and the
+      offset of the body in its bytecode. */
+   Script_T oScript;
+   int iEntry;
+};
+
+/* An Iteration is the state of a running for loop. */
+
+struct Iteration
+{
+   /* The expanded words, in one block that the Iteration owns, their
+      number, and the index of the next one. */
+   char **ppcItems;
+   int iNumItems;
+   int iNext;
+};
+
+/*------------------------------------------------------------------*/
+
+/* The Functions defined so far, or NULL if there are none. */
+static DynArray_T oFunctions = NULL;
+
+/* The Iterations of the for loops that are running, the innermost
+   last, and TRUE iff the array has been initialized. */
+static struct SmallArray sIterations;
+static int iIterationsInitialized = FALSE;
+
+/* The number of function calls in progress. */
+static int iCallDepth = 0;
+
+/* What the pipelines run at each depth of function calls are
+   expanded into, made when first needed. A call runs while the
+   pipeline that calls it is still in use, so each depth has its
+   own. */
+static Arena_T aoArenas[MAX_CALL_DEPTH + 1];
+static DynArray_T aoCommands[MAX_CALL_DEPTH + 1];
+
+/*------------------------------------------------------------------*/
+
+static struct Function *findFunction(const char *pcName)
+
+/* Return the Function named pcName, or NULL if there is none. */
+
+{
+   struct Function *psFunction;
+   int iLength;
+   int i;
+
+   assert(pcName != NULL);
+
+   if(oFunctions == NULL)
+      return NULL;
+   iLength = DynArray_getLength(oFunctions);
+   for(i = 0; i < iLength; i++)
+   {
+      psFunction = (struct Function*)DynArray_get(oFunctions, i);
+      if(strcmp(psFunction->pcName, pcName) == 0)
+         return psFunction;
+   }
+   return NULL;
+}
+
+/*------------------------------------------------------------------*/
+
+static void define(Script_T oScript, int iFunction)
+
+/* Define the function at index iFunction of oScript, replacing any
+   function of the same name. */
+
+{
+   struct ScriptFunction *psDefinition;
+   struct Function *psFunction;
+
+   assert(oScript != NULL);
+
+   psDefinition = &oScript->psFunctions[iFunction];
+   Script_retain(oScript);
+   psFunction = findFunction(psDefinition->pcName);
+   if(psFunction != NULL)
+      Script_release(psFunction->oScript);
+   else
+   {
+      if(oFunctions == NULL)
+         oFunctions = DynArray_new(0);
+      psFunction = (struct Function*)malloc(sizeof(struct Function));
+      assert(psFunction != NULL);
+      DynArray_add(oFunctions, psFunction);
+   }
+   psFunction->pcName = psDefinition->pcName;
+   psFunction->oScript = oScript;
+   psFunction->iEntry = psDefinition->iEntry;
+}
+
+/*------------------------------------------------------------------*/
+
+static Arena_T getArena(void)
+
+/* Return the arena of the current depth of function calls, making
+   it, and the DynArray of the same depth, if need be. */
+
+{
+   if(aoArenas[iCallDepth] == NULL)
+   {
+      aoArenas[iCallDepth] = Arena_new();
+      aoCommands[iCallDepth] = DynArray_new(0);
+   }
+   return aoArenas[iCallDepth];
+}
+
+/*------------------------------------------------------------------*/
+
+static char *expandWord(char *pcWord, Arena_T oArena)
+
+/* Return pcWord, or its expansion allocated from oArena if it is a
+   template, or NULL if it is dropped; see lexExpand(). */
+
+{
+   size_t uLength;
+
+   assert(pcWord != NULL);
+   assert(oArena != NULL);
+
+   if(strchr(pcWord, '$') == NULL)
+      return pcWord;
+   return lexExpand(pcWord, &uLength, oArena);
+}
+
+/*------------------------------------------------------------------*/
+
+static char *expandRedirection(char *pcWord, Arena_T oArena)
+
+/* Return the file name that pcWord, a redirection or NULL, gives:
+   NULL if pcWord is NULL, and its expansion otherwise, which is the
+   empty string if it is dropped. */
+
+{
+   char *pcName;
+
+   assert(oArena != NULL);
+
+   if(pcWord == NULL)
+      return NULL;
+   pcName = expandWord(pcWord, oArena);
+   return (pcName == NULL) ? "" : pcName;
+}
+
+/*------------------------------------------------------------------*/
+
+static int expandStage(const struct ScriptStage *psStage,
+                       Command_T oCommand, Arena_T oArena)
+
+/* Make oCommand the stage psStage with its templates expanded,
+   allocated from oArena. Return TRUE if successful, and FALSE if no
+   command name is left, in which case only the redirections of
+   oCommand are set. */
+
+{
+   char **ppcArray;
+   char *pcWord;
+   char *pcHere;
+   size_t uHereLength;
+   int iNumWords = 0;
+   int i;
+
+   assert(psStage != NULL);
+   assert(oCommand != NULL);
+   assert(oArena != NULL);
+
+   pcHere = psStage->pcHere;
+   uHereLength = psStage->uHereLength;
+   if(psStage->iHereIsTemplate)
+      pcHere = lexExpand(pcHere, &uHereLength, oArena);
+   Command_setRedirections(oCommand,
+                           expandRedirection(psStage->pcStdin, oArena),
+                           pcHere, uHereLength,
+                           expandRedirection(psStage->pcStdout, oArena));
+
+   ppcArray = (char**)Arena_alloc(oArena,
+      (size_t)(psStage->iNumWords + 1) * sizeof(char*));
+   for(i = 0; i < psStage->iNumWords; i++)
+   {
+      pcWord = expandWord(psStage->ppcWords[i], oArena);
+      if(pcWord != NULL)
+         ppcArray[iNumWords++] = pcWord;
+   }
+   ppcArray[iNumWords] = NULL;
+   if(iNumWords == 0)
+      return FALSE;
+   Command_setArray(oCommand, ppcArray, iNumWords - 1);
+   return TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static int runPipeline(const struct ScriptPipeline *psPipeline,
+                       History_T oHistList, char *pcProgName)
+
+/* Run psPipeline, with its templates expanded, and return its exit
+   status. A pipeline of one command whose words all are dropped and
+   that has no redirections does nothing, as such a line does. */
+
+{
+   Arena_T oArena;
+   DynArray_T oCommands;
+   Command_T oCommand;
+   size_t uHereLength;
+   int iStatus = 0;
+   int i;
+
+   assert(psPipeline != NULL);
+   assert(oHistList != NULL);
+   assert(pcProgName != NULL);
+
+   oArena = getArena();
+   oCommands = aoCommands[iCallDepth];
+
+   for(i = 0; i < psPipeline->iNumStages; i++)
+   {
+      oCommand = Command_new(oArena);
+      if(!expandStage(&psPipeline->psStages[i], oCommand, oArena))
+      {
+         if(psPipeline->iNumStages > 1 ||
+            Command_getStdin(oCommand, NULL) != NULL ||
+            Command_getStdout(oCommand, NULL) != NULL ||
+            Command_getHere(oCommand, &uHereLength) != NULL)
+         {
+            fprintf(stderr, "%s: Missing command name\n", pcProgName);
+            iStatus = EXIT_FAILURE;
+         }
+         break;
+      }
+      DynArray_add(oCommands, oCommand);
+   }
+   if(i == psPipeline->iNumStages)
+      iStatus = vmExecute(oCommands, psPipeline->iBackground,
+                          oHistList, pcProgName);
+
+   DynArray_clear(oCommands);
+   Arena_reset(oArena);
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static void beginIteration(const struct ScriptList *psList)
+
+/* Begin an Iteration over the words of psList, expanded. */
+
+/* The expanded words must outlive the pipelines of the loop's body,
+   so they are copied into a block of their own. */
+
+{
+   struct Iteration sIteration;
+   Arena_T oArena;
+   char **ppcItems;
+   char *pc;
+   size_t uSize;
+   int iNumItems = 0;
+   int i;
+
+   assert(psList != NULL);
+
+   oArena = getArena();
+
+   ppcItems = (char**)Arena_alloc(oArena,
+      (size_t)(psList->iNumWords + 1) * sizeof(char*));
+   uSize = 0;
+   for(i = 0; i < psList->iNumWords; i++)
+   {
+      ppcItems[iNumItems] = expandWord(psList->ppcWords[i], oArena);
+      if(ppcItems[iNumItems] != NULL)
+         uSize += strlen(ppcItems[iNumItems++]) + 1;
+   }
+
+   sIteration.ppcItems = (char**)malloc(
+      (size_t)iNumItems * sizeof(char*) + uSize + 1);
+   assert(sIteration.ppcItems != NULL);
+   pc = (char*)(sIteration.ppcItems + iNumItems);
+   for(i = 0; i < iNumItems; i++)
+   {
+      sIteration.ppcItems[i] = pc;
+      strcpy(pc, ppcItems[i]);
+      pc += strlen(pc) + 1;
+   }
+   sIteration.iNumItems = iNumItems;
+   sIteration.iNext = 0;
+   Arena_reset(oArena);
+
+   (void)SmallArray_add(&sIterations, &sIteration);
+}
+
+/*------------------------------------------------------------------*/
+
+static void endIteration(void)
+
+/* End the innermost Iteration. */
+
+{
+   struct Iteration *psIteration;
+   int iLength;
+
+   iLength = SmallArray_getLength(&sIterations);
+   assert(iLength > 0);
+
+   psIteration = (struct Iteration*)SmallArray_get(&sIterations,
+                                                   iLength - 1);
+   free(psIteration->ppcItems);
+   SmallArray_setLength(&sIterations, iLength - 1);
+}
+
+/*------------------------------------------------------------------*/
+
+static int getReturnStatus(const struct ScriptList *psList,
+                           int iStatus, char *pcProgName)
+
+/* Return the exit status that the word of psList, the operand of a
+   return command, gives, which is iStatus if it is dropped. Write an
+   error to stderr and return EXIT_FAILURE if it is not a number. */
+
+{
+   Arena_T oArena;
+   char *pcWord;
+   char *pcEnd;
+   long lStatus;
+
+   assert(psList != NULL);
+   assert(psList->iNumWords == 1);
+   assert(pcProgName != NULL);
+
+   oArena = getArena();
+   pcWord = expandWord(psList->ppcWords[0], oArena);
+   if(pcWord != NULL)
+   {
+      lStatus = strtol(pcWord, &pcEnd, 10);
+      if(*pcWord == '\0' || *pcEnd != '\0')
+      {
+         fprintf(stderr, "%s: return: Numeric argument required\n",
+                 pcProgName);
+         iStatus = EXIT_FAILURE;
+      }
+      else
+         iStatus = (int)(lStatus & 0xFF);
+   }
+   Arena_reset(oArena);
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+static int dispatch(Script_T oScript, int iPc, History_T oHistList,
+                    char *pcProgName)
+
+/* Execute the bytecode of oScript from offset iPc up to an OP_RETURN
+   or OP_END, and return the exit status of the last command run, or
+   0 if none was. */
+
+/* The status is the VM's only register. The Iterations of all calls
+   share one stack, and those that a call has begun are ended when it
+   returns. A pipeline that SIGINT killed returns at once, as a job
+   of parallel stops a run, and its status ends each call it is 
+   nested in the same way. */
+
+{
+   const int *piCode;
+   struct Iteration *psIteration;
+   int iBase;
+   int iStatus = 0;
+
+   assert(oScript != NULL);
+   assert(oHistList != NULL);
+   assert(pcProgName != NULL);
+
+   if(!iIterationsInitialized)
+   {
+      SmallArray_init(&sIterations, sizeof(struct Iteration));
+      iIterationsInitialized = TRUE;
+   }
+   iBase = SmallArray_getLength(&sIterations);
+   piCode = oScript->piCode;
+
+   for(;;)
+   {
+      assert(iPc >= 0 && iPc < oScript->iCodeLength);
+      switch((enum Opcode)piCode[iPc])
+      {
+         case OP_RUN:
+            iStatus = runPipeline(&oScript->psPipelines[piCode[iPc + 1]],
+                                  oHistList, pcProgName);
+            /* Reap background jobs as they finish, not only between
+               lines, so a long loop leaves no zombies behind. */
+            jobReap();
+            if(iStatus == INTERRUPTED_STATUS)
+            {
+               while(SmallArray_getLength(&sIterations) > iBase)
+                  endIteration();
+               return iStatus;
+            }
+            iPc += 2;
+            break;
+
+         case OP_JUMP:
+            iPc = piCode[iPc + 1];
+            break;
+
+         case OP_JUMP_FALSE:
+            if(iStatus == 0)
+               iPc += 2;
+            else
+            {
+               /* A false condition is no failure of the command it
+                  belongs to. */
+               iStatus = 0;
+               iPc = piCode[iPc + 1];
+            }
+            break;
+
+         case OP_FOR_BEGIN:
+            beginIteration(&oScript->psLists[piCode[iPc + 1]]);
+            iStatus = 0;
+            iPc += 2;
+            break;
+
+         case OP_FOR_NEXT:
+            psIteration = (struct Iteration*)SmallArray_get(
+               &sIterations, SmallArray_getLength(&sIterations) - 1);
+            if(psIteration->iNext == psIteration->iNumItems)
+               iPc = piCode[iPc + 2];
+            else
+            {
+               (void)varSet(oScript->ppcNames[piCode[iPc + 1]],
+                            psIteration->ppcItems[psIteration->iNext++]);
+               iPc += 3;
+            }
+            break;
+
+         case OP_FOR_END:
+            endIteration();
+            iPc += 1;
+            break;
+
+         case OP_DEFINE:
+            define(oScript, piCode[iPc + 1]);
+            iStatus = 0;
+            iPc += 2;
+            break;
+
+         case OP_RETURN:
+            if(piCode[iPc + 1] >= 0)
+               iStatus = getReturnStatus(
+                  &oScript->psLists[piCode[iPc + 1]], iStatus,
+                  pcProgName);
+            while(SmallArray_getLength(&sIterations) > iBase)
+               endIteration();
+            return iStatus;
+
+         case OP_END:
+            assert(SmallArray_getLength(&sIterations) == iBase);
+            return iStatus;
+
+         default:
+            assert(0);
+      }
+   }
+}
+
+/*------------------------------------------------------------------*/
+
+static int callFunction(struct Function *psFunction, char **ppcArray,
+                        int iNumArg, History_T oHistList,
+                        char *pcProgName)
+
+/* Call psFunction, making the iNumArg arguments that follow the
+   command name in ppcArray the positional parameters while it runs,
+   and return its exit status. */
+
+/* The arguments are copied into one block, since the pipeline they
+   came from may be freed before the call ends. The Script is held
+   for the same reason: the function may be redefined while it
+   runs. */
+
+{
+   Script_T oScript;
+   char **ppcArgs;
+   char **ppcSavedArgs;
+   char *pc;
+   size_t uSize = 0;
+   int iNumSavedArgs;
+   int iStatus;
+   int i;
+
+   assert(psFunction != NULL);
+   assert(ppcArray != NULL);
+   assert(oHistList != NULL);
+   assert(pcProgName != NULL);
+
+   if(iCallDepth == MAX_CALL_DEPTH)
+   {
+      fprintf(stderr, "%s: %s: Function calls nested too deeply\n",
+              pcProgName, ppcArray[0]);
+      return EXIT_FAILURE;
+   }
+
+   for(i = 1; i <= iNumArg; i++)
+      uSize += strlen(ppcArray[i]) + 1;
+   ppcArgs = (char**)malloc((size_t)iNumArg * sizeof(char*) + uSize + 1);
+   assert(ppcArgs != NULL);
+   pc = (char*)(ppcArgs + iNumArg);
+   for(i = 0; i < iNumArg; i++)
+   {
+      ppcArgs[i] = pc;
+      strcpy(pc, ppcArray[i + 1]);
+      pc += strlen(pc) + 1;
+   }
+
+   oScript = psFunction->oScript;
+   Script_retain(oScript);
+   ppcSavedArgs = varGetArgs(&iNumSavedArgs);
+   varSetArgs(ppcArgs, iNumArg);
+   iCallDepth++;
+   iStatus = dispatch(oScript, psFunction->iEntry, oHistList,
+                      pcProgName);
+   iCallDepth--;
+   varSetArgs(ppcSavedArgs, iNumSavedArgs);
+   Script_release(oScript);
+   free(ppcArgs);
+   return iStatus;
+}
+
+/*------------------------------------------------------------------*/
+
+int vmRun(Script_T oScript, History_T oHistList, char *pcProgName)
+
+/* Execute oScript, and return the exit status of the last command it
+   ran, or 0 if it ran none. A command that SIGINT killed ends the 
+   execution, so ^C interrupts a loop. pcProgName is used in printing
+   error messages. It is a checked runtime error for oScript, 
+   oHistList, or pcProgName to be NULL. */
+
+{
+   assert(oScript != NULL);
+   assert(oHistList != NULL);
+   assert(pcProgName != NULL);
+
+   return dispatch(oScript, 0, oHistList, pcProgName);
+}
+
+/*------------------------------------------------------------------*/
+
+int vmIsCall(DynArray_T oCommands)
+
+/* Return TRUE if a stage of the pipeline oCommands names a function,
+   and FALSE otherwise. It is a checked runtime error for oCommands
+   to be NULL. */
+
+{
+   int iLength;
+   int i;
+
+   assert(oCommands != NULL);
+
+   if(oFunctions == NULL)
+      return FALSE;
+   iLength = DynArray_getLength(oCommands);
+   for(i = 0; i < iLength; i++)
+      if(findFunction(Command_getArray(DynArray_get(oCommands, i),
+                                       NULL)[0]) != NULL)
+         return TRUE;
+   return FALSE;
+}
+
+/*------------------------------------------------------------------*/
+
+int vmIsTimed(DynArray_T oCommands)
+
+/* Return TRUE if the first command of the pipeline oCommands is 
+   "time" followed by a command, which vmExecute() then times, and 
+   FALSE otherwise. It is a checked runtime error for oCommands to be
+   NULL or empty. */
+
+{
+   Command_T oCommand;
+
+   assert(oCommands != NULL);
+   assert(DynArray_getLength(oCommands) > 0);
+
+   oCommand = (Command_T)DynArray_get(oCommands, 0);
+   return strcmp(Command_getArray(oCommand, NULL)[0], "time") == 0 &&
+          Command_getNumArg(oCommand, NULL) > 0;
+}
+
+/*------------------------------------------------------------------*/
+
+int vmExecute(DynArray_T oCommands, int iBackground,
+              History_T oHistList, char *pcProgName)
+
+/* Execute the pipeline oCommands as execute() does, unless
+   vmIsCall() is TRUE of it. In that case, if it is a single command
+   in the foreground without redirections, call the function it
+   names, with its arguments as the positional parameters, and return
+   the exit status of the function; otherwise write an error to
+   stderr and return EXIT_FAILURE. If vmIsTimed() is TRUE of 
+   oCommands, remove "time" from it first, and write the resource 
+   usage of the pipeline to stderr once it has run; a pipeline in 
+   the background or a function call cannot be timed, and is 
+   rejected with an error. pcProgName is used in
+   printing error messages. It is a checked runtime error for 
+   oCommands, oHistList, or pcProgName to be NULL. It is a checked 
+   runtime error for oCommands to be empty. */
+
+/* "time" is handled here, so that it works the same on a line of its
+   own and within a compound command. */
+
+{
+   Command_T oCommand;
+   size_t uHereLength;
+   int iTimed;
+   int iStatus;
+
+   assert(oCommands != NULL);
+   assert(DynArray_getLength(oCommands) > 0);
+   assert(oHistList != NULL);
+   assert(pcProgName != NULL);
+
+   oCommand = (Command_T)DynArray_get(oCommands, 0);
+   iTimed = vmIsTimed(oCommands);
+   if(iTimed)
+      Command_removeName(oCommand);
+
+   if(iTimed && iBackground)
+   {
+      fprintf(stderr, "%s: time: A background pipeline cannot be "
+              "timed\n", pcProgName);
+      return EXIT_FAILURE;
+   }
+
+   if(!vmIsCall(oCommands))
+   {
+      iStatus = execute(oCommands, iBackground, oHistList, pcProgName);
+      if(iTimed)
+      {
+         fflush(stdout);
+         execPrintStats(execGetStats(), NULL, stderr);
+      }
+      return iStatus;
+   }
+
+   if(iTimed)
+   {
+      fprintf(stderr, "%s: time: A function call cannot be timed\n",
+              pcProgName);
+      return EXIT_FAILURE;
+   }
+   if(DynArray_getLength(oCommands) > 1 || iBackground ||
+      Command_getStdin(oCommand, NULL) != NULL ||
+      Command_getStdout(oCommand, NULL) != NULL ||
+      Command_getHere(oCommand, &uHereLength) != NULL)
+   {
+      fprintf(stderr, "%s: A function cannot be piped, redirected, "
+              "or run in the background\n", pcProgName);
+      return EXIT_FAILURE;
+   }
+   return callFunction(findFunction(Command_getArray(oCommand,
+                                                     NULL)[0]),
+                       Command_getArray(oCommand, NULL),
+                       Command_getNumArg(oCommand, NULL), oHistList,
+                       pcProgName);
+}
@@ -0,0 +1,46 @@
+/*------------------------------------------------------------------*/
+/* vm.h                                                             */
+/* Author: Mark Xia                                                 */
+/*------------------------------------------------------------------*/
+
+#ifndef VM_INCLUDED
+#define VM_INCLUDED
+
+/* The VM runs the bytecode of Scripts, and keeps the functions they
+   define, which may then be called from any line. */
+
+int vmRun(Script_T oScript, History_T oHistList, char *pcProgName);
+/* Execute oScript, and return the exit status of the last command it
+   ran, or 0 if it ran none. A command that SIGINT killed ends the 
+   execution, so ^C interrupts a loop. pcProgName is used in printing
+   error messages. It is a checked runtime error for oScript, 
+   oHistList, or pcProgName to be NULL. */
+
+int vmIsCall(DynArray_T oCommands);
+/* Return TRUE if a stage of the pipeline oCommands names a function,
+   and FALSE otherwise. It is a checked runtime error for oCommands
+   to be NULL. */
+
+int vmIsTimed(DynArray_T oCommands);
+/* Return TRUE if the first command of the pipeline oCommands is 
+   "time" followed by a command, which vmExecute() then times, and 
+   FALSE otherwise. It is a checked runtime error for oCommands to be
+   NULL or empty. */
+
+int vmExecute(DynArray_T oCommands, int iBackground,
+              History_T oHistList, char *pcProgName);
+/* Execute the pipeline oCommands as execute() does, unless
+   vmIsCall() is TRUE of it. In that case, if it is a single command
+   in the foreground without redirections, call the function it
+   names, with its arguments as the positional parameters, and return
+   the exit status of the function; otherwise write an error to
+   stderr and return EXIT_FAILURE. If vmIsTimed() is TRUE of 
+   oCommands, remove "time" from it first, and write the resource 
+   usage of the pipeline to stderr once it has run; a pipeline in 
+   the background or a function call cannot be timed, and is 
+   rejected with an error. pcProgName is used in
+   printing error messages. It is a checked runtime error for 
+   oCommands, oHistList, or pcProgName to be NULL. It is a checked 
+   runtime error for oCommands to be empty. */
+
+#endif                      /* VM_INCLUDED */